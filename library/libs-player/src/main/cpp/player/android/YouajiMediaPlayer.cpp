@@ -6,6 +6,10 @@ YouajiMediaPlayer::YouajiMediaPlayer() {
     mIsAbortRequest = true;
     mVideoDevice = nullptr;
     mMediaPlayer = nullptr;
+    mRecycledPlayer = nullptr;
+    mRecyclePending = false;
+    mReadingQueue = nullptr;
+    mSourceSerial = 0;
     mMediaPlayerListener = nullptr;
     mIsPrepareSync = false;
     mPrepareStatus = NO_ERROR;
@@ -22,7 +26,7 @@ YouajiMediaPlayer::~YouajiMediaPlayer() {
 void YouajiMediaPlayer::init() {
     mMutex.lock();
     mIsAbortRequest = false;
-    mCondition.signal();
+    mCondition.broadcast();
     mMutex.unlock();
 
     mMutex.lock();
@@ -63,10 +67,14 @@ void YouajiMediaPlayer::changeFilter(int type, const int id) {
 void YouajiMediaPlayer::disconnect() {
     mMutex.lock();
     mIsAbortRequest = true;
-    mCondition.signal();
+    mCondition.broadcast();
     mMutex.unlock();
-    // 重置
-    reset();
+    // 先解除关联，停止消息分发和输出，消息线程可以马上退出
+    mIsPrepareSync = false;
+    MediaPlayer *mediaPlayer = mMediaPlayer;
+    if (mediaPlayer != nullptr) {
+        mediaPlayer->detach();
+    }
     LOGD("YouajiMediaPlayer->player disconnect");
     if (mMessageThread != nullptr) {
         LOGD("YouajiMediaPlayer->删除消息通知线程---开始");
@@ -75,11 +83,28 @@ void YouajiMediaPlayer::disconnect() {
         LOGD("YouajiMediaPlayer->删除消息通知线程---完成");
         mMessageThread = nullptr;
     }
+    mMediaPlayer = nullptr;
 
+    // 立即断开 Surface，播放器和渲染环境交给回收线程销毁
     if (mVideoDevice != nullptr) {
+        mVideoDevice->detachSurface();
+    }
+    // 还在软重置的播放器不再交还，由回收线程直接销毁
+    PlayerReaper::getInstance()->cancelRecycle(this);
+    mMutex.lock();
+    MediaPlayer *recycledPlayer = mRecycledPlayer;
+    mRecycledPlayer = nullptr;
+    mRecyclePending = false;
+    mMutex.unlock();
+    if (recycledPlayer != nullptr) {
+        PlayerReaper::getInstance()->release(recycledPlayer);
+    }
+    if (mediaPlayer != nullptr) {
+        PlayerReaper::getInstance()->release(mediaPlayer, mVideoDevice);
+    } else {
         delete mVideoDevice;
-        mVideoDevice = nullptr;
     }
+    mVideoDevice = nullptr;
     if (mMediaPlayerListener != nullptr) {
         delete mMediaPlayerListener;
         mMediaPlayerListener = nullptr;
@@ -91,11 +116,75 @@ status_t YouajiMediaPlayer::setDataSource(const char *url, int64_t offset, const
         return BAD_VALUE;
     }
 
+    MediaPlayer *mediaPlayer = mMediaPlayer;
+    if (mediaPlayer == nullptr) {
+        // 优先使用预加载的播放器，已经打开文件并解码出第一帧
+        mediaPlayer = PlayerPreloadPool::getInstance()->acquire(url);
+        mMutex.lock();
+        if (mediaPlayer == nullptr) {
+            // 紧接着 reset 调用时软重置通常还在回收线程中进行，等待一小段时间再复用
+            int64_t deadline = av_gettime_relative() + RECYCLE_WAIT_TIMEOUT * 1000;
+            while (mRecyclePending && !mIsAbortRequest) {
+                int64_t remaining = deadline - av_gettime_relative();
+                if (remaining <= 0) {
+                    break;
+                }
+                mCondition.waitRelative(mMutex, remaining * 1000);
+            }
+        }
+        // 超时后不再等待，软重置完成时由回收线程直接销毁，不会一直占用解码器和音频输出
+        mRecyclePending = false;
+        MediaPlayer *recycledPlayer = mRecycledPlayer;
+        mRecycledPlayer = nullptr;
+        mMutex.unlock();
+        if (mediaPlayer != nullptr) {
+            if (recycledPlayer != nullptr) {
+                PlayerReaper::getInstance()->release(recycledPlayer);
+            }
+        } else if (recycledPlayer != nullptr) {
+            // 其次复用软重置保留下来的播放器，等待超时时创建新的播放器
+            mediaPlayer = recycledPlayer;
+            mediaPlayer->setDataSource(url, offset, headers);
+        } else {
+            mediaPlayer = new MediaPlayer();
+            mediaPlayer->setDataSource(url, offset, headers);
+        }
+    } else {
+        mediaPlayer->setDataSource(url, offset, headers);
+    }
+    mediaPlayer->setVideoDevice(mVideoDevice);
+    // 唤醒等待下一个播放器的消息线程
+    mMutex.lock();
+    mMediaPlayer = mediaPlayer;
+    mSourceSerial++;
+    mCondition.broadcast();
+    mMutex.unlock();
+    return NO_ERROR;
+}
+
+status_t YouajiMediaPlayer::enqueueDataSource(const char *url, int64_t offset, const char *headers) {
+    if (url == nullptr) {
+        return BAD_VALUE;
+    }
     if (mMediaPlayer == nullptr) {
-        mMediaPlayer = new MediaPlayer();
+        return INVALID_OPERATION;
+    }
+    mMediaPlayer->enqueueDataSource(url, offset, headers);
+    return NO_ERROR;
+}
+
+status_t YouajiMediaPlayer::clearPlaylist() {
+    if (mMediaPlayer != nullptr) {
+        mMediaPlayer->clearPlaylist();
+    }
+    return NO_ERROR;
+}
+
+status_t YouajiMediaPlayer::trimMemory(int level) {
+    MemoryPressure pressure = MemoryBudget::getInstance()->trimMemory(level);
+    if (mMediaPlayer != nullptr) {
+        mMediaPlayer->trimMemory(pressure);
     }
-    mMediaPlayer->setDataSource(url, offset, headers);
-    mMediaPlayer->setVideoDevice(mVideoDevice);
     return NO_ERROR;
 }
 
@@ -248,13 +337,37 @@ long YouajiMediaPlayer::getDuration() {
 status_t YouajiMediaPlayer::reset() {
     mIsPrepareSync = false;
     if (mMediaPlayer != nullptr) {
-        mMediaPlayer->reset();
-        delete mMediaPlayer;
+        // 视频输出设备继续给下一个播放器使用，只断开；播放器软重置后保留，解码器和音频输出留给下一个数据源
+        MediaPlayer *mediaPlayer = mMediaPlayer;
+        mediaPlayer->detach();
+        AVMessageQueue *messageQueue = mediaPlayer->getMessageQueue();
+        mMutex.lock();
         mMediaPlayer = nullptr;
+        // detach 已经停止消息队列，等消息线程离开之后才交出播放器，之后播放器可能被销毁
+        while (messageQueue != nullptr && mReadingQueue == messageQueue) {
+            mCondition.wait(mMutex);
+        }
+        mRecyclePending = true;
+        mMutex.unlock();
+        // 软重置需要等待线程退出，交给回收线程执行，完成后交还到 mRecycledPlayer
+        PlayerReaper::getInstance()->recycle(mediaPlayer, this);
     }
     return NO_ERROR;
 }
 
+MediaPlayer *YouajiMediaPlayer::onPlayerRecycled(MediaPlayer *player) {
+    Mutex::Autolock lock(mMutex);
+    // setDataSource 已经不再等待或者已经断开，保留下来也不会再使用，交给回收线程销毁
+    if (!mRecyclePending) {
+        return player;
+    }
+    mRecyclePending = false;
+    MediaPlayer *displaced = mRecycledPlayer;
+    mRecycledPlayer = player;
+    mCondition.broadcast();
+    return displaced;
+}
+
 status_t YouajiMediaPlayer::setAudioStreamType(int type) {
     return NO_ERROR;
 }
@@ -312,6 +425,60 @@ void YouajiMediaPlayer::setPitch(float pitch) {
     }
 }
 
+void YouajiMediaPlayer::setAudioFilter(const char *filters) {
+    if (mMediaPlayer != nullptr) {
+        mMediaPlayer->setAudioFilter(filters);
+    }
+}
+
+void YouajiMediaPlayer::setAudioAnalyzer(int enable) {
+    if (mMediaPlayer != nullptr) {
+        mMediaPlayer->setAudioAnalyzer(enable);
+    }
+}
+
+status_t YouajiMediaPlayer::getAudioAnalysis(AudioAnalysis *analysis, long *position) {
+    if (mMediaPlayer != nullptr) {
+        return mMediaPlayer->getAudioAnalysis(analysis, position);
+    }
+    return INVALID_OPERATION;
+}
+
+status_t YouajiMediaPlayer::selectAudioTrack(int streamIndex) {
+    if (mMediaPlayer != nullptr) {
+        return mMediaPlayer->selectAudioTrack(streamIndex);
+    }
+    return INVALID_OPERATION;
+}
+
+int YouajiMediaPlayer::getSelectedAudioTrack() {
+    if (mMediaPlayer != nullptr) {
+        return mMediaPlayer->getSelectedAudioTrack();
+    }
+    return -1;
+}
+
+int YouajiMediaPlayer::getAudioTracks(int *indexes, int size) {
+    if (mMediaPlayer != nullptr) {
+        return mMediaPlayer->getAudioTracks(indexes, size);
+    }
+    return 0;
+}
+
+status_t YouajiMediaPlayer::setMixTrack(int streamIndex, float gain) {
+    if (mMediaPlayer != nullptr) {
+        return mMediaPlayer->setMixTrack(streamIndex, gain);
+    }
+    return INVALID_OPERATION;
+}
+
+status_t YouajiMediaPlayer::removeMixTrack(int streamIndex) {
+    if (mMediaPlayer != nullptr) {
+        return mMediaPlayer->removeMixTrack(streamIndex);
+    }
+    return INVALID_OPERATION;
+}
+
 status_t YouajiMediaPlayer::setAudioSessionId(int sessionId) {
     if (sessionId < 0) {
         return BAD_VALUE;
@@ -387,21 +554,36 @@ void YouajiMediaPlayer::postEvent(int what, int arg1, int arg2, void *obj) {
 void YouajiMediaPlayer::run() {
 
     int retval;
+    int abortedSerial = -1;
     while (true) {
 
+        // 等待播放器初始化，重置时播放器的消息队列会被中止，等待下一次 setDataSource
+        mMutex.lock();
+        while (!mIsAbortRequest
+               && (!mMediaPlayer || !mMediaPlayer->getMessageQueue() || abortedSerial == mSourceSerial)) {
+            mCondition.wait(mMutex);
+        }
         if (mIsAbortRequest) {
+            mMutex.unlock();
             break;
         }
-
-        // 如果此时播放器还没准备好，则睡眠10毫秒，等待播放器初始化
-        if (!mMediaPlayer || !mMediaPlayer->getMessageQueue()) {
-            av_usleep(10 * 1000);
-            continue;
-        }
+        int serial = mSourceSerial;
+        AVMessageQueue *messageQueue = mMediaPlayer->getMessageQueue();
+        mReadingQueue = messageQueue;
+        mMutex.unlock();
 
         AVMessage msg;
-        retval = mMediaPlayer->getMessageQueue()->getMessage(&msg);
+        retval = messageQueue->getMessage(&msg);
+        // 离开消息队列，reset 等到这里之后才把播放器交给回收线程
+        mMutex.lock();
+        mReadingQueue = nullptr;
+        mCondition.broadcast();
+        mMutex.unlock();
         if (retval < 0) {
+            if (!mIsAbortRequest) {
+                abortedSerial = serial;
+                continue;
+            }
             LOGE("YouajiMediaPlayer->player get message error.");
             break;
         }
@@ -420,7 +602,13 @@ void YouajiMediaPlayer::run() {
                     mIsPrepareSync = false;
                     mPrepareStatus = msg.arg1;
                 }
-                postEvent(MEDIA_ERROR, msg.arg1, 0);
+                if (msg.arg1 == ERROR_TIMED_OUT) {
+                    // 超时阶段只记录日志，上层通过 extra 区分超时和其他错误
+                    LOGE("YouajiMediaPlayer->[POST EVENT] timed out in phase %d.", msg.arg2);
+                    postEvent(MEDIA_ERROR, MEDIA_ERROR_UNKNOWN, MEDIA_ERROR_TIMED_OUT);
+                } else {
+                    postEvent(MEDIA_ERROR, msg.arg1, msg.arg2);
+                }
                 break;
             }
 
@@ -460,11 +648,13 @@ void YouajiMediaPlayer::run() {
 
             case MSG_VIDEO_RENDERING_START: {
                 LOGD("YouajiMediaPlayer->[POST EVENT] video playing.");
+                postEvent(MEDIA_INFO, MEDIA_INFO_RENDERING_START, 0);
                 break;
             }
 
             case MSG_AUDIO_RENDERING_START: {
                 LOGD("YouajiMediaPlayer->[POST EVENT] audio playing.");
+                postEvent(MEDIA_INFO, MEDIA_INFO_AUDIO_RENDERING_START, 0);
                 break;
             }
 
@@ -570,6 +760,24 @@ void YouajiMediaPlayer::run() {
                 break;
             }
 
+            case MSG_PLAYLIST_ITEM_STARTED: {
+                LOGD("YouajiMediaPlayer->[POST EVENT] playlist item %d started.", msg.arg1);
+                postEvent(MEDIA_INFO, MEDIA_INFO_STARTED_AS_NEXT, msg.arg1);
+                break;
+            }
+
+            case MSG_AUDIO_TRACK_CHANGED: {
+                LOGD("YouajiMediaPlayer->[POST EVENT] audio track changed to %d.", msg.arg1);
+                postEvent(MEDIA_INFO, MEDIA_INFO_AUDIO_TRACK_CHANGED, msg.arg1);
+                break;
+            }
+
+            case MSG_STARTUP_TIMING: {
+                LOGD("YouajiMediaPlayer->[POST EVENT] startup phase %d takes %d ms.", msg.arg1, msg.arg2);
+                postEvent(MEDIA_INFO, MEDIA_INFO_STARTUP_TIMING + msg.arg1, msg.arg2);
+                break;
+            }
+
             default: {
                 LOGE("YouajiMediaPlayer->[POST EVENT] unknown [what:%d, arg1:%d, arg2:%d].", msg.what, msg.arg1, msg.arg2);
                 break;
@@ -7,6 +7,7 @@
 #include <cstring>
 #include <cstdio>
 #include <memory.h>
+#include <vector>
 
 extern "C" {
 #include <libavcodec/jni.h>
@@ -309,6 +310,58 @@ void Player_nativeSetDataSource(JNIEnv *env, jobject thiz, jstring _path) {
     Player_nativeSetDataSource_header(env, thiz, _path, NULL, NULL);
 }
 
+void Player_nativeEnqueueDataSource(JNIEnv *env, jobject thiz, jstring _path) {
+    YouajiMediaPlayer *mp = getMediaPlayer(env, thiz);
+    if (mp == NULL || _path == NULL) {
+        return;
+    }
+    const char *path = env->GetStringUTFChars(_path, 0);
+    if (path == NULL) {
+        return;
+    }
+    status_t opStatus = mp->enqueueDataSource(path);
+    env->ReleaseStringUTFChars(_path, path);
+    process_media_player_call(env, thiz, opStatus, "java/lang/IllegalStateException", "enqueueDataSource failed.");
+}
+
+void Player_nativeClearPlaylist(JNIEnv *env, jobject thiz) {
+    YouajiMediaPlayer *mp = getMediaPlayer(env, thiz);
+    if (mp == NULL) {
+        return;
+    }
+    mp->clearPlaylist();
+}
+
+void Player_nativeTrimMemory(JNIEnv *env, jobject thiz, jint level) {
+    YouajiMediaPlayer *mp = getMediaPlayer(env, thiz);
+    if (mp == NULL) {
+        MemoryBudget::getInstance()->trimMemory(level);
+        return;
+    }
+    mp->trimMemory(level);
+}
+
+void Player_nativeSetPrerollTime(JNIEnv *env, jobject thiz, jlong millisecond) {
+    YouajiMediaPlayer *mp = getMediaPlayer(env, thiz);
+    if (mp == NULL) {
+        return;
+    }
+    mp->setOption(OPT_CATEGORY_PLAYER, "prerolltime", (int64_t) millisecond);
+}
+
+void Player_nativeSetVideoFilter(JNIEnv *env, jobject thiz, jstring _filters, jint threads) {
+    YouajiMediaPlayer *mp = getMediaPlayer(env, thiz);
+    if (mp == NULL) {
+        return;
+    }
+    const char *filters = _filters != NULL ? env->GetStringUTFChars(_filters, 0) : NULL;
+    mp->setOption(OPT_CATEGORY_PLAYER, "vf", filters != NULL ? filters : "");
+    mp->setOption(OPT_CATEGORY_PLAYER, "filterthreads", (int64_t) threads);
+    if (filters != NULL) {
+        env->ReleaseStringUTFChars(_filters, filters);
+    }
+}
+
 void Player_nativePrepare(JNIEnv *env, jobject thiz) {
     YouajiMediaPlayer *mp = getMediaPlayer(env, thiz);
     if (mp == NULL) {
@@ -466,6 +519,103 @@ void Player_nativeSetPitch(JNIEnv *env, jobject thiz, jfloat pitch) {
     mp->setPitch(pitch);
 }
 
+void Player_nativeSetAudioFilter(JNIEnv *env, jobject thiz, jstring _filters) {
+    YouajiMediaPlayer *mp = getMediaPlayer(env, thiz);
+    if (mp == NULL) {
+        jniThrowException(env, "java/lang/IllegalStateException");
+        return;
+    }
+    const char *filters = _filters != NULL ? env->GetStringUTFChars(_filters, 0) : NULL;
+    mp->setAudioFilter(filters);
+    if (filters != NULL) {
+        env->ReleaseStringUTFChars(_filters, filters);
+    }
+}
+
+void Player_nativeSetAudioAnalyzer(JNIEnv *env, jobject thiz, jboolean enable) {
+    YouajiMediaPlayer *mp = getMediaPlayer(env, thiz);
+    if (mp == NULL) {
+        jniThrowException(env, "java/lang/IllegalStateException");
+        return;
+    }
+    mp->setAudioAnalyzer(enable);
+}
+
+jlong Player_nativeGetAudioAnalysis(JNIEnv *env, jobject thiz, jfloatArray levels, jfloatArray spectrum) {
+    YouajiMediaPlayer *mp = getMediaPlayer(env, thiz);
+    if (mp == NULL) {
+        jniThrowException(env, "java/lang/IllegalStateException");
+        return -1;
+    }
+    AudioAnalysis analysis;
+    long position = 0;
+    if (mp->getAudioAnalysis(&analysis, &position) != NO_ERROR) {
+        return -1;
+    }
+    // levels 依次为左右声道的均方根电平和峰值电平
+    if (levels != NULL) {
+        jfloat values[4] = {analysis.rms[0], analysis.rms[1], analysis.peak[0], analysis.peak[1]};
+        env->SetFloatArrayRegion(levels, 0, FFMIN(env->GetArrayLength(levels), 4), values);
+    }
+    if (spectrum != NULL) {
+        env->SetFloatArrayRegion(spectrum, 0, FFMIN(env->GetArrayLength(spectrum), AUDIO_ANALYZER_BINS),
+                                 analysis.spectrum);
+    }
+    return position;
+}
+
+jint Player_nativeSelectAudioTrack(JNIEnv *env, jobject thiz, jint streamIndex) {
+    YouajiMediaPlayer *mp = getMediaPlayer(env, thiz);
+    if (mp == NULL) {
+        jniThrowException(env, "java/lang/IllegalStateException");
+        return INVALID_OPERATION;
+    }
+    return mp->selectAudioTrack(streamIndex);
+}
+
+jint Player_nativeGetSelectedAudioTrack(JNIEnv *env, jobject thiz) {
+    YouajiMediaPlayer *mp = getMediaPlayer(env, thiz);
+    if (mp == NULL) {
+        jniThrowException(env, "java/lang/IllegalStateException");
+        return -1;
+    }
+    return mp->getSelectedAudioTrack();
+}
+
+jintArray Player_nativeGetAudioTracks(JNIEnv *env, jobject thiz) {
+    YouajiMediaPlayer *mp = getMediaPlayer(env, thiz);
+    if (mp == NULL) {
+        jniThrowException(env, "java/lang/IllegalStateException");
+        return NULL;
+    }
+    int count = mp->getAudioTracks(NULL, 0);
+    std::vector<jint> indexes(count > 0 ? count : 1);
+    count = mp->getAudioTracks(indexes.data(), count);
+    jintArray result = env->NewIntArray(count);
+    if (result != NULL && count > 0) {
+        env->SetIntArrayRegion(result, 0, count, indexes.data());
+    }
+    return result;
+}
+
+jint Player_nativeSetMixTrack(JNIEnv *env, jobject thiz, jint streamIndex, jfloat gain) {
+    YouajiMediaPlayer *mp = getMediaPlayer(env, thiz);
+    if (mp == NULL) {
+        jniThrowException(env, "java/lang/IllegalStateException");
+        return INVALID_OPERATION;
+    }
+    return mp->setMixTrack(streamIndex, gain);
+}
+
+jint Player_nativeRemoveMixTrack(JNIEnv *env, jobject thiz, jint streamIndex) {
+    YouajiMediaPlayer *mp = getMediaPlayer(env, thiz);
+    if (mp == NULL) {
+        jniThrowException(env, "java/lang/IllegalStateException");
+        return INVALID_OPERATION;
+    }
+    return mp->removeMixTrack(streamIndex);
+}
+
 void Player_nativeSetRate(JNIEnv *env, jobject thiz, jfloat rate) {
     YouajiMediaPlayer *mp = getMediaPlayer(env, thiz);
     if (mp == NULL) {
@@ -596,6 +746,114 @@ jboolean Player_nativeScreenshot(JNIEnv *env, jobject thiz, jstring filePath) {
     return (jboolean) (mp->screenshot(file) ? JNI_TRUE : JNI_FALSE);
 }
 
+void Player_nativePreload(JNIEnv *env, jclass clazz, jstring _path) {
+    if (_path == NULL) {
+        return;
+    }
+    const char *path = env->GetStringUTFChars(_path, 0);
+    if (path == NULL) {
+        return;
+    }
+    PlayerPreloadPool::getInstance()->preload(path);
+    env->ReleaseStringUTFChars(_path, path);
+}
+
+void Player_nativeCancelPreload(JNIEnv *env, jclass clazz, jstring _path) {
+    if (_path == NULL) {
+        PlayerPreloadPool::getInstance()->clear();
+        return;
+    }
+    const char *path = env->GetStringUTFChars(_path, 0);
+    if (path == NULL) {
+        return;
+    }
+    PlayerPreloadPool::getInstance()->remove(path);
+    env->ReleaseStringUTFChars(_path, path);
+}
+
+void Player_nativeSetPreloadPolicy(JNIEnv *env, jclass clazz, jint maxPlayers, jlong memoryBudget) {
+    PlayerPreloadPool::getInstance()->setPolicy(maxPlayers, memoryBudget);
+}
+
+void Player_nativeSetMemoryBudget(JNIEnv *env, jclass clazz, jlong budget) {
+    MemoryBudget::getInstance()->setBudget(budget);
+}
+
+void Player_nativeTrimCaches(JNIEnv *env, jclass clazz, jint level) {
+    MemoryBudget::getInstance()->trimMemory(level);
+}
+
+void Player_nativeResetMemoryPressure(JNIEnv *env, jclass clazz) {
+    MemoryBudget::getInstance()->setPressure(MEMORY_PRESSURE_NONE);
+}
+
+void Player_nativePrewarm(JNIEnv *env, jclass clazz) {
+    PlayerRuntime::getInstance()->prewarm();
+}
+
+jlong Player_nativeBenchmarkTimeStretcher(JNIEnv *env, jclass clazz, jint type, jfloat speed) {
+    return TimeStretcher::benchmark((TimeStretcherType) type, speed, 48000, 2);
+}
+
+void Player_nativeAnalyzeBeats(JNIEnv *env, jclass clazz, jstring _path) {
+    if (_path == NULL) {
+        return;
+    }
+    const char *path = env->GetStringUTFChars(_path, 0);
+    if (path == NULL) {
+        return;
+    }
+    BeatAnalyzer::getInstance()->analyze(path);
+    env->ReleaseStringUTFChars(_path, path);
+}
+
+void Player_nativeCancelBeatAnalysis(JNIEnv *env, jclass clazz, jstring _path) {
+    if (_path == NULL) {
+        BeatAnalyzer::getInstance()->clear();
+        return;
+    }
+    const char *path = env->GetStringUTFChars(_path, 0);
+    if (path == NULL) {
+        return;
+    }
+    BeatAnalyzer::getInstance()->remove(path);
+    env->ReleaseStringUTFChars(_path, path);
+}
+
+jlongArray Player_nativeGetBeatAnalysis(JNIEnv *env, jclass clazz, jstring _path, jdoubleArray info) {
+    if (_path == NULL) {
+        return NULL;
+    }
+    const char *path = env->GetStringUTFChars(_path, 0);
+    if (path == NULL) {
+        return NULL;
+    }
+    BeatAnalysis analysis;
+    BeatAnalysisState state = BeatAnalyzer::getInstance()->getAnalysis(path, &analysis);
+    env->ReleaseStringUTFChars(_path, path);
+    if (state != BEAT_ANALYSIS_DONE) {
+        analysis.bpm = 0;
+        analysis.duration = 0;
+        analysis.cpuTime = 0;
+        analysis.speed = 0;
+    }
+    // info 依次为分析状态、速度、音频时长(毫秒)、CPU 时间(微秒)、每秒 CPU 时间处理的音频秒数
+    if (info != NULL) {
+        jdouble values[5] = {(jdouble) state, analysis.bpm, (jdouble) analysis.duration, (jdouble) analysis.cpuTime,
+                             analysis.speed};
+        env->SetDoubleArrayRegion(info, 0, FFMIN(env->GetArrayLength(info), 5), values);
+    }
+    if (state != BEAT_ANALYSIS_DONE) {
+        return NULL;
+    }
+    jlongArray beats = env->NewLongArray((jsize) analysis.beats.size());
+    if (beats != NULL && !analysis.beats.empty()) {
+        std::vector<jlong> values(analysis.beats.begin(), analysis.beats.end());
+        env->SetLongArrayRegion(beats, 0, (jsize) values.size(), values.data());
+    }
+    return beats;
+}
+
 /**
  * ===============================================================================================================
  * ===============================================================================================================
@@ -609,6 +867,11 @@ static const JNINativeMethod gMethods[] = {
         {"nativeSetDataSource",      "(Ljava/io/FileDescriptor;JJ)V",                               (void *) Player_nativeSetDataSource_fileDescriptor},
         {"nativeSetDataSource",      "(Ljava/lang/String;[Ljava/lang/String;[Ljava/lang/String;)V", (void *) Player_nativeSetDataSource_header},
         {"nativeSetDataSource",      "(Ljava/lang/String;)V",                                       (void *) Player_nativeSetDataSource},
+        {"nativeEnqueueDataSource",  "(Ljava/lang/String;)V",                                       (void *) Player_nativeEnqueueDataSource},
+        {"nativeClearPlaylist",      "()V",                                                         (void *) Player_nativeClearPlaylist},
+        {"nativeSetPrerollTime",     "(J)V",                                                        (void *) Player_nativeSetPrerollTime},
+        {"nativeSetVideoFilter",     "(Ljava/lang/String;I)V",                                      (void *) Player_nativeSetVideoFilter},
+        {"nativeTrimMemory",         "(I)V",                                                        (void *) Player_nativeTrimMemory},
         {"nativePrepare",            "()V",                                                         (void *) Player_nativePrepare},
         {"nativePrepareAsync",       "()V",                                                         (void *) Player_nativePrepareAsync},
         {"nativeStart",              "()V",                                                         (void *) Player_nativeStart},
@@ -627,6 +890,14 @@ static const JNINativeMethod gMethods[] = {
         {"nativeGetLooping",         "()Z",                                                         (void *) Player_nativeGetLooping},
         {"nativeSetMute",            "(Z)V",                                                        (void *) Player_nativeSetMute},
         {"nativeSetPitch",           "(F)V",                                                        (void *) Player_nativeSetPitch},
+        {"nativeSetAudioFilter",     "(Ljava/lang/String;)V",                                       (void *) Player_nativeSetAudioFilter},
+        {"nativeSetAudioAnalyzer",   "(Z)V",                                                        (void *) Player_nativeSetAudioAnalyzer},
+        {"nativeGetAudioAnalysis",   "([F[F)J",                                                     (void *) Player_nativeGetAudioAnalysis},
+        {"nativeSelectAudioTrack",   "(I)I",                                                        (void *) Player_nativeSelectAudioTrack},
+        {"nativeGetSelectedAudioTrack", "()I",                                                      (void *) Player_nativeGetSelectedAudioTrack},
+        {"nativeGetAudioTracks",     "()[I",                                                        (void *) Player_nativeGetAudioTracks},
+        {"nativeSetMixTrack",        "(IF)I",                                                       (void *) Player_nativeSetMixTrack},
+        {"nativeRemoveMixTrack",     "(I)I",                                                        (void *) Player_nativeRemoveMixTrack},
         {"nativeSetRate",            "(F)V",                                                        (void *) Player_nativeSetRate},
         {"nativeGetRotate",          "()I",                                                         (void *) Player_nativeGetRotate},
         {"nativeGetDuration",        "()J",                                                         (void *) Player_nativeGetDuration},
@@ -640,6 +911,17 @@ static const JNINativeMethod gMethods[] = {
         {"nativeStopRecord",         "()Z",                                                         (void *) Player_nativeStopRecord},
         {"nativeIsRecording",        "()Z",                                                         (void *) Player_nativeIsRecording},
         {"nativeScreenshot",         "(Ljava/lang/String;)Z",                                       (void *) Player_nativeScreenshot},
+        {"nativePreload",            "(Ljava/lang/String;)V",                                       (void *) Player_nativePreload},
+        {"nativeCancelPreload",      "(Ljava/lang/String;)V",                                       (void *) Player_nativeCancelPreload},
+        {"nativeSetPreloadPolicy",   "(IJ)V",                                                       (void *) Player_nativeSetPreloadPolicy},
+        {"nativeSetMemoryBudget",    "(J)V",                                                        (void *) Player_nativeSetMemoryBudget},
+        {"nativeTrimCaches",         "(I)V",                                                        (void *) Player_nativeTrimCaches},
+        {"nativeResetMemoryPressure", "()V",                                                        (void *) Player_nativeResetMemoryPressure},
+        {"nativePrewarm",            "()V",                                                         (void *) Player_nativePrewarm},
+        {"nativeBenchmarkTimeStretcher", "(IF)J",                                                   (void *) Player_nativeBenchmarkTimeStretcher},
+        {"nativeAnalyzeBeats",       "(Ljava/lang/String;)V",                                       (void *) Player_nativeAnalyzeBeats},
+        {"nativeCancelBeatAnalysis", "(Ljava/lang/String;)V",                                       (void *) Player_nativeCancelBeatAnalysis},
+        {"nativeGetBeatAnalysis",    "(Ljava/lang/String;[D)[J",                                    (void *) Player_nativeGetBeatAnalysis},
 
 };
 
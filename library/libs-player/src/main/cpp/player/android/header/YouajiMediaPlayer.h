@@ -9,6 +9,12 @@
 #include <libavutil/dict.h>
 #include <GLESDevice.h>
 #include <MediaPlayer.h>
+#include <PlayerPreloadPool.h>
+#include <PlayerReaper.h>
+#include <BeatAnalyzer.h>
+
+// reset 之后紧接着 setDataSource 时，等待回收线程软重置完成的最长时间，单位毫秒
+#define RECYCLE_WAIT_TIMEOUT 300
 
 enum media_event_type {
     MEDIA_NOP = 0, // interface test message
@@ -35,6 +41,9 @@ enum media_error_type {
 
     // 2xx
     MEDIA_ERROR_NOT_VALID_FOR_PROGRESSIVE_PLAYBACK = 200,
+
+    // 超时，作为 extra 上报，what 为 MEDIA_ERROR_UNKNOWN
+    MEDIA_ERROR_TIMED_OUT = -110,
 };
 
 enum media_info_type {
@@ -71,6 +80,16 @@ enum media_info_type {
 
     //9xx
     MEDIA_INFO_TIMED_TEXT_ERROR = 900,
+
+    // 10xxx
+    // The player just pushed the very first audio frame for rendering
+    MEDIA_INFO_AUDIO_RENDERING_START = 10002,
+    // 切换音轨完成，extra 为新的音频流索引
+    MEDIA_INFO_AUDIO_TRACK_CHANGED = 10003,
+
+    // 11xxx
+    // 起播耗时，what 为 MEDIA_INFO_STARTUP_TIMING + 阶段(StartupPhase)，extra 为距离开始准备的毫秒数
+    MEDIA_INFO_STARTUP_TIMING = 11000,
 };
 
 /**
@@ -83,7 +102,7 @@ public:
 
 /**
  */
-class YouajiMediaPlayer : public Runnable {
+class YouajiMediaPlayer : public Runnable, public RecycleListener {
 public:
     /**
      */
@@ -109,6 +128,28 @@ public:
      */
     status_t setDataSource(const char *url, int64_t offset = 0, const char *headers = NULL);
 
+    /**
+     * 添加到播放列表，当前条目播放结束后无缝衔接播放
+     * @param url
+     * @param offset
+     * @param headers
+     * @return
+     */
+    status_t enqueueDataSource(const char *url, int64_t offset = 0, const char *headers = NULL);
+
+    /**
+     * 清空播放列表中等待播放的条目
+     * @return
+     */
+    status_t clearPlaylist();
+
+    /**
+     * 内存紧张时释放缓存，暂停中的播放器同时释放解码帧和渲染资源
+     * @param level onTrimMemory 的等级
+     * @return
+     */
+    status_t trimMemory(int level);
+
     /**
      *
      * @param allow
@@ -289,6 +330,54 @@ public:
      */
     void setPitch(float pitch);
 
+    /**
+     * @param filters 音频滤镜描述
+     */
+    void setAudioFilter(const char *filters);
+
+    /**
+     * @param enable 是否分析输出音频的电平和频谱
+     */
+    void setAudioAnalyzer(int enable);
+
+    /**
+     * @param analysis 最新的电平和频谱
+     * @param position 对应的播放位置，单位毫秒
+     * @return
+     */
+    status_t getAudioAnalysis(AudioAnalysis *analysis, long *position);
+
+    /**
+     * @param streamIndex 音频流索引
+     * @return
+     */
+    status_t selectAudioTrack(int streamIndex);
+
+    /**
+     * @return 当前选择的音频流索引
+     */
+    int getSelectedAudioTrack();
+
+    /**
+     * @param indexes
+     * @param size
+     * @return 音频流的数量
+     */
+    int getAudioTracks(int *indexes, int size);
+
+    /**
+     * @param streamIndex 音频流索引
+     * @param gain 增益
+     * @return
+     */
+    status_t setMixTrack(int streamIndex, float gain);
+
+    /**
+     * @param streamIndex 音频流索引
+     * @return
+     */
+    status_t removeMixTrack(int streamIndex);
+
     /**
      * @param sessionId
      * @return
@@ -350,6 +439,13 @@ public:
      */
     bool screenshot(const char *filePath);
 
+    /**
+     * 回收线程软重置完成后交还播放器
+     * @param player 软重置后的播放器
+     * @return 被替换下来的播放器
+     */
+    MediaPlayer *onPlayerRecycled(MediaPlayer *player) override;
+
 protected:
     //override表示重写了基类的虚函数
     void run() override;
@@ -370,6 +466,10 @@ private:
     bool mIsAbortRequest;
     GLESDevice *mVideoDevice;
     MediaPlayer *mMediaPlayer;
+    MediaPlayer *mRecycledPlayer;   // 软重置后保留的播放器，下次 setDataSource 时复用解码器和音频输出，由 mMutex 保护
+    bool mRecyclePending;           // reset 交给回收线程的软重置还没完成，setDataSource 不再等待时清除，由 mMutex 保护
+    AVMessageQueue *mReadingQueue;  // 消息线程正在读取的消息队列，reset 等它离开后才交出播放器，由 mMutex 保护
+    int mSourceSerial;              // 每次 setDataSource 加一，消息线程据此等待下一个播放器，由 mMutex 保护
     MediaPlayerListener *mMediaPlayerListener;
 
     bool mIsSeeking;
@@ -0,0 +1,200 @@
+#include "AudioAnalyzer.h"
+
+AudioAnalyzer::AudioAnalyzer() {
+    mThread = NULL;
+    mAbortRequest = false;
+    memset(mRing, 0, sizeof(mRing));
+    mWritten.store(0);
+    mSequence.store(0);
+    mEndPts.store(NAN);
+    mEndFrames.store(0);
+    mSpeed.store(1.0f);
+    mSampleRate.store(0);
+    mLatency.store(0);
+    mWriteTime.store(0);
+    mValidFrom.store(0);
+
+    mTx = NULL;
+    mTxFn = NULL;
+    float scale = 1.0f;
+    if (av_tx_init(&mTx, &mTxFn, AV_TX_FLOAT_FFT, 0, AUDIO_ANALYZER_FFT_SIZE, &scale, 0) < 0) {
+        LOGE("AudioAnalyzer->av_tx_init failed");
+        mTx = NULL;
+    }
+    mWindowGain = 0;
+    for (int i = 0; i < AUDIO_ANALYZER_FFT_SIZE; i++) {
+        mWindow[i] = 0.5f - 0.5f * cosf(2.0f * (float) M_PI * i / AUDIO_ANALYZER_FFT_SIZE);
+        mWindowGain += mWindow[i];
+    }
+
+    memset(mSlots, 0, sizeof(mSlots));
+    mBack = 0;
+    mMiddle.store(1);
+    mFront = 2;
+    mHasResult = false;
+}
+
+AudioAnalyzer::~AudioAnalyzer() {
+    stop();
+    av_tx_uninit(&mTx);
+}
+
+void AudioAnalyzer::start() {
+    mMutex.lock();
+    mAbortRequest = false;
+    mMutex.unlock();
+    if (!mThread) {
+        mThread = new Thread(this);
+        mThread->start();
+        LOGD("AudioAnalyzer->开启音频分析线程");
+    }
+}
+
+void AudioAnalyzer::stop() {
+    mMutex.lock();
+    mAbortRequest = true;
+    mCondition.signal();
+    mMutex.unlock();
+    if (mThread) {
+        mThread->join();
+        delete mThread;
+        mThread = NULL;
+        LOGD("AudioAnalyzer->删除音频分析线程");
+    }
+}
+
+void AudioAnalyzer::write(const int16_t *samples, int frames, int channels, int sampleRate, double endPts,
+                          float speed, int latency) {
+    if (frames <= 0 || channels <= 0) {
+        return;
+    }
+    // 只有音频回调写入，先写数据再发布写入位置，分析线程读到的位置之前的数据都已经写好
+    int64_t written = mWritten.load(std::memory_order_relaxed);
+    for (int i = 0; i < frames; i++) {
+        int index = (int) ((written + i) & (AUDIO_ANALYZER_RING_SIZE - 1));
+        const int16_t *frame = samples + i * channels;
+        mRing[0][index] = frame[0] * (1.0f / 32768.0f);
+        mRing[1][index] = (channels > 1 ? frame[1] : frame[0]) * (1.0f / 32768.0f);
+    }
+    written += frames;
+
+    // 写入位置和对应的时间需要一起更新，用版本号保证分析线程读到一致的值
+    mSequence.fetch_add(1, std::memory_order_acq_rel);
+    mEndPts.store(endPts, std::memory_order_relaxed);
+    mEndFrames.store(written, std::memory_order_relaxed);
+    mSpeed.store(speed > 0 ? speed : 1.0f, std::memory_order_relaxed);
+    mSampleRate.store(sampleRate, std::memory_order_relaxed);
+    mLatency.store(latency, std::memory_order_relaxed);
+    mWriteTime.store(av_gettime_relative(), std::memory_order_relaxed);
+    mSequence.fetch_add(1, std::memory_order_release);
+    mWritten.store(written, std::memory_order_release);
+}
+
+void AudioAnalyzer::flush() {
+    mValidFrom.store(mWritten.load(std::memory_order_relaxed), std::memory_order_release);
+}
+
+int AudioAnalyzer::getAnalysis(AudioAnalysis *analysis) {
+    Mutex::Autolock lock(mReadMutex);
+    int middle = mMiddle.load(std::memory_order_acquire);
+    if (middle & AUDIO_ANALYZER_FRESH) {
+        mFront = mMiddle.exchange(mFront, std::memory_order_acq_rel) & ~AUDIO_ANALYZER_FRESH;
+        mHasResult = true;
+    }
+    if (!mHasResult) {
+        return -1;
+    }
+    *analysis = mSlots[mFront];
+    return 0;
+}
+
+void AudioAnalyzer::run() {
+    for (;;) {
+        mMutex.lock();
+        if (!mAbortRequest) {
+            mCondition.waitRelative(mMutex, (int64_t) AUDIO_ANALYZER_INTERVAL * 1000);
+        }
+        bool abort = mAbortRequest;
+        mMutex.unlock();
+        if (abort) {
+            break;
+        }
+        if (!mTx) {
+            continue;
+        }
+
+        // 读取一致的写入位置和时间
+        unsigned int sequence;
+        double endPts;
+        int64_t endFrames;
+        float speed;
+        int sampleRate;
+        int latency;
+        int64_t writeTime;
+        do {
+            sequence = mSequence.load(std::memory_order_acquire);
+            endPts = mEndPts.load(std::memory_order_relaxed);
+            endFrames = mEndFrames.load(std::memory_order_relaxed);
+            speed = mSpeed.load(std::memory_order_relaxed);
+            sampleRate = mSampleRate.load(std::memory_order_relaxed);
+            latency = mLatency.load(std::memory_order_relaxed);
+            writeTime = mWriteTime.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while ((sequence & 1) || sequence != mSequence.load(std::memory_order_relaxed));
+        if (sampleRate <= 0) {
+            continue;
+        }
+
+        // 写入的数据领先于正在播放的位置一个设备缓冲，写入之后设备继续按采样率消耗
+        int64_t elapsed = (av_gettime_relative() - writeTime) * sampleRate / 1000000;
+        int64_t ahead = av_clip64(latency - elapsed, 0, AUDIO_ANALYZER_RING_SIZE - AUDIO_ANALYZER_FFT_SIZE);
+        int64_t end = endFrames - ahead;
+        if (end - AUDIO_ANALYZER_FFT_SIZE < mValidFrom.load(std::memory_order_acquire)) {
+            continue;
+        }
+        double pts = isnan(endPts) ? NAN : endPts - (double) (endFrames - end) * speed / sampleRate;
+        analyze(end, pts);
+    }
+}
+
+int AudioAnalyzer::analyze(int64_t end, double pts) {
+    int64_t start = end - AUDIO_ANALYZER_FFT_SIZE;
+    for (int i = 0; i < AUDIO_ANALYZER_FFT_SIZE; i++) {
+        int index = (int) ((start + i) & (AUDIO_ANALYZER_RING_SIZE - 1));
+        mLeft[i] = mRing[0][index];
+        mRight[i] = mRing[1][index];
+    }
+    // 复制期间音频回调可能绕回覆盖了窗口，这时丢弃这次结果
+    if (mWritten.load(std::memory_order_acquire) - start > AUDIO_ANALYZER_RING_SIZE) {
+        return -1;
+    }
+
+    AudioAnalysis *analysis = &mSlots[mBack];
+    analysis->pts = pts;
+    float sum[2] = {0, 0};
+    float peak[2] = {0, 0};
+    for (int i = 0; i < AUDIO_ANALYZER_FFT_SIZE; i++) {
+        sum[0] += mLeft[i] * mLeft[i];
+        sum[1] += mRight[i] * mRight[i];
+        peak[0] = FFMAX(peak[0], fabsf(mLeft[i]));
+        peak[1] = FFMAX(peak[1], fabsf(mRight[i]));
+        mFftIn[i].re = (mLeft[i] + mRight[i]) * 0.5f * mWindow[i];
+        mFftIn[i].im = 0;
+    }
+    for (int c = 0; c < 2; c++) {
+        analysis->rms[c] = sqrtf(sum[c] / AUDIO_ANALYZER_FFT_SIZE);
+        analysis->peak[c] = peak[c];
+    }
+
+    mTxFn(mTx, mFftOut, mFftIn, sizeof(AVComplexFloat));
+    // 实数输入的频谱对称，单边谱乘以 2，再按窗函数的系数和归一化
+    float scale = 2.0f / mWindowGain;
+    for (int i = 0; i < AUDIO_ANALYZER_BINS; i++) {
+        analysis->spectrum[i] = hypotf(mFftOut[i].re, mFftOut[i].im) * scale;
+    }
+    analysis->spectrum[0] *= 0.5f;
+
+    // 发布结果，换回上一个交换位置继续写入
+    mBack = mMiddle.exchange(mBack | AUDIO_ANALYZER_FRESH, std::memory_order_acq_rel) & ~AUDIO_ANALYZER_FRESH;
+    return 0;
+}
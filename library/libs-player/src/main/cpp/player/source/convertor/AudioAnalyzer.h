@@ -0,0 +1,128 @@
+#ifndef AUDIOANALYZER_H
+#define AUDIOANALYZER_H
+
+#include <atomic>
+#include <string.h>
+#include <Thread.h>
+#include "AndroidLog.h"
+
+extern "C" {
+#include "libavutil/common.h"
+#include "libavutil/time.h"
+#include "libavutil/tx.h"
+}
+
+// 频谱分析的窗口长度，单位为采样点，必须为 2 的幂
+#define AUDIO_ANALYZER_FFT_SIZE 1024
+// 输出的频点数量，从直流到奈奎斯特频率之前
+#define AUDIO_ANALYZER_BINS (AUDIO_ANALYZER_FFT_SIZE / 2)
+// 环形缓冲的长度，单位为采样点，必须为 2 的幂，需要容纳音频输出设备的缓冲再加一个分析窗口
+#define AUDIO_ANALYZER_RING_SIZE 32768
+// 分析的间隔，单位微秒
+#define AUDIO_ANALYZER_INTERVAL 33333
+// 三缓冲交换位置下标中表示有新结果的标志
+#define AUDIO_ANALYZER_FRESH 4
+
+/**
+ * 音频分析结果
+ */
+typedef struct AudioAnalysis {
+    double pts;                             // 分析窗口结束位置的时间，单位秒
+    float rms[2];                           // 左右声道的均方根电平，0 ~ 1
+    float peak[2];                          // 左右声道的峰值电平，0 ~ 1
+    float spectrum[AUDIO_ANALYZER_BINS];    // 左右声道平均后加汉宁窗的幅度谱，满幅正弦波约为 1
+} AudioAnalysis;
+
+/**
+ * 音频电平和频谱分析
+ * 音频回调把输出的数据写入无锁的环形缓冲，分析线程按设备缓冲的延时和写入后经过的时间推算出正在播放的位置，
+ * 取出它之前的一个窗口计算电平和频谱后写入三缓冲，读取方随时取最新的结果，分析线程和音频回调都不会被读取方阻塞。
+ * 不开启时不创建，音频回调中没有额外的开销
+ */
+class AudioAnalyzer : public Runnable {
+public:
+    AudioAnalyzer();
+
+    virtual ~AudioAnalyzer();
+
+    /**
+     * 开启分析线程
+     */
+    void start();
+
+    /**
+     * 退出分析线程
+     */
+    void stop();
+
+    /**
+     * 写入输出的数据，在音频回调中调用，不阻塞
+     * @param samples 交错存放的 S16 数据
+     * @param frames 每个声道的采样点数
+     * @param channels 声道数
+     * @param sampleRate 采样率
+     * @param endPts 最后一个采样点之后的时间，单位秒，NAN 表示未知
+     * @param speed 播放速度，变速时一个采样点对应的媒体时长按速度换算
+     * @param latency 写入的数据还要经过多少个采样点才播放出来，即设备中缓冲的数据
+     */
+    void write(const int16_t *samples, int frames, int channels, int sampleRate, double endPts, float speed,
+               int latency);
+
+    /**
+     * 丢弃缓冲的数据，定位或者更换音频解码器时调用
+     */
+    void flush();
+
+    /**
+     * 取出最新的结果
+     * @param analysis
+     * @return 0 为成功，< 0 为还没有结果
+     */
+    int getAnalysis(AudioAnalysis *analysis);
+
+    void run() override;
+
+private:
+    /**
+     * 分析 [end - AUDIO_ANALYZER_FFT_SIZE, end) 的数据，结果写入三缓冲
+     * @param end 结束位置，单位为写入的采样点总数
+     * @param pts 结束位置的时间
+     * @return < 0 为数据已经被覆盖
+     */
+    int analyze(int64_t end, double pts);
+
+private:
+    Mutex mMutex;                           // 只用于分析线程的等待和退出
+    Condition mCondition;                   //
+    Thread *mThread;                        //
+    bool mAbortRequest;                     //
+
+    float mRing[2][AUDIO_ANALYZER_RING_SIZE]; // 左右声道的环形缓冲，单声道时两者相同
+    std::atomic<int64_t> mWritten;          // 写入的采样点总数
+    std::atomic<unsigned int> mSequence;    // 写入位置对应时间的版本号，奇数表示正在更新
+    std::atomic<double> mEndPts;            // 写入的最后一个采样点之后的时间
+    std::atomic<int64_t> mEndFrames;        // mEndPts 对应的采样点总数
+    std::atomic<float> mSpeed;              //
+    std::atomic<int> mSampleRate;           //
+    std::atomic<int> mLatency;              // 设备中缓冲的采样点数
+    std::atomic<int64_t> mWriteTime;        // 最近一次写入的时间，单位微秒
+    std::atomic<int64_t> mValidFrom;        // 丢弃数据后第一个有效的采样点
+
+    AVTXContext *mTx;                       // FFT
+    av_tx_fn mTxFn;                         //
+    float mWindow[AUDIO_ANALYZER_FFT_SIZE]; // 汉宁窗
+    float mWindowGain;                      // 窗函数的系数和，用于归一化幅度
+    AVComplexFloat mFftIn[AUDIO_ANALYZER_FFT_SIZE];  //
+    AVComplexFloat mFftOut[AUDIO_ANALYZER_FFT_SIZE]; //
+    float mLeft[AUDIO_ANALYZER_FFT_SIZE];   // 取出的窗口
+    float mRight[AUDIO_ANALYZER_FFT_SIZE];  //
+
+    AudioAnalysis mSlots[3];                // 三缓冲
+    std::atomic<int> mMiddle;               // 交换位置的下标，AUDIO_ANALYZER_FRESH 表示有新结果
+    int mBack;                              // 分析线程写入的下标
+    int mFront;                             // 读取方使用的下标
+    Mutex mReadMutex;                       // 只在多个读取方之间互斥
+    bool mHasResult;                        // 读取方是否取到过结果
+};
+
+#endif //AUDIOANALYZER_H
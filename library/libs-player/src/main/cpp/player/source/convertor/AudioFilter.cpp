@@ -0,0 +1,582 @@
+#include "AudioFilter.h"
+
+extern "C" {
+#include "libavutil/opt.h"
+}
+
+/**
+ * 跳过帧开头的采样点，只移动数据指针，不复制数据
+ */
+static void skipSamples(AVFrame *frame, int count) {
+    int planar = av_sample_fmt_is_planar((AVSampleFormat) frame->format);
+    int planes = planar ? frame->channels : 1;
+    int offset = count * av_get_bytes_per_sample((AVSampleFormat) frame->format) * (planar ? 1 : frame->channels);
+    for (int i = 0; i < planes; i++) {
+        frame->extended_data[i] += offset;
+    }
+    if (frame->extended_data != frame->data) {
+        for (int i = 0; i < FFMIN(planes, AV_NUM_DATA_POINTERS); i++) {
+            frame->data[i] += offset;
+        }
+    }
+    frame->nb_samples -= count;
+    if (frame->pts != AV_NOPTS_VALUE) {
+        frame->pts += count;
+    }
+}
+
+AudioFilter::AudioFilter(const char *filters) {
+    mPendingFilters = NULL;
+    mFiltersChanged = false;
+    mFilters = (filters && *filters) ? av_strdup(filters) : NULL;
+    mGraph = NULL;
+    mBufferSrc = NULL;
+    mBufferSink = NULL;
+    mLastSampleRate = 0;
+    mLastFormat = -1;
+    mLastChannelLayout = 0;
+    mSkipPts = AV_NOPTS_VALUE;
+    mNextPts = AV_NOPTS_VALUE;
+    mOutputPts = AV_NOPTS_VALUE;
+    mFading = false;
+    mFadeGraph = NULL;
+    mFadeSrc = NULL;
+    mFadeSink = NULL;
+    mFadePosition = 0;
+    mFadeLength = 0;
+    mFadeInput = 0;
+    mFadeMaxInput = 0;
+    mCost = 0;
+    mFrameDuration = 0;
+    mTotalCost = 0;
+    memset(&mStats, 0, sizeof(AudioFilterStats));
+}
+
+AudioFilter::~AudioFilter() {
+    flush();
+    av_freep(&mPendingFilters);
+    av_freep(&mFilters);
+}
+
+void AudioFilter::setFilters(const char *filters) {
+    Mutex::Autolock lock(mMutex);
+    av_freep(&mPendingFilters);
+    mPendingFilters = (filters && *filters) ? av_strdup(filters) : NULL;
+    mFiltersChanged = true;
+}
+
+void AudioFilter::flush() {
+    release();
+    releaseCrossfade();
+    clearOutput(mOutput);
+    mNextPts = AV_NOPTS_VALUE;
+    mOutputPts = AV_NOPTS_VALUE;
+    mCost = 0;
+    mFrameDuration = 0;
+}
+
+int AudioFilter::sendFrame(AVFrame *frame) {
+    int64_t start = av_gettime_relative();
+    int ret = 0;
+    updateStats();
+
+    // 更换滤镜描述，交叉淡化期间的更换等淡化结束后再生效
+    char *filters = NULL;
+    bool changed;
+    mMutex.lock();
+    changed = mFiltersChanged && !mFading;
+    if (changed) {
+        filters = mPendingFilters;
+        mPendingFilters = NULL;
+        mFiltersChanged = false;
+        mStats.bypass = 0;
+        mStats.overloadCount = 0;
+    }
+    bool bypass = mStats.bypass != 0;
+    mMutex.unlock();
+
+    mFrameDuration = frame->sample_rate > 0 ? av_rescale(frame->nb_samples, AV_TIME_BASE, frame->sample_rate) : 0;
+    // 时间戳不连续说明发生了跳转，缓冲的数据直接丢弃
+    if ((mGraph || mFading) && frame->pts != AV_NOPTS_VALUE && mNextPts != AV_NOPTS_VALUE
+        && llabs(frame->pts - mNextPts) > frame->sample_rate / 2) {
+        release();
+        releaseCrossfade();
+        clearOutput(mOutput);
+        mOutputPts = AV_NOPTS_VALUE;
+    }
+    mNextPts = frame->pts != AV_NOPTS_VALUE ? frame->pts + frame->nb_samples : AV_NOPTS_VALUE;
+
+    bool sameFormat = frame->sample_rate == mLastSampleRate && frame->format == mLastFormat
+                      && frame->channel_layout == mLastChannelLayout;
+    if (changed) {
+        // 旧滤镜图转为淡出的一路；停用、输入参数变化或者没有时间戳时取出旧滤镜图剩余的数据后直接切换
+        if (!mGraph || bypass || !sameFormat || startCrossfade(frame) < 0) {
+            drain();
+        }
+        av_freep(&mFilters);
+        mFilters = filters;
+        LOGD("AudioFilter->change filters: %s", mFilters ? mFilters : "none");
+    }
+    // 停用或者输入参数变化时不再淡化，旧滤镜图的数据全部输出后直接切换
+    if (mFading && (bypass || !sameFormat)) {
+        finishCrossfade(false);
+        release();
+    }
+    // 停用时先送入结束标志取出剩余的数据，loudnorm 等滤镜的预读缓冲不丢失
+    if (mGraph && !mFading && (bypass || !mFilters || !sameFormat)) {
+        drain();
+    }
+    if (!bypass && !mGraph && (mFilters || mFading)) {
+        // 新建滤镜图时先输出原始数据，新滤镜图追上后再淡入，预读期间不会没有声音
+        if (!mFading) {
+            startCrossfade(frame);
+        }
+        if (configure(frame) < 0) {
+            if (mFading) {
+                finishCrossfade(false);
+            }
+            Mutex::Autolock lock(mMutex);
+            mStats.bypass = 1;
+        }
+    }
+
+    // 交叉淡化期间旧滤镜图处理同样的输入
+    if (mFading) {
+        AVFrame *copy = av_frame_clone(frame);
+        ret = copy ? av_buffersrc_add_frame_flags(mFadeSrc, copy, 0) : AVERROR(ENOMEM);
+        av_frame_free(&copy);
+        if (ret < 0) {
+            finishCrossfade(false);
+        } else {
+            mFadeInput += frame->nb_samples;
+        }
+        ret = 0;
+    }
+    if (mGraph) {
+        ret = av_buffersrc_add_frame_flags(mBufferSrc, frame, 0);
+        if (ret < 0) {
+            av_frame_unref(frame);
+        }
+    } else {
+        // 没有滤镜时直接输出
+        AVFrame *output = av_frame_alloc();
+        if (output) {
+            av_frame_move_ref(output, frame);
+            mOutput.push_back(output);
+        } else {
+            av_frame_unref(frame);
+            ret = AVERROR(ENOMEM);
+        }
+    }
+    if (mFading) {
+        pullFrames(mFadeSink, mFadeOutput);
+        pullFrames(mBufferSink, mNewOutput);
+        trimOutput(mFadeOutput);
+        trimOutput(mNewOutput);
+        // 新滤镜图迟迟追不上时不再淡化，旧滤镜图的数据全部输出，新滤镜图跳过重复的部分后接着输出
+        if (mFadePosition == 0 && mFadeInput > mFadeMaxInput) {
+            LOGW("AudioFilter->%s did not catch up in %d s, switch without crossfade",
+                 mFilters ? mFilters : "none", AUDIO_FILTER_CROSSFADE_MAX_DELAY);
+            finishCrossfade(false);
+        }
+    }
+    mCost += av_gettime_relative() - start;
+    return ret;
+}
+
+int AudioFilter::receiveFrame(AVFrame *frame) {
+    int64_t start = av_gettime_relative();
+    int ret;
+    if (!mOutput.empty()) {
+        AVFrame *output = mOutput.front();
+        mOutput.pop_front();
+        av_frame_move_ref(frame, output);
+        av_frame_free(&output);
+        ret = 0;
+    } else if (mFading) {
+        ret = receiveCrossfade(frame);
+        if (ret == AVERROR(EAGAIN) && !mFading) {
+            // 淡化在这次调用中结束，剩余的数据按正常的方式输出
+            mCost += av_gettime_relative() - start;
+            return receiveFrame(frame);
+        }
+    } else if (mGraph) {
+        for (;;) {
+            ret = pullFrame(mBufferSink, frame);
+            if (ret < 0 || mSkipPts == AV_NOPTS_VALUE || frame->pts == AV_NOPTS_VALUE || frame->pts >= mSkipPts) {
+                break;
+            }
+            // 与旧滤镜图已经输出的数据重复
+            if (frame->pts + frame->nb_samples > mSkipPts) {
+                skipSamples(frame, (int) (mSkipPts - frame->pts));
+                break;
+            }
+            av_frame_unref(frame);
+        }
+        if (ret >= 0) {
+            mSkipPts = AV_NOPTS_VALUE;
+        }
+    } else {
+        ret = AVERROR(EAGAIN);
+    }
+    mCost += av_gettime_relative() - start;
+    if (ret >= 0 && frame->pts != AV_NOPTS_VALUE) {
+        mOutputPts = frame->pts + frame->nb_samples;
+    }
+    return ret;
+}
+
+bool AudioFilter::isCatchingUp() {
+    return mFading && mFadePosition == 0 && mNewOutput.empty();
+}
+
+int AudioFilter::pullFrame(AVFilterContext *bufferSink, AVFrame *frame) {
+    int ret = av_buffersink_get_frame_flags(bufferSink, frame, 0);
+    if (ret >= 0 && frame->pts != AV_NOPTS_VALUE) {
+        frame->pts = av_rescale_q(frame->pts, av_buffersink_get_time_base(bufferSink),
+                                  (AVRational) {1, frame->sample_rate});
+    }
+    return ret;
+}
+
+void AudioFilter::pullFrames(AVFilterContext *bufferSink, std::deque<AVFrame *> &output) {
+    if (!bufferSink) {
+        return;
+    }
+    for (;;) {
+        AVFrame *frame = av_frame_alloc();
+        if (!frame || pullFrame(bufferSink, frame) < 0) {
+            av_frame_free(&frame);
+            break;
+        }
+        output.push_back(frame);
+    }
+}
+
+void AudioFilter::getStats(AudioFilterStats *stats) {
+    Mutex::Autolock lock(mMutex);
+    *stats = mStats;
+}
+
+int AudioFilter::configure(AVFrame *frame) {
+    release();
+    // 淡化到不使用滤镜时，新的一路用 anull 输出原始数据
+    const char *filters = mFilters ? mFilters : "anull";
+    int ret = createGraph(filters, frame, &mGraph, &mBufferSrc, &mBufferSink);
+    if (ret < 0) {
+        return ret;
+    }
+    mLastSampleRate = frame->sample_rate;
+    mLastFormat = frame->format;
+    mLastChannelLayout = frame->channel_layout;
+    LOGD("AudioFilter->configure %s, %d Hz %s", filters, frame->sample_rate,
+         av_get_sample_fmt_name((AVSampleFormat) frame->format));
+    return 0;
+}
+
+int AudioFilter::createGraph(const char *filters, AVFrame *frame, AVFilterGraph **graph,
+                             AVFilterContext **bufferSrc, AVFilterContext **bufferSink) {
+    static const enum AVSampleFormat sample_fmts[] = {AV_SAMPLE_FMT_FLTP, AV_SAMPLE_FMT_NONE};
+    int sample_rates[] = {frame->sample_rate, -1};
+    char args[256];
+    int ret;
+    AVFilterInOut *outputs = NULL;
+    AVFilterInOut *inputs = NULL;
+
+    *graph = avfilter_graph_alloc();
+    if (!*graph) {
+        return AVERROR(ENOMEM);
+    }
+    // 在音频回调中同步处理，不开启额外的线程
+    (*graph)->nb_threads = 1;
+
+    uint64_t channelLayout = frame->channel_layout ? frame->channel_layout
+                                                   : av_get_default_channel_layout(frame->channels);
+    snprintf(args, sizeof(args), "time_base=1/%d:sample_rate=%d:sample_fmt=%s:channel_layout=0x%llx",
+             frame->sample_rate, frame->sample_rate, av_get_sample_fmt_name((AVSampleFormat) frame->format),
+             (unsigned long long) channelLayout);
+
+    ret = avfilter_graph_create_filter(bufferSrc, avfilter_get_by_name("abuffer"), "in", args, NULL, *graph);
+    if (ret < 0) {
+        goto fail;
+    }
+    ret = avfilter_graph_create_filter(bufferSink, avfilter_get_by_name("abuffersink"), "out", NULL, NULL, *graph);
+    if (ret < 0) {
+        goto fail;
+    }
+    // 输出统一为 fltp 和输入的采样率，新旧滤镜图的数据可以直接混合，声道布局不做限制
+    ret = av_opt_set_int_list(*bufferSink, "sample_fmts", sample_fmts, AV_SAMPLE_FMT_NONE, AV_OPT_SEARCH_CHILDREN);
+    if (ret < 0) {
+        goto fail;
+    }
+    ret = av_opt_set_int_list(*bufferSink, "sample_rates", sample_rates, -1, AV_OPT_SEARCH_CHILDREN);
+    if (ret < 0) {
+        goto fail;
+    }
+
+    outputs = avfilter_inout_alloc();
+    inputs = avfilter_inout_alloc();
+    if (!outputs || !inputs) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    outputs->name = av_strdup("in");
+    outputs->filter_ctx = *bufferSrc;
+    outputs->pad_idx = 0;
+    outputs->next = NULL;
+    inputs->name = av_strdup("out");
+    inputs->filter_ctx = *bufferSink;
+    inputs->pad_idx = 0;
+    inputs->next = NULL;
+
+    ret = avfilter_graph_parse_ptr(*graph, filters, &inputs, &outputs, NULL);
+    if (ret < 0) {
+        goto fail;
+    }
+    ret = avfilter_graph_config(*graph, NULL);
+    if (ret < 0) {
+        goto fail;
+    }
+    avfilter_inout_free(&inputs);
+    avfilter_inout_free(&outputs);
+    return 0;
+
+fail:
+    LOGE("AudioFilter->create graph %s failed: %d", filters, ret);
+    avfilter_inout_free(&inputs);
+    avfilter_inout_free(&outputs);
+    avfilter_graph_free(graph);
+    *bufferSrc = NULL;
+    *bufferSink = NULL;
+    return ret;
+}
+
+int AudioFilter::startCrossfade(AVFrame *frame) {
+    if (frame->pts == AV_NOPTS_VALUE || frame->sample_rate <= 0) {
+        return -1;
+    }
+    if (mGraph) {
+        mFadeGraph = mGraph;
+        mFadeSrc = mBufferSrc;
+        mFadeSink = mBufferSink;
+        mGraph = NULL;
+        mBufferSrc = NULL;
+        mBufferSink = NULL;
+        mSkipPts = AV_NOPTS_VALUE;
+    } else if (createGraph("anull", frame, &mFadeGraph, &mFadeSrc, &mFadeSink) < 0) {
+        // 原来没有滤镜时，旧的一路用 anull 输出原始数据
+        return -1;
+    }
+    mFading = true;
+    mFadePosition = 0;
+    mFadeLength = FFMAX((int) (AUDIO_FILTER_CROSSFADE * frame->sample_rate), 1);
+    mFadeInput = 0;
+    mFadeMaxInput = (int64_t) AUDIO_FILTER_CROSSFADE_MAX_DELAY * frame->sample_rate;
+    return 0;
+}
+
+void AudioFilter::finishCrossfade(bool complete) {
+    if (complete) {
+        // 淡化完成，新滤镜图的数据接着输出
+        pullFrames(mBufferSink, mNewOutput);
+        trimOutput(mNewOutput);
+        while (!mNewOutput.empty()) {
+            mOutput.push_back(mNewOutput.front());
+            mNewOutput.pop_front();
+        }
+        mSkipPts = AV_NOPTS_VALUE;
+    } else {
+        // 旧滤镜图送入结束标志，剩余的数据全部输出，新滤镜图在这之前的数据与之重复
+        if (av_buffersrc_add_frame(mFadeSrc, NULL) >= 0) {
+            pullFrames(mFadeSink, mFadeOutput);
+        }
+        trimOutput(mFadeOutput);
+        mSkipPts = mOutputPts;
+        while (!mFadeOutput.empty()) {
+            AVFrame *output = mFadeOutput.front();
+            mFadeOutput.pop_front();
+            if (output->pts != AV_NOPTS_VALUE) {
+                mSkipPts = output->pts + output->nb_samples;
+            }
+            mOutput.push_back(output);
+        }
+    }
+    releaseCrossfade();
+    // 淡化到不使用滤镜，anull 不缓冲数据，之后直接输出
+    if (!mFilters) {
+        if (complete) {
+            drain();
+        } else {
+            release();
+        }
+    }
+}
+
+int AudioFilter::receiveCrossfade(AVFrame *frame) {
+    pullFrames(mFadeSink, mFadeOutput);
+    pullFrames(mBufferSink, mNewOutput);
+    trimOutput(mFadeOutput);
+    trimOutput(mNewOutput);
+    if (mFadeOutput.empty()) {
+        return AVERROR(EAGAIN);
+    }
+    AVFrame *old = mFadeOutput.front();
+    AVFrame *cur = mNewOutput.empty() ? NULL : mNewOutput.front();
+    if (old->pts == AV_NOPTS_VALUE || (cur && cur->pts == AV_NOPTS_VALUE)) {
+        finishCrossfade(false);
+        return AVERROR(EAGAIN);
+    }
+    // 新滤镜图还没有追上，先输出旧滤镜图的数据
+    if (!cur || cur->pts > old->pts) {
+        int count = cur ? (int) FFMIN(old->nb_samples, cur->pts - old->pts) : old->nb_samples;
+        return takeSamples(mFadeOutput, count, frame);
+    }
+    // 旧滤镜图的数据有空缺
+    if (cur->pts < old->pts) {
+        return takeSamples(mNewOutput, (int) FFMIN(cur->nb_samples, old->pts - cur->pts), frame);
+    }
+    // 两路的声道数不同，无法混合，从当前位置直接切换
+    if (cur->format != AV_SAMPLE_FMT_FLTP || cur->format != old->format || cur->channels != old->channels
+        || cur->sample_rate != old->sample_rate) {
+        LOGW("AudioFilter->channels changed from %d to %d, switch without crossfade", old->channels, cur->channels);
+        finishCrossfade(true);
+        return AVERROR(EAGAIN);
+    }
+
+    int count = FFMIN(FFMIN(old->nb_samples, cur->nb_samples), mFadeLength - mFadePosition);
+    int ret = takeSamples(mNewOutput, count, frame);
+    if (ret >= 0) {
+        ret = av_frame_make_writable(frame);
+    }
+    if (ret < 0) {
+        av_frame_unref(frame);
+        return ret;
+    }
+    // 旧滤镜图淡出、新滤镜图淡入
+    for (int ch = 0; ch < frame->channels; ch++) {
+        float *dst = (float *) frame->extended_data[ch];
+        const float *src = (const float *) old->extended_data[ch];
+        for (int i = 0; i < count; i++) {
+            float gain = (float) (mFadePosition + i + 1) / (mFadeLength + 1);
+            dst[i] = src[i] * (1.0f - gain) + dst[i] * gain;
+        }
+    }
+    if (count >= old->nb_samples) {
+        mFadeOutput.pop_front();
+        av_frame_free(&old);
+    } else {
+        skipSamples(old, count);
+    }
+    mFadePosition += count;
+    if (mFadePosition >= mFadeLength) {
+        LOGD("AudioFilter->crossfade to %s finished", mFilters ? mFilters : "none");
+        finishCrossfade(true);
+    }
+    return 0;
+}
+
+void AudioFilter::trimOutput(std::deque<AVFrame *> &output) {
+    if (mOutputPts == AV_NOPTS_VALUE) {
+        return;
+    }
+    while (!output.empty()) {
+        AVFrame *frame = output.front();
+        if (frame->pts == AV_NOPTS_VALUE || frame->pts >= mOutputPts) {
+            break;
+        }
+        if (frame->pts + frame->nb_samples > mOutputPts) {
+            skipSamples(frame, (int) (mOutputPts - frame->pts));
+            break;
+        }
+        output.pop_front();
+        av_frame_free(&frame);
+    }
+}
+
+int AudioFilter::takeSamples(std::deque<AVFrame *> &output, int count, AVFrame *frame) {
+    AVFrame *head = output.front();
+    if (count >= head->nb_samples) {
+        output.pop_front();
+        av_frame_move_ref(frame, head);
+        av_frame_free(&head);
+        return 0;
+    }
+    int ret = av_frame_ref(frame, head);
+    if (ret < 0) {
+        return ret;
+    }
+    frame->nb_samples = count;
+    skipSamples(head, count);
+    return 0;
+}
+
+void AudioFilter::drain() {
+    if (!mGraph) {
+        return;
+    }
+    if (av_buffersrc_add_frame(mBufferSrc, NULL) >= 0) {
+        pullFrames(mBufferSink, mOutput);
+    }
+    release();
+}
+
+void AudioFilter::release() {
+    if (mGraph) {
+        avfilter_graph_free(&mGraph);
+    }
+    mGraph = NULL;
+    mBufferSrc = NULL;
+    mBufferSink = NULL;
+    mLastSampleRate = 0;
+    mLastFormat = -1;
+    mLastChannelLayout = 0;
+    mSkipPts = AV_NOPTS_VALUE;
+}
+
+void AudioFilter::releaseCrossfade() {
+    if (mFadeGraph) {
+        avfilter_graph_free(&mFadeGraph);
+    }
+    mFadeGraph = NULL;
+    mFadeSrc = NULL;
+    mFadeSink = NULL;
+    clearOutput(mFadeOutput);
+    clearOutput(mNewOutput);
+    mFading = false;
+    mFadePosition = 0;
+    mFadeLength = 0;
+    mFadeInput = 0;
+    mFadeMaxInput = 0;
+}
+
+void AudioFilter::clearOutput(std::deque<AVFrame *> &output) {
+    while (!output.empty()) {
+        AVFrame *frame = output.front();
+        output.pop_front();
+        av_frame_free(&frame);
+    }
+}
+
+void AudioFilter::updateStats() {
+    if (mFrameDuration <= 0) {
+        return;
+    }
+    Mutex::Autolock lock(mMutex);
+    mTotalCost += mCost;
+    mStats.frameCount++;
+    mStats.lastCost = mCost;
+    mStats.avgCost = mTotalCost / mStats.frameCount;
+    mStats.maxCost = FFMAX(mStats.maxCost, mCost);
+    if (mGraph && mCost * 100 > mFrameDuration * AUDIO_FILTER_MAX_LOAD) {
+        mStats.overloadCount++;
+        if (mStats.overloadCount >= AUDIO_FILTER_OVERLOAD_COUNT && !mStats.bypass) {
+            mStats.bypass = 1;
+            LOGW("AudioFilter->%s overloaded, cost: %lld us, duration: %lld us, bypass",
+                 mFilters, (long long) mCost, (long long) mFrameDuration);
+        }
+    } else {
+        mStats.overloadCount = 0;
+    }
+    mCost = 0;
+    mFrameDuration = 0;
+}
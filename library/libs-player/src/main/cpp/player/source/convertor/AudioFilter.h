@@ -0,0 +1,214 @@
+#ifndef AUDIOFILTER_H
+#define AUDIOFILTER_H
+
+#include <deque>
+#include "PlayerState.h"
+#include "AndroidLog.h"
+
+extern "C" {
+#include "libavfilter/avfilter.h"
+#include "libavfilter/buffersink.h"
+#include "libavfilter/buffersrc.h"
+}
+
+// 滤镜处理一帧的耗时超过该帧时长的百分比视为过载
+#define AUDIO_FILTER_MAX_LOAD 50
+// 连续过载的帧数达到该值时停用滤镜，避免音频回调欠载
+#define AUDIO_FILTER_OVERLOAD_COUNT 8
+// 更换滤镜时新旧滤镜图交叉淡化的时长，单位秒
+#define AUDIO_FILTER_CROSSFADE 0.05
+// 新滤镜图追赶的最长时长，单位秒，超过时不再淡化直接切换
+#define AUDIO_FILTER_CROSSFADE_MAX_DELAY 10
+
+/**
+ * 音频滤镜统计信息
+ */
+typedef struct AudioFilterStats {
+    int64_t lastCost;       // 最近一帧的处理耗时，单位微秒
+    int64_t avgCost;        // 平均每帧的处理耗时，单位微秒
+    int64_t maxCost;        // 单帧最大的处理耗时，单位微秒
+    int64_t frameCount;     // 处理的帧数
+    int overloadCount;      // 连续过载的帧数
+    int bypass;             // 是否因为过载或者创建失败停用
+} AudioFilterStats;
+
+/**
+ * 音频滤镜
+ * 在音频回调中把解码帧送入 avfilter 滤镜图，例如 "loudnorm"、"acompressor"、"equalizer=f=1000:g=3"、"pan=stereo|c0=c0|c1=c0"，
+ * 输出统一为 fltp 格式、与输入相同的采样率，再交给重采样和变速变调处理。
+ * 更换滤镜描述或者新建滤镜图时，输入同时送入旧的滤镜图（原来没有滤镜时为 anull），先输出旧滤镜图的数据，
+ * 新滤镜图追上输出位置后两路交叉淡化，loudnorm 等带预读的滤镜在预读期间不会没有声音，切换时也没有跳变。
+ * 每一帧的处理耗时与该帧的时长比较，持续过载时停用滤镜，直接输出解码帧
+ */
+class AudioFilter {
+public:
+    /**
+     * @param filters 滤镜描述，为空时直接输出
+     */
+    AudioFilter(const char *filters);
+
+    virtual ~AudioFilter();
+
+    /**
+     * 更换滤镜描述，可以在任意线程调用，下一次送入数据时生效
+     * @param filters 为空时停用滤镜
+     */
+    void setFilters(const char *filters);
+
+    /**
+     * 丢弃滤镜图中缓冲的数据，跳转或者更换音频解码器时调用
+     */
+    void flush();
+
+    /**
+     * 送入解码帧
+     * @param frame 移走引用
+     * @return 0 为成功
+     */
+    int sendFrame(AVFrame *frame);
+
+    /**
+     * 取出处理后的帧，时间戳的时间基为 1/采样率，与解码帧一致
+     * @param frame
+     * @return 0 为成功，AVERROR(EAGAIN) 表示需要更多输入
+     */
+    int receiveFrame(AVFrame *frame);
+
+    /**
+     * 新的滤镜图还没有追上输出位置，需要额外送入数据
+     * @return
+     */
+    bool isCatchingUp();
+
+    /**
+     * 获取统计信息
+     * @param stats
+     */
+    void getStats(AudioFilterStats *stats);
+
+private:
+    /**
+     * 根据输入帧的参数创建滤镜图
+     * @param frame
+     * @return 0 为成功
+     */
+    int configure(AVFrame *frame);
+
+    /**
+     * 创建滤镜图，输出端限定为 fltp 格式和输入的采样率
+     * @param filters 滤镜描述
+     * @param frame 输入帧
+     * @return 0 为成功
+     */
+    int createGraph(const char *filters, AVFrame *frame, AVFilterGraph **graph,
+                    AVFilterContext **bufferSrc, AVFilterContext **bufferSink);
+
+    /**
+     * 从滤镜图的输出端取出一帧，时间戳换算成 1/采样率
+     * @param frame
+     * @return
+     */
+    int pullFrame(AVFilterContext *bufferSink, AVFrame *frame);
+
+    /**
+     * 取出滤镜图输出端所有可用的帧
+     * @param bufferSink
+     * @param output
+     */
+    void pullFrames(AVFilterContext *bufferSink, std::deque<AVFrame *> &output);
+
+    /**
+     * 开始交叉淡化，当前的滤镜图转为淡出的一路，没有滤镜图时用 anull 输出原始数据
+     * @param frame 输入帧
+     * @return 0 为成功
+     */
+    int startCrossfade(AVFrame *frame);
+
+    /**
+     * 结束交叉淡化
+     * @param complete 为 true 时淡化已经完成，丢弃旧滤镜图；否则旧滤镜图的剩余数据全部输出，丢弃新滤镜图后直接切换
+     */
+    void finishCrossfade(bool complete);
+
+    /**
+     * 交叉淡化期间取出一帧，先输出旧滤镜图的数据，新滤镜图追上后两路混合
+     * @param frame
+     * @return 0 为成功，AVERROR(EAGAIN) 表示需要更多输入
+     */
+    int receiveCrossfade(AVFrame *frame);
+
+    /**
+     * 丢弃队列头部在输出位置之前的数据
+     * @param output
+     */
+    void trimOutput(std::deque<AVFrame *> &output);
+
+    /**
+     * 从队列头部取出指定数量的采样点
+     * @param output
+     * @param count
+     * @param frame
+     * @return 0 为成功
+     */
+    int takeSamples(std::deque<AVFrame *> &output, int count, AVFrame *frame);
+
+    /**
+     * 释放交叉淡化的旧滤镜图和两路缓冲的数据
+     */
+    void releaseCrossfade();
+
+    /**
+     * 送入结束标志，把滤镜图中剩余的数据取出到输出队列
+     */
+    void drain();
+
+    /**
+     * 释放滤镜图
+     */
+    void release();
+
+    /**
+     * 丢弃输出队列中的帧
+     */
+    void clearOutput(std::deque<AVFrame *> &output);
+
+    /**
+     * 统计上一帧的处理耗时，持续过载时停用滤镜
+     */
+    void updateStats();
+
+private:
+    Mutex mMutex;                   // 保护新的滤镜描述和统计信息
+    char *mPendingFilters;          // 等待生效的滤镜描述
+    bool mFiltersChanged;           //
+    char *mFilters;                 // 当前的滤镜描述
+
+    AVFilterGraph *mGraph;          // 滤镜图
+    AVFilterContext *mBufferSrc;    // 输入端
+    AVFilterContext *mBufferSink;   // 输出端
+    int mLastSampleRate;            // 创建滤镜图时输入帧的参数，变化时重建
+    int mLastFormat;                //
+    uint64_t mLastChannelLayout;    //
+    int64_t mSkipPts;               // 直接切换时新滤镜图输出中在该位置之前的数据与旧滤镜图重复，丢弃
+    int64_t mNextPts;               // 下一帧的预期时间戳，不连续时说明发生了跳转
+    std::deque<AVFrame *> mOutput;  // 直接输出以及切换滤镜图时取出的帧
+    int64_t mOutputPts;             // 已经输出到的位置，单位 1/采样率，交叉淡化时按它对齐两路数据
+
+    bool mFading;                   // 正在交叉淡化
+    AVFilterGraph *mFadeGraph;      // 淡出的旧滤镜图，与新滤镜图处理相同的输入
+    AVFilterContext *mFadeSrc;      //
+    AVFilterContext *mFadeSink;     //
+    std::deque<AVFrame *> mFadeOutput;  // 旧滤镜图的输出
+    std::deque<AVFrame *> mNewOutput;   // 淡化完成前新滤镜图的输出
+    int mFadePosition;              // 已经混合的采样点数
+    int mFadeLength;                // 交叉淡化的采样点数
+    int64_t mFadeInput;             // 开始淡化后送入的采样点数
+    int64_t mFadeMaxInput;          // 新滤镜图追赶期间最多送入的采样点数
+
+    int64_t mCost;                  // 当前帧累计的处理耗时
+    int64_t mFrameDuration;         // 当前帧的时长，单位微秒
+    int64_t mTotalCost;             //
+    AudioFilterStats mStats;        // 统计信息
+};
+
+#endif //AUDIOFILTER_H
@@ -0,0 +1,255 @@
+#include "AudioGain.h"
+#include <math.h>
+#include <string.h>
+
+extern "C" {
+#include "libavutil/common.h"
+}
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define AUDIO_GAIN_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define AUDIO_GAIN_NEON
+#endif
+
+// 向量路径一组处理的采样点数上限，lcm(channels, 8) 超过这个值时使用标量实现
+#define GAIN_GROUP_MAX 64
+
+#if defined(AUDIO_GAIN_SSE2)
+// 4 个 S16 乘以增益，饱和后就近取整，0.5 取偶数，与标量路径一致，结果为 32 位
+static inline __m128i mulGain(__m128i samples, __m128 gain) {
+    __m128 value = _mm_mul_ps(_mm_cvtepi32_ps(samples), gain);
+    value = _mm_min_ps(_mm_max_ps(value, _mm_set1_ps(-32768.0f)), _mm_set1_ps(32767.0f));
+    return _mm_cvtps_epi32(value);
+}
+#elif defined(AUDIO_GAIN_NEON)
+static inline int16x4_t mulGain(int16x4_t samples, float32x4_t gain) {
+    float32x4_t value = vmulq_f32(vcvtq_f32_s32(vmovl_s16(samples)), gain);
+    value = vminq_f32(vmaxq_f32(value, vdupq_n_f32(-32768.0f)), vdupq_n_f32(32767.0f));
+#if defined(__aarch64__)
+    int32x4_t result = vcvtnq_s32_f32(value);
+#else
+    // armv7 没有就近舍入的转换指令，加减 1.5 * 2^23 按就近偶数取整，饱和后的值在精确范围内
+    const float32x4_t magic = vdupq_n_f32(12582912.0f);
+    int32x4_t result = vcvtq_s32_f32(vsubq_f32(vaddq_f32(value, magic), magic));
+#endif
+    return vmovn_s32(result);
+}
+#endif
+
+// 乘以增益，饱和后就近取整，0.5 取偶数（默认的舍入模式）
+static inline int16_t mulGain(int16_t sample, float gain) {
+    return (int16_t) lrintf(av_clipf(sample * gain, -32768.0f, 32767.0f));
+}
+
+AudioGain::AudioGain() {
+    reset(0.0f, 0.0f);
+}
+
+AudioGain::~AudioGain() {}
+
+void AudioGain::setTarget(float left, float right, int rampFrames) {
+    if (left == mTarget[0] && right == mTarget[1]) {
+        return;
+    }
+    mTarget[0] = left;
+    mTarget[1] = right;
+    if (rampFrames <= 0) {
+        reset(left, right);
+        return;
+    }
+    // 从渐变中途的增益开始重新计算
+    mStep[0] = (left - mGain[0]) / rampFrames;
+    mStep[1] = (right - mGain[1]) / rampFrames;
+    mRampFrames = rampFrames;
+}
+
+void AudioGain::reset(float left, float right) {
+    mGain[0] = mTarget[0] = left;
+    mGain[1] = mTarget[1] = right;
+    mStep[0] = mStep[1] = 0.0f;
+    mRampFrames = 0;
+}
+
+int AudioGain::getRampFrames() {
+    return mRampFrames;
+}
+
+bool AudioGain::isSilent() {
+    return mRampFrames == 0 && mGain[0] == 0.0f && mGain[1] == 0.0f;
+}
+
+void AudioGain::process(int16_t *samples, int frames, int channels) {
+    if (frames <= 0 || channels <= 0) {
+        return;
+    }
+    if (mRampFrames > 0) {
+        int count = FFMIN(frames, mRampFrames);
+        applyGain(samples, count, channels, mGain, mStep);
+        mRampFrames -= count;
+        if (mRampFrames == 0) {
+            // 渐变结束时直接取目标值，避免累计误差
+            mGain[0] = mTarget[0];
+            mGain[1] = mTarget[1];
+            mStep[0] = mStep[1] = 0.0f;
+        } else {
+            mGain[0] += mStep[0] * count;
+            mGain[1] += mStep[1] * count;
+        }
+        samples += count * channels;
+        frames -= count;
+        if (frames <= 0) {
+            return;
+        }
+    }
+    float left = channels == 1 ? (mGain[0] + mGain[1]) * 0.5f : mGain[0];
+    float right = channels == 1 ? left : mGain[1];
+    if (left == 1.0f && right == 1.0f) {
+        return;
+    }
+    if (left == 0.0f && right == 0.0f) {
+        memset(samples, 0, (size_t) frames * channels * sizeof(int16_t));
+        return;
+    }
+    applyGain(samples, frames, channels, mGain, mStep);
+}
+
+void AudioGain::applyGain(int16_t *samples, int frames, int channels, const float *start, const float *step) {
+    // 单声道以及第三个之后的声道取左右声道的平均值
+    float others = (start[0] + start[1]) * 0.5f;
+    float othersStep = (step[0] + step[1]) * 0.5f;
+    int i = 0;
+#if defined(AUDIO_GAIN_SSE2) || defined(AUDIO_GAIN_NEON)
+    // lcm(channels, 8) 个采样点为一组，组内每个位置的起始增益、增量和帧偏移固定，
+    // 增益按 start + step * i 计算，与标量路径相同
+    int group = channels;
+    while (group % 8 != 0) {
+        group += channels;
+    }
+    if (group <= GAIN_GROUP_MAX) {
+        float base[GAIN_GROUP_MAX];
+        float inc[GAIN_GROUP_MAX];
+        float offset[GAIN_GROUP_MAX];
+        for (int k = 0; k < group; k++) {
+            int c = k % channels;
+            base[k] = channels == 1 || c >= 2 ? others : start[c];
+            inc[k] = channels == 1 || c >= 2 ? othersStep : step[c];
+            offset[k] = (float) (k / channels);
+        }
+        int groupFrames = group / channels;
+        for (; i + groupFrames <= frames; i += groupFrames) {
+            int16_t *p = samples + i * channels;
+#if defined(AUDIO_GAIN_SSE2)
+            const __m128 frame = _mm_set1_ps((float) i);
+            for (int k = 0; k < group; k += 8) {
+                __m128 g0 = _mm_add_ps(_mm_loadu_ps(base + k),
+                                       _mm_mul_ps(_mm_loadu_ps(inc + k), _mm_add_ps(frame, _mm_loadu_ps(offset + k))));
+                __m128 g1 = _mm_add_ps(_mm_loadu_ps(base + k + 4),
+                                       _mm_mul_ps(_mm_loadu_ps(inc + k + 4),
+                                                  _mm_add_ps(frame, _mm_loadu_ps(offset + k + 4))));
+                __m128i x = _mm_loadu_si128((const __m128i *) (p + k));
+                __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+                __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+                _mm_storeu_si128((__m128i *) (p + k), _mm_packs_epi32(mulGain(lo, g0), mulGain(hi, g1)));
+            }
+#else
+            const float32x4_t frame = vdupq_n_f32((float) i);
+            for (int k = 0; k < group; k += 8) {
+                float32x4_t g0 = vaddq_f32(vld1q_f32(base + k),
+                                           vmulq_f32(vld1q_f32(inc + k), vaddq_f32(frame, vld1q_f32(offset + k))));
+                float32x4_t g1 = vaddq_f32(vld1q_f32(base + k + 4),
+                                           vmulq_f32(vld1q_f32(inc + k + 4),
+                                                     vaddq_f32(frame, vld1q_f32(offset + k + 4))));
+                int16x8_t x = vld1q_s16(p + k);
+                vst1q_s16(p + k, vcombine_s16(mulGain(vget_low_s16(x), g0), mulGain(vget_high_s16(x), g1)));
+            }
+#endif
+        }
+    }
+#endif
+    for (; i < frames; i++) {
+        for (int c = 0; c < channels; c++) {
+            float gain = channels == 1 || c >= 2 ? others + othersStep * i : start[c] + step[c] * i;
+            int16_t *sample = samples + i * channels + c;
+            *sample = mulGain(*sample, gain);
+        }
+    }
+}
+
+int AudioGain::toFixedGain(float gain) {
+    return av_clip((int) lrintf(gain * (1 << MIX_GAIN_SHIFT)), 0, INT16_MAX);
+}
+
+/**
+ * dst += src * gain，偶数位置的采样点使用 gain0，奇数位置使用 gain1，
+ * 所有路径都是 (x * gain + 2^13) >> 14，相加后饱和到 16 位
+ */
+static void mixInterleaved(int16_t *dst, const int16_t *src, int count, int gain0, int gain1) {
+    int i = 0;
+#if defined(AUDIO_GAIN_SSE2)
+    const __m128i g = _mm_set_epi16((int16_t) gain1, (int16_t) gain0, (int16_t) gain1, (int16_t) gain0,
+                                    (int16_t) gain1, (int16_t) gain0, (int16_t) gain1, (int16_t) gain0);
+    const __m128i round = _mm_set1_epi32(1 << (MIX_GAIN_SHIFT - 1));
+    for (; i + 8 <= count; i += 8) {
+        __m128i s = _mm_loadu_si128((const __m128i *) (src + i));
+        __m128i mulLo = _mm_mullo_epi16(s, g);
+        __m128i mulHi = _mm_mulhi_epi16(s, g);
+        __m128i lo = _mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi16(mulLo, mulHi), round), MIX_GAIN_SHIFT);
+        __m128i hi = _mm_srai_epi32(_mm_add_epi32(_mm_unpackhi_epi16(mulLo, mulHi), round), MIX_GAIN_SHIFT);
+        __m128i d = _mm_loadu_si128((const __m128i *) (dst + i));
+        _mm_storeu_si128((__m128i *) (dst + i), _mm_adds_epi16(d, _mm_packs_epi32(lo, hi)));
+    }
+#elif defined(AUDIO_GAIN_NEON)
+    const int16_t gains[4] = {(int16_t) gain0, (int16_t) gain1, (int16_t) gain0, (int16_t) gain1};
+    const int16x4_t g = vld1_s16(gains);
+    for (; i + 8 <= count; i += 8) {
+        int16x8_t s = vld1q_s16(src + i);
+        int32x4_t lo = vmull_s16(vget_low_s16(s), g);
+        int32x4_t hi = vmull_s16(vget_high_s16(s), g);
+        int16x8_t scaled = vcombine_s16(vqrshrn_n_s32(lo, MIX_GAIN_SHIFT), vqrshrn_n_s32(hi, MIX_GAIN_SHIFT));
+        vst1q_s16(dst + i, vqaddq_s16(vld1q_s16(dst + i), scaled));
+    }
+#endif
+    for (; i < count; i++) {
+        int gain = (i & 1) ? gain1 : gain0;
+        int scaled = av_clip_int16((src[i] * gain + (1 << (MIX_GAIN_SHIFT - 1))) >> MIX_GAIN_SHIFT);
+        dst[i] = (int16_t) av_clip_int16(dst[i] + scaled);
+    }
+}
+
+void AudioGain::mixSamples(int16_t *dst, const int16_t *src, int count, int gain) {
+    mixInterleaved(dst, src, count, gain, gain);
+}
+
+void AudioGain::mixStereoSamples(int16_t *dst, const int16_t *src, int frames, int leftGain, int rightGain) {
+    mixInterleaved(dst, src, frames * 2, leftGain, rightGain);
+}
+
+void AudioGain::scaleSamples(int16_t *buf, int count, int gain) {
+    int i = 0;
+#if defined(AUDIO_GAIN_SSE2)
+    const __m128i g = _mm_set1_epi16((int16_t) gain);
+    const __m128i round = _mm_set1_epi32(1 << (MIX_GAIN_SHIFT - 1));
+    for (; i + 8 <= count; i += 8) {
+        __m128i s = _mm_loadu_si128((const __m128i *) (buf + i));
+        __m128i mulLo = _mm_mullo_epi16(s, g);
+        __m128i mulHi = _mm_mulhi_epi16(s, g);
+        __m128i lo = _mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi16(mulLo, mulHi), round), MIX_GAIN_SHIFT);
+        __m128i hi = _mm_srai_epi32(_mm_add_epi32(_mm_unpackhi_epi16(mulLo, mulHi), round), MIX_GAIN_SHIFT);
+        _mm_storeu_si128((__m128i *) (buf + i), _mm_packs_epi32(lo, hi));
+    }
+#elif defined(AUDIO_GAIN_NEON)
+    const int16x4_t g = vdup_n_s16((int16_t) gain);
+    for (; i + 8 <= count; i += 8) {
+        int16x8_t s = vld1q_s16(buf + i);
+        int32x4_t lo = vmull_s16(vget_low_s16(s), g);
+        int32x4_t hi = vmull_s16(vget_high_s16(s), g);
+        vst1q_s16(buf + i, vcombine_s16(vqrshrn_n_s32(lo, MIX_GAIN_SHIFT), vqrshrn_n_s32(hi, MIX_GAIN_SHIFT)));
+    }
+#endif
+    for (; i < count; i++) {
+        buf[i] = (int16_t) av_clip_int16((buf[i] * gain + (1 << (MIX_GAIN_SHIFT - 1))) >> MIX_GAIN_SHIFT);
+    }
+}
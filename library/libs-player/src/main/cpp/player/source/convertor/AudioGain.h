@@ -0,0 +1,105 @@
+#ifndef AUDIOGAIN_H
+#define AUDIOGAIN_H
+
+#include <stdint.h>
+
+// 混音增益的定点精度，Q14 最大可以表示 2 倍增益
+#define MIX_GAIN_SHIFT 14
+#define MIX_GAIN_MAX 2.0f
+
+/**
+ * 软件增益
+ * 在输出前对交错存放的 S16 数据按声道乘以增益，目标增益变化时按采样点线性渐变，用于音量、静音以及暂停、定位时的淡入淡出，
+ * 不依赖音频输出设备的音量接口，x86 上使用 SSE2，arm 上使用 NEON，常见的声道数都有向量路径。只在音频回调线程中使用
+ */
+class AudioGain {
+public:
+    AudioGain();
+
+    virtual ~AudioGain();
+
+    /**
+     * 设置目标增益，从当前增益线性渐变过去，目标没有变化时不做处理
+     * @param left 左声道增益，单声道时取左右声道的平均值
+     * @param right 右声道增益
+     * @param rampFrames 渐变的采样点数，0 为立即生效
+     */
+    void setTarget(float left, float right, int rampFrames);
+
+    /**
+     * 立即设置增益，不渐变
+     * @param left
+     * @param right
+     */
+    void reset(float left, float right);
+
+    /**
+     * @return 渐变剩余的采样点数
+     */
+    int getRampFrames();
+
+    /**
+     * @return 当前增益是否为 0 且不在渐变中
+     */
+    bool isSilent();
+
+    /**
+     * 处理数据，同时推进渐变
+     * @param samples 交错存放的 S16 数据，原地处理
+     * @param frames 每个声道的采样点数
+     * @param channels 声道数
+     */
+    void process(int16_t *samples, int frames, int channels);
+
+    /**
+     * samples[i] *= start + step * i，按声道分别计算，结果饱和到 16 位后就近取整，0.5 取偶数，所有路径一致
+     * @param samples 交错存放的 S16 数据
+     * @param frames 每个声道的采样点数
+     * @param channels 声道数
+     * @param start 每个声道的起始增益，长度为 2，多于两个声道时其余声道使用两者的平均值
+     * @param step 每个声道每个采样点的增量
+     */
+    static void applyGain(int16_t *samples, int frames, int channels, const float *start, const float *step);
+
+    /**
+     * 浮点增益换算成 Q14 定点
+     * @param gain
+     * @return
+     */
+    static int toFixedGain(float gain);
+
+    /**
+     * dst += src * gain，乘积按 Q14 四舍五入后饱和到 16 位
+     * @param dst
+     * @param src
+     * @param count 采样点数，包括所有声道
+     * @param gain Q14 定点增益
+     */
+    static void mixSamples(int16_t *dst, const int16_t *src, int count, int gain);
+
+    /**
+     * 左右声道增益不同的 mixSamples，舍入方式相同
+     * @param dst 交错存放的双声道数据
+     * @param src
+     * @param frames 每个声道的采样点数
+     * @param leftGain Q14 定点增益
+     * @param rightGain
+     */
+    static void mixStereoSamples(int16_t *dst, const int16_t *src, int frames, int leftGain, int rightGain);
+
+    /**
+     * buf *= gain，结果按 Q14 四舍五入后饱和到 16 位
+     * @param buf
+     * @param count 采样点数，包括所有声道
+     * @param gain Q14 定点增益
+     */
+    static void scaleSamples(int16_t *buf, int count, int gain);
+
+private:
+    float mGain[2];         // 当前增益
+    float mTarget[2];       // 目标增益
+    float mStep[2];         // 渐变中每个采样点的增量
+    int mRampFrames;        // 渐变剩余的采样点数
+};
+
+#endif //AUDIOGAIN_H
@@ -0,0 +1,328 @@
+#include "AudioMixer.h"
+
+MixTrack::MixTrack(AudioDecoder *decoder, float gain) {
+    mDecoder = decoder;
+    mThread = NULL;
+    mAbortRequest = false;
+    mGain = AudioGain::toFixedGain(gain);
+    mFreq = 0;
+    mChannels = 0;
+    mChannelLayout = 0;
+    mFifo = NULL;
+    mFifoStart = AV_NOPTS_VALUE;
+    mSwrCtx = NULL;
+    mSrcFormat = -1;
+    mSrcRate = 0;
+    mSrcChannelLayout = 0;
+    mDstFreq = 0;
+    mDstChannels = 0;
+    mConvertBuffer = NULL;
+    mConvertSize = 0;
+}
+
+MixTrack::~MixTrack() {
+    stop();
+    if (mFifo) {
+        av_audio_fifo_free(mFifo);
+        mFifo = NULL;
+    }
+    swr_free(&mSwrCtx);
+    av_freep(&mConvertBuffer);
+}
+
+void MixTrack::setOutputFormat(int freq, int channels, int64_t channelLayout) {
+    Mutex::Autolock lock(mMutex);
+    if (freq == mFreq && channels == mChannels && channelLayout == mChannelLayout) {
+        return;
+    }
+    mFreq = freq;
+    mChannels = channels;
+    mChannelLayout = channelLayout;
+    if (mFifo) {
+        av_audio_fifo_free(mFifo);
+        mFifo = NULL;
+    }
+    mFifoStart = AV_NOPTS_VALUE;
+    mCondition.signal();
+}
+
+void MixTrack::start() {
+    mMutex.lock();
+    mAbortRequest = false;
+    mMutex.unlock();
+    if (!mThread) {
+        mThread = new Thread(this);
+        mThread->start();
+    }
+}
+
+void MixTrack::stop() {
+    mMutex.lock();
+    mAbortRequest = true;
+    mCondition.signal();
+    mMutex.unlock();
+    // 唤醒阻塞在数据包队列中的解码线程
+    mDecoder->stop();
+    if (mThread) {
+        mThread->join();
+        delete mThread;
+        mThread = NULL;
+    }
+}
+
+void MixTrack::flush() {
+    Mutex::Autolock lock(mMutex);
+    clearBuffer();
+    mCondition.signal();
+}
+
+void MixTrack::setGain(float gain) {
+    Mutex::Autolock lock(mMutex);
+    mGain = AudioGain::toFixedGain(gain);
+}
+
+AudioDecoder *MixTrack::getDecoder() {
+    return mDecoder;
+}
+
+void MixTrack::mixTo(int16_t *buffer, int64_t start, int samples, uint8_t **temp, unsigned int *tempSize) {
+    Mutex::Autolock lock(mMutex);
+    if (!mFifo || mFifoStart == AV_NOPTS_VALUE || av_audio_fifo_size(mFifo) <= 0) {
+        return;
+    }
+    // 缓冲的数据远在当前位置之后，是往回跳转之前解码的
+    if (mFifoStart - start > mFreq * MIX_TRACK_BUFFER_DURATION * 2) {
+        clearBuffer();
+        mCondition.signal();
+        return;
+    }
+    // 丢弃早于当前位置的数据
+    if (mFifoStart < start) {
+        int drop = (int) FFMIN(start - mFifoStart, (int64_t) av_audio_fifo_size(mFifo));
+        av_audio_fifo_drain(mFifo, drop);
+        mFifoStart += drop;
+        mCondition.signal();
+    }
+    int offset = (int) (mFifoStart - start);
+    int count = FFMIN(samples - offset, av_audio_fifo_size(mFifo));
+    if (offset < 0 || count <= 0) {
+        return;
+    }
+    av_fast_malloc(temp, tempSize, count * mChannels * sizeof(int16_t));
+    if (!*temp) {
+        return;
+    }
+    count = av_audio_fifo_read(mFifo, (void **) temp, count);
+    if (count <= 0) {
+        return;
+    }
+    mFifoStart += count;
+    AudioGain::mixSamples(buffer + offset * mChannels, (const int16_t *) *temp, count * mChannels, mGain);
+    mCondition.signal();
+}
+
+void MixTrack::run() {
+    AVFrame *frame = av_frame_alloc();
+    if (!frame) {
+        return;
+    }
+    for (;;) {
+        // 缓冲足够时等待音频回调取走
+        mMutex.lock();
+        while (!mAbortRequest && (mFreq <= 0
+                                  || (mFifo && av_audio_fifo_size(mFifo) >= mFreq * MIX_TRACK_BUFFER_DURATION))) {
+            mCondition.wait(mMutex);
+        }
+        bool abort = mAbortRequest;
+        mMutex.unlock();
+        if (abort) {
+            break;
+        }
+        int ret = mDecoder->getAudioFrame(frame);
+        if (ret < 0) {
+            break;
+        }
+        if (ret > 0) {
+            writeFrame(frame);
+            av_frame_unref(frame);
+        }
+    }
+    av_frame_free(&frame);
+}
+
+int MixTrack::writeFrame(AVFrame *frame) {
+    mMutex.lock();
+    int freq = mFreq;
+    int channels = mChannels;
+    int64_t channelLayout = mChannelLayout;
+    mMutex.unlock();
+
+    int64_t srcLayout = (frame->channel_layout && av_get_channel_layout_nb_channels(frame->channel_layout) == frame->channels)
+                        ? frame->channel_layout : av_get_default_channel_layout(frame->channels);
+    if (!mSwrCtx || frame->format != mSrcFormat || frame->sample_rate != mSrcRate || srcLayout != mSrcChannelLayout
+        || freq != mDstFreq || channels != mDstChannels) {
+        swr_free(&mSwrCtx);
+        mSwrCtx = swr_alloc_set_opts(NULL, channelLayout, AV_SAMPLE_FMT_S16, freq,
+                                     srcLayout, (AVSampleFormat) frame->format, frame->sample_rate, 0, NULL);
+        if (!mSwrCtx || swr_init(mSwrCtx) < 0) {
+            LOGE("MixTrack->Cannot create sample rate converter for %d Hz %s %d channels",
+                 frame->sample_rate, av_get_sample_fmt_name((AVSampleFormat) frame->format), frame->channels);
+            swr_free(&mSwrCtx);
+            return -1;
+        }
+        mSrcFormat = frame->format;
+        mSrcRate = frame->sample_rate;
+        mSrcChannelLayout = srcLayout;
+        mDstFreq = freq;
+        mDstChannels = channels;
+    }
+
+    int outCount = (int64_t) frame->nb_samples * freq / frame->sample_rate + 256;
+    int outSize = av_samples_get_buffer_size(NULL, channels, outCount, AV_SAMPLE_FMT_S16, 0);
+    if (outSize < 0) {
+        return -1;
+    }
+    av_fast_malloc(&mConvertBuffer, &mConvertSize, outSize);
+    if (!mConvertBuffer) {
+        return AVERROR(ENOMEM);
+    }
+    int len = swr_convert(mSwrCtx, &mConvertBuffer, outCount, (const uint8_t **) frame->extended_data, frame->nb_samples);
+    if (len <= 0) {
+        return len;
+    }
+    int64_t pts = frame->pts != AV_NOPTS_VALUE ? av_rescale(frame->pts, freq, frame->sample_rate) : AV_NOPTS_VALUE;
+
+    Mutex::Autolock lock(mMutex);
+    // 转换期间输出格式已经改变
+    if (freq != mFreq || channels != mChannels) {
+        return 0;
+    }
+    if (!mFifo) {
+        mFifo = av_audio_fifo_alloc(AV_SAMPLE_FMT_S16, channels, (int) (freq * MIX_TRACK_BUFFER_DURATION));
+        if (!mFifo) {
+            return AVERROR(ENOMEM);
+        }
+    }
+    // 时间戳不连续(跳转)时丢弃旧的数据，小的抖动按连续处理
+    if (pts != AV_NOPTS_VALUE) {
+        int64_t end = mFifoStart + av_audio_fifo_size(mFifo);
+        if (mFifoStart == AV_NOPTS_VALUE || llabs(pts - end) > freq / 50) {
+            clearBuffer();
+            mFifoStart = pts;
+        }
+    }
+    // 没有时间戳无法对齐
+    if (mFifoStart == AV_NOPTS_VALUE) {
+        return 0;
+    }
+    return av_audio_fifo_write(mFifo, (void **) &mConvertBuffer, len);
+}
+
+void MixTrack::clearBuffer() {
+    if (mFifo) {
+        av_audio_fifo_reset(mFifo);
+    }
+    mFifoStart = AV_NOPTS_VALUE;
+}
+
+AudioMixer::AudioMixer() {
+    mFreq = 0;
+    mChannels = 0;
+    mChannelLayout = 0;
+    mPrimaryGain = 1 << MIX_GAIN_SHIFT;
+    mMixBuffer = NULL;
+    mMixBufferSize = 0;
+}
+
+AudioMixer::~AudioMixer() {
+    mMutex.lock();
+    std::vector<MixTrack *> tracks;
+    tracks.swap(mTracks);
+    mMutex.unlock();
+    for (size_t i = 0; i < tracks.size(); i++) {
+        delete tracks[i];
+    }
+    av_freep(&mMixBuffer);
+}
+
+void AudioMixer::setOutputFormat(int freq, int channels, int64_t channelLayout) {
+    Mutex::Autolock lock(mMutex);
+    mFreq = freq;
+    mChannels = channels;
+    mChannelLayout = channelLayout;
+    for (size_t i = 0; i < mTracks.size(); i++) {
+        mTracks[i]->setOutputFormat(freq, channels, channelLayout);
+    }
+}
+
+void AudioMixer::addTrack(AudioDecoder *decoder, float gain) {
+    MixTrack *track = new MixTrack(decoder, gain);
+    mMutex.lock();
+    track->setOutputFormat(mFreq, mChannels, mChannelLayout);
+    mTracks.push_back(track);
+    mMutex.unlock();
+    track->start();
+    LOGD("AudioMixer->add track %d, gain: %f", decoder->getStreamIndex(), gain);
+}
+
+void AudioMixer::removeTrack(AudioDecoder *decoder) {
+    MixTrack *track = NULL;
+    mMutex.lock();
+    for (std::vector<MixTrack *>::iterator it = mTracks.begin(); it != mTracks.end(); ++it) {
+        if ((*it)->getDecoder() == decoder) {
+            track = *it;
+            mTracks.erase(it);
+            break;
+        }
+    }
+    mMutex.unlock();
+    // 在锁外退出解码线程，不阻塞音频回调
+    if (track) {
+        delete track;
+        LOGD("AudioMixer->remove track %d", decoder->getStreamIndex());
+    }
+}
+
+void AudioMixer::setTrackGain(AudioDecoder *decoder, float gain) {
+    Mutex::Autolock lock(mMutex);
+    for (size_t i = 0; i < mTracks.size(); i++) {
+        if (mTracks[i]->getDecoder() == decoder) {
+            mTracks[i]->setGain(gain);
+        }
+    }
+}
+
+void AudioMixer::setPrimaryGain(float gain) {
+    Mutex::Autolock lock(mMutex);
+    mPrimaryGain = AudioGain::toFixedGain(gain);
+}
+
+bool AudioMixer::isActive() {
+    Mutex::Autolock lock(mMutex);
+    return !mTracks.empty() || mPrimaryGain != (1 << MIX_GAIN_SHIFT);
+}
+
+void AudioMixer::flush() {
+    Mutex::Autolock lock(mMutex);
+    for (size_t i = 0; i < mTracks.size(); i++) {
+        mTracks[i]->flush();
+    }
+}
+
+void AudioMixer::mix(uint8_t *buffer, int samples, double pts) {
+    Mutex::Autolock lock(mMutex);
+    if (mChannels <= 0) {
+        return;
+    }
+    if (mPrimaryGain != (1 << MIX_GAIN_SHIFT)) {
+        AudioGain::scaleSamples((int16_t *) buffer, samples * mChannels, mPrimaryGain);
+    }
+    if (mTracks.empty() || isnan(pts)) {
+        return;
+    }
+    // 以主音轨的时间戳为基准，对齐到输出采样率的采样点
+    int64_t start = llrint(pts * mFreq);
+    for (size_t i = 0; i < mTracks.size(); i++) {
+        mTracks[i]->mixTo((int16_t *) buffer, start, samples, &mMixBuffer, &mMixBufferSize);
+    }
+}
@@ -0,0 +1,186 @@
+#ifndef AUDIOMIXER_H
+#define AUDIOMIXER_H
+
+#include <vector>
+#include "PlayerState.h"
+#include "AudioDecoder.h"
+#include "AudioGain.h"
+#include "AndroidLog.h"
+
+extern "C" {
+#include "libavutil/audio_fifo.h"
+#include "libswresample/swresample.h"
+}
+
+// 每个混音音轨预先解码缓冲的时长，单位秒
+#define MIX_TRACK_BUFFER_DURATION 0.5
+
+/**
+ * 混音音轨
+ * 在独立的线程中解码，转换成输出格式后按时间戳写入 PCM 环形缓冲，由音频回调按当前帧的时间戳取出混音
+ */
+class MixTrack : public Runnable {
+public:
+    /**
+     * @param decoder 已经开始接收数据包的音频解码器，不持有
+     * @param gain 增益
+     */
+    MixTrack(AudioDecoder *decoder, float gain);
+
+    virtual ~MixTrack();
+
+    /**
+     * 设置输出格式，格式变化时清空缓冲
+     * @param freq 采样率
+     * @param channels 声道数
+     * @param channelLayout 声道布局
+     */
+    void setOutputFormat(int freq, int channels, int64_t channelLayout);
+
+    /**
+     * 开启解码线程
+     */
+    void start();
+
+    /**
+     * 退出解码线程，同时停止解码器
+     */
+    void stop();
+
+    /**
+     * 清空缓冲，跳转时调用
+     */
+    void flush();
+
+    /**
+     * @param gain 0 ~ MIX_GAIN_MAX
+     */
+    void setGain(float gain);
+
+    /**
+     * @return
+     */
+    AudioDecoder *getDecoder();
+
+    /**
+     * 取出从 start 开始的数据混入 buffer，早于 start 的数据直接丢弃，缓冲中还没有的部分保持原样
+     * @param buffer 交错存放的 S16 数据
+     * @param start buffer 第一个采样点的时间，单位为输出采样率的采样点
+     * @param samples buffer 中每个声道的采样点数
+     * @param temp 临时缓冲
+     * @param tempSize
+     */
+    void mixTo(int16_t *buffer, int64_t start, int samples, uint8_t **temp, unsigned int *tempSize);
+
+    void run() override;
+
+private:
+    /**
+     * 把解码帧转换成输出格式后写入缓冲
+     * @param frame
+     * @return < 0 为失败
+     */
+    int writeFrame(AVFrame *frame);
+
+    /**
+     * 清空缓冲，需要持有 mMutex
+     */
+    void clearBuffer();
+
+private:
+    Mutex mMutex;                   //
+    Condition mCondition;           //
+    AudioDecoder *mDecoder;         // 音频解码器
+    Thread *mThread;                // 解码线程
+    bool mAbortRequest;             //
+    int mGain;                      // Q14 定点增益
+
+    int mFreq;                      // 输出格式
+    int mChannels;                  //
+    int64_t mChannelLayout;         //
+    AVAudioFifo *mFifo;             // PCM 环形缓冲
+    int64_t mFifoStart;             // 缓冲中第一个采样点的时间，单位为输出采样率的采样点
+
+    SwrContext *mSwrCtx;            // 转换成输出格式，只在解码线程中使用
+    int mSrcFormat;                 // 创建 mSwrCtx 时输入帧的参数
+    int mSrcRate;                   //
+    int64_t mSrcChannelLayout;      //
+    int mDstFreq;                   // 创建 mSwrCtx 时的输出格式
+    int mDstChannels;               //
+    uint8_t *mConvertBuffer;        //
+    unsigned int mConvertSize;      //
+};
+
+/**
+ * 多音轨混音器
+ * 伴奏、解说等额外的音轨各自解码到 PCM 环形缓冲，在音频回调中按主音轨当前帧的时间戳对齐到采样点混入，
+ * 以音频时钟为基准，额外音轨解码慢时对应部分静音，不阻塞回调
+ */
+class AudioMixer {
+public:
+    AudioMixer();
+
+    virtual ~AudioMixer();
+
+    /**
+     * 设置输出格式，打开音频输出设备后调用，只支持 S16
+     * @param freq
+     * @param channels
+     * @param channelLayout
+     */
+    void setOutputFormat(int freq, int channels, int64_t channelLayout);
+
+    /**
+     * 添加混音音轨并开启解码线程
+     * @param decoder 已经开始接收数据包的音频解码器，不持有
+     * @param gain 增益
+     */
+    void addTrack(AudioDecoder *decoder, float gain);
+
+    /**
+     * 移除混音音轨，退出解码线程
+     * @param decoder
+     */
+    void removeTrack(AudioDecoder *decoder);
+
+    /**
+     * @param decoder
+     * @param gain 0 ~ MIX_GAIN_MAX
+     */
+    void setTrackGain(AudioDecoder *decoder, float gain);
+
+    /**
+     * @param gain 主音轨的增益，0 ~ MIX_GAIN_MAX
+     */
+    void setPrimaryGain(float gain);
+
+    /**
+     * @return 是否有混音音轨
+     */
+    bool isActive();
+
+    /**
+     * 清空所有音轨的缓冲，跳转时调用
+     */
+    void flush();
+
+    /**
+     * 把混音音轨对应时间的数据混入主音轨的数据中
+     * @param buffer 主音轨转换成输出格式的数据
+     * @param samples 每个声道的采样点数
+     * @param pts buffer 的开始时间，单位秒
+     */
+    void mix(uint8_t *buffer, int samples, double pts);
+
+private:
+    Mutex mMutex;                       //
+    std::vector<MixTrack *> mTracks;    // 混音音轨
+    int mFreq;                          // 输出格式
+    int mChannels;                      //
+    int64_t mChannelLayout;             //
+    int mPrimaryGain;                   // 主音轨的 Q14 定点增益
+    uint8_t *mMixBuffer;                // 从音轨缓冲中取出的数据
+    unsigned int mMixBufferSize;        //
+};
+
+#endif //AUDIOMIXER_H
@@ -7,22 +7,58 @@ AudioResampler::AudioResampler(PlayerState *playerState, AudioDecoder *audioDeco
     // 音频重采样结构体
     mAudioState = (AudioState *) av_mallocz(sizeof(AudioState));
     memset(mAudioState, 0, sizeof(AudioState));
-    mSoundTouchWrapper = new SoundTouchWrapper();
+    mTimeStretcher = NULL;
+    mStretcherType = TIME_STRETCHER_AUTO;
+    mAudioFilter = new AudioFilter(playerState->afilters);
+    mFilterBudget = 0;
+    mAudioMixer = new AudioMixer();
     mFrame = av_frame_alloc();
-
+    mNextAudioDecoder = NULL;
+    mNextFrame = av_frame_alloc();
+    mSwitchBuffer = NULL;
+    mSwitchBufferSize = 0;
+    mFramePts = NAN;
+    mStretching = false;
+    // 从静音开始，第一次输出时淡入
+    mAudioGain = new AudioGain();
+    mSeekSerial = playerState->seek_serial;
+    mFadingOut = false;
+    mAudioAnalyzer = NULL;
+    if (playerState->audio_analyzer) {
+        setAnalyzerEnabled(true);
+    }
 }
 
 AudioResampler::~AudioResampler() {
     mPlayerState = NULL;
     mAudioDecoder = NULL;
     mMediaSync = NULL;
-    if (mSoundTouchWrapper) {
-        delete mSoundTouchWrapper;
-        mSoundTouchWrapper = NULL;
+    if (mTimeStretcher) {
+        delete mTimeStretcher;
+        mTimeStretcher = NULL;
+    }
+    if (mAudioFilter) {
+        delete mAudioFilter;
+        mAudioFilter = NULL;
+    }
+    if (mAudioMixer) {
+        delete mAudioMixer;
+        mAudioMixer = NULL;
+    }
+    if (mAudioGain) {
+        delete mAudioGain;
+        mAudioGain = NULL;
+    }
+    if (mAudioAnalyzer) {
+        mAudioAnalyzer->stop();
+        delete mAudioAnalyzer;
+        mAudioAnalyzer = NULL;
     }
     if (mAudioState) {
         swr_free(&mAudioState->swr_ctx);
         av_freep(&mAudioState->resample_buffer);
+        av_freep(&mAudioState->sound_touch_buffer);
+        av_freep(&mAudioState->stretch_buffer);
         memset(mAudioState, 0, sizeof(AudioState));
         av_free(mAudioState);
         mAudioState = NULL;
@@ -32,6 +68,9 @@ AudioResampler::~AudioResampler() {
         av_frame_free(&mFrame);
         mFrame = NULL;
     }
+    mNextAudioDecoder = NULL;
+    av_frame_free(&mNextFrame);
+    av_freep(&mSwitchBuffer);
 }
 
 int AudioResampler::setResampleParams(AudioDeviceSpec *spec, int64_t wanted_channel_layout) {
@@ -71,10 +110,83 @@ int AudioResampler::setResampleParams(AudioDeviceSpec *spec, int64_t wanted_chan
         LOGE("AudioResampler->av_samples_get_buffer_size failed");
         return -1;
     }
+    mAudioMixer->setOutputFormat(mAudioState->audio_params_target.freq, mAudioState->audio_params_target.channels,
+                                 mAudioState->audio_params_target.channel_layout);
     return 0;
 }
 
-void AudioResampler::pcmQueueCallback(uint8_t *stream, int len) {
+void AudioResampler::setAudioDecoder(AudioDecoder *audioDecoder) {
+    mSwitchMutex.lock();
+    mAudioDecoder = audioDecoder;
+    mNextAudioDecoder = NULL;
+    av_frame_unref(mNextFrame);
+    mSwitchMutex.unlock();
+    mAudioState->outputBuffer = NULL;
+    mAudioState->buffer_size = 0;
+    mAudioState->buffer_index = 0;
+    mAudioState->write_buffer_size = 0;
+    mAudioState->audioClock = NAN;
+    mAudioState->audio_diff_cum = 0;
+    mAudioState->audio_diff_avg_count = 0;
+    if (mTimeStretcher) {
+        mTimeStretcher->clear();
+    }
+    if (mAudioFilter) {
+        mAudioFilter->flush();
+    }
+    if (mAudioAnalyzer) {
+        mAudioAnalyzer->flush();
+    }
+}
+
+void AudioResampler::setNextAudioDecoder(AudioDecoder *audioDecoder) {
+    Mutex::Autolock lock(mSwitchMutex);
+    mNextAudioDecoder = audioDecoder;
+    av_frame_unref(mNextFrame);
+}
+
+AudioDecoder *AudioResampler::getAudioDecoder() {
+    Mutex::Autolock lock(mSwitchMutex);
+    return mAudioDecoder;
+}
+
+void AudioResampler::trimMemory() {
+    Mutex::Autolock lock(mMutex);
+    if (mTimeStretcher) {
+        mTimeStretcher->clear();
+    }
+    if (mAudioFilter) {
+        mAudioFilter->flush();
+    }
+    // 丢弃还没有输出的数据
+    mAudioState->outputBuffer = NULL;
+    mAudioState->buffer_size = 0;
+    mAudioState->buffer_index = 0;
+    av_freep(&mAudioState->resample_buffer);
+    mAudioState->resample_size = 0;
+    av_freep(&mAudioState->sound_touch_buffer);
+    mAudioState->sound_touch_buffer_size = 0;
+    av_freep(&mAudioState->stretch_buffer);
+    mAudioState->stretch_buffer_size = 0;
+    mStretching = false;
+}
+
+void AudioResampler::setAudioFilter(const char *filters) {
+    if (mAudioFilter) {
+        mAudioFilter->setFilters(filters);
+    }
+}
+
+void AudioResampler::getAudioFilterStats(AudioFilterStats *stats) {
+    if (mAudioFilter) {
+        mAudioFilter->getStats(stats);
+    } else {
+        memset(stats, 0, sizeof(AudioFilterStats));
+    }
+}
+
+void AudioResampler::pcmQueueCallback(uint8_t *stream, int len, int64_t callbackTime) {
+    Mutex::Autolock lock(mMutex);
     int bufferSize, length;
     // 没有音频解码器时，直接返回
     if (!mAudioDecoder) {
@@ -83,8 +195,42 @@ void AudioResampler::pcmQueueCallback(uint8_t *stream, int len) {
     }
     // 单位:AV_TIME_BASE,
     // 即 ffmpeg 内部使用的时间单位，返回的可能是从系统启动那一刻开始计时的时间
-    mAudioState->audio_callback_time = av_gettime_relative();
+    // 共享音频输出时是按混音帧计数推算的时间
+    mAudioState->audio_callback_time = callbackTime;
+
+    // 暂停和定位时先在已经解码的数据上淡出，之后输出静音并保留剩余的数据，恢复播放时淡入，
+    // 定位完成后丢弃定位前剩余的数据再淡入
+    int channels = mAudioState->audio_params_target.channels;
+    int frameSize = FFMAX(mAudioState->audio_params_target.frame_size, 1);
+    bool seeking = mPlayerState->seek_request || mPlayerState->seek_serial != mSeekSerial;
+    bool hold = mPlayerState->pause_request || mPlayerState->abort_request || seeking;
+    if (hold || mPlayerState->mute) {
+        mAudioGain->setTarget(0.0f, 0.0f, (int) (AUDIO_GAIN_RAMP_DURATION * mAudioState->audio_params_target.freq));
+    }
+    if (seeking && !mPlayerState->seek_request && mAudioGain->getRampFrames() == 0) {
+        mAudioState->buffer_index = mAudioState->buffer_size;
+        mSeekSerial = mPlayerState->seek_serial;
+        if (mAudioAnalyzer) {
+            mAudioAnalyzer->flush();
+        }
+        hold = mPlayerState->pause_request || mPlayerState->abort_request;
+    }
+    if (!hold && !mPlayerState->mute) {
+        mAudioGain->setTarget(mPlayerState->left_volume, mPlayerState->right_volume,
+                              (int) (AUDIO_GAIN_RAMP_DURATION * mAudioState->audio_params_target.freq));
+    }
+    mFadingOut = hold && mAudioGain->getRampFrames() > 0;
+    // 滤镜预读或者追赶时，一次回调中解码和处理的数据不超过回调时长的若干倍，避免回调超时
+    mFilterBudget = mAudioState->audio_params_target.bytes_per_sec > 0
+                    ? (int64_t) len * AV_TIME_BASE / mAudioState->audio_params_target.bytes_per_sec * AUDIO_FILTER_BUDGET
+                    : 0;
+
     while (len > 0) {
+        if (hold && mAudioGain->getRampFrames() == 0) {
+            // 淡出结束，不再消耗数据
+            memset(stream, 0, len);
+            break;
+        }
         // 一般 audioState->bufferSize 为一次 audioFrameResample 采集音频数据大小，
         // mAudioState->buffer_index 实际上就是这些数据写了多少
         if (mAudioState->buffer_index >= mAudioState->buffer_size) {
@@ -108,14 +254,28 @@ void AudioResampler::pcmQueueCallback(uint8_t *stream, int len) {
         if (length > len) {
             length = len;
         }
-        // 复制经过转码输出的PCM数据到缓冲区中
-        if (mAudioState->outputBuffer != NULL && !mPlayerState->mute) {
+        // 淡出时只消耗渐变所需的数据
+        if (hold) {
+            length = FFMIN(length, mAudioGain->getRampFrames() * frameSize);
+        }
+        // 复制经过转码输出的PCM数据到缓冲区中，静音由软件增益渐变处理
+        if (mAudioState->outputBuffer != NULL) {
             // 从存储区 str2 复制 n 个字符到存储区 str1。
             memcpy(stream, mAudioState->outputBuffer + mAudioState->buffer_index, length);
         } else {
             // 暂停执行这里
             memset(stream, 0, length);
         }
+        // 分析增益之前的数据，电平和频谱不受音量影响
+        if (mAudioAnalyzer && mAudioState->outputBuffer != NULL && length > 0) {
+            double endPts = mAudioState->audioClock
+                            - (double) (mAudioState->buffer_size - mAudioState->buffer_index - length)
+                              / mAudioState->audio_params_target.bytes_per_sec;
+            mAudioAnalyzer->write((const int16_t *) stream, length / frameSize, channels,
+                                  mAudioState->audio_params_target.freq, endPts, mPlayerState->playback_rate,
+                                  (int) ((2 * mAudioState->audio_hw_buf_size + len - length) / frameSize));
+        }
+        mAudioGain->process((int16_t *) stream, length / frameSize, channels);
         len -= length;
         stream += length;
         // 写了多少index就增加多少
@@ -164,23 +324,206 @@ int AudioResampler::audioSynchronize(int nbSamples) {
     return wanted_nb_samples;
 }
 
+AudioMixer *AudioResampler::getAudioMixer() {
+    return mAudioMixer;
+}
+
+void AudioResampler::setAnalyzerEnabled(bool enable) {
+    // 只有这里修改指针，判断不需要加锁
+    if (enable == (mAudioAnalyzer != NULL)) {
+        return;
+    }
+    // 分析器有几百 KB 的缓冲并且要开启线程，在回调锁之外创建，锁内只替换指针
+    AudioAnalyzer *analyzer = NULL;
+    if (enable) {
+        analyzer = new AudioAnalyzer();
+        analyzer->start();
+    }
+    mMutex.lock();
+    AudioAnalyzer *old = mAudioAnalyzer;
+    mAudioAnalyzer = analyzer;
+    mMutex.unlock();
+    // 在回调锁之外等待分析线程退出
+    if (old) {
+        old->stop();
+        delete old;
+    }
+}
+
+int AudioResampler::getAudioAnalysis(AudioAnalysis *analysis) {
+    // 读取不经过回调锁，避免阻塞音频回调
+    if (!mAudioAnalyzer) {
+        return -1;
+    }
+    return mAudioAnalyzer->getAnalysis(analysis);
+}
+
+int AudioResampler::getFilteredFrame() {
+    // 滤镜一次可能输出多帧，先取完再解码下一帧
+    if (mAudioFilter->receiveFrame(mFrame) >= 0) {
+        return 1;
+    }
+    // 滤镜还在预读，这次回调送入的数据已经达到预算，剩下的留到下一次回调
+    if (mFilterBudget <= 0) {
+        return 0;
+    }
+    int ret = 0;
+    // 切换音轨时已经解码出来的第一帧
+    mSwitchMutex.lock();
+    if (!mNextAudioDecoder && mNextFrame->buf[0]) {
+        av_frame_move_ref(mFrame, mNextFrame);
+        ret = 1;
+    }
+    mSwitchMutex.unlock();
+    if (!ret) {
+        ret = mAudioDecoder->getAudioFrame(mFrame);
+    }
+    if (ret <= 0) {
+        return ret;
+    }
+    int64_t duration = mFrame->sample_rate > 0 ? av_rescale(mFrame->nb_samples, AV_TIME_BASE, mFrame->sample_rate) : 0;
+    if (mAudioFilter->sendFrame(mFrame) < 0) {
+        return 0;
+    }
+    // 更换滤镜后新的滤镜图还没有追上输出位置，在预算内多解码几帧，不阻塞等待数据包
+    while (mFilterBudget > 0 && mAudioFilter->isCatchingUp()) {
+        if (mAudioDecoder->getAudioFrame(mFrame, 0) <= 0) {
+            break;
+        }
+        mFilterBudget -= mFrame->sample_rate > 0 ? av_rescale(mFrame->nb_samples, AV_TIME_BASE, mFrame->sample_rate) : 0;
+        if (mAudioFilter->sendFrame(mFrame) < 0) {
+            break;
+        }
+    }
+    if (mAudioFilter->receiveFrame(mFrame) >= 0) {
+        return 1;
+    }
+    // 送入的数据没有输出，计入预算
+    mFilterBudget -= duration;
+    return 0;
+}
+
 int AudioResampler::audioFrameResample() {
+    int size = resampleFrame();
+    if (size <= 0) {
+        return size;
+    }
+    // 切换音轨，新音轨追上当前的播放位置后接入
+    mSwitchMutex.lock();
+    bool ready = mNextAudioDecoder && isNextFrameReady(mFramePts);
+    if (ready) {
+        mAudioDecoder = mNextAudioDecoder;
+        mNextAudioDecoder = NULL;
+    }
+    mSwitchMutex.unlock();
+    // 新的解码器可能阻塞等待数据包，不能在 mSwitchMutex 内处理
+    if (ready) {
+        size = switchAudioDecoder(size);
+    }
+    return size;
+}
+
+bool AudioResampler::isNextFrameReady(double pts) {
+    for (;;) {
+        if (!mNextFrame->buf[0] && mNextAudioDecoder->getAudioFrame(mNextFrame, 0) <= 0) {
+            return false;
+        }
+        if (isnan(pts) || mNextFrame->pts == AV_NOPTS_VALUE || mNextFrame->sample_rate <= 0) {
+            return true;
+        }
+        double start = mNextFrame->pts / (double) mNextFrame->sample_rate;
+        double end = start + mNextFrame->nb_samples / (double) mNextFrame->sample_rate;
+        // 新音轨的数据还在当前位置之前，丢弃后继续解码
+        if (end <= pts) {
+            av_frame_unref(mNextFrame);
+            continue;
+        }
+        return start <= pts;
+    }
+}
+
+int AudioResampler::switchAudioDecoder(int size) {
+    double pts = mFramePts;
+    double nextPts = mNextFrame->pts != AV_NOPTS_VALUE && mNextFrame->sample_rate > 0
+                     ? mNextFrame->pts / (double) mNextFrame->sample_rate : NAN;
+    int frameSize = mAudioState->audio_params_target.frame_size;
+    LOGD("AudioResampler->switch audio decoder at %0.3f, next frame: %0.3f", pts, nextPts);
+
+    // 保存旧音轨当前帧的数据
+    uint8_t *oldBuffer = NULL;
+    if (hasConvertedOutput()) {
+        av_fast_malloc(&mSwitchBuffer, &mSwitchBufferSize, size);
+        if (mSwitchBuffer) {
+            memcpy(mSwitchBuffer, mAudioState->outputBuffer, size);
+            oldBuffer = mSwitchBuffer;
+        }
+    }
+
+    // 丢弃旧音轨在滤镜和变速变调中缓冲的数据
+    mAudioFilter->flush();
+    if (mTimeStretcher) {
+        mTimeStretcher->clear();
+    }
+    int newSize = resampleFrame();
+    if (newSize <= 0) {
+        return newSize;
+    }
+    // 直接转换和 swresample 的结果都在 resample_buffer 中，不能用 swr_ctx 判断
+    bool converted = hasConvertedOutput();
+
+    // 新音轨的帧从当前位置之前开始，跳过多出来的采样点，对齐到旧音轨当前帧的开头
+    if (!isnan(pts) && !isnan(nextPts) && pts > nextPts && mPlayerState->playback_rate == 1.0f) {
+        int skip = (int) ((pts - nextPts) * mAudioState->audio_params_target.freq) * frameSize;
+        if (skip > 0 && skip < newSize && mAudioState->outputBuffer) {
+            mAudioState->outputBuffer += skip;
+            newSize -= skip;
+        }
+    }
+
+    // 交叉淡化，旧音轨淡出、新音轨淡入
+    if (oldBuffer && converted && mAudioState->audio_params_target.fmt == AV_SAMPLE_FMT_S16) {
+        int channels = mAudioState->audio_params_target.channels;
+        int samples = FFMIN(size, newSize) / frameSize;
+        samples = FFMIN(samples, (int) (AUDIO_SWITCH_CROSSFADE * mAudioState->audio_params_target.freq));
+        int16_t *oldData = (int16_t *) oldBuffer;
+        int16_t *newData = (int16_t *) mAudioState->outputBuffer;
+        for (int i = 0; i < samples; i++) {
+            float gain = (float) (i + 1) / (samples + 1);
+            for (int c = 0; c < channels; c++) {
+                int index = i * channels + c;
+                newData[index] = (int16_t) (oldData[index] * (1.0f - gain) + newData[index] * gain);
+            }
+        }
+    }
+    return newSize;
+}
+
+bool AudioResampler::hasConvertedOutput() {
+    return mAudioState->outputBuffer
+           && (mAudioState->outputBuffer == mAudioState->resample_buffer
+               || mAudioState->outputBuffer == (uint8_t *) mAudioState->sound_touch_buffer);
+}
+
+int AudioResampler::resampleFrame() {
     int data_size, resampled_data_size;
     int64_t dec_channel_layout;
     int wanted_nb_samples;
-    int translate_time = 1;
     int ret;
     // 处于暂停状态
-    if (!mAudioDecoder || mPlayerState->abort_request || mPlayerState->pause_request) {
+    if (!mAudioDecoder || mPlayerState->abort_request || (mPlayerState->pause_request && !mFadingOut)) {
         return -1;
     }
 
     for (;;) {
         // 如果数据包解码失败，直接返回
-        if ((ret = mAudioDecoder->getAudioFrame(mFrame)) < 0) { //获取解码得到的音频帧
+        if ((ret = getFilteredFrame()) < 0) { //获取解码并经过滤镜处理的音频帧
             return -1;
         }
         if (ret == 0) {
+            // 滤镜预读的数据达到这次回调的预算，先输出静音
+            if (mFilterBudget <= 0) {
+                return -1;
+            }
             continue;
         }
         // 获取 frame 的大小
@@ -196,18 +539,36 @@ int AudioResampler::audioFrameResample() {
                              : av_get_default_channel_layout(av_frame_get_channels(mFrame));
 
         wanted_nb_samples = audioSynchronize(mFrame->nb_samples);
+        // 混音在输出格式的数据上进行，格式一致时也要经过重采样复制出来
+        bool mixing = mAudioMixer->isActive();
+        // 原速原调时跳过变速变调，变速变调时由重采样直接输出处理的样本格式，
+        // 需要混音时先按输出格式混音再转换
+        bool stretching = mPlayerState->playback_rate != 1.0f || mPlayerState->playback_pitch != 1.0f;
+        AVSampleFormat resample_fmt = stretching && !mixing ? AUDIO_STRETCH_FMT : mAudioState->audio_params_target.fmt;
+        AVSampleFormat out_fmt = resample_fmt;  // resample_buffer 的样本格式
+        int len2 = 0;
+        bool converted = false;
+
+        // 采样率不变且不需要同步补偿时，平面格式直接转换成输出格式，不经过 swresample，
+        // swresample 中还有补偿留下的数据时继续使用它，避免丢掉这部分数据
+        bool direct = mFrame->sample_rate == mAudioState->audio_params_target.freq
+                      && wanted_nb_samples == mFrame->nb_samples
+                      && SampleConverter::isSupported((AVSampleFormat) mFrame->format, dec_channel_layout,
+                                                      resample_fmt, mAudioState->audio_params_target.channel_layout)
+                      && (!mAudioState->swr_ctx || swr_get_delay(mAudioState->swr_ctx, mFrame->sample_rate) == 0);
 
         // 帧格式跟源格式不对？？？？当返回 frame 的格式跟音频原始参数不一样的时候，则修正
-        if (mFrame->format != mAudioState->audio_params_src.fmt ||
+        if (!direct && (mFrame->format != mAudioState->audio_params_src.fmt ||
             dec_channel_layout != mAudioState->audio_params_src.channel_layout ||
             mFrame->sample_rate != mAudioState->audio_params_src.freq ||
-            (wanted_nb_samples != mFrame->nb_samples && !mAudioState->swr_ctx)) {
+            ((wanted_nb_samples != mFrame->nb_samples || mixing || stretching) && !mAudioState->swr_ctx) ||
+            (mAudioState->swr_ctx && resample_fmt != mAudioState->resample_fmt))) {
 
             swr_free(&mAudioState->swr_ctx);
             mAudioState->swr_ctx = swr_alloc_set_opts(
                     NULL,
                     mAudioState->audio_params_target.channel_layout,
-                    mAudioState->audio_params_target.fmt,
+                    resample_fmt,
                     mAudioState->audio_params_target.freq,
                     dec_channel_layout,
                     (AVSampleFormat) mFrame->format,
@@ -223,12 +584,13 @@ int AudioResampler::audioFrameResample() {
                         av_get_sample_fmt_name((AVSampleFormat) mFrame->format),
                         av_frame_get_channels(mFrame),
                         mAudioState->audio_params_target.freq,
-                        av_get_sample_fmt_name(mAudioState->audio_params_target.fmt),
+                        av_get_sample_fmt_name(resample_fmt),
                         mAudioState->audio_params_target.channels
                 );
                 swr_free(&mAudioState->swr_ctx);
                 return -1;
             }
+            mAudioState->resample_fmt = resample_fmt;
             mAudioState->audio_params_src.channel_layout = dec_channel_layout;
             mAudioState->audio_params_src.channels = av_frame_get_channels(mFrame);
             mAudioState->audio_params_src.freq = mFrame->sample_rate;
@@ -236,7 +598,24 @@ int AudioResampler::audioFrameResample() {
         }
 
         // 音频重采样处理
-        if (mAudioState->swr_ctx) {
+        if (direct) {
+            int out_size = mFrame->nb_samples * mAudioState->audio_params_target.channels
+                           * av_get_bytes_per_sample(resample_fmt);
+            av_fast_malloc(&mAudioState->resample_buffer, &mAudioState->resample_size, out_size);
+            if (!mAudioState->resample_buffer) {
+                return AVERROR(ENOMEM);
+            }
+            if (SampleConverter::convert(mAudioState->resample_buffer, resample_fmt,
+                                         mAudioState->audio_params_target.channels,
+                                         (const uint8_t *const *) mFrame->extended_data,
+                                         (AVSampleFormat) mFrame->format, av_frame_get_channels(mFrame),
+                                         mFrame->nb_samples) < 0) {
+                LOGE("AudioResampler->SampleConverter::convert() failed");
+                return -1;
+            }
+            len2 = mFrame->nb_samples;
+            converted = true;
+        } else if (mAudioState->swr_ctx) {
             const uint8_t **in = (const uint8_t **) mFrame->extended_data;
             uint8_t **out = &mAudioState->resample_buffer;
             int out_count = (int64_t) wanted_nb_samples * mAudioState->audio_params_target.freq / mFrame->sample_rate + 256;
@@ -244,10 +623,9 @@ int AudioResampler::audioFrameResample() {
                     NULL,
                     mAudioState->audio_params_target.channels,
                     out_count,
-                    mAudioState->audio_params_target.fmt,
+                    mAudioState->resample_fmt,
                     0
             );
-            int len2;
             if (out_size < 0) {
                 LOGE("AudioResampler->av_samples_get_buffer_size() failed");
                 return -1;
@@ -288,44 +666,39 @@ int AudioResampler::audioFrameResample() {
                     swr_free(&mAudioState->swr_ctx);
                 }
             }
+            out_fmt = mAudioState->resample_fmt;
+            converted = true;
+        }
+
+        if (converted) {
             mAudioState->outputBuffer = mAudioState->resample_buffer;
             // 重采样得到的数据大小，单位 byte
             resampled_data_size = len2 * mAudioState->audio_params_target.channels *
-                                  av_get_bytes_per_sample(mAudioState->audio_params_target.fmt);
+                                  av_get_bytes_per_sample(out_fmt);
+
+            // 按主音轨当前帧的时间戳混入其它音轨
+            if (mixing) {
+                mAudioMixer->mix(mAudioState->resample_buffer, len2,
+                                 mFrame->pts != AV_NOPTS_VALUE ? mFrame->pts / (double) mFrame->sample_rate : NAN);
+            }
 
             // 变速变调处理
-            if ((mPlayerState->playback_rate != 1.0f || mPlayerState->playback_pitch != 1.0f) &&
-                !mPlayerState->abort_request) {
-                int bytes_per_sample = av_get_bytes_per_sample(mAudioState->audio_params_target.fmt);
-                av_fast_malloc(
-                        &mAudioState->sound_touch_buffer,
-                        &mAudioState->sound_touch_buffer_size,
-                        out_size * translate_time
-                );
-                for (int i = 0; i < (resampled_data_size / 2); i++) {
-                    mAudioState->sound_touch_buffer[i] = (mAudioState->resample_buffer[i * 2] |
-                                                          (mAudioState->resample_buffer[i * 2 + 1] << 8));
-                }
-                if (!mSoundTouchWrapper) {
-                    mSoundTouchWrapper = new SoundTouchWrapper();
+            if (stretching && !mPlayerState->abort_request) {
+                int ret_len = timeStretch(len2, out_fmt);
+                if (ret_len < 0) {
+                    return -1;
                 }
-                int ret_len = mSoundTouchWrapper->translate(
-                        mAudioState->sound_touch_buffer,
-                        (float) (mPlayerState->playback_rate),
-                        (float) (mPlayerState->playback_pitch != 1.0f ? mPlayerState->playback_pitch : 1.0f / mPlayerState->playback_rate),
-                        resampled_data_size / 2,
-                        bytes_per_sample,
-                        mAudioState->audio_params_target.channels,
-                        mFrame->sample_rate
-                );
                 if (ret_len > 0) {
                     mAudioState->outputBuffer = (uint8_t *) mAudioState->sound_touch_buffer;
                     resampled_data_size = ret_len;
                 } else {
-                    translate_time++;
                     av_frame_unref(mFrame);
                     continue;
                 }
+            } else if (mStretching) {
+                // 恢复原速原调，丢弃变速变调中缓冲的数据
+                mTimeStretcher->clear();
+                mStretching = false;
             }
         } else {
             mAudioState->outputBuffer = mFrame->data[0];
@@ -337,6 +710,7 @@ int AudioResampler::audioFrameResample() {
     }
 
     // 利用 pts 更新音频时钟
+    mFramePts = mFrame->pts != AV_NOPTS_VALUE ? mFrame->pts / (double) mFrame->sample_rate : NAN;
     if (mFrame->pts != AV_NOPTS_VALUE) {
         mAudioState->audioClock = mFrame->pts * av_q2d((AVRational) {1, mFrame->sample_rate}) + (double) mFrame->nb_samples / mFrame->sample_rate;
     } else {
@@ -349,3 +723,82 @@ int AudioResampler::audioFrameResample() {
     return resampled_data_size;
 }
 
+int AudioResampler::timeStretch(int nbSamples, AVSampleFormat fmt) {
+    int channels = mAudioState->audio_params_target.channels;
+    float speed = mPlayerState->playback_rate;
+    float pitch = mPlayerState->playback_pitch;
+    // 高倍速不变调时使用开销更低的 atempo，变调时使用 SoundTouch
+    TimeStretcherType type = TimeStretcher::chooseType(mPlayerState->time_stretcher, speed, pitch,
+                                                       mPlayerState->speech != 0);
+    // 自动选择时，变速过程中当前算法支持新参数就继续使用，恢复原速之后再重新选择
+    if (mStretching && mTimeStretcher && mPlayerState->time_stretcher == TIME_STRETCHER_AUTO
+        && mTimeStretcher->isSupported(speed, pitch)) {
+        type = mStretcherType;
+    }
+    // 必须切换时先处理完旧算法缓冲的数据，输出在新算法的数据之前
+    TimeStretcher *previous = NULL;
+    if (!mTimeStretcher || type != mStretcherType) {
+        if (mTimeStretcher && mStretching) {
+            mTimeStretcher->drain();
+            previous = mTimeStretcher;
+        } else if (mTimeStretcher) {
+            delete mTimeStretcher;
+        }
+        mTimeStretcher = TimeStretcher::create(type, mPlayerState->speech != 0);
+        mStretcherType = type;
+        LOGD("AudioResampler->time stretcher: %s, speed: %.2f, pitch: %.2f", mTimeStretcher->getName(), speed, pitch);
+    }
+    // 参数没有变化时不会重新配置
+    mTimeStretcher->setParams(speed, pitch, channels, mAudioState->audio_params_target.freq);
+    mStretching = true;
+
+    // 重采样已经输出变速变调的样本格式时直接送入，混音后的数据需要先转换
+    int bytesPerSample = av_get_bytes_per_sample(AUDIO_STRETCH_FMT);
+    const uint8_t *input = mAudioState->resample_buffer;
+    if (fmt != AUDIO_STRETCH_FMT) {
+        int count = nbSamples * channels;
+        av_fast_malloc(&mAudioState->stretch_buffer, &mAudioState->stretch_buffer_size, count * bytesPerSample);
+        if (!mAudioState->stretch_buffer) {
+            delete previous;
+            return AVERROR(ENOMEM);
+        }
+        const int16_t *src = (const int16_t *) mAudioState->resample_buffer;
+        SAMPLETYPE *dst = (SAMPLETYPE *) mAudioState->stretch_buffer;
+        for (int i = 0; i < count; i++) {
+            dst[i] = (SAMPLETYPE) (src[i] * (1.0f / 32768.0f));
+        }
+        input = mAudioState->stretch_buffer;
+    }
+    mTimeStretcher->putSamples(input, nbSamples);
+
+    // 按实际可以取出的数量分配，慢速播放时输出会比输入多
+    int pending = previous ? previous->availableSamples() : 0;
+    int available = mTimeStretcher->availableSamples();
+    if (pending + available <= 0) {
+        delete previous;
+        return 0;
+    }
+    av_fast_malloc(&mAudioState->sound_touch_buffer, &mAudioState->sound_touch_buffer_size,
+                   (pending + available) * channels * bytesPerSample);
+    if (!mAudioState->sound_touch_buffer) {
+        delete previous;
+        return AVERROR(ENOMEM);
+    }
+    int received = 0;
+    if (previous) {
+        received = previous->receiveSamples((uint8_t *) mAudioState->sound_touch_buffer, pending);
+        delete previous;
+    }
+    received += mTimeStretcher->receiveSamples((uint8_t *) mAudioState->sound_touch_buffer
+                                               + received * channels * bytesPerSample, available);
+#ifdef SOUNDTOUCH_FLOAT_SAMPLES
+    // 原地转换成 S16，写入的位置始终不超过读取的位置
+    const float *src = (const float *) mAudioState->sound_touch_buffer;
+    int16_t *dst = (int16_t *) mAudioState->sound_touch_buffer;
+    for (int i = 0; i < received * channels; i++) {
+        dst[i] = av_clip_int16(lrintf(src[i] * 32768.0f));
+    }
+#endif
+    return received * channels * av_get_bytes_per_sample(mAudioState->audio_params_target.fmt);
+}
+
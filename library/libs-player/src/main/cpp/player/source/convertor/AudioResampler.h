@@ -3,10 +3,22 @@
 
 #include <PlayerState.h>
 #include <MediaSync.h>
-#include <SoundTouchWrapper.h>
 #include <AudioDevice.h>
+#include "AudioAnalyzer.h"
+#include "AudioFilter.h"
+#include "AudioGain.h"
+#include "AudioMixer.h"
+#include "SampleConverter.h"
+#include "TimeStretcher.h"
 #include "AndroidLog.h"
 
+// 切换音轨时新旧音轨交叉淡化的时长，单位秒
+#define AUDIO_SWITCH_CROSSFADE 0.03
+// 音量变化、静音以及暂停、定位时淡入淡出的时长，单位秒
+#define AUDIO_GAIN_RAMP_DURATION 0.02
+// 每次回调最多向没有输出的滤镜额外送入的数据时长，相对回调时长的倍数，超过时先输出静音，下一次回调继续
+#define AUDIO_FILTER_BUDGET 2
+
 /**
  * 音频参数
  */
@@ -31,13 +43,16 @@ typedef struct AudioState {
     int audio_hw_buf_size;                  // SLES 中音频缓冲区大小
     uint8_t *outputBuffer;                  // 输出缓冲大小
     uint8_t *resample_buffer;               // 重采样大小
-    short *sound_touch_buffer;              // SoundTouch 缓冲
+    short *sound_touch_buffer;              // 变速变调输出缓冲，取出后原地转换成输出格式
+    uint8_t *stretch_buffer;                // 混音后的数据转换成变速变调样本格式的缓冲
     unsigned int buffer_size;               // 缓冲大小
     unsigned int resample_size;             // 重采样大小
-    unsigned int sound_touch_buffer_size;   // SoundTouch 处理后的缓冲大小大小
+    unsigned int sound_touch_buffer_size;   // 变速变调处理后的缓冲大小
+    unsigned int stretch_buffer_size;       //
     int buffer_index;                       //
     int write_buffer_size;                  // 写入大小
     SwrContext *swr_ctx;                    // 音频转码上下文
+    enum AVSampleFormat resample_fmt;       // swr_ctx 的输出格式，变速变调时为 AUDIO_STRETCH_FMT
     int64_t audio_callback_time;            // 音频回调时间
     AudioParams audio_params_src;           // 音频原始参数
     AudioParams audio_params_target;        // 音频目标参数
@@ -65,14 +80,109 @@ public:
      */
     int setResampleParams(AudioDeviceSpec *spec, int64_t wanted_channel_layout);
 
+    /**
+     * 更换音频解码器，丢弃已经缓冲的数据，输出参数和重采样上下文保持不变，
+     * 复用音频输出设备播放新的文件时调用
+     * @param audioDecoder
+     */
+    void setAudioDecoder(AudioDecoder *audioDecoder);
+
+    /**
+     * 设置切换音轨后的音频解码器，回调中等到它解码出的帧追上当前的播放位置后，
+     * 对齐到同一个采样点并交叉淡化接入输出，之后替换当前的音频解码器
+     * @param audioDecoder 已经开始接收数据包的解码器，NULL 表示取消切换
+     */
+    void setNextAudioDecoder(AudioDecoder *audioDecoder);
+
+    /**
+     * @return 当前输出的音频解码器，切换完成后为新的解码器
+     */
+    AudioDecoder *getAudioDecoder();
+
     /**
      * PCM队列回调方法，用于取得PCM数据
      * @param stream
      * @param len 需要读取数据的长度
+     * @param callbackTime 这次回调的时间，单位微秒，由音频输出设备提供
      */
-    void pcmQueueCallback(uint8_t *stream, int len);
+    void pcmQueueCallback(uint8_t *stream, int len, int64_t callbackTime);
+
+    /**
+     * 清空变速变调缓冲的数据并释放重采样缓冲区，暂停时内存紧张调用，下次回调时按需重新分配
+     */
+    void trimMemory();
+
+    /**
+     * 更换音频滤镜，播放中调用在下一帧生效
+     * @param filters 滤镜描述，为空时停用滤镜
+     */
+    void setAudioFilter(const char *filters);
+
+    /**
+     * 获取音频滤镜的统计信息
+     * @param stats
+     */
+    void getAudioFilterStats(AudioFilterStats *stats);
+
+    /**
+     * @return 多音轨混音器
+     */
+    AudioMixer *getAudioMixer();
+
+    /**
+     * 开启或者关闭输出音频的电平和频谱分析
+     * @param enable
+     */
+    void setAnalyzerEnabled(bool enable);
+
+    /**
+     * 取出最新的分析结果，与 setAnalyzerEnabled 不能同时调用
+     * @param analysis
+     * @return 0 为成功，< 0 为没有开启或者还没有结果
+     */
+    int getAudioAnalysis(AudioAnalysis *analysis);
 
 private:
+    /**
+     * 取出经过音频滤镜处理的帧，滤镜预读时每次回调送入的数据受 mFilterBudget 限制
+     * @return < 0 为失败，0 需要重新获取，预算用完时先输出静音，> 0 为成功
+     */
+    int getFilteredFrame();
+
+    /**
+     * 新音轨是否已经解码到当前帧的位置，不阻塞，已经过时的帧直接丢弃
+     * @param pts 当前帧的开始时间，单位秒
+     * @return
+     */
+    bool isNextFrameReady(double pts);
+
+    /**
+     * 替换成新的音频解码器，重新生成当前位置的数据，开头与旧音轨的数据交叉淡化
+     * @param size 旧音轨当前帧的数据大小
+     * @return 新的数据大小
+     */
+    int switchAudioDecoder(int size);
+
+    /**
+     * outputBuffer 是否指向重采样或者变速变调的输出，这两种数据是输出格式，帧释放之后仍然有效
+     * @return
+     */
+    bool hasConvertedOutput();
+
+    /**
+     * 解码一帧并重采样、变速变调
+     * @return 数据大小，< 0 为失败
+     */
+    int resampleFrame();
+
+    /**
+     * 变速变调，结果写入 sound_touch_buffer 并转换成输出格式
+     * @param nbSamples resample_buffer 中每个声道的采样点数
+     * @param fmt resample_buffer 的样本格式
+     * @return 输出的数据大小，0 表示需要更多数据
+     */
+    int timeStretch(int nbSamples, AVSampleFormat fmt);
+
     /**
      * @param nbSamples
      * @return
@@ -85,12 +195,28 @@ private:
     int audioFrameResample();
 
 private:
+    Mutex mMutex;                            // 回调和释放内存互斥
     PlayerState *mPlayerState;               //
     MediaSync *mMediaSync;                   //
     AVFrame *mFrame;                         //
     AudioDecoder *mAudioDecoder;             // 音频解码器
     AudioState *mAudioState;                 // 音频重采样状态
-    SoundTouchWrapper *mSoundTouchWrapper;   // 变速变调处理
+    TimeStretcher *mTimeStretcher;           // 变速变调处理，按速度和音调选择算法
+    TimeStretcherType mStretcherType;        // 当前使用的算法
+    AudioFilter *mAudioFilter;               // 音频滤镜
+    int64_t mFilterBudget;                   // 本次回调还能向滤镜额外送入的数据时长，单位微秒
+    AudioMixer *mAudioMixer;                 // 多音轨混音
+    Mutex mSwitchMutex;                      // 切换音频解码器互斥，切换过程不阻塞
+    AudioDecoder *mNextAudioDecoder;         // 切换音轨后的音频解码器
+    AVFrame *mNextFrame;                     // 新音轨已解码、等待接入的帧
+    uint8_t *mSwitchBuffer;                  // 切换时保存旧音轨的数据，用于交叉淡化
+    unsigned int mSwitchBufferSize;          //
+    double mFramePts;                        // 最近一帧的开始时间，单位秒
+    bool mStretching;                        // 变速变调中是否有缓冲的数据，恢复原速时清空
+    AudioGain *mAudioGain;                   // 音量、静音和淡入淡出
+    int mSeekSerial;                         // 已经处理的定位次数
+    bool mFadingOut;                         // 暂停后正在淡出，继续解码直到淡出结束
+    AudioAnalyzer *mAudioAnalyzer;           // 电平和频谱分析，没有开启时为 NULL
 };
 
 #endif //FFMPEG4_AUDIORESAMPLER_H
@@ -0,0 +1,346 @@
+#include "SampleConverter.h"
+#include <math.h>
+#include <string.h>
+
+extern "C" {
+#include "libavutil/common.h"
+}
+
+#if defined(SAMPLE_CONVERTER_NO_SIMD)
+// 测试时关闭 SIMD，只编译标量实现
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SAMPLE_CONVERTER_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+// armv7 的 NEON 没有就近舍入的浮点转整数指令，无法与 lrintf 保持一致，使用标量实现
+#include <arm_neon.h>
+#define SAMPLE_CONVERTER_NEON
+#endif
+
+// 单声道转立体声的系数，swresample 默认把中置声道按 -3dB 混入左右声道
+#define MONO_TO_STEREO_GAIN 0.70710677f
+// 同一个系数在 S16 混音中使用的 Q15 定点值
+#define MONO_TO_STEREO_GAIN_Q15 23170
+// 立体声转单声道时两个声道的系数，-3dB 的系数按总和归一化后为 0.5
+#define STEREO_TO_MONO_GAIN 0.5f
+
+// 先饱和再取整，与 SIMD 路径一致，超出 int32 范围的输入不会回绕
+static inline int16_t floatToS16(float value) {
+    return (int16_t) lrintf(av_clipf(value * 32768.0f, -32768.0f, 32767.0f));
+}
+
+#if defined(SAMPLE_CONVERTER_SSE2)
+// 先饱和再取整，结果与 av_clip_int16(lrintf(x * 32768)) 相同，同时避免超出 int32 的范围
+static inline __m128i floatToS32(__m128 value) {
+    value = _mm_mul_ps(value, _mm_set1_ps(32768.0f));
+    value = _mm_min_ps(_mm_max_ps(value, _mm_set1_ps(-32768.0f)), _mm_set1_ps(32767.0f));
+    return _mm_cvtps_epi32(value);
+}
+#elif defined(SAMPLE_CONVERTER_NEON)
+static inline int16x4_t floatToS16x4(float32x4_t value) {
+    value = vmulq_n_f32(value, 32768.0f);
+    value = vminq_f32(vmaxq_f32(value, vdupq_n_f32(-32768.0f)), vdupq_n_f32(32767.0f));
+    return vqmovn_s32(vcvtnq_s32_f32(value));
+}
+#endif
+
+bool SampleConverter::isSupported(AVSampleFormat srcFmt, int64_t srcLayout, AVSampleFormat dstFmt, int64_t dstLayout) {
+    if ((srcFmt != AV_SAMPLE_FMT_FLTP && srcFmt != AV_SAMPLE_FMT_S16P) || srcLayout == 0) {
+        return false;
+    }
+    if (dstFmt != AV_SAMPLE_FMT_S16 && dstFmt != AV_SAMPLE_FMT_FLT) {
+        return false;
+    }
+    if (srcLayout == dstLayout) {
+        return true;
+    }
+    // 输出浮点时 swresample 的混音系数不做归一化，只支持 S16 输出的上下混
+    return dstFmt == AV_SAMPLE_FMT_S16
+           && ((srcLayout == AV_CH_LAYOUT_MONO && dstLayout == AV_CH_LAYOUT_STEREO)
+               || (srcLayout == AV_CH_LAYOUT_STEREO && dstLayout == AV_CH_LAYOUT_MONO));
+}
+
+int SampleConverter::convert(uint8_t *dst, AVSampleFormat dstFmt, int dstChannels,
+                             const uint8_t *const *src, AVSampleFormat srcFmt, int srcChannels, int nbSamples) {
+    if (dstFmt == AV_SAMPLE_FMT_FLT) {
+        if (srcChannels != dstChannels) {
+            return -1;
+        }
+        planarToFlt((float *) dst, src, srcFmt, srcChannels, nbSamples);
+        return 0;
+    }
+    if (dstFmt != AV_SAMPLE_FMT_S16) {
+        return -1;
+    }
+    int16_t *out = (int16_t *) dst;
+    if (srcFmt == AV_SAMPLE_FMT_FLTP) {
+        const float *const *in = (const float *const *) src;
+        if (srcChannels == dstChannels) {
+            fltpToS16(out, in, srcChannels, nbSamples);
+        } else if (srcChannels == 1 && dstChannels == 2) {
+            fltMonoToStereoS16(out, in[0], nbSamples);
+        } else if (srcChannels == 2 && dstChannels == 1) {
+            fltStereoToMonoS16(out, in[0], in[1], nbSamples);
+        } else {
+            return -1;
+        }
+        return 0;
+    }
+    if (srcFmt == AV_SAMPLE_FMT_S16P) {
+        const int16_t *const *in = (const int16_t *const *) src;
+        if (srcChannels == dstChannels) {
+            s16pToS16(out, in, srcChannels, nbSamples);
+        } else if (srcChannels == 1 && dstChannels == 2) {
+            s16MonoToStereoS16(out, in[0], nbSamples);
+        } else if (srcChannels == 2 && dstChannels == 1) {
+            s16StereoToMonoS16(out, in[0], in[1], nbSamples);
+        } else {
+            return -1;
+        }
+        return 0;
+    }
+    return -1;
+}
+
+void SampleConverter::fltpToS16(int16_t *dst, const float *const *src, int channels, int nbSamples) {
+    int i = 0;
+    if (channels == 1) {
+        const float *in = src[0];
+#if defined(SAMPLE_CONVERTER_SSE2)
+        for (; i + 8 <= nbSamples; i += 8) {
+            __m128i a = floatToS32(_mm_loadu_ps(in + i));
+            __m128i b = floatToS32(_mm_loadu_ps(in + i + 4));
+            _mm_storeu_si128((__m128i *) (dst + i), _mm_packs_epi32(a, b));
+        }
+#elif defined(SAMPLE_CONVERTER_NEON)
+        for (; i + 8 <= nbSamples; i += 8) {
+            int16x8_t v = vcombine_s16(floatToS16x4(vld1q_f32(in + i)), floatToS16x4(vld1q_f32(in + i + 4)));
+            vst1q_s16(dst + i, v);
+        }
+#endif
+        for (; i < nbSamples; i++) {
+            dst[i] = floatToS16(in[i]);
+        }
+        return;
+    }
+    if (channels == 2) {
+        const float *left = src[0];
+        const float *right = src[1];
+#if defined(SAMPLE_CONVERTER_SSE2)
+        for (; i + 8 <= nbSamples; i += 8) {
+            __m128i l0 = floatToS32(_mm_loadu_ps(left + i));
+            __m128i r0 = floatToS32(_mm_loadu_ps(right + i));
+            __m128i l1 = floatToS32(_mm_loadu_ps(left + i + 4));
+            __m128i r1 = floatToS32(_mm_loadu_ps(right + i + 4));
+            _mm_storeu_si128((__m128i *) (dst + i * 2),
+                             _mm_packs_epi32(_mm_unpacklo_epi32(l0, r0), _mm_unpackhi_epi32(l0, r0)));
+            _mm_storeu_si128((__m128i *) (dst + i * 2 + 8),
+                             _mm_packs_epi32(_mm_unpacklo_epi32(l1, r1), _mm_unpackhi_epi32(l1, r1)));
+        }
+#elif defined(SAMPLE_CONVERTER_NEON)
+        for (; i + 8 <= nbSamples; i += 8) {
+            int16x8x2_t v;
+            v.val[0] = vcombine_s16(floatToS16x4(vld1q_f32(left + i)), floatToS16x4(vld1q_f32(left + i + 4)));
+            v.val[1] = vcombine_s16(floatToS16x4(vld1q_f32(right + i)), floatToS16x4(vld1q_f32(right + i + 4)));
+            vst2q_s16(dst + i * 2, v);
+        }
+#endif
+        for (; i < nbSamples; i++) {
+            dst[i * 2] = floatToS16(left[i]);
+            dst[i * 2 + 1] = floatToS16(right[i]);
+        }
+        return;
+    }
+    for (; i < nbSamples; i++) {
+        for (int c = 0; c < channels; c++) {
+            dst[i * channels + c] = floatToS16(src[c][i]);
+        }
+    }
+}
+
+void SampleConverter::s16pToS16(int16_t *dst, const int16_t *const *src, int channels, int nbSamples) {
+    int i = 0;
+    if (channels == 1) {
+        memcpy(dst, src[0], (size_t) nbSamples * sizeof(int16_t));
+        return;
+    }
+    if (channels == 2) {
+        const int16_t *left = src[0];
+        const int16_t *right = src[1];
+#if defined(SAMPLE_CONVERTER_SSE2)
+        for (; i + 8 <= nbSamples; i += 8) {
+            __m128i l = _mm_loadu_si128((const __m128i *) (left + i));
+            __m128i r = _mm_loadu_si128((const __m128i *) (right + i));
+            _mm_storeu_si128((__m128i *) (dst + i * 2), _mm_unpacklo_epi16(l, r));
+            _mm_storeu_si128((__m128i *) (dst + i * 2 + 8), _mm_unpackhi_epi16(l, r));
+        }
+#elif defined(SAMPLE_CONVERTER_NEON)
+        for (; i + 8 <= nbSamples; i += 8) {
+            int16x8x2_t v;
+            v.val[0] = vld1q_s16(left + i);
+            v.val[1] = vld1q_s16(right + i);
+            vst2q_s16(dst + i * 2, v);
+        }
+#endif
+        for (; i < nbSamples; i++) {
+            dst[i * 2] = left[i];
+            dst[i * 2 + 1] = right[i];
+        }
+        return;
+    }
+    for (; i < nbSamples; i++) {
+        for (int c = 0; c < channels; c++) {
+            dst[i * channels + c] = src[c][i];
+        }
+    }
+}
+
+void SampleConverter::fltMonoToStereoS16(int16_t *dst, const float *src, int nbSamples) {
+    int i = 0;
+#if defined(SAMPLE_CONVERTER_SSE2)
+    const __m128 gain = _mm_set1_ps(MONO_TO_STEREO_GAIN);
+    for (; i + 8 <= nbSamples; i += 8) {
+        __m128i a = floatToS32(_mm_mul_ps(_mm_loadu_ps(src + i), gain));
+        __m128i b = floatToS32(_mm_mul_ps(_mm_loadu_ps(src + i + 4), gain));
+        __m128i v = _mm_packs_epi32(a, b);
+        _mm_storeu_si128((__m128i *) (dst + i * 2), _mm_unpacklo_epi16(v, v));
+        _mm_storeu_si128((__m128i *) (dst + i * 2 + 8), _mm_unpackhi_epi16(v, v));
+    }
+#elif defined(SAMPLE_CONVERTER_NEON)
+    for (; i + 8 <= nbSamples; i += 8) {
+        int16x8x2_t v;
+        v.val[0] = vcombine_s16(floatToS16x4(vmulq_n_f32(vld1q_f32(src + i), MONO_TO_STEREO_GAIN)),
+                                floatToS16x4(vmulq_n_f32(vld1q_f32(src + i + 4), MONO_TO_STEREO_GAIN)));
+        v.val[1] = v.val[0];
+        vst2q_s16(dst + i * 2, v);
+    }
+#endif
+    for (; i < nbSamples; i++) {
+        int16_t value = floatToS16(src[i] * MONO_TO_STEREO_GAIN);
+        dst[i * 2] = value;
+        dst[i * 2 + 1] = value;
+    }
+}
+
+void SampleConverter::fltStereoToMonoS16(int16_t *dst, const float *left, const float *right, int nbSamples) {
+    int i = 0;
+#if defined(SAMPLE_CONVERTER_SSE2)
+    const __m128 gain = _mm_set1_ps(STEREO_TO_MONO_GAIN);
+    for (; i + 8 <= nbSamples; i += 8) {
+        __m128i a = floatToS32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(left + i), gain),
+                                          _mm_mul_ps(_mm_loadu_ps(right + i), gain)));
+        __m128i b = floatToS32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(left + i + 4), gain),
+                                          _mm_mul_ps(_mm_loadu_ps(right + i + 4), gain)));
+        _mm_storeu_si128((__m128i *) (dst + i), _mm_packs_epi32(a, b));
+    }
+#elif defined(SAMPLE_CONVERTER_NEON)
+    for (; i + 8 <= nbSamples; i += 8) {
+        float32x4_t a = vaddq_f32(vmulq_n_f32(vld1q_f32(left + i), STEREO_TO_MONO_GAIN),
+                                  vmulq_n_f32(vld1q_f32(right + i), STEREO_TO_MONO_GAIN));
+        float32x4_t b = vaddq_f32(vmulq_n_f32(vld1q_f32(left + i + 4), STEREO_TO_MONO_GAIN),
+                                  vmulq_n_f32(vld1q_f32(right + i + 4), STEREO_TO_MONO_GAIN));
+        vst1q_s16(dst + i, vcombine_s16(floatToS16x4(a), floatToS16x4(b)));
+    }
+#endif
+    for (; i < nbSamples; i++) {
+        dst[i] = floatToS16(left[i] * STEREO_TO_MONO_GAIN + right[i] * STEREO_TO_MONO_GAIN);
+    }
+}
+
+void SampleConverter::s16MonoToStereoS16(int16_t *dst, const int16_t *src, int nbSamples) {
+    int i = 0;
+#if defined(SAMPLE_CONVERTER_SSE2)
+    const __m128i gain = _mm_set1_epi16(MONO_TO_STEREO_GAIN_Q15);
+    const __m128i round = _mm_set1_epi32(1 << 14);
+    for (; i + 8 <= nbSamples; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *) (src + i));
+        __m128i lo = _mm_mullo_epi16(x, gain);
+        __m128i hi = _mm_mulhi_epi16(x, gain);
+        __m128i a = _mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi16(lo, hi), round), 15);
+        __m128i b = _mm_srai_epi32(_mm_add_epi32(_mm_unpackhi_epi16(lo, hi), round), 15);
+        __m128i v = _mm_packs_epi32(a, b);
+        _mm_storeu_si128((__m128i *) (dst + i * 2), _mm_unpacklo_epi16(v, v));
+        _mm_storeu_si128((__m128i *) (dst + i * 2 + 8), _mm_unpackhi_epi16(v, v));
+    }
+#elif defined(SAMPLE_CONVERTER_NEON)
+    for (; i + 8 <= nbSamples; i += 8) {
+        // (2 * x * gain + 2^15) >> 16，与 (x * gain + 2^14) >> 15 相同
+        int16x8x2_t v;
+        v.val[0] = vqrdmulhq_n_s16(vld1q_s16(src + i), MONO_TO_STEREO_GAIN_Q15);
+        v.val[1] = v.val[0];
+        vst2q_s16(dst + i * 2, v);
+    }
+#endif
+    for (; i < nbSamples; i++) {
+        int16_t value = (int16_t) ((src[i] * MONO_TO_STEREO_GAIN_Q15 + (1 << 14)) >> 15);
+        dst[i * 2] = value;
+        dst[i * 2 + 1] = value;
+    }
+}
+
+void SampleConverter::s16StereoToMonoS16(int16_t *dst, const int16_t *left, const int16_t *right, int nbSamples) {
+    int i = 0;
+#if defined(SAMPLE_CONVERTER_SSE2)
+    // 有符号数偏移成无符号数后求舍入平均，再偏移回来
+    const __m128i bias = _mm_set1_epi16((short) 0x8000);
+    for (; i + 8 <= nbSamples; i += 8) {
+        __m128i l = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (left + i)), bias);
+        __m128i r = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (right + i)), bias);
+        _mm_storeu_si128((__m128i *) (dst + i), _mm_xor_si128(_mm_avg_epu16(l, r), bias));
+    }
+#elif defined(SAMPLE_CONVERTER_NEON)
+    for (; i + 8 <= nbSamples; i += 8) {
+        vst1q_s16(dst + i, vrhaddq_s16(vld1q_s16(left + i), vld1q_s16(right + i)));
+    }
+#endif
+    // 0.5 的 Q15 系数为 16384，(16384 * (l + r) + 2^14) >> 15 即 (l + r + 1) >> 1
+    for (; i < nbSamples; i++) {
+        dst[i] = (int16_t) ((left[i] + right[i] + 1) >> 1);
+    }
+}
+
+void SampleConverter::planarToFlt(float *dst, const uint8_t *const *src, AVSampleFormat srcFmt, int channels,
+                                  int nbSamples) {
+    int i = 0;
+    if (srcFmt == AV_SAMPLE_FMT_S16P) {
+        for (; i < nbSamples; i++) {
+            for (int c = 0; c < channels; c++) {
+                dst[i * channels + c] = ((const int16_t *) src[c])[i] * (1.0f / 32768.0f);
+            }
+        }
+        return;
+    }
+    if (channels == 1) {
+        memcpy(dst, src[0], (size_t) nbSamples * sizeof(float));
+        return;
+    }
+    if (channels == 2) {
+        const float *left = (const float *) src[0];
+        const float *right = (const float *) src[1];
+#if defined(SAMPLE_CONVERTER_SSE2)
+        for (; i + 4 <= nbSamples; i += 4) {
+            __m128 l = _mm_loadu_ps(left + i);
+            __m128 r = _mm_loadu_ps(right + i);
+            _mm_storeu_ps(dst + i * 2, _mm_unpacklo_ps(l, r));
+            _mm_storeu_ps(dst + i * 2 + 4, _mm_unpackhi_ps(l, r));
+        }
+#elif defined(SAMPLE_CONVERTER_NEON)
+        for (; i + 4 <= nbSamples; i += 4) {
+            float32x4x2_t v;
+            v.val[0] = vld1q_f32(left + i);
+            v.val[1] = vld1q_f32(right + i);
+            vst2q_f32(dst + i * 2, v);
+        }
+#endif
+        for (; i < nbSamples; i++) {
+            dst[i * 2] = left[i];
+            dst[i * 2 + 1] = right[i];
+        }
+        return;
+    }
+    for (; i < nbSamples; i++) {
+        for (int c = 0; c < channels; c++) {
+            dst[i * channels + c] = ((const float *) src[c])[i];
+        }
+    }
+}
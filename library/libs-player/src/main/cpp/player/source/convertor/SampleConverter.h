@@ -0,0 +1,107 @@
+#ifndef SAMPLECONVERTER_H
+#define SAMPLECONVERTER_H
+
+#include <stdint.h>
+
+extern "C" {
+#include "libavutil/channel_layout.h"
+#include "libavutil/samplefmt.h"
+}
+
+/**
+ * 采样格式转换
+ * 采样率不变时把解码输出的平面格式直接转换成交错格式，省去 swresample 的中间缓冲，
+ * 支持 FLTP/S16P 转 S16 以及单声道与立体声之间的上下混，FLTP/S16P 转 FLT 只支持声道数相同的情况。
+ * 取整、饱和以及混音系数按 swresample 的默认参数实现，x86 上使用 SSE2，arm64 上使用 NEON。
+ * 与 swresample 输出的一致性由 SampleConverterSwrTest 校验，需要安装 FFmpeg 才能运行
+ */
+class SampleConverter {
+public:
+    /**
+     * 是否支持直接转换，声道数相同时要求声道布局也相同，否则 swresample 会重新混音
+     * @param srcFmt 输入格式
+     * @param srcLayout 输入声道布局
+     * @param dstFmt 输出格式
+     * @param dstLayout 输出声道布局
+     * @return
+     */
+    static bool isSupported(AVSampleFormat srcFmt, int64_t srcLayout, AVSampleFormat dstFmt, int64_t dstLayout);
+
+    /**
+     * 转换，需要先用 isSupported 判断
+     * @param dst 交错存放的输出数据
+     * @param dstFmt
+     * @param dstChannels
+     * @param src 每个声道的输入数据
+     * @param srcFmt
+     * @param srcChannels
+     * @param nbSamples 每个声道的采样点数
+     * @return 0 为成功，< 0 为不支持
+     */
+    static int convert(uint8_t *dst, AVSampleFormat dstFmt, int dstChannels,
+                       const uint8_t *const *src, AVSampleFormat srcFmt, int srcChannels, int nbSamples);
+
+    /**
+     * FLTP 转 S16，按 x * 32768 饱和后就近取整，与 swresample 的 av_clip_int16(lrintf(x * 32768)) 相同（swresample 在乘积超出 int32 时会回绕）
+     * @param dst
+     * @param src
+     * @param channels
+     * @param nbSamples
+     */
+    static void fltpToS16(int16_t *dst, const float *const *src, int channels, int nbSamples);
+
+    /**
+     * S16P 转 S16
+     * @param dst
+     * @param src
+     * @param channels
+     * @param nbSamples
+     */
+    static void s16pToS16(int16_t *dst, const int16_t *const *src, int channels, int nbSamples);
+
+    /**
+     * 单声道 FLTP 转立体声 S16，两个声道都乘以 -3dB 的系数
+     * @param dst
+     * @param src
+     * @param nbSamples
+     */
+    static void fltMonoToStereoS16(int16_t *dst, const float *src, int nbSamples);
+
+    /**
+     * 立体声 FLTP 转单声道 S16，两个声道取平均
+     * @param dst
+     * @param left
+     * @param right
+     * @param nbSamples
+     */
+    static void fltStereoToMonoS16(int16_t *dst, const float *left, const float *right, int nbSamples);
+
+    /**
+     * 单声道 S16P 转立体声 S16，按 swresample 的 Q15 定点系数计算
+     * @param dst
+     * @param src
+     * @param nbSamples
+     */
+    static void s16MonoToStereoS16(int16_t *dst, const int16_t *src, int nbSamples);
+
+    /**
+     * 立体声 S16P 转单声道 S16
+     * @param dst
+     * @param left
+     * @param right
+     * @param nbSamples
+     */
+    static void s16StereoToMonoS16(int16_t *dst, const int16_t *left, const int16_t *right, int nbSamples);
+
+    /**
+     * FLTP/S16P 转 FLT，S16 按 x / 32768 换算
+     * @param dst
+     * @param src
+     * @param srcFmt
+     * @param channels
+     * @param nbSamples
+     */
+    static void planarToFlt(float *dst, const uint8_t *const *src, AVSampleFormat srcFmt, int channels, int nbSamples);
+};
+
+#endif //SAMPLECONVERTER_H
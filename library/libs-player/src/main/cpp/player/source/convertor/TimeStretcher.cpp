@@ -0,0 +1,356 @@
+#include "TimeStretcher.h"
+#include <math.h>
+#include <time.h>
+
+extern "C" {
+#include "libavutil/opt.h"
+}
+
+TimeStretcherType TimeStretcher::chooseType(TimeStretcherType preferred, float speed, float pitch, bool speech) {
+    // atempo 不能变调，变调时只能使用 SoundTouch
+    if (pitch != 1.0f) {
+        return TIME_STRETCHER_SOUNDTOUCH;
+    }
+    if (preferred != TIME_STRETCHER_AUTO) {
+        return preferred;
+    }
+    return speed >= (speech ? ATEMPO_SPEECH_MIN_SPEED : ATEMPO_MIN_SPEED)
+           ? TIME_STRETCHER_ATEMPO : TIME_STRETCHER_SOUNDTOUCH;
+}
+
+TimeStretcher *TimeStretcher::create(TimeStretcherType type, bool speech) {
+    if (type == TIME_STRETCHER_ATEMPO) {
+        return new AtempoStretcher();
+    }
+    return new SoundTouchStretcher(speech);
+}
+
+static int64_t getThreadCpuTime() {
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+        return -1;
+    }
+    return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int64_t TimeStretcher::benchmark(TimeStretcherType type, float speed, int sampleRate, int channels) {
+    if (type == TIME_STRETCHER_AUTO) {
+        type = chooseType(type, speed, 1.0f, false);
+    }
+    if (speed <= 0 || sampleRate <= 0 || channels <= 0) {
+        return -1;
+    }
+    const int chunk = 1024;
+    int bytesPerSample = av_get_bytes_per_sample(AUDIO_STRETCH_FMT);
+    uint8_t *input = (uint8_t *) av_malloc((size_t) chunk * channels * bytesPerSample);
+    // 慢速播放时输出比输入多
+    int outputSamples = (int) (chunk / FFMIN(speed, 1.0f)) + chunk;
+    uint8_t *output = (uint8_t *) av_malloc((size_t) outputSamples * channels * bytesPerSample);
+    TimeStretcher *stretcher = create(type, false);
+    if (!input || !output || !stretcher) {
+        av_free(input);
+        av_free(output);
+        delete stretcher;
+        return -1;
+    }
+    stretcher->setParams(speed, 1.0f, channels, sampleRate);
+
+    // 合成信号在计时之外生成，只统计算法本身的开销
+    int64_t cost = 0;
+    int64_t total = (int64_t) sampleRate * TIME_STRETCH_BENCHMARK_DURATION;
+    uint32_t seed = 1;
+    for (int64_t pos = 0; pos < total; pos += chunk) {
+        for (int i = 0; i < chunk; i++) {
+            double t = (double) (pos + i) / sampleRate;
+            seed = seed * 1664525 + 1013904223;
+            double noise = ((int32_t) seed) / 2147483648.0;
+            double value = 0.4 * sin(2 * M_PI * 220 * t) + 0.2 * sin(2 * M_PI * 1330 * t) + 0.05 * noise;
+            for (int c = 0; c < channels; c++) {
+                int index = i * channels + c;
+                if (AUDIO_STRETCH_FMT == AV_SAMPLE_FMT_FLT) {
+                    ((float *) input)[index] = (float) value;
+                } else {
+                    ((int16_t *) input)[index] = (int16_t) (value * 32767);
+                }
+            }
+        }
+        int64_t start = getThreadCpuTime();
+        stretcher->putSamples(input, chunk);
+        while (stretcher->receiveSamples(output, outputSamples) > 0) {
+        }
+        cost += getThreadCpuTime() - start;
+    }
+    LOGD("TimeStretcher->benchmark %s speed: %.2f, %d Hz %d channels, cost: %lld us",
+         stretcher->getName(), speed, sampleRate, channels, (long long) cost);
+
+    delete stretcher;
+    av_free(input);
+    av_free(output);
+    return cost / TIME_STRETCH_BENCHMARK_DURATION;
+}
+
+SoundTouchStretcher::SoundTouchStretcher(bool speech) {
+    mWrapper = new SoundTouchWrapper();
+    if (speech && mWrapper->getSoundTouch()) {
+        // 缩短序列和重叠的时长，语音更清晰
+        mWrapper->getSoundTouch()->setSetting(SETTING_SEQUENCE_MS, 40);
+        mWrapper->getSoundTouch()->setSetting(SETTING_SEEKWINDOW_MS, 15);
+        mWrapper->getSoundTouch()->setSetting(SETTING_OVERLAP_MS, 8);
+    }
+}
+
+SoundTouchStretcher::~SoundTouchStretcher() {
+    delete mWrapper;
+    mWrapper = NULL;
+}
+
+const char *SoundTouchStretcher::getName() {
+    return "soundtouch";
+}
+
+bool SoundTouchStretcher::isSupported(float speed, float pitch) {
+    return speed > 0 && pitch > 0;
+}
+
+void SoundTouchStretcher::setParams(float speed, float pitch, int channels, int sampleRate) {
+    // 保持原调时按速度的倒数调整音调，抵消变速带来的音调变化
+    mWrapper->setParams(speed, pitch != 1.0f ? pitch : 1.0f / speed, channels, sampleRate);
+}
+
+void SoundTouchStretcher::putSamples(const uint8_t *data, int nbSamples) {
+    mWrapper->putSamples((const SAMPLETYPE *) data, nbSamples);
+}
+
+int SoundTouchStretcher::availableSamples() {
+    return mWrapper->availableSamples();
+}
+
+int SoundTouchStretcher::receiveSamples(uint8_t *output, int maxSamples) {
+    return mWrapper->receiveSamples((SAMPLETYPE *) output, maxSamples);
+}
+
+void SoundTouchStretcher::clear() {
+    mWrapper->clear();
+}
+
+void SoundTouchStretcher::drain() {
+    mWrapper->flush();
+}
+
+AtempoStretcher::AtempoStretcher() {
+    mGraph = NULL;
+    mBufferSrc = NULL;
+    mBufferSink = NULL;
+    mFrame = av_frame_alloc();
+    mFifo = NULL;
+    mSpeed = 1.0f;
+    mChannels = 0;
+    mSampleRate = 0;
+    mNextPts = 0;
+}
+
+AtempoStretcher::~AtempoStretcher() {
+    release();
+    if (mFifo) {
+        av_audio_fifo_free(mFifo);
+        mFifo = NULL;
+    }
+    av_frame_free(&mFrame);
+}
+
+const char *AtempoStretcher::getName() {
+    return "atempo";
+}
+
+bool AtempoStretcher::isSupported(float speed, float pitch) {
+    return speed > 0 && pitch == 1.0f;
+}
+
+void AtempoStretcher::setParams(float speed, float pitch, int channels, int sampleRate) {
+    if (channels != mChannels || sampleRate != mSampleRate) {
+        release();
+        if (mFifo) {
+            av_audio_fifo_free(mFifo);
+            mFifo = NULL;
+        }
+        mChannels = channels;
+        mSampleRate = sampleRate;
+        mSpeed = speed;
+        return;
+    }
+    if (speed == mSpeed) {
+        return;
+    }
+    // 单级 atempo 可以直接修改速度，保留缓冲的数据，需要串联时重建滤镜图
+    if (mGraph && speed >= ATEMPO_MIN_TEMPO && mSpeed >= ATEMPO_MIN_TEMPO) {
+        char value[32];
+        snprintf(value, sizeof(value), "%f", speed);
+        if (avfilter_graph_send_command(mGraph, "atempo", "tempo", value, NULL, 0, 0) >= 0) {
+            mSpeed = speed;
+            return;
+        }
+    }
+    // 把旧滤镜图中剩余的数据取出来再重建
+    drain();
+    mSpeed = speed;
+}
+
+void AtempoStretcher::putSamples(const uint8_t *data, int nbSamples) {
+    if (mChannels <= 0 || mSampleRate <= 0 || nbSamples <= 0) {
+        return;
+    }
+    if (!mGraph && configure() < 0) {
+        return;
+    }
+    mFrame->nb_samples = nbSamples;
+    mFrame->format = AUDIO_STRETCH_FMT;
+    mFrame->channel_layout = (uint64_t) av_get_default_channel_layout(mChannels);
+    mFrame->channels = mChannels;
+    mFrame->sample_rate = mSampleRate;
+    mFrame->pts = mNextPts;
+    if (av_frame_get_buffer(mFrame, 0) < 0) {
+        av_frame_unref(mFrame);
+        return;
+    }
+    memcpy(mFrame->data[0], data, (size_t) nbSamples * mChannels * av_get_bytes_per_sample(AUDIO_STRETCH_FMT));
+    mNextPts += nbSamples;
+    int ret = av_buffersrc_add_frame(mBufferSrc, mFrame);
+    if (ret < 0) {
+        LOGW("AtempoStretcher->add frame failed: %d", ret);
+        av_frame_unref(mFrame);
+        return;
+    }
+    pullFrames();
+}
+
+int AtempoStretcher::availableSamples() {
+    return mFifo ? av_audio_fifo_size(mFifo) : 0;
+}
+
+int AtempoStretcher::receiveSamples(uint8_t *output, int maxSamples) {
+    if (!mFifo || maxSamples <= 0) {
+        return 0;
+    }
+    int ret = av_audio_fifo_read(mFifo, (void **) &output, maxSamples);
+    return ret > 0 ? ret : 0;
+}
+
+void AtempoStretcher::clear() {
+    release();
+    if (mFifo) {
+        av_audio_fifo_reset(mFifo);
+    }
+}
+
+void AtempoStretcher::drain() {
+    // 送入结束标志取出滤镜图中剩余的数据，下次送入数据时重建
+    if (mGraph && av_buffersrc_add_frame(mBufferSrc, NULL) >= 0) {
+        pullFrames();
+    }
+    release();
+}
+
+int AtempoStretcher::configure() {
+    static const enum AVSampleFormat sample_fmts[] = {AUDIO_STRETCH_FMT, AV_SAMPLE_FMT_NONE};
+    char args[256];
+    char filters[128];
+    int ret;
+    AVFilterInOut *outputs = NULL;
+    AVFilterInOut *inputs = NULL;
+
+    release();
+    mGraph = avfilter_graph_alloc();
+    if (!mGraph) {
+        return AVERROR(ENOMEM);
+    }
+    // 在音频回调中同步处理，不开启额外的线程
+    mGraph->nb_threads = 1;
+
+    snprintf(args, sizeof(args), "time_base=1/%d:sample_rate=%d:sample_fmt=%s:channel_layout=0x%llx",
+             mSampleRate, mSampleRate, av_get_sample_fmt_name(AUDIO_STRETCH_FMT),
+             (unsigned long long) av_get_default_channel_layout(mChannels));
+    // 单级 atempo 最低只支持 0.5 倍速，更慢时串联
+    filters[0] = '\0';
+    float speed = mSpeed;
+    while (speed < ATEMPO_MIN_TEMPO) {
+        av_strlcat(filters, "atempo=0.5,", sizeof(filters));
+        speed /= ATEMPO_MIN_TEMPO;
+    }
+    av_strlcatf(filters, sizeof(filters), "atempo=%f", speed);
+
+    ret = avfilter_graph_create_filter(&mBufferSrc, avfilter_get_by_name("abuffer"), "in", args, NULL, mGraph);
+    if (ret < 0) {
+        goto fail;
+    }
+    ret = avfilter_graph_create_filter(&mBufferSink, avfilter_get_by_name("abuffersink"), "out", NULL, NULL, mGraph);
+    if (ret < 0) {
+        goto fail;
+    }
+    ret = av_opt_set_int_list(mBufferSink, "sample_fmts", sample_fmts, AV_SAMPLE_FMT_NONE, AV_OPT_SEARCH_CHILDREN);
+    if (ret < 0) {
+        goto fail;
+    }
+
+    outputs = avfilter_inout_alloc();
+    inputs = avfilter_inout_alloc();
+    if (!outputs || !inputs) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    outputs->name = av_strdup("in");
+    outputs->filter_ctx = mBufferSrc;
+    outputs->pad_idx = 0;
+    outputs->next = NULL;
+    inputs->name = av_strdup("out");
+    inputs->filter_ctx = mBufferSink;
+    inputs->pad_idx = 0;
+    inputs->next = NULL;
+
+    ret = avfilter_graph_parse_ptr(mGraph, filters, &inputs, &outputs, NULL);
+    if (ret < 0) {
+        goto fail;
+    }
+    ret = avfilter_graph_config(mGraph, NULL);
+    if (ret < 0) {
+        goto fail;
+    }
+    if (!mFifo) {
+        mFifo = av_audio_fifo_alloc(AUDIO_STRETCH_FMT, mChannels, mSampleRate / 10);
+        if (!mFifo) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+    }
+
+    avfilter_inout_free(&inputs);
+    avfilter_inout_free(&outputs);
+    LOGD("AtempoStretcher->configure %s, %d Hz %d channels", filters, mSampleRate, mChannels);
+    return 0;
+
+fail:
+    LOGE("AtempoStretcher->configure %s failed: %d", filters, ret);
+    avfilter_inout_free(&inputs);
+    avfilter_inout_free(&outputs);
+    release();
+    return ret;
+}
+
+void AtempoStretcher::release() {
+    if (mGraph) {
+        avfilter_graph_free(&mGraph);
+    }
+    mGraph = NULL;
+    mBufferSrc = NULL;
+    mBufferSink = NULL;
+    mNextPts = 0;
+}
+
+void AtempoStretcher::pullFrames() {
+    if (!mGraph || !mFifo) {
+        return;
+    }
+    while (av_buffersink_get_frame_flags(mBufferSink, mFrame, 0) >= 0) {
+        av_audio_fifo_write(mFifo, (void **) mFrame->extended_data, mFrame->nb_samples);
+        av_frame_unref(mFrame);
+    }
+}
@@ -0,0 +1,206 @@
+#ifndef TIMESTRETCHER_H
+#define TIMESTRETCHER_H
+
+#include <SoundTouchWrapper.h>
+#include "PlayerState.h"
+#include "AndroidLog.h"
+
+extern "C" {
+#include "libavfilter/avfilter.h"
+#include "libavfilter/buffersink.h"
+#include "libavfilter/buffersrc.h"
+#include "libavutil/audio_fifo.h"
+}
+
+// 变速变调处理的样本格式，变速变调时重采样直接输出这个格式
+#ifdef SOUNDTOUCH_FLOAT_SAMPLES
+#define AUDIO_STRETCH_FMT AV_SAMPLE_FMT_FLT
+#else
+#define AUDIO_STRETCH_FMT AV_SAMPLE_FMT_S16
+#endif
+
+// 自动选择时，不变调且速度不低于该值使用 atempo，SoundTouch 在高倍速下开销大
+#define ATEMPO_MIN_SPEED 1.5f
+// 语音内容不变调时在 atempo 单级支持的范围内都使用 atempo，SoundTouch 的默认参数按音乐调整，语音容易发糊
+#define ATEMPO_SPEECH_MIN_SPEED 0.5f
+// atempo 单个滤镜支持的最小速度，更慢时串联多个
+#define ATEMPO_MIN_TEMPO 0.5f
+// 测试开销时处理的音频时长，单位秒
+#define TIME_STRETCH_BENCHMARK_DURATION 10
+
+/**
+ * 变速变调算法
+ * 输入输出都是交错存放的 AUDIO_STRETCH_FMT 数据
+ */
+class TimeStretcher {
+public:
+    virtual ~TimeStretcher() {}
+
+    /**
+     * @return 算法名称
+     */
+    virtual const char *getName() = 0;
+
+    /**
+     * 是否支持这组参数
+     * @param speed 速度
+     * @param pitch 音调，1.0 为保持原调
+     * @return
+     */
+    virtual bool isSupported(float speed, float pitch) = 0;
+
+    /**
+     * 设置参数，只有参数变化时才重新配置
+     * @param speed 速度
+     * @param pitch 音调，1.0 为保持原调
+     * @param channels 声道数
+     * @param sampleRate 采样率
+     */
+    virtual void setParams(float speed, float pitch, int channels, int sampleRate) = 0;
+
+    /**
+     * 送入数据
+     * @param data
+     * @param nbSamples 每个声道的采样点数
+     */
+    virtual void putSamples(const uint8_t *data, int nbSamples) = 0;
+
+    /**
+     * @return 可以取出的每个声道的采样点数
+     */
+    virtual int availableSamples() = 0;
+
+    /**
+     * 取出处理后的数据
+     * @param output
+     * @param maxSamples 每个声道最多取出的采样点数
+     * @return 取出的每个声道的采样点数
+     */
+    virtual int receiveSamples(uint8_t *output, int maxSamples) = 0;
+
+    /**
+     * 丢弃缓冲的数据
+     */
+    virtual void clear() = 0;
+
+    /**
+     * 处理完已经送入的数据，之后用 receiveSamples 取出，切换算法前调用避免丢失缓冲的音频
+     */
+    virtual void drain() = 0;
+
+    /**
+     * 按参数和内容选择算法
+     * @param preferred 指定的算法，指定的算法不支持这组参数时使用 SoundTouch
+     * @param speed
+     * @param pitch
+     * @param speech 是否为语音内容
+     * @return
+     */
+    static TimeStretcherType chooseType(TimeStretcherType preferred, float speed, float pitch, bool speech);
+
+    /**
+     * 创建算法实例
+     * @param type 不能是 TIME_STRETCHER_AUTO
+     * @param speech 是否为语音内容
+     * @return
+     */
+    static TimeStretcher *create(TimeStretcherType type, bool speech);
+
+    /**
+     * 用合成的音频测试算法开销，用于按设备选择速度可以接受的算法
+     * @param type
+     * @param speed
+     * @param sampleRate
+     * @param channels
+     * @return 处理每秒音频占用的 CPU 时间，单位微秒，< 0 为失败
+     */
+    static int64_t benchmark(TimeStretcherType type, float speed, int sampleRate, int channels);
+};
+
+/**
+ * SoundTouch WSOLA 变速变调
+ */
+class SoundTouchStretcher : public TimeStretcher {
+public:
+    /**
+     * @param speech 是否按语音调整序列、搜索窗口和重叠的时长
+     */
+    SoundTouchStretcher(bool speech);
+
+    virtual ~SoundTouchStretcher();
+
+    const char *getName() override;
+
+    bool isSupported(float speed, float pitch) override;
+
+    void setParams(float speed, float pitch, int channels, int sampleRate) override;
+
+    void putSamples(const uint8_t *data, int nbSamples) override;
+
+    int availableSamples() override;
+
+    int receiveSamples(uint8_t *output, int maxSamples) override;
+
+    void clear() override;
+
+    void drain() override;
+
+private:
+    SoundTouchWrapper *mWrapper;
+};
+
+/**
+ * libavfilter atempo 变速，只变速不变调
+ */
+class AtempoStretcher : public TimeStretcher {
+public:
+    AtempoStretcher();
+
+    virtual ~AtempoStretcher();
+
+    const char *getName() override;
+
+    bool isSupported(float speed, float pitch) override;
+
+    void setParams(float speed, float pitch, int channels, int sampleRate) override;
+
+    void putSamples(const uint8_t *data, int nbSamples) override;
+
+    int availableSamples() override;
+
+    int receiveSamples(uint8_t *output, int maxSamples) override;
+
+    void clear() override;
+
+    void drain() override;
+
+private:
+    /**
+     * 按当前参数创建滤镜图
+     * @return 0 为成功
+     */
+    int configure();
+
+    /**
+     * 释放滤镜图
+     */
+    void release();
+
+    /**
+     * 取出滤镜图的输出写入缓冲
+     */
+    void pullFrames();
+
+private:
+    AVFilterGraph *mGraph;          // 滤镜图
+    AVFilterContext *mBufferSrc;    // 输入端
+    AVFilterContext *mBufferSink;   // 输出端
+    AVFrame *mFrame;                //
+    AVAudioFifo *mFifo;             // 处理后的数据
+    float mSpeed;                   // 当前配置的参数
+    int mChannels;                  //
+    int mSampleRate;                //
+    int64_t mNextPts;               // 下一次送入数据的时间戳，单位为采样点
+};
+
+#endif //TIMESTRETCHER_H
@@ -0,0 +1,339 @@
+#include "VideoFilter.h"
+
+extern "C" {
+#include "libavutil/opt.h"
+}
+
+VideoFilter::VideoFilter(PlayerState *playerState, const char *filters, AVRational timeBase, AVRational frameRate) {
+    mPlayerState = playerState;
+    mThread = NULL;
+    mFrameQueue = NULL;
+    mFilters = av_strdup(filters);
+    mTimeBase = timeBase;
+    mFrameRate = frameRate;
+    mGraph = NULL;
+    mBufferSrc = NULL;
+    mBufferSink = NULL;
+    mOutFrame = av_frame_alloc();
+    mLastWidth = 0;
+    mLastHeight = 0;
+    mLastFormat = -1;
+    mLastAspectRatio = (AVRational) {0, 1};
+    memset(mQueue, 0, sizeof(mQueue));
+    mReadIndex = 0;
+    mSize = 0;
+    mSerial = 0;
+    mFlushRequest = false;
+    mAbortRequest = false;
+    mBypass = false;
+}
+
+VideoFilter::~VideoFilter() {
+    stop();
+    flush();
+    release();
+    av_frame_free(&mOutFrame);
+    av_freep(&mFilters);
+}
+
+void VideoFilter::setFrameQueue(FrameQueue *frameQueue) {
+    Mutex::Autolock lock(mMutex);
+    mFrameQueue = frameQueue;
+}
+
+void VideoFilter::start() {
+    mMutex.lock();
+    mAbortRequest = false;
+    mMutex.unlock();
+    if (!mThread) {
+        LOGD("VideoFilter->开启视频滤镜线程: %s", mFilters);
+        mThread = new Thread(this);
+        mThread->start();
+    }
+}
+
+void VideoFilter::stop() {
+    mMutex.lock();
+    mAbortRequest = true;
+    mCondition.broadcast();
+    mMutex.unlock();
+    if (mThread) {
+        mThread->join();
+        delete mThread;
+        mThread = NULL;
+        LOGD("VideoFilter->删除视频滤镜线程");
+    }
+}
+
+void VideoFilter::flush() {
+    Mutex::Autolock lock(mMutex);
+    while (mSize > 0) {
+        av_frame_free(&mQueue[mReadIndex]);
+        mReadIndex = (mReadIndex + 1) % VIDEO_FILTER_QUEUE_SIZE;
+        mSize--;
+    }
+    mSerial++;
+    // 滤镜图只在滤镜线程中使用，由滤镜线程重建
+    mFlushRequest = true;
+    mCondition.broadcast();
+}
+
+int VideoFilter::pushFrame(AVFrame *frame) {
+    // 结束标志在输入队列中用 NULL 表示
+    AVFrame *copy = NULL;
+    if (frame) {
+        copy = av_frame_alloc();
+        if (!copy) {
+            return AVERROR(ENOMEM);
+        }
+    }
+    Mutex::Autolock lock(mMutex);
+    while (!mAbortRequest && mSize >= VIDEO_FILTER_QUEUE_SIZE) {
+        mCondition.wait(mMutex);
+    }
+    if (mAbortRequest) {
+        av_frame_free(&copy);
+        return -1;
+    }
+    if (copy) {
+        av_frame_move_ref(copy, frame);
+    }
+    mQueue[(mReadIndex + mSize) % VIDEO_FILTER_QUEUE_SIZE] = copy;
+    mSize++;
+    mCondition.broadcast();
+    return 0;
+}
+
+int VideoFilter::sendFrame(AVFrame *frame) {
+    if (frame) {
+        // 输入参数变化时重建滤镜图，yadif 等滤镜的内部状态随之清空
+        if (!mGraph || frame->width != mLastWidth || frame->height != mLastHeight
+            || frame->format != mLastFormat
+            || av_cmp_q(frame->sample_aspect_ratio, mLastAspectRatio) != 0) {
+            int ret = configure(frame);
+            if (ret < 0) {
+                return ret;
+            }
+        }
+    } else if (!mGraph) {
+        return AVERROR_EOF;
+    }
+    return av_buffersrc_add_frame_flags(mBufferSrc, frame, AV_BUFFERSRC_FLAG_KEEP_REF);
+}
+
+int VideoFilter::receiveFrame(AVFrame *frame) {
+    if (!mGraph) {
+        return AVERROR(EAGAIN);
+    }
+    return av_buffersink_get_frame_flags(mBufferSink, frame, 0);
+}
+
+AVRational VideoFilter::getOutputTimeBase() {
+    return mBufferSink ? av_buffersink_get_time_base(mBufferSink) : mTimeBase;
+}
+
+AVRational VideoFilter::getOutputFrameRate() {
+    return mBufferSink ? av_buffersink_get_frame_rate(mBufferSink) : mFrameRate;
+}
+
+void VideoFilter::run() {
+    for (;;) {
+        mMutex.lock();
+        while (!mAbortRequest && !mFlushRequest && mSize == 0) {
+            mCondition.wait(mMutex);
+        }
+        if (mAbortRequest) {
+            mMutex.unlock();
+            break;
+        }
+        if (mFlushRequest) {
+            mFlushRequest = false;
+            mMutex.unlock();
+            release();
+            continue;
+        }
+        AVFrame *frame = mQueue[mReadIndex];
+        mQueue[mReadIndex] = NULL;
+        mReadIndex = (mReadIndex + 1) % VIDEO_FILTER_QUEUE_SIZE;
+        mSize--;
+        int serial = mSerial;
+        mCondition.broadcast();
+        mMutex.unlock();
+
+        int ret = filterFrame(frame, serial);
+        av_frame_free(&frame);
+        if (ret < 0) {
+            break;
+        }
+    }
+    release();
+}
+
+int VideoFilter::filterFrame(AVFrame *frame, int serial) {
+    if (!frame) {
+        // 输入结束，没有滤镜图时不需要处理
+        if (!mGraph) {
+            return 0;
+        }
+    } else if (mBypass) {
+        // 滤镜图创建失败时不做处理直接输出，避免画面中断
+        return queueFrame(frame, mTimeBase, mFrameRate, serial);
+    }
+    int ret = sendFrame(frame);
+    if (ret < 0) {
+        LOGW("VideoFilter->filter frame failed: %d", ret);
+        if (frame && !mGraph) {
+            mBypass = true;
+            return queueFrame(frame, mTimeBase, mFrameRate, serial);
+        }
+        return 0;
+    }
+    AVRational tb = getOutputTimeBase();
+    AVRational frameRate = getOutputFrameRate();
+    if (!frameRate.num || !frameRate.den) {
+        frameRate = mFrameRate;
+    }
+    for (;;) {
+        ret = receiveFrame(mOutFrame);
+        if (ret < 0) {
+            if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
+                LOGW("VideoFilter->receive frame failed: %d", ret);
+            }
+            break;
+        }
+        ret = queueFrame(mOutFrame, tb, frameRate, serial);
+        av_frame_unref(mOutFrame);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+    // 送入结束标志后滤镜图不再接收数据，循环播放或者继续读取到的帧重新创建滤镜图
+    if (!frame) {
+        release();
+    }
+    return 0;
+}
+
+int VideoFilter::queueFrame(AVFrame *frame, AVRational tb, AVRational frameRate, int serial) {
+    Frame *vp = mFrameQueue ? mFrameQueue->peekWritable() : NULL;  // 可能会被阻塞
+    if (!vp) {
+        return -1;
+    }
+    // 阻塞期间发生了跳转，跳转前的帧不再写入
+    mMutex.lock();
+    bool expired = serial != mSerial;
+    mMutex.unlock();
+    if (expired) {
+        return 0;
+    }
+    vp->uploaded = 0;
+    vp->width = frame->width;
+    vp->height = frame->height;
+    vp->format = frame->format;
+    vp->pts = (frame->pts == AV_NOPTS_VALUE) ? NAN : frame->pts * av_q2d(tb);
+    // 帧率改变后按输出端的帧率计算一帧的时长
+    vp->duration = frameRate.num && frameRate.den ? av_q2d((AVRational) {frameRate.den, frameRate.num}) : 0;
+    av_frame_move_ref(vp->frame, frame);
+    mFrameQueue->pushFrame();
+    return 0;
+}
+
+int VideoFilter::configure(AVFrame *frame) {
+    // 渲染只支持 YUV420P 和 BGRA，限制输出格式让滤镜图在内部完成转换
+    static const enum AVPixelFormat pix_fmts[] = {AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUVJ420P, AV_PIX_FMT_BGRA,
+                                                  AV_PIX_FMT_NONE};
+    char args[256];
+    int ret;
+    AVFilterInOut *outputs = NULL;
+    AVFilterInOut *inputs = NULL;
+
+    release();
+    mGraph = avfilter_graph_alloc();
+    if (!mGraph) {
+        return AVERROR(ENOMEM);
+    }
+    // 滤镜按片段多线程执行，0 为自动
+    mGraph->nb_threads = mPlayerState->filter_threads;
+
+    // 缩放滤镜使用与视频转码相同的参数
+    AVDictionaryEntry *entry = av_dict_get(mPlayerState->sws_dict, "flags", NULL, 0);
+    if (entry) {
+        snprintf(args, sizeof(args), "flags=%s", entry->value);
+        mGraph->scale_sws_opts = av_strdup(args);
+    }
+
+    AVRational sar = frame->sample_aspect_ratio;
+    snprintf(args, sizeof(args), "video_size=%dx%d:pix_fmt=%d:time_base=%d/%d:pixel_aspect=%d/%d",
+             frame->width, frame->height, frame->format, mTimeBase.num, mTimeBase.den,
+             sar.num, FFMAX(sar.den, 1));
+    if (mFrameRate.num && mFrameRate.den) {
+        av_strlcatf(args, sizeof(args), ":frame_rate=%d/%d", mFrameRate.num, mFrameRate.den);
+    }
+
+    ret = avfilter_graph_create_filter(&mBufferSrc, avfilter_get_by_name("buffer"), "in", args, NULL, mGraph);
+    if (ret < 0) {
+        goto fail;
+    }
+    ret = avfilter_graph_create_filter(&mBufferSink, avfilter_get_by_name("buffersink"), "out", NULL, NULL, mGraph);
+    if (ret < 0) {
+        goto fail;
+    }
+    ret = av_opt_set_int_list(mBufferSink, "pix_fmts", pix_fmts, AV_PIX_FMT_NONE, AV_OPT_SEARCH_CHILDREN);
+    if (ret < 0) {
+        goto fail;
+    }
+
+    outputs = avfilter_inout_alloc();
+    inputs = avfilter_inout_alloc();
+    if (!outputs || !inputs) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    outputs->name = av_strdup("in");
+    outputs->filter_ctx = mBufferSrc;
+    outputs->pad_idx = 0;
+    outputs->next = NULL;
+    inputs->name = av_strdup("out");
+    inputs->filter_ctx = mBufferSink;
+    inputs->pad_idx = 0;
+    inputs->next = NULL;
+
+    ret = avfilter_graph_parse_ptr(mGraph, mFilters, &inputs, &outputs, NULL);
+    if (ret < 0) {
+        goto fail;
+    }
+    ret = avfilter_graph_config(mGraph, NULL);
+    if (ret < 0) {
+        goto fail;
+    }
+
+    mLastWidth = frame->width;
+    mLastHeight = frame->height;
+    mLastFormat = frame->format;
+    mLastAspectRatio = frame->sample_aspect_ratio;
+    avfilter_inout_free(&inputs);
+    avfilter_inout_free(&outputs);
+    LOGD("VideoFilter->configure %s, %dx%d format: %d, threads: %d",
+         mFilters, frame->width, frame->height, frame->format, mPlayerState->filter_threads);
+    return 0;
+
+fail:
+    LOGE("VideoFilter->configure %s failed: %d", mFilters, ret);
+    avfilter_inout_free(&inputs);
+    avfilter_inout_free(&outputs);
+    release();
+    return ret;
+}
+
+void VideoFilter::release() {
+    if (mGraph) {
+        avfilter_graph_free(&mGraph);
+    }
+    mGraph = NULL;
+    mBufferSrc = NULL;
+    mBufferSink = NULL;
+    mLastWidth = 0;
+    mLastHeight = 0;
+    mLastFormat = -1;
+    mLastAspectRatio = (AVRational) {0, 1};
+}
@@ -0,0 +1,149 @@
+#ifndef VIDEOFILTER_H
+#define VIDEOFILTER_H
+
+#include "PlayerState.h"
+#include "FrameQueue.h"
+#include "AndroidLog.h"
+
+extern "C" {
+#include "libavfilter/avfilter.h"
+#include "libavfilter/buffersink.h"
+#include "libavfilter/buffersrc.h"
+}
+
+// 等待滤镜处理的解码帧数量，解码线程超出后阻塞
+#define VIDEO_FILTER_QUEUE_SIZE 4
+
+/**
+ * 视频滤镜
+ * 在解码器和帧队列之间插入 avfilter 滤镜图，例如 "yadif"、"hqdn3d"、"transpose=1"、"scale=1280:-2"，
+ * 解码帧放入输入队列后由独立的滤镜线程处理，输出帧的时间戳按滤镜图输出端的时间基换算，
+ * 帧率变化（如 yadif=1 逐场输出）后按输出端的帧率计算每帧时长，然后写入帧队列走原有的渲染流程。
+ * 不调用 start 时可以直接用 sendFrame/receiveFrame 同步处理，不依赖渲染，便于单独测试耗时
+ */
+class VideoFilter : public Runnable {
+public:
+    /**
+     * @param playerState
+     * @param filters 滤镜描述
+     * @param timeBase 输入帧时间戳的时间基
+     * @param frameRate 输入帧率，未知时为 {0, 1}
+     */
+    VideoFilter(PlayerState *playerState, const char *filters, AVRational timeBase, AVRational frameRate);
+
+    virtual ~VideoFilter();
+
+    /**
+     * 设置输出的帧队列，滤镜线程处理后的帧写入其中
+     * @param frameQueue
+     */
+    void setFrameQueue(FrameQueue *frameQueue);
+
+    /**
+     * 开启滤镜线程
+     */
+    void start();
+
+    /**
+     * 退出滤镜线程，唤醒阻塞在 pushFrame 中的解码线程
+     */
+    void stop();
+
+    /**
+     * 丢弃输入队列中的帧，滤镜线程在处理下一帧前重建滤镜图，跳转时调用
+     */
+    void flush();
+
+    /**
+     * 解码线程把解码帧放入输入队列，队列满时阻塞
+     * @param frame 成功后移走引用，NULL 表示输入结束，滤镜线程取出滤镜图中剩余的帧后重建滤镜图
+     * @return 0 为成功，< 0 表示已经退出
+     */
+    int pushFrame(AVFrame *frame);
+
+    /**
+     * 把帧送入滤镜图，帧的宽高、像素格式或宽高比变化时重建滤镜图
+     * @param frame 不移走引用，NULL 表示输入结束
+     * @return 0 为成功
+     */
+    int sendFrame(AVFrame *frame);
+
+    /**
+     * 从滤镜图中取出处理后的帧
+     * @param frame
+     * @return 0 为成功，AVERROR(EAGAIN) 表示需要更多输入
+     */
+    int receiveFrame(AVFrame *frame);
+
+    /**
+     * @return 输出帧时间戳的时间基
+     */
+    AVRational getOutputTimeBase();
+
+    /**
+     * @return 输出帧率，未知时为 {0, 1}
+     */
+    AVRational getOutputFrameRate();
+
+    void run() override;
+
+private:
+    /**
+     * 根据输入帧的参数创建滤镜图
+     * @param frame
+     * @return 0 为成功
+     */
+    int configure(AVFrame *frame);
+
+    /**
+     * 释放滤镜图
+     */
+    void release();
+
+    /**
+     * 处理一帧并把输出写入帧队列
+     * @param frame NULL 表示输入结束
+     * @param serial 取出帧时的序号，跳转后序号改变，旧的输出直接丢弃
+     * @return < 0 表示帧队列已经退出
+     */
+    int filterFrame(AVFrame *frame, int serial);
+
+    /**
+     * 把帧写入帧队列
+     * @param frame 成功后移走引用
+     * @param tb 帧时间戳的时间基
+     * @param frameRate 用于计算帧时长
+     * @param serial
+     * @return < 0 表示帧队列已经退出
+     */
+    int queueFrame(AVFrame *frame, AVRational tb, AVRational frameRate, int serial);
+
+private:
+    Mutex mMutex;                   //
+    Condition mCondition;           //
+    PlayerState *mPlayerState;      //
+    Thread *mThread;                // 滤镜线程
+    FrameQueue *mFrameQueue;        // 输出的帧队列
+    char *mFilters;                 // 滤镜描述
+    AVRational mTimeBase;           // 输入时间基
+    AVRational mFrameRate;          // 输入帧率
+
+    AVFilterGraph *mGraph;          // 滤镜图
+    AVFilterContext *mBufferSrc;    // 输入端
+    AVFilterContext *mBufferSink;   // 输出端
+    AVFrame *mOutFrame;             // 滤镜输出的帧
+    int mLastWidth;                 // 创建滤镜图时输入帧的参数，变化时重建
+    int mLastHeight;                //
+    int mLastFormat;                //
+    AVRational mLastAspectRatio;    //
+
+    AVFrame *mQueue[VIDEO_FILTER_QUEUE_SIZE];   // 输入队列
+    int mReadIndex;                 //
+    int mSize;                      //
+    int mSerial;                    // 跳转序号
+    bool mFlushRequest;             // 重建滤镜图请求
+    bool mAbortRequest;             // 退出标志
+    bool mBypass;                   // 滤镜图创建失败，直接输出解码帧
+};
+
+#endif //VIDEOFILTER_H
@@ -20,7 +20,21 @@ AudioDecoder::~AudioDecoder() {
     mMutex.unlock();
 }
 
+void AudioDecoder::reuse(AVStream *stream, int streamIndex) {
+    MediaDecoder::reuse(stream, streamIndex);
+    mMutex.lock();
+    // 丢弃上一个文件未解码完的数据包
+    mPacketPending = 0;
+    av_packet_unref(mPacket);
+    mNextPTS = AV_NOPTS_VALUE;
+    mMutex.unlock();
+}
+
 int AudioDecoder::getAudioFrame(AVFrame *frame) {
+    return getAudioFrame(frame, 1);
+}
+
+int AudioDecoder::getAudioFrame(AVFrame *frame, int block) {
     int got_frame = 0;
     int ret;
 
@@ -38,6 +52,10 @@ int AudioDecoder::getAudioFrame(AVFrame *frame) {
         }
 
         if (mPlayerState->seek_request) { // 正在定位
+            if (!block) {
+                ret = 0;
+                break;
+            }
             continue;
         }
 
@@ -47,13 +65,17 @@ int AudioDecoder::getAudioFrame(AVFrame *frame) {
             mPacketPending = 0;
         } else {
             // 取出数据包
-            if (mPacketQueue->getPacket(&pkt) < 0) {
+            ret = mPacketQueue->getPacket(&pkt, block);
+            if (ret < 0) {
                 ret = -1;
                 break;
             }
+            if (ret == 0) {
+                break;
+            }
         }
 
-        mPlayerState->mutex.lock();
+        mCodecMutex.lock();
         // 将数据包解码
         ret = avcodec_send_packet(mAVCodecCtx, &pkt);
         if (ret < 0) {
@@ -65,13 +87,13 @@ int AudioDecoder::getAudioFrame(AVFrame *frame) {
                 av_packet_unref(&pkt);
                 mPacketPending = 0;
             }
-            mPlayerState->mutex.unlock();
+            mCodecMutex.unlock();
             continue;
         }
 
         // 获取解码得到的音频帧 AVFrame
         ret = avcodec_receive_frame(mAVCodecCtx, frame);
-        mPlayerState->mutex.unlock();
+        mCodecMutex.unlock();
         // 释放数据包的引用，防止内存泄漏
         av_packet_unref(mPacket);
         if (ret < 0) {
@@ -0,0 +1,245 @@
+#include <AndroidLog.h>
+#include <limits.h>
+#include <stdlib.h>
+#include "FrameBufferPool.h"
+
+extern "C" {
+#include "libavutil/pixdesc.h"
+}
+
+FrameBufferPool *FrameBufferPool::instance = 0;
+std::mutex FrameBufferPool::mutex;
+
+FrameBufferPool::FrameBufferPool() {
+    mMemoryBudget = FRAME_POOL_DEFAULT_MEMORY_BUDGET;
+    memset(&mStats, 0, sizeof(FramePoolStats));
+}
+
+FrameBufferPool::~FrameBufferPool() {
+    trim();
+}
+
+FrameBufferPool *FrameBufferPool::getInstance() {
+    if (!instance) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!instance) {
+            instance = new(std::nothrow) FrameBufferPool();
+        }
+    }
+    return instance;
+}
+
+void FrameBufferPool::destroy() {
+    if (instance) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (instance) {
+            delete instance;
+            instance = nullptr;
+        }
+    }
+}
+
+void FrameBufferPool::attach(AVCodecContext *avctx, AVCodec *codec) {
+    if (!avctx || !codec || avctx->codec_type != AVMEDIA_TYPE_VIDEO) {
+        return;
+    }
+    // 不支持直接渲染的解码器对缓冲区有额外要求，交给默认的分配器
+    if (!(codec->capabilities & AV_CODEC_CAP_DR1) || avctx->hw_device_ctx) {
+        return;
+    }
+    avctx->get_buffer2 = getBuffer;
+#if FF_API_THREAD_SAFE_CALLBACKS
+    // 回调是线程安全的，多线程解码时不需要切换到解码线程中分配
+    avctx->thread_safe_callbacks = 1;
+#endif
+}
+
+void FrameBufferPool::setMemoryBudget(int64_t memoryBudget) {
+    Mutex::Autolock lock(mLock);
+    mMemoryBudget = memoryBudget > 0 ? memoryBudget : 0;
+    trimToBudget();
+}
+
+int64_t FrameBufferPool::trim() {
+    Mutex::Autolock lock(mLock);
+    int64_t size = mStats.idleSize;
+    std::map<int, std::vector<uint8_t *> >::iterator it = mIdleBuffers.begin();
+    for (; it != mIdleBuffers.end(); ++it) {
+        for (size_t i = 0; i < it->second.size(); i++) {
+            free(it->second[i]);
+        }
+    }
+    mIdleBuffers.clear();
+    mStats.totalSize -= size;
+    mStats.idleSize = 0;
+    if (size > 0) {
+        LOGD("FrameBufferPool->trim %lld bytes, total: %lld, peak: %lld, alloc: %lld (%lld us), reuse: %lld",
+             (long long) size, (long long) mStats.totalSize, (long long) mStats.peakSize,
+             (long long) mStats.allocCount, (long long) mStats.allocTime, (long long) mStats.reuseCount);
+    }
+    return size;
+}
+
+void FrameBufferPool::getStats(FramePoolStats *stats) {
+    Mutex::Autolock lock(mLock);
+    *stats = mStats;
+}
+
+int FrameBufferPool::getBuffer(AVCodecContext *avctx, AVFrame *frame, int flags) {
+    FrameBufferPool *pool = getInstance();
+    if (pool && frame->width > 0 && frame->height > 0 && pool->getVideoBuffer(avctx, frame) == 0) {
+        return 0;
+    }
+    return avcodec_default_get_buffer2(avctx, frame, flags);
+}
+
+int FrameBufferPool::getVideoBuffer(AVCodecContext *avctx, AVFrame *frame) {
+    enum AVPixelFormat format = (enum AVPixelFormat) frame->format;
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(format);
+    // 硬件帧和调色板格式交给默认的分配器
+    if (!desc || (desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_BITSTREAM))) {
+        return -1;
+    }
+
+    // 按解码器的要求对齐宽高，行宽再对齐到 FRAME_POOL_ALIGN
+    int width = frame->width;
+    int height = frame->height;
+    int linesizeAlign[AV_NUM_DATA_POINTERS];
+    avcodec_align_dimensions2(avctx, &width, &height, linesizeAlign);
+    int linesize[4];
+    int unaligned;
+    do {
+        if (av_image_fill_linesizes(linesize, format, width) < 0) {
+            return -1;
+        }
+        width += width & ~(width - 1);
+        unaligned = 0;
+        for (int i = 0; i < 4; i++) {
+            unaligned |= linesize[i] % FRAME_POOL_ALIGN;
+        }
+    } while (unaligned);
+
+    // 计算每个平面的大小
+    ptrdiff_t linesizes[4];
+    for (int i = 0; i < 4; i++) {
+        linesizes[i] = linesize[i];
+    }
+    size_t sizes[4];
+    if (av_image_fill_plane_sizes(sizes, format, height, linesizes) < 0) {
+        return -1;
+    }
+    int planeSize[4] = {0};
+    for (int i = 0; i < 4; i++) {
+        if (sizes[i] > (size_t) (INT_MAX - 16 - FRAME_POOL_ALIGN)) {
+            return -1;
+        }
+        planeSize[i] = (int) sizes[i];
+    }
+    if (planeSize[0] <= 0) {
+        return -1;
+    }
+
+    for (int i = 0; i < 4 && planeSize[i] > 0; i++) {
+        // 尾部预留解码器越界读写的空间，起始地址对齐到 FRAME_POOL_ALIGN
+        frame->buf[i] = allocBuffer(planeSize[i] + 16 + FRAME_POOL_ALIGN - 1);
+        if (!frame->buf[i]) {
+            for (int j = 0; j < i; j++) {
+                av_buffer_unref(&frame->buf[j]);
+            }
+            return AVERROR(ENOMEM);
+        }
+        frame->data[i] = (uint8_t *) FFALIGN((uintptr_t) frame->buf[i]->data, FRAME_POOL_ALIGN);
+        frame->linesize[i] = linesize[i];
+    }
+    for (int i = 0; i < AV_NUM_DATA_POINTERS; i++) {
+        if (i >= 4 || planeSize[i] <= 0) {
+            frame->data[i] = NULL;
+            frame->linesize[i] = 0;
+        }
+    }
+    frame->extended_data = frame->data;
+    return 0;
+}
+
+AVBufferRef *FrameBufferPool::allocBuffer(int size) {
+    int classSize = sizeClass(size);
+    uint8_t *data = NULL;
+    {
+        Mutex::Autolock lock(mLock);
+        std::map<int, std::vector<uint8_t *> >::iterator it = mIdleBuffers.find(classSize);
+        if (it != mIdleBuffers.end() && !it->second.empty()) {
+            data = it->second.back();
+            it->second.pop_back();
+            mStats.idleSize -= classSize;
+            mStats.reuseCount++;
+        }
+    }
+    if (!data) {
+        int64_t start = av_gettime_relative();
+        void *ptr = NULL;
+        if (posix_memalign(&ptr, FRAME_POOL_ALIGN, (size_t) classSize) != 0) {
+            return NULL;
+        }
+        data = (uint8_t *) ptr;
+        Mutex::Autolock lock(mLock);
+        mStats.totalSize += classSize;
+        mStats.peakSize = FFMAX(mStats.peakSize, mStats.totalSize);
+        mStats.allocCount++;
+        mStats.allocTime += av_gettime_relative() - start;
+        // 新的分辨率需要新的级别，先释放其它级别的空闲缓冲区
+        trimToBudget();
+    }
+    // 级别大小记录在 opaque 中，缓冲区归还时按级别放回
+    AVBufferRef *buf = av_buffer_create(data, classSize, releaseBuffer, (void *) (intptr_t) classSize, 0);
+    if (!buf) {
+        releaseBuffer((void *) (intptr_t) classSize, data);
+    }
+    return buf;
+}
+
+void FrameBufferPool::releaseBuffer(void *opaque, uint8_t *data) {
+    int classSize = (int) (intptr_t) opaque;
+    FrameBufferPool *pool = getInstance();
+    if (!pool) {
+        free(data);
+        return;
+    }
+    Mutex::Autolock lock(pool->mLock);
+    if (pool->mStats.totalSize > pool->mMemoryBudget) {
+        free(data);
+        pool->mStats.totalSize -= classSize;
+        return;
+    }
+    pool->mIdleBuffers[classSize].push_back(data);
+    pool->mStats.idleSize += classSize;
+}
+
+int FrameBufferPool::sizeClass(int size) {
+    if (size <= 4096) {
+        return 4096;
+    }
+    int shift = 0;
+    while ((size >> shift) > 4) {
+        shift++;
+    }
+    // size 的最高位加上之后两位，余数向上取整
+    int step = 1 << (shift - 1);
+    return (size + step - 1) / step * step;
+}
+
+void FrameBufferPool::trimToBudget() {
+    std::map<int, std::vector<uint8_t *> >::iterator it = mIdleBuffers.begin();
+    while (mStats.totalSize > mMemoryBudget && it != mIdleBuffers.end()) {
+        while (mStats.totalSize > mMemoryBudget && !it->second.empty()) {
+            free(it->second.back());
+            it->second.pop_back();
+            mStats.totalSize -= it->first;
+            mStats.idleSize -= it->first;
+        }
+        if (it->second.empty()) {
+            mIdleBuffers.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+}
@@ -1,4 +1,5 @@
 #include "MediaDecoder.h"
+#include "MemoryBudget.h"
 
 MediaDecoder::MediaDecoder(AVCodecContext *avctx,
                            AVStream *stream,
@@ -9,6 +10,8 @@ MediaDecoder::MediaDecoder(AVCodecContext *avctx,
     this->mAVStream = stream;
     this->mStreamIndex = streamIndex;
     this->mPlayerState = playerState;
+    mNewExtradata = NULL;
+    mNewExtradataSize = 0;
 }
 
 MediaDecoder::~MediaDecoder() {
@@ -23,6 +26,7 @@ MediaDecoder::~MediaDecoder() {
         avcodec_free_context(&mAVCodecCtx);
         mAVCodecCtx = NULL;
     }
+    av_freep(&mNewExtradata);
     mPlayerState = NULL;
     mMutex.unlock();
 }
@@ -52,18 +56,31 @@ void MediaDecoder::flush() {
         mPacketQueue->flush();
     }
     // 定位时，音视频均需要清空缓冲区
-    mPlayerState->mutex.lock();
+    mCodecMutex.lock();
     avcodec_flush_buffers(getCodecContext());
-    mPlayerState->mutex.unlock();
+    mCodecMutex.unlock();
 }
 
 int MediaDecoder::pushPacket(AVPacket *pkt) {
+    // 复用解码器后，新的参数集作为 side data 随第一个数据包送给解码器
+    if (mNewExtradata && pkt->size > 0) {
+        uint8_t *data = av_packet_new_side_data(pkt, AV_PKT_DATA_NEW_EXTRADATA, mNewExtradataSize);
+        if (data) {
+            memcpy(data, mNewExtradata, mNewExtradataSize);
+        }
+        av_freep(&mNewExtradata);
+        mNewExtradataSize = 0;
+    }
     if (mPacketQueue) {
         return mPacketQueue->pushPacket(pkt);
     }
     return 0;
 }
 
+int MediaDecoder::pushNullPacket() {
+    return mPacketQueue ? mPacketQueue->pushNullPacket(mStreamIndex) : 0;
+}
+
 int MediaDecoder::getPacketSize() {
     return mPacketQueue ? mPacketQueue->getPacketSize() : 0;
 }
@@ -76,6 +93,34 @@ AVStream *MediaDecoder::getStream() {
     return mAVStream;
 }
 
+void MediaDecoder::setStream(AVStream *stream) {
+    Mutex::Autolock lock(mMutex);
+    mAVStream = stream;
+}
+
+void MediaDecoder::reuse(AVStream *stream, int streamIndex) {
+    mMutex.lock();
+    mAVStream = stream;
+    mStreamIndex = streamIndex;
+    av_codec_set_pkt_timebase(mAVCodecCtx, stream->time_base);
+    av_freep(&mNewExtradata);
+    mNewExtradataSize = 0;
+    mMutex.unlock();
+    // 解码器内部可能已经换过参数集，有 extradata 时总是重新送一次
+    setNewExtradata(stream->codecpar);
+    flush();
+}
+
+void MediaDecoder::setNewExtradata(AVCodecParameters *codecpar) {
+    Mutex::Autolock lock(mMutex);
+    if (codecpar->extradata_size <= 0) {
+        return;
+    }
+    av_freep(&mNewExtradata);
+    mNewExtradata = (uint8_t *) av_memdup(codecpar->extradata, codecpar->extradata_size);
+    mNewExtradataSize = mNewExtradata ? codecpar->extradata_size : 0;
+}
+
 AVCodecContext *MediaDecoder::getCodecContext() {
     return mAVCodecCtx;
 }
@@ -90,7 +135,8 @@ int MediaDecoder::hasEnoughPackets() {
            (mPacketQueue->isAbort()) ||
            (mAVStream->disposition & AV_DISPOSITION_ATTACHED_PIC) ||
            (mPacketQueue->getPacketSize() > MIN_FRAMES) &&
-           (!mPacketQueue->getDuration() || av_q2d(mAVStream->time_base) * mPacketQueue->getDuration() > 1.0);
+           (!mPacketQueue->getDuration() || av_rescale_q(mPacketQueue->getDuration(), mAVStream->time_base, AV_TIME_BASE_Q)
+                                            > MemoryBudget::getInstance()->getPacketQueueDuration());
 }
 
 void MediaDecoder::run() {
@@ -1,4 +1,5 @@
 #include "VideoDecoder.h"
+#include "MemoryBudget.h"
 
 VideoDecoder::VideoDecoder(AVFormatContext *pFormatCtx,
                            AVCodecContext *avctx,
@@ -7,10 +8,17 @@ VideoDecoder::VideoDecoder(AVFormatContext *pFormatCtx,
                            PlayerState *playerState) : MediaDecoder(avctx, stream, streamIndex, playerState) {
 
     this->pFormatCtx = pFormatCtx;
-    mFrameQueue = new FrameQueue(VIDEO_QUEUE_SIZE, 1);
+    // 帧队列的长度按帧大小从进程内存预算中分配，高分辨率时缓冲更少的帧
+    mFrameQueue = new FrameQueue(MemoryBudget::getInstance()->getFrameQueueSize(avctx->width, avctx->height, avctx->pix_fmt), 1);
     mExit = true;
     mDecodeThread = NULL;
     mMasterClock = NULL;
+    mVideoFilter = NULL;
+    if (playerState->vfilters) {
+        mVideoFilter = new VideoFilter(playerState, playerState->vfilters, stream->time_base,
+                                       av_guess_frame_rate(pFormatCtx, stream, NULL));
+        mVideoFilter->setFrameQueue(mFrameQueue);
+    }
     // 旋转角度
     AVDictionaryEntry *entry = av_dict_get(stream->metadata, "rotate", NULL, AV_DICT_MATCH_CASE);
     if (entry && entry->value) {
@@ -23,6 +31,10 @@ VideoDecoder::VideoDecoder(AVFormatContext *pFormatCtx,
 VideoDecoder::~VideoDecoder() {
     mMutex.lock();
     pFormatCtx = NULL;
+    if (mVideoFilter) {
+        delete mVideoFilter;
+        mVideoFilter = NULL;
+    }
     if (mFrameQueue) {
         mFrameQueue->flush();
         delete mFrameQueue;
@@ -45,6 +57,10 @@ void VideoDecoder::start() {
         mFrameQueue->start();
     }
 
+    if (mVideoFilter) {
+        mVideoFilter->start();
+    }
+
     // 解码线程
     if (!mDecodeThread) {
         LOGD("VideoDecoder->开启视频解码线程");
@@ -61,6 +77,11 @@ void VideoDecoder::stop() {
         mFrameQueue->abort();
     }
 
+    // 唤醒阻塞在滤镜输入队列中的解码线程
+    if (mVideoFilter) {
+        mVideoFilter->stop();
+    }
+
     mMutex.lock();
     while (!mExit) {
         mCondition.wait(mMutex);
@@ -78,6 +99,9 @@ void VideoDecoder::stop() {
 void VideoDecoder::flush() {
     mMutex.lock();
     MediaDecoder::flush();
+    if (mVideoFilter) {
+        mVideoFilter->flush();
+    }
     if (mFrameQueue) {
         mFrameQueue->flush();
     }
@@ -85,6 +109,24 @@ void VideoDecoder::flush() {
     mMutex.unlock();
 }
 
+void VideoDecoder::reuse(AVStream *stream, int streamIndex) {
+    MediaDecoder::reuse(stream, streamIndex);
+    mMutex.lock();
+    AVDictionaryEntry *entry = av_dict_get(stream->metadata, "rotate", NULL, AV_DICT_MATCH_CASE);
+    mRotate = (entry && entry->value) ? atoi(entry->value) : 0;
+    // 解码线程和滤镜线程已经停止，滤镜图的时间基、帧率以及滤镜描述按新的媒体流和当前的设置重新创建
+    if (mVideoFilter) {
+        delete mVideoFilter;
+        mVideoFilter = NULL;
+    }
+    if (mPlayerState->vfilters) {
+        mVideoFilter = new VideoFilter(mPlayerState, mPlayerState->vfilters, stream->time_base,
+                                       av_guess_frame_rate(pFormatCtx, stream, NULL));
+        mVideoFilter->setFrameQueue(mFrameQueue);
+    }
+    mMutex.unlock();
+}
+
 int VideoDecoder::getFrameSize() {
     Mutex::Autolock lock(mMutex);
     return mFrameQueue ? mFrameQueue->getFrameSize() : 0;
@@ -105,6 +147,11 @@ AVFormatContext *VideoDecoder::getFormatContext() {
     return pFormatCtx;
 }
 
+void VideoDecoder::setFormatContext(AVFormatContext *formatCtx) {
+    Mutex::Autolock lock(mMutex);
+    pFormatCtx = formatCtx;
+}
+
 void VideoDecoder::run() {
     decodeVideo();
 }
@@ -119,8 +166,11 @@ int VideoDecoder::decodeVideo() {
     int got_picture;
     int ret;
 
+    // 重连时会替换媒体流，解码线程只在锁内访问 mAVStream
+    mMutex.lock();
     AVRational tb = mAVStream->time_base;
     AVRational frame_rate = av_guess_frame_rate(pFormatCtx, mAVStream, NULL);
+    mMutex.unlock();
 
     if (!frame) {
         mExit = true;
@@ -136,6 +186,9 @@ int VideoDecoder::decodeVideo() {
         return AVERROR(ENOMEM);
     }
 
+    // 送入空数据包后不再取数据包，逐帧取出解码器缓存的帧直到 AVERROR_EOF
+    bool draining = false;
+
     // 循环从队列中取出未解码的数据，解码成功后将数据结果存入到另一个队列中
     for (;;) {
 
@@ -149,24 +202,43 @@ int VideoDecoder::decodeVideo() {
         }
 
         /* 取数据，如果没有数据会阻塞，这是一个生产者消费者模式 */
-        if (mPacketQueue->getPacket(packet) < 0) { // 可能会被阻塞
+        if (!draining && mPacketQueue->getPacket(packet) < 0) { // 可能会被阻塞
             ret = -1;
             break;
         }
 
-        mPlayerState->mutex.lock();
-        // 送去解码
-        ret = avcodec_send_packet(mAVCodecCtx, packet);
-        if (ret < 0 && ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
-            av_packet_unref(packet);
-            mPlayerState->mutex.unlock();
-            continue;
+        mCodecMutex.lock();
+        if (!draining) {
+            // 送去解码
+            ret = avcodec_send_packet(mAVCodecCtx, packet);
+            if (ret < 0 && ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
+                av_packet_unref(packet);
+                mCodecMutex.unlock();
+                continue;
+            }
+            draining = !packet->data && !packet->size;
         }
         // 得到解码帧
         ret = avcodec_receive_frame(mAVCodecCtx, frame);
-        mPlayerState->mutex.unlock();
+        // 缓存的帧已经全部取出，清空后解码器可以继续接收数据包
+        if (ret == AVERROR_EOF) {
+            avcodec_flush_buffers(mAVCodecCtx);
+        }
+        mCodecMutex.unlock();
 
-        if (ret < 0 && ret != AVERROR_EOF) {
+        if (ret == AVERROR_EOF) {
+            draining = false;
+            av_packet_unref(packet);
+            // 滤镜图送入结束标志，取出 yadif 等滤镜缓存的最后几帧
+            if (mVideoFilter && mVideoFilter->pushFrame(NULL) < 0) {
+                ret = -1;
+                break;
+            }
+            continue;
+        }
+        if (ret < 0) {
+            // 定位时解码器已经清空，不再等待缓存的帧
+            draining = false;
             av_frame_unref(frame);
             av_packet_unref(packet);
             continue;
@@ -183,11 +255,13 @@ int VideoDecoder::decodeVideo() {
             if (mMasterClock != NULL) {
                 double dpts = NAN;
 
+                // 计算帧的长宽比，重连时会替换解复用上下文和媒体流，这里需要加锁
+                mMutex.lock();
                 if (frame->pts != AV_NOPTS_VALUE) {
                     dpts = av_q2d(mAVStream->time_base) * frame->pts;
                 }
-                // 计算帧的长宽比
                 frame->sample_aspect_ratio = av_guess_sample_aspect_ratio(pFormatCtx, mAVStream, frame);
+                mMutex.unlock();
                 // 是否需要做舍帧操作
                 // 主要看音视频同步是否差距过大
                 if (mPlayerState->frame_drop > 0 ||
@@ -204,7 +278,13 @@ int VideoDecoder::decodeVideo() {
             }
         }
 
-        if (got_picture) { //解码正常
+        if (got_picture && mVideoFilter) {
+            // 交给滤镜线程处理后写入帧队列
+            if (mVideoFilter->pushFrame(frame) < 0) { // 可能会被阻塞
+                ret = -1;
+                break;
+            }
+        } else if (got_picture) { //解码正常
             // 取出 frame 数组中的可写入元素指针
             // 当 frame 数组满时，会阻塞等待
             if (!(vp = mFrameQueue->peekWritable())) { // 可能会被阻塞
@@ -30,6 +30,15 @@ public:
      */
     int getAudioFrame(AVFrame *frame);
 
+    /**
+     * @param frame
+     * @param block 队列中没有数据包时是否阻塞，不阻塞时直接返回 0
+     * @return
+     */
+    int getAudioFrame(AVFrame *frame, int block);
+
+    void reuse(AVStream *stream, int streamIndex) override;
+
 private:
     bool mPacketPending;     // 一次解码无法全部消耗完 AVPacket 中的数据的标志
     AVPacket *mPacket;       //
@@ -0,0 +1,117 @@
+#ifndef FRAMEBUFFERPOOL_H
+#define FRAMEBUFFERPOOL_H
+
+#include <mutex>
+#include <map>
+#include <vector>
+#include "PlayerState.h"
+#include "MemoryBudget.h"
+
+// 缓冲区起始地址和行宽的对齐字节数，满足 SIMD 和纹理上传的要求
+#define FRAME_POOL_ALIGN 64
+// 默认的内存上限，单位字节，与 MemoryBudget 默认分给帧缓冲池的内存一致，超出后归还的缓冲区直接释放，不再缓存
+#define FRAME_POOL_DEFAULT_MEMORY_BUDGET ((int64_t) MEMORY_DEFAULT_BUDGET * MEMORY_FRAME_PERCENT / 100)
+
+/**
+ * 帧缓冲池统计信息
+ */
+typedef struct FramePoolStats {
+    int64_t totalSize;      // 已分配的内存，包括正在使用和空闲的缓冲区，单位字节
+    int64_t idleSize;       // 空闲缓冲区占用的内存，单位字节
+    int64_t peakSize;       // 已分配内存的峰值，单位字节
+    int64_t allocCount;     // 新分配缓冲区的次数
+    int64_t reuseCount;     // 复用空闲缓冲区的次数
+    int64_t allocTime;      // 新分配缓冲区的累计耗时，单位微秒
+} FramePoolStats;
+
+/**
+ * 视频帧缓冲池
+ * 通过解码上下文的 get_buffer2 回调分配解码输出的缓冲区，缓冲区按大小分级缓存，
+ * 引用计数归零后回到池中，在跳转、切换分辨率和切换播放源之后继续复用，所有播放器共享，
+ * 已分配的内存超出上限时归还的缓冲区直接释放
+ */
+class FrameBufferPool {
+public:
+    static FrameBufferPool *getInstance();
+
+    /**
+     * 需要在所有解码器关闭后调用
+     */
+    void destroy();
+
+    /**
+     * 让解码上下文从缓冲池分配视频帧，需要在 avcodec_open2 之前调用，
+     * 不支持直接渲染(DR1)的解码器以及硬件解码不使用缓冲池
+     * @param avctx
+     * @param codec 即将打开的解码器
+     */
+    void attach(AVCodecContext *avctx, AVCodec *codec);
+
+    /**
+     * 设置内存上限
+     * @param memoryBudget 单位字节
+     */
+    void setMemoryBudget(int64_t memoryBudget);
+
+    /**
+     * 释放所有空闲的缓冲区
+     * @return 释放的内存，单位字节
+     */
+    int64_t trim();
+
+    /**
+     * 获取统计信息
+     * @param stats
+     */
+    void getStats(FramePoolStats *stats);
+
+private:
+    FrameBufferPool();
+
+    virtual ~FrameBufferPool();
+
+    /**
+     * get_buffer2 回调
+     */
+    static int getBuffer(AVCodecContext *avctx, AVFrame *frame, int flags);
+
+    /**
+     * 缓冲区引用计数归零时的回调，把缓冲区放回池中
+     */
+    static void releaseBuffer(void *opaque, uint8_t *data);
+
+    /**
+     * 为视频帧的每个平面分配缓冲区
+     * @return 0 为成功
+     */
+    int getVideoBuffer(AVCodecContext *avctx, AVFrame *frame);
+
+    /**
+     * 分配缓冲区，优先复用同一级别的空闲缓冲区
+     * @param size 需要的大小
+     * @return
+     */
+    AVBufferRef *allocBuffer(int size);
+
+    /**
+     * 缓冲区大小分级，向上取整到 2 的幂的 1/4 步长，浪费不超过 25%
+     * @param size
+     * @return
+     */
+    static int sizeClass(int size);
+
+    /**
+     * 释放空闲缓冲区直到已分配的内存不超过上限，需要持有 mLock
+     */
+    void trimToBudget();
+
+    static FrameBufferPool *instance;
+    static std::mutex mutex;
+
+    Mutex mLock;
+    std::map<int, std::vector<uint8_t *> > mIdleBuffers;    // 按大小分级的空闲缓冲区
+    int64_t mMemoryBudget;              // 内存上限
+    FramePoolStats mStats;              // 统计信息
+};
+
+#endif //FRAMEBUFFERPOOL_H
@@ -44,6 +44,12 @@ public:
      */
     int pushPacket(AVPacket *pkt);
 
+    /**
+     * 送入空数据包表示输入结束，解码器取出缓存的全部帧
+     * @return
+     */
+    int pushNullPacket();
+
     /**
      * @return
      */
@@ -59,6 +65,26 @@ public:
      */
     AVStream *getStream();
 
+    /**
+     * 替换媒体流，重连以后媒体流属于新的解复用上下文，解码上下文保持不变
+     * @param stream
+     */
+    void setStream(AVStream *stream);
+
+    /**
+     * 复用解码器播放新的媒体流：清空缓冲的数据，解码上下文保持打开，
+     * 新媒体流的参数集随第一个数据包送给解码器
+     * @param stream 新的媒体流
+     * @param streamIndex 新的媒体流索引
+     */
+    virtual void reuse(AVStream *stream, int streamIndex);
+
+    /**
+     * 设置新的参数集，随下一个数据包送给解码器，播放列表无缝切换时使用
+     * @param codecpar 新媒体流的参数，没有 extradata 时不处理
+     */
+    void setNewExtradata(AVCodecParameters *codecpar);
+
     /**
      * @return
      */
@@ -81,12 +107,15 @@ public:
 protected:
     Mutex mMutex;                 //
     Condition mCondition;         //
+    Mutex mCodecMutex;            // 解码上下文锁，每个解码器独立，多个音轨同时解码时互不阻塞
     bool mAbortRequest;           //
     PlayerState *mPlayerState;    //
     PacketQueue *mPacketQueue;    // 数据包队列
     AVCodecContext *mAVCodecCtx;  //
     AVStream *mAVStream;          //
     int mStreamIndex;             //
+    uint8_t *mNewExtradata;       // 复用解码器后等待送给解码器的参数集
+    int mNewExtradataSize;        //
 };
 
 #endif //FFMPEG4_MEDIADECODER_H
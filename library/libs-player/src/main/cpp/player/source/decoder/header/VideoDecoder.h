@@ -4,6 +4,7 @@
 #include "MediaDecoder.h"
 #include "PlayerState.h"
 #include "MediaClock.h"
+#include "VideoFilter.h"
 
 /**
  * 视频解码器
@@ -44,6 +45,13 @@ public:
      */
     void flush() override;
 
+    /**
+     * 复用解码器，需要在解码线程停止时调用，视频滤镜按新媒体流的时间基和帧率重新创建
+     * @param stream
+     * @param streamIndex
+     */
+    void reuse(AVStream *stream, int streamIndex) override;
+
     /**
      * @return
      */
@@ -64,6 +72,12 @@ public:
      */
     AVFormatContext *getFormatContext();
 
+    /**
+     * 替换解复用上下文，重连时使用
+     * @param formatCtx
+     */
+    void setFormatContext(AVFormatContext *formatCtx);
+
     /**
      */
     void run() override;
@@ -82,6 +96,7 @@ private:
     bool mExit;                     // 退出标志
     Thread *mDecodeThread;          // 解码线程
     MediaClock *mMasterClock;       // 主时钟
+    VideoFilter *mVideoFilter;      // 视频滤镜，设置了滤镜描述时在解码和帧队列之间处理
 };
 
 #endif //FFMPEG4_VIDEODECODER_H
@@ -26,4 +26,8 @@ float AudioDevice::getVolume() {
 
 void AudioDevice::setStereoVolume(float left_volume, float right_volume) {}
 
+int64_t AudioDevice::getCallbackTime() {
+    return av_gettime_relative();
+}
+
 void AudioDevice::run() {}
\ No newline at end of file
@@ -0,0 +1,134 @@
+#include <AndroidLog.h>
+#include "NullAudioDevice.h"
+
+std::mutex NullAudioDevice::captureMutex;
+AudioPCMCallback NullAudioDevice::captureCallback = NULL;
+void *NullAudioDevice::captureUserdata = NULL;
+
+NullAudioDevice::NullAudioDevice() {
+    mAudioThread = NULL;
+    memset(&mAudioDeviceSpec, 0, sizeof(AudioDeviceSpec));
+    mBuffer = NULL;
+    mBytesPerBuffer = 0;
+    mAbortRequest = 1;
+    mPauseRequest = 0;
+    mVolume = 1.0f;
+}
+
+NullAudioDevice::~NullAudioDevice() {
+    stop();
+    av_freep(&mBuffer);
+}
+
+int NullAudioDevice::open(const AudioDeviceSpec *desired, AudioDeviceSpec *obtained) {
+    if (desired->channels <= 0 || desired->freq <= 0) {
+        return -1;
+    }
+    Mutex::Autolock lock(mMutex);
+    int bytesPerFrame = desired->channels * av_get_bytes_per_sample(desired->format);
+    mBytesPerBuffer = bytesPerFrame * (desired->freq * NULL_AUDIO_BUFLEN / 1000);
+    av_freep(&mBuffer);
+    mBuffer = (uint8_t *) av_malloc(mBytesPerBuffer);
+    if (!mBuffer) {
+        return -1;
+    }
+    mAudioDeviceSpec = *desired;
+    if (obtained != NULL) {
+        *obtained = *desired;
+        obtained->size = (uint32_t) (NULL_AUDIO_BUFFERS * mBytesPerBuffer);
+    }
+    LOGD("NullAudioDevice->open %d Hz, %d channels, buffer: %d bytes", desired->freq, desired->channels,
+         mBytesPerBuffer);
+    return NULL_AUDIO_BUFFERS * mBytesPerBuffer;
+}
+
+void NullAudioDevice::start() {
+    if (mAudioDeviceSpec.callback == NULL) {
+        LOGE("NullAudioDevice->audio device callback is NULL!");
+        return;
+    }
+    mMutex.lock();
+    mAbortRequest = 0;
+    mPauseRequest = 0;
+    mMutex.unlock();
+    if (!mAudioThread) {
+        mAudioThread = new Thread(this, Priority_High);
+        mAudioThread->start();
+    }
+}
+
+void NullAudioDevice::stop() {
+    mMutex.lock();
+    mAbortRequest = 1;
+    mCondition.signal();
+    mMutex.unlock();
+    if (mAudioThread) {
+        mAudioThread->join();
+        delete mAudioThread;
+        mAudioThread = NULL;
+    }
+}
+
+void NullAudioDevice::pause() {
+    Mutex::Autolock lock(mMutex);
+    mPauseRequest = 1;
+    mCondition.signal();
+}
+
+void NullAudioDevice::resume() {
+    Mutex::Autolock lock(mMutex);
+    mPauseRequest = 0;
+    mCondition.signal();
+}
+
+void NullAudioDevice::setVolume(float volume) {
+    setStereoVolume(volume, volume);
+}
+
+float NullAudioDevice::getVolume() {
+    Mutex::Autolock lock(mMutex);
+    return mVolume;
+}
+
+void NullAudioDevice::setStereoVolume(float left_volume, float right_volume) {
+    Mutex::Autolock lock(mMutex);
+    mVolume = (left_volume + right_volume) / 2;
+}
+
+void NullAudioDevice::setCapture(AudioPCMCallback capture, void *userdata) {
+    std::unique_lock<std::mutex> lock(captureMutex);
+    captureCallback = capture;
+    captureUserdata = userdata;
+}
+
+void NullAudioDevice::run() {
+    int64_t bufferDuration = NULL_AUDIO_BUFLEN * 1000;
+    int64_t nextTime = av_gettime_relative();
+    mMutex.lock();
+    while (!mAbortRequest) {
+        if (mPauseRequest) {
+            mCondition.wait(mMutex);
+            nextTime = av_gettime_relative();
+            continue;
+        }
+        // 按缓冲区时长等待，模拟设备消耗数据的速度
+        int64_t delay = nextTime - av_gettime_relative();
+        if (delay > 0) {
+            mCondition.waitRelative(mMutex, delay * 1000);
+            continue;
+        }
+        // 落后太多时不追赶，从当前时间重新开始计时
+        if (delay < -NULL_AUDIO_BUFFERS * bufferDuration) {
+            nextTime = av_gettime_relative();
+        }
+        mAudioDeviceSpec.callback(mAudioDeviceSpec.userdata, mBuffer, mBytesPerBuffer);
+        {
+            std::unique_lock<std::mutex> lock(captureMutex);
+            if (captureCallback) {
+                captureCallback(captureUserdata, mBuffer, mBytesPerBuffer);
+            }
+        }
+        nextTime += bufferDuration;
+    }
+    mMutex.unlock();
+}
@@ -0,0 +1,360 @@
+#include <algorithm>
+#include <AndroidLog.h>
+#include "SharedAudioDevice.h"
+#include "NullAudioDevice.h"
+#include "AudioGain.h"
+
+#if defined(__ANDROID__)
+
+#include "SLESDevice.h"
+
+#endif
+
+SharedAudioOutput *SharedAudioOutput::instance = 0;
+std::mutex SharedAudioOutput::mutex;
+
+SharedAudioOutput::SharedAudioOutput() {
+    mDevice = NULL;
+    memset(&mSpec, 0, sizeof(AudioDeviceSpec));
+    mBufferSize = 0;
+    mClockBase = AV_NOPTS_VALUE;
+    mFramesMixed = 0;
+}
+
+SharedAudioOutput::~SharedAudioOutput() {
+    mDeviceMutex.lock();
+    if (mDevice) {
+        mDevice->stop();
+        delete mDevice;
+        mDevice = NULL;
+    }
+    mDeviceMutex.unlock();
+}
+
+SharedAudioOutput *SharedAudioOutput::getInstance() {
+    if (!instance) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!instance) {
+            instance = new(std::nothrow) SharedAudioOutput();
+        }
+    }
+    return instance;
+}
+
+void SharedAudioOutput::destroy() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (instance) {
+        delete instance;
+        instance = NULL;
+    }
+}
+
+int SharedAudioOutput::addInput(SharedAudioDevice *input, AudioDeviceSpec *obtained) {
+    Mutex::Autolock lock(mDeviceMutex);
+    if (!mDevice) {
+#if defined(__ANDROID__)
+        mDevice = new SLESDevice();
+#else
+        mDevice = new NullAudioDevice();
+#endif
+        AudioDeviceSpec desired;
+        memset(&desired, 0, sizeof(AudioDeviceSpec));
+        desired.freq = SHARED_AUDIO_SAMPLE_RATE;
+        desired.format = AV_SAMPLE_FMT_S16;
+        desired.channels = SHARED_AUDIO_CHANNELS;
+        desired.samples = AUDIO_MIN_BUFFER_SIZE;
+        desired.callback = mixCallback;
+        desired.userdata = this;
+        mBufferSize = mDevice->open(&desired, &mSpec);
+        if (mBufferSize <= 0) {
+            LOGE("SharedAudioOutput->open audio device failed: %d", mBufferSize);
+            delete mDevice;
+            mDevice = NULL;
+            return -1;
+        }
+        mMutex.lock();
+        mClockBase = AV_NOPTS_VALUE;
+        mFramesMixed = 0;
+        mMutex.unlock();
+        mDevice->start();
+        LOGD("SharedAudioOutput->open %d Hz, %d channels, buffer: %d bytes", mSpec.freq, mSpec.channels,
+             mBufferSize);
+    }
+
+    mMutex.lock();
+    if (std::find(mInputs.begin(), mInputs.end(), input) == mInputs.end()) {
+        mInputs.push_back(input);
+    }
+    mMutex.unlock();
+
+    if (obtained) {
+        *obtained = mSpec;
+        obtained->size = (uint32_t) mBufferSize;
+    }
+    return mBufferSize;
+}
+
+void SharedAudioOutput::removeInput(SharedAudioDevice *input) {
+    Mutex::Autolock lock(mDeviceMutex);
+    mMutex.lock();
+    std::vector<SharedAudioDevice *>::iterator it = std::find(mInputs.begin(), mInputs.end(), input);
+    if (it != mInputs.end()) {
+        mInputs.erase(it);
+    }
+    bool empty = mInputs.empty();
+    mMutex.unlock();
+    // 输出线程的回调需要 mMutex，关闭设备时不能持有
+    if (empty && mDevice) {
+        mDevice->stop();
+        delete mDevice;
+        mDevice = NULL;
+        LOGD("SharedAudioOutput->close audio device");
+    }
+}
+
+void SharedAudioOutput::mixCallback(void *userdata, uint8_t *stream, int len) {
+    SharedAudioOutput *output = (SharedAudioOutput *) userdata;
+    output->mix(stream, len);
+}
+
+void SharedAudioOutput::mix(uint8_t *stream, int len) {
+    Mutex::Autolock lock(mMutex);
+    int bytesPerFrame = mSpec.channels * av_get_bytes_per_sample(mSpec.format);
+    if (bytesPerFrame <= 0 || mSpec.freq <= 0) {
+        memset(stream, 0, len);
+        return;
+    }
+    // 回调时间按已经混音的帧数推算，所有输入的音频时钟使用同一个时间轴，
+    // 设备卡顿或者欠载导致与实际时间偏差太大时重新对齐
+    int64_t now = av_gettime_relative();
+    int64_t callbackTime = mClockBase == AV_NOPTS_VALUE ? now
+                                                        : mClockBase + av_rescale(mFramesMixed, AV_TIME_BASE, mSpec.freq);
+    if (mClockBase == AV_NOPTS_VALUE || llabs(callbackTime - now) > SHARED_AUDIO_MAX_CLOCK_DRIFT) {
+        mClockBase = now;
+        mFramesMixed = 0;
+        callbackTime = now;
+    }
+
+    // 只从各个输入的环形缓冲取数据，持有 mMutex 期间不调用播放器的回调
+    memset(stream, 0, len);
+    for (size_t i = 0; i < mInputs.size(); i++) {
+        mInputs[i]->mixTo(stream, len, callbackTime);
+    }
+    mFramesMixed += len / bytesPerFrame;
+}
+
+SharedAudioDevice::SharedAudioDevice() {
+    mThread = NULL;
+    memset(&mAudioDeviceSpec, 0, sizeof(AudioDeviceSpec));
+    mOpened = false;
+    mStarted = false;
+    mPaused = false;
+    mAbortRequest = true;
+    mLeftVolume = 1.0f;
+    mRightVolume = 1.0f;
+    mLeftGain = 1 << MIX_GAIN_SHIFT;
+    mRightGain = 1 << MIX_GAIN_SHIFT;
+    mCallbackTime = 0;
+    mChunk = NULL;
+    mChunkSize = 0;
+    mRing = NULL;
+    mRingSize = 0;
+    mReadPos = 0;
+    mFill = 0;
+    mSerial = 0;
+    mNextMixTime = AV_NOPTS_VALUE;
+}
+
+SharedAudioDevice::~SharedAudioDevice() {
+    // 先从共享输出中移除，之后混音线程不再访问环形缓冲
+    if (mOpened) {
+        SharedAudioOutput::getInstance()->removeInput(this);
+    }
+    stop();
+    av_freep(&mChunk);
+    av_freep(&mRing);
+}
+
+int SharedAudioDevice::open(const AudioDeviceSpec *desired, AudioDeviceSpec *obtained) {
+    mMutex.lock();
+    mAudioDeviceSpec = *desired;
+    mMutex.unlock();
+    AudioDeviceSpec spec;
+    int ret = SharedAudioOutput::getInstance()->addInput(this, &spec);
+    if (ret < 0) {
+        return ret;
+    }
+    mOpened = true;
+
+    // 播放器每次回调取一个缓冲区大小的数据，环形缓冲存放 SHARED_AUDIO_RING_CHUNKS 块
+    int bytesPerFrame = spec.channels * av_get_bytes_per_sample(spec.format);
+    int chunkSize = bytesPerFrame > 0 ? ret / bytesPerFrame * bytesPerFrame : 0;
+    mMutex.lock();
+    mAudioDeviceSpec.freq = spec.freq;
+    mAudioDeviceSpec.format = spec.format;
+    mAudioDeviceSpec.channels = spec.channels;
+    if (chunkSize != mChunkSize) {
+        av_freep(&mChunk);
+        av_freep(&mRing);
+        mChunk = (uint8_t *) av_malloc(chunkSize);
+        mRing = (uint8_t *) av_malloc(chunkSize * SHARED_AUDIO_RING_CHUNKS);
+        mChunkSize = chunkSize;
+        mRingSize = chunkSize * SHARED_AUDIO_RING_CHUNKS;
+    }
+    mReadPos = 0;
+    mFill = 0;
+    mSerial++;
+    mNextMixTime = AV_NOPTS_VALUE;
+    bool allocated = mChunk && mRing && chunkSize > 0;
+    mMutex.unlock();
+    if (!allocated) {
+        LOGE("SharedAudioDevice->alloc ring buffer failed, chunk: %d bytes", chunkSize);
+        SharedAudioOutput::getInstance()->removeInput(this);
+        mOpened = false;
+        return -1;
+    }
+
+    if (obtained) {
+        *obtained = *desired;
+        obtained->freq = spec.freq;
+        obtained->format = spec.format;
+        obtained->channels = spec.channels;
+        obtained->size = spec.size;
+    }
+    return ret;
+}
+
+void SharedAudioDevice::start() {
+    mMutex.lock();
+    mStarted = true;
+    mPaused = false;
+    mAbortRequest = false;
+    mCondition.broadcast();
+    mMutex.unlock();
+    if (!mThread) {
+        mThread = new Thread(this, Priority_High);
+        mThread->start();
+    }
+}
+
+void SharedAudioDevice::stop() {
+    mMutex.lock();
+    mStarted = false;
+    mAbortRequest = true;
+    mCondition.broadcast();
+    mMutex.unlock();
+    // 等待正在进行的回调返回，之后不会再回调
+    if (mThread) {
+        mThread->join();
+        delete mThread;
+        mThread = NULL;
+    }
+    flush();
+}
+
+void SharedAudioDevice::pause() {
+    Mutex::Autolock lock(mMutex);
+    mPaused = true;
+}
+
+void SharedAudioDevice::resume() {
+    Mutex::Autolock lock(mMutex);
+    mPaused = false;
+    mCondition.broadcast();
+}
+
+void SharedAudioDevice::flush() {
+    Mutex::Autolock lock(mMutex);
+    mReadPos = 0;
+    mFill = 0;
+    mSerial++;
+    mNextMixTime = AV_NOPTS_VALUE;
+    mCondition.broadcast();
+}
+
+void SharedAudioDevice::setVolume(float volume) {
+    setStereoVolume(volume, volume);
+}
+
+float SharedAudioDevice::getVolume() {
+    Mutex::Autolock lock(mMutex);
+    return (mLeftVolume + mRightVolume) / 2;
+}
+
+void SharedAudioDevice::setStereoVolume(float left_volume, float right_volume) {
+    Mutex::Autolock lock(mMutex);
+    mLeftVolume = av_clipf(left_volume, 0.0f, 1.0f);
+    mRightVolume = av_clipf(right_volume, 0.0f, 1.0f);
+    mLeftGain = AudioGain::toFixedGain(mLeftVolume);
+    mRightGain = AudioGain::toFixedGain(mRightVolume);
+}
+
+int64_t SharedAudioDevice::getCallbackTime() {
+    return mCallbackTime;
+}
+
+void SharedAudioDevice::run() {
+    mMutex.lock();
+    while (!mAbortRequest) {
+        if (!mStarted || mPaused || !mAudioDeviceSpec.callback || !mRing || mRingSize - mFill < mChunkSize) {
+            mCondition.wait(mMutex);
+            continue;
+        }
+        // 这块数据排在环形缓冲中已有数据的后面混音
+        int bytesPerFrame = mAudioDeviceSpec.channels * av_get_bytes_per_sample(mAudioDeviceSpec.format);
+        int64_t mixTime = mNextMixTime != AV_NOPTS_VALUE ? mNextMixTime : av_gettime_relative();
+        mCallbackTime = mixTime + av_rescale(mFill / bytesPerFrame, AV_TIME_BASE, mAudioDeviceSpec.freq);
+        AudioPCMCallback callback = mAudioDeviceSpec.callback;
+        void *userdata = mAudioDeviceSpec.userdata;
+        int serial = mSerial;
+        mMutex.unlock();
+
+        // 不持有锁，播放器的回调可以阻塞等待解码，混音线程不受影响
+        callback(userdata, mChunk, mChunkSize);
+
+        mMutex.lock();
+        // 回调期间清空过，这块数据已经过时
+        if (serial != mSerial) {
+            continue;
+        }
+        int writePos = (mReadPos + mFill) % mRingSize;
+        int first = FFMIN(mChunkSize, mRingSize - writePos);
+        memcpy(mRing + writePos, mChunk, first);
+        if (mChunkSize > first) {
+            memcpy(mRing, mChunk + first, mChunkSize - first);
+        }
+        mFill += mChunkSize;
+    }
+    mMutex.unlock();
+}
+
+void SharedAudioDevice::mixTo(uint8_t *output, int len, int64_t callbackTime) {
+    Mutex::Autolock lock(mMutex);
+    if (!mStarted || mPaused || !mRing) {
+        // 暂停期间不推算混音时间，恢复后重新开始
+        mNextMixTime = AV_NOPTS_VALUE;
+        return;
+    }
+    // 数据不足时只混入已有的部分，其余为静音
+    int size = FFMIN(len, mFill);
+    int first = FFMIN(size, mRingSize - mReadPos);
+    mixSamples(output, mRing + mReadPos, first);
+    if (size > first) {
+        mixSamples(output + first, mRing, size - first);
+    }
+    mReadPos = (mReadPos + size) % mRingSize;
+    mFill -= size;
+    int bytesPerFrame = mAudioDeviceSpec.channels * av_get_bytes_per_sample(mAudioDeviceSpec.format);
+    mNextMixTime = callbackTime + av_rescale(len / bytesPerFrame, AV_TIME_BASE, mAudioDeviceSpec.freq);
+    mCondition.broadcast();
+}
+
+void SharedAudioDevice::mixSamples(uint8_t *output, const uint8_t *data, int len) {
+    int16_t *dst = (int16_t *) output;
+    const int16_t *src = (const int16_t *) data;
+    if (mLeftGain == mRightGain || mAudioDeviceSpec.channels != 2) {
+        AudioGain::mixSamples(dst, src, len / (int) sizeof(int16_t), mLeftGain);
+    } else {
+        AudioGain::mixStereoSamples(dst, src, len / (int) (2 * sizeof(int16_t)), mLeftGain, mRightGain);
+    }
+}
@@ -6,6 +6,10 @@ VideoDevice::~VideoDevice() {}
 
 void VideoDevice::terminate() {}
 
+void VideoDevice::prewarm() {}
+
+void VideoDevice::unbindContext() {}
+
 void VideoDevice::setTimeStamp(double timeStamp) {}
 
 void VideoDevice::onInitTexture(int width, int height, TextureFormat format, BlendMode blendMode, int rotate) {}
@@ -20,4 +24,9 @@ int VideoDevice::onUpdateARGB(uint8_t *rgba, int pitch) {
 
 int VideoDevice::onRequestRender(bool flip) {
     return 0;
-}
\ No newline at end of file
+}
+int VideoDevice::onRedraw() {
+    return -1;
+}
+
+void VideoDevice::onTrimMemory() {}
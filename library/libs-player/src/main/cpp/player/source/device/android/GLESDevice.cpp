@@ -10,15 +10,21 @@ GLESDevice::GLESDevice() {
     mSurfaceWidth = 0;
     mSurfaceHeight = 0;
     mEGLSurface = EGL_NO_SURFACE;
+    mPbufferSurface = EGL_NO_SURFACE;
     mEglHelper = new EglHelper();
 
+    mIsSurfaceReset = false;
     mIsHasEGLSurface = false;
     mIsHasEGlContext = false;
     mIsHasSurface = false;
+    mIsRedrawRequest = false;
+    mLastTexture = -1;
+    mIsFrameBufferReleased = false;
     // 分配纹理数据的内存
     mVideoTexture = (Texture *) malloc(sizeof(Texture));
     memset(mVideoTexture, 0, sizeof(Texture));
     mInputRenderNode = NULL;
+    mInputFormat = FMT_NONE;
 
     mNodeList = new RenderNodeList();
     mNodeList->addNode(new DisplayRenderNode());     // 添加显示渲染的结点
@@ -35,6 +41,8 @@ GLESDevice::GLESDevice() {
 GLESDevice::~GLESDevice() {
     mMutex.lock();
     terminate();
+    delete mEglHelper;
+    mEglHelper = NULL;
     free(mVideoTexture);
     delete mNodeList;
     mMutex.unlock();
@@ -53,6 +61,8 @@ void GLESDevice::surfaceCreated(ANativeWindow *window) {
         // 渲染区域的宽高
         mSurfaceWidth = ANativeWindow_getWidth(mNativeWindow);
         mSurfaceHeight = ANativeWindow_getHeight(mNativeWindow);
+        // 只替换窗口对应的 EGLSurface，上下文和纹理、FBO、着色器程序都保留，新窗口上立即重绘最后一帧
+        mIsRedrawRequest = true;
     }
     mIsHasSurface = true;
     mMutex.unlock();
@@ -67,10 +77,27 @@ void GLESDevice::surfaceChanged(int width, int height) {
         GLOutFilter *glOutFilter = (GLOutFilter *) mNodeList->findNode(NODE_DISPLAY)->glFilter;
         glOutFilter->nativeSurfaceChanged(width, height);
     }
+    mIsRedrawRequest = true;
     mMutex.unlock();
 }
 
 
+void GLESDevice::detachSurface() {
+    mMutex.lock();
+    // 上下文还关联在渲染线程时，EGLSurface 会在解除关联后才真正销毁
+    if (mEGLSurface != EGL_NO_SURFACE) {
+        mEglHelper->destroySurface(mEGLSurface);
+        mEGLSurface = EGL_NO_SURFACE;
+        mIsHasEGLSurface = false;
+    }
+    if (mNativeWindow != NULL) {
+        ANativeWindow_release(mNativeWindow);
+        mNativeWindow = NULL;
+    }
+    mIsHasSurface = false;
+    mMutex.unlock();
+}
+
 void GLESDevice::changeFilter(RenderNodeType type, const char *filterName) {
     mMutex.lock();
     mFilterInfo.type = type;
@@ -124,18 +151,12 @@ void GLESDevice::terminate(bool releaseContext) {
     }
 
     // 销毁egl上下文
-    if (mEglHelper->getEglContext() != EGL_NO_CONTEXT && releaseContext) {
-        if (mInputRenderNode != NULL) { //释放输入节点
-            mInputRenderNode->destroy();
-            delete mInputRenderNode;
-        }
-        mEglHelper->release();
-        delete mEglHelper;
+    if (releaseContext) {
+        this->releaseContext();
         if (mNativeWindow != NULL) {
             ANativeWindow_release(mNativeWindow);
             mNativeWindow = NULL;
         }
-        mIsHasEGlContext = false;
     }
 }
 
@@ -143,6 +164,70 @@ void GLESDevice::terminate() {
     terminate(true);
 }
 
+void GLESDevice::releaseContext() {
+    if (mEglHelper == NULL || mEglHelper->getEglContext() == EGL_NO_CONTEXT) {
+        return;
+    }
+    if (mInputRenderNode != NULL) { //释放输入节点
+        mInputRenderNode->destroy();
+        delete mInputRenderNode;
+        mInputRenderNode = NULL;
+        mInputFormat = FMT_NONE;
+    }
+    if (mPbufferSurface != EGL_NO_SURFACE) {
+        mEglHelper->destroySurface(mPbufferSurface);
+        mPbufferSurface = EGL_NO_SURFACE;
+    }
+    mEglHelper->release();
+    mIsHasEGlContext = false;
+    mLastTexture = -1;
+    // 滤镜的着色器程序和 FBO 随上下文一起销毁，重新创建上下文后需要重新初始化
+    mIsFilterChange = true;
+}
+
+EGLSurface GLESDevice::getRenderSurface() {
+    if (mEGLSurface != EGL_NO_SURFACE) {
+        return mEGLSurface;
+    }
+    if (mPbufferSurface == EGL_NO_SURFACE && mIsHasEGlContext) {
+        mPbufferSurface = mEglHelper->createSurface(1, 1);
+    }
+    return mPbufferSurface;
+}
+
+void GLESDevice::prewarm() {
+    mMutex.lock();
+    if (!mIsHasEGlContext) {
+        mIsHasEGlContext = mEglHelper->init(FLAG_TRY_GLES3);
+        LOGD("GLESDevice->prewarm isHasEGlContext : %d", mIsHasEGlContext);
+    }
+    if (!mIsHasEGlContext || mInputRenderNode != NULL) {
+        mMutex.unlock();
+        return;
+    }
+    // 着色器程序需要在关联了上下文的线程中创建，这里借用一个离屏 Surface，创建完成后解除关联，交给渲染线程使用
+    EGLSurface eglSurface = mEglHelper->createSurface(1, 1);
+    if (eglSurface != EGL_NO_SURFACE) {
+        mEglHelper->makeCurrent(eglSurface);
+        // 这时还不知道解码输出的格式，按最常见的 YUV420P 创建
+        mVideoTexture->format = FMT_YUV420P;
+        mInputRenderNode = new InputRenderNode();
+        mInputRenderNode->initFilter(mVideoTexture);
+        mInputFormat = FMT_YUV420P;
+        mEglHelper->makeNothingCurrent();
+        mEglHelper->destroySurface(eglSurface);
+    }
+    mMutex.unlock();
+}
+
+void GLESDevice::unbindContext() {
+    mMutex.lock();
+    if (mIsHasEGlContext) {
+        mEglHelper->makeNothingCurrent();
+    }
+    mMutex.unlock();
+}
+
 void GLESDevice::setTimeStamp(double timeStamp) {
     mMutex.lock();
     if (mNodeList) {
@@ -162,6 +247,7 @@ void GLESDevice::onInitTexture(int width, int height, TextureFormat format, Blen
     }
 
     if (!mIsHasEGlContext) {
+        mMutex.unlock();
         return;
     }
     // 是否需要重置Surface，兼容SurfaceHolder处理
@@ -212,8 +298,15 @@ void GLESDevice::onInitTexture(int width, int height, TextureFormat format, Blen
     mVideoTexture->format = format;
     mVideoTexture->blendMode = blendMode;
     mVideoTexture->direction = FLIP_NONE;
-    // 关联egl上下文
-    mEglHelper->makeCurrent(mEGLSurface);
+    // 关联egl上下文，没有窗口时关联离屏 Surface
+    mEglHelper->makeCurrent(getRenderSurface());
+
+    // 预热时按 YUV420P 创建的输入节点与实际格式不一致，需要重新创建
+    if (mInputRenderNode != NULL && mInputFormat != format) {
+        mInputRenderNode->destroy();
+        delete mInputRenderNode;
+        mInputRenderNode = NULL;
+    }
 
     // 第一次会初始化，这个初始化主要作用是，创建对应的着色器程序和对应的纹理对象
     if (mInputRenderNode == NULL) {
@@ -222,19 +315,31 @@ void GLESDevice::onInitTexture(int width, int height, TextureFormat format, Blen
         if (mInputRenderNode != NULL) {
             // 输入节点的初始化
             mInputRenderNode->initFilter(mVideoTexture);
+            mInputFormat = format;
+        }
+    }
 
-            // 创建一个FBO给渲染节点
-            FrameBuffer *frameBuffer = new FrameBuffer(width, height);
-            // 初始化主要是创建一个帧缓冲区FBO并挂载一个颜色纹理
-            frameBuffer->init();
-            mInputRenderNode->setFrameBuffer(frameBuffer);
-
-            // 设置所有节点的视口大小
-            if (mSurfaceWidth != 0 && mSurfaceHeight != 0) {
-                mNodeList->setDisplaySize(mSurfaceWidth, mSurfaceHeight);
-            }
+    // 预热时只创建了着色器程序，FBO 需要知道帧的宽高才能创建；播放列表拼接的条目分辨率不同时按新的大小重新创建
+    bool resized = mInputRenderNode != NULL && mInputRenderNode->hasFrameBuffer()
+                   && !mInputRenderNode->hasFrameBuffer(width, height);
+    if (mInputRenderNode != NULL && !mInputRenderNode->hasFrameBuffer(width, height)) {
+        mInputRenderNode->setTextureSize(width, height);
+        // 创建一个FBO给渲染节点
+        FrameBuffer *frameBuffer = new FrameBuffer(width, height);
+        // 初始化主要是创建一个帧缓冲区FBO并挂载一个颜色纹理
+        frameBuffer->init();
+        mInputRenderNode->setFrameBuffer(frameBuffer);
+
+        // 设置所有节点的视口大小
+        if (mSurfaceWidth != 0 && mSurfaceHeight != 0) {
+            mNodeList->setDisplaySize(mSurfaceWidth, mSurfaceHeight);
         }
     }
+    // 内存紧张时释放过的 FBO 以及分辨率变化后滤镜节点的 FBO 按帧的大小重新创建
+    if ((mIsFrameBufferReleased || resized) && !mIsFilterChange) {
+        mNodeList->setTextureSize(width, height);
+    }
+    mIsFrameBufferReleased = false;
     // 如果改变了滤镜效果的渲染，则在节点链表中增加或更改为当前的滤镜
     if (mIsFilterChange) {
         // 改变滤镜
@@ -266,8 +371,9 @@ int GLESDevice::onUpdateYUV(uint8_t *yData, int yPitch, uint8_t *uData, int uPit
     mVideoTexture->pixels[1] = uData;
     mVideoTexture->pixels[2] = vData;
 
-    if (mInputRenderNode != NULL && mEGLSurface != EGL_NO_SURFACE) {
-        mEglHelper->makeCurrent(mEGLSurface);
+    EGLSurface eglSurface = getRenderSurface();
+    if (mInputRenderNode != NULL && eglSurface != EGL_NO_SURFACE) {
+        mEglHelper->makeCurrent(eglSurface);
         mInputRenderNode->uploadTexture(mVideoTexture);
     }
     // LOGE("GLESDevice->纹理的宽度%d",yPitch)
@@ -286,8 +392,9 @@ int GLESDevice::onUpdateARGB(uint8_t *rgba, int pitch) {
     mVideoTexture->pitches[0] = pitch; // lineSize
     mVideoTexture->pixels[0] = rgba; // data
 
-    if (mInputRenderNode != NULL && mEGLSurface != EGL_NO_SURFACE) {
-        mEglHelper->makeCurrent(mEGLSurface);
+    EGLSurface eglSurface = getRenderSurface();
+    if (mInputRenderNode != NULL && eglSurface != EGL_NO_SURFACE) {
+        mEglHelper->makeCurrent(eglSurface);
         mInputRenderNode->uploadTexture(mVideoTexture);
     }
     // LOGE("GLESDevice->纹理的宽度%d",pitch/4);
@@ -305,11 +412,13 @@ int GLESDevice::onRequestRender(bool flip) {
     mMutex.lock();
     mVideoTexture->direction = flip ? FLIP_VERTICAL : FLIP_NONE;
     // LOGD("GLESDevice->flip ? %d", flip);
-    if (mInputRenderNode != NULL && mEGLSurface != EGL_NO_SURFACE) {
-        mEglHelper->makeCurrent(mEGLSurface);
+    EGLSurface eglSurface = getRenderSurface();
+    if (mInputRenderNode != NULL && eglSurface != EGL_NO_SURFACE) {
+        mEglHelper->makeCurrent(eglSurface);
 
         // 第一步是输入节点的渲染，mRenderNode就是输入节点，输入节点也有一个FBO，此时将渲染结果保存到FBO中
         int texture = mInputRenderNode->drawFrameBuffer(mVideoTexture);
+        mLastTexture = texture;
 
 //        if (mSurfaceWidth != 0 && mSurfaceHeight != 0) {
 //            // 设置显示窗口的大小
@@ -320,12 +429,70 @@ int GLESDevice::onRequestRender(bool flip) {
         // mInputRenderNode->drawFrame(mVideoTexture);
         // 从渲染节点链表中的节点依次对纹理数据进行处理，并最后显示
         mNodeList->drawFrame(texture, mVertices, mTextureVertices);
-        mEglHelper->swapBuffers(mEGLSurface);
+        // 离屏 Surface 只用来保持滤镜的状态，不需要交换
+        if (eglSurface == mEGLSurface) {
+            mEglHelper->swapBuffers(mEGLSurface);
+            mIsRedrawRequest = false;
+        }
+    }
+    mMutex.unlock();
+    return 0;
+}
+
+int GLESDevice::onRedraw() {
+    mMutex.lock();
+    if (!mIsRedrawRequest || !mIsHasEGlContext || mLastTexture < 0) {
+        mMutex.unlock();
+        return -1;
+    }
+    // 窗口重新创建后，在新窗口上创建 EGLSurface
+    if (mIsHasSurface && mIsSurfaceReset) {
+        terminate(false);
+        mIsSurfaceReset = false;
+    }
+    if (mEGLSurface == EGL_NO_SURFACE && mNativeWindow != NULL && mIsHasSurface) {
+        mEGLSurface = mEglHelper->createSurface(mNativeWindow);
+        mIsHasEGLSurface = mEGLSurface != EGL_NO_SURFACE;
+    }
+    if (mEGLSurface == EGL_NO_SURFACE) {
+        mMutex.unlock();
+        return -1;
+    }
+    // 输入节点 FBO 中保存着最后一帧，只需要重新走一遍滤镜链并输出到新窗口
+    mEglHelper->makeCurrent(mEGLSurface);
+    // 内存紧张时释放过的 FBO 按最后一帧的大小重新创建
+    if (mIsFrameBufferReleased) {
+        mNodeList->setTextureSize(mVideoTexture->frameWidth, mVideoTexture->frameHeight);
+        mIsFrameBufferReleased = false;
+    }
+    if (mSurfaceWidth != 0 && mSurfaceHeight != 0) {
+        mNodeList->setDisplaySize(mSurfaceWidth, mSurfaceHeight);
     }
+    mNodeList->drawFrame(mLastTexture, mVertices, mTextureVertices);
+    mEglHelper->swapBuffers(mEGLSurface);
+    mIsRedrawRequest = false;
     mMutex.unlock();
     return 0;
 }
 
+void GLESDevice::onTrimMemory() {
+    mMutex.lock();
+    if (!mIsHasEGlContext) {
+        mMutex.unlock();
+        return;
+    }
+    EGLSurface eglSurface = getRenderSurface();
+    if (eglSurface != EGL_NO_SURFACE) {
+        mEglHelper->makeCurrent(eglSurface);
+        // 只释放滤镜链的中间 FBO，下一帧或者重绘时重新创建；
+        // 输入节点的着色器程序和保存着最后一帧的 FBO 保留，暂停时窗口重建后仍然可以重绘
+        mNodeList->releaseFrameBuffers();
+        mIsFrameBufferReleased = true;
+        LOGD("GLESDevice->trim memory, filter frame buffers released");
+    }
+    mMutex.unlock();
+}
+
 void GLESDevice::resetVertices() {
     const float *verticesVertexCoordinates = CoordinateUtils::getVertexCoordinates();
     for (int i = 0; i < 8; ++i) {
@@ -1,17 +1,20 @@
 #include <AndroidLog.h>
 #include "SLESDevice.h"
+#include "PlayerRuntime.h"
 
 #define OPENSLES_BUFFERS 4  // 最大缓冲区数量
 #define OPENSLES_BUFLEN  10 // 缓冲区长度(毫秒)
 
 SLESDevice::SLESDevice() {
-    mSLObject = NULL;
+    // OpenSL 引擎和混音器由运行环境共享，设备存在期间保持引用
+    PlayerRuntime::getInstance()->acquire();
     mSLEngine = NULL;
     mSLOutputMixObject = NULL;
     mSLPlayerObject = NULL;
     mSLPlayItf = NULL;
     mSLVolumeItf = NULL;
     mSLBufferQueueItf = NULL;
+    mBuffer = NULL;
     memset(&mAudioDeviceSpec, 0, sizeof(AudioDeviceSpec));
     mAbortRequest = 1;
     mPauseRequest = 0;
@@ -30,18 +33,16 @@ SLESDevice::~SLESDevice() {
         mSLVolumeItf = NULL;
         mSLBufferQueueItf = NULL;
     }
-
-    if (mSLOutputMixObject != NULL) {
-        (*mSLOutputMixObject)->Destroy(mSLOutputMixObject);
-        mSLOutputMixObject = NULL;
+    if (mBuffer != NULL) {
+        free(mBuffer);
+        mBuffer = NULL;
     }
 
-    if (mSLObject != NULL) {
-        (*mSLObject)->Destroy(mSLObject);
-        mSLObject = NULL;
-        mSLEngine = NULL;
-    }
+    // 共享的引擎和混音器由运行环境销毁
+    mSLOutputMixObject = NULL;
+    mSLEngine = NULL;
     mMutex.unlock();
+    PlayerRuntime::getInstance()->release();
 }
 
 void SLESDevice::start() {
@@ -248,38 +249,22 @@ void slBufferPCMCallBack(SLAndroidSimpleBufferQueueItf bf, void *context) {}
 int SLESDevice::open(const AudioDeviceSpec *desired, AudioDeviceSpec *obtained) {
     LOGD("SLESDevice->打开音频");
     SLresult result;
-    // 创建引擎engineObject
-    result = slCreateEngine(&mSLObject, 0, NULL, 0, NULL, NULL);
-    if ((result) != SL_RESULT_SUCCESS) {
-        LOGE("SLESDevice->%s: slCreateEngine() failed", __func__);
+    // 使用进程内共享的引擎和混音器，预热过时不需要再创建
+    if (PlayerRuntime::getInstance()->getAudioEngine(&mSLEngine, &mSLOutputMixObject) < 0) {
+        LOGE("SLESDevice->%s: get OpenSL engine failed", __func__);
         return -1;
     }
-    // 实现引擎engineObject
-    result = (*mSLObject)->Realize(mSLObject, SL_BOOLEAN_FALSE);
-    if (result != SL_RESULT_SUCCESS) {
-        LOGE("SLESDevice->%s: mSLObject->Realize() failed", __func__);
-        return -1;
-    }
-    // 获取引擎接口SLEngineItf
-    result = (*mSLObject)->GetInterface(mSLObject, SL_IID_ENGINE, &mSLEngine);
-    if (result != SL_RESULT_SUCCESS) {
-        LOGE("SLESDevice->%s: mSLObject->GetInterface() failed", __func__);
-        return -1;
-    }
-
-    const SLInterfaceID mids[1] = {SL_IID_ENVIRONMENTALREVERB};
-    const SLboolean mreq[1] = {SL_BOOLEAN_FALSE};
-    // 创建混音器outputMixObject
-    result = (*mSLEngine)->CreateOutputMix(mSLEngine, &mSLOutputMixObject, 1, mids, mreq);
-    if (result != SL_RESULT_SUCCESS) {
-        LOGE("SLESDevice->%s: mSLEngine->CreateOutputMix() failed", __func__);
-        return -1;
+    // 重新打开时先销毁之前的播放器对象和缓冲区
+    if (mSLPlayerObject != NULL) {
+        (*mSLPlayerObject)->Destroy(mSLPlayerObject);
+        mSLPlayerObject = NULL;
+        mSLPlayItf = NULL;
+        mSLVolumeItf = NULL;
+        mSLBufferQueueItf = NULL;
     }
-    // 实现混音器outputMixObject
-    result = (*mSLOutputMixObject)->Realize(mSLOutputMixObject, SL_BOOLEAN_FALSE);
-    if (result != SL_RESULT_SUCCESS) {
-        LOGE("SLESDevice->%s: mSLOutputMixObject->Realize() failed", __func__);
-        return -1;
+    if (mBuffer != NULL) {
+        free(mBuffer);
+        mBuffer = NULL;
     }
     // 设置混音器
     SLDataLocator_OutputMix outputMix = {
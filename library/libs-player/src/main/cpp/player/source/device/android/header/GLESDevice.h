@@ -29,6 +29,11 @@ public:
      */
     void surfaceChanged(int width, int height);
 
+    /**
+     * 立即断开 Surface，不再往窗口输出画面，渲染上下文保留到设备销毁
+     */
+    void detachSurface();
+
     /**
      * 改变滤镜
      * @param type
@@ -61,6 +66,10 @@ public:
 
     void terminate() override;
 
+    void prewarm() override;
+
+    void unbindContext() override;
+
     void setTimeStamp(double timeStamp) override;
 
     void onInitTexture(int width, int height, TextureFormat format, BlendMode blendMode, int rotate) override;
@@ -71,7 +80,22 @@ public:
 
     int onRequestRender(bool flip) override;
 
+    int onRedraw() override;
+
+    void onTrimMemory() override;
+
 private:
+    /**
+     * 获取当前用于渲染的 EGLSurface，没有窗口时使用离屏的 pbuffer，保证纹理上传和滤镜渲染不中断
+     * @return
+     */
+    EGLSurface getRenderSurface();
+
+    /**
+     * 释放所有 GL 对象以及渲染上下文
+     */
+    void releaseContext();
+
     void resetVertices();
 
     void resetTextureVertices();
@@ -84,14 +108,19 @@ private:
     int mSurfaceWidth;                  // 窗口宽度
     int mSurfaceHeight;                 // 窗口高度
     EGLSurface mEGLSurface;             // eglSurface
+    EGLSurface mPbufferSurface;         // 没有窗口时使用的离屏 Surface
     EglHelper *mEglHelper;              // EGL帮助器
     bool mIsSurfaceReset;               // 重新设置 Surface
     bool mIsHasSurface;                 // 是否存在 Surface
     bool mIsHasEGLSurface;              // EGLSurface
     bool mIsHasEGlContext;              // 释放资源
+    bool mIsRedrawRequest;              // 窗口变化后需要重绘最后一帧
+    int mLastTexture;                   // 最后一帧输入节点输出的纹理
+    bool mIsFrameBufferReleased;        // 滤镜链的 FBO 已释放，需要重新创建
 
     Texture *mVideoTexture;             // 视频纹理
     InputRenderNode *mInputRenderNode;  // 输入渲染结点
+    TextureFormat mInputFormat;         // 输入渲染结点的纹理格式
     float mVertices[8];                 // 顶点坐标
     float mTextureVertices[8];          // 纹理坐标
 
@@ -51,10 +51,9 @@ private:
 
 private:
 
-    SLObjectItf mSLObject;   // 引擎接口
-    SLEngineItf mSLEngine;   // 引擎接口
+    SLEngineItf mSLEngine;   // 引擎接口，进程内共享
 
-    SLObjectItf mSLOutputMixObject;  // 混音器
+    SLObjectItf mSLOutputMixObject;  // 混音器，进程内共享
 
     SLObjectItf mSLPlayerObject; // 播放器对象
     SLPlayItf mSLPlayItf;        // 播放器对象
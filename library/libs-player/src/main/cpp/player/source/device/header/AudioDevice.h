@@ -80,6 +80,12 @@ public:
      */
     virtual void setStereoVolume(float left_volume, float right_volume);
 
+    /**
+     * 当前这次回调的时间，在回调中调用，用于更新音频时钟
+     * @return 单位微秒，与 av_gettime_relative 一致
+     */
+    virtual int64_t getCallbackTime();
+
     /**
      */
     virtual void run();
@@ -0,0 +1,64 @@
+#ifndef NULLAUDIODEVICE_H
+#define NULLAUDIODEVICE_H
+
+#include <mutex>
+#include "AudioDevice.h"
+
+// 每次回调取数据的时长，单位毫秒
+#define NULL_AUDIO_BUFLEN 10
+// 模拟的缓冲区数量，用于计算缓冲区大小
+#define NULL_AUDIO_BUFFERS 4
+
+/**
+ * 空音频设备
+ * 不输出声音，只在独立线程中按实际播放速度周期性地调用回调取数据，没有音频硬件的环境下（如 Linux 上测试）模拟音频输出的节奏
+ */
+class NullAudioDevice : public AudioDevice {
+public:
+    NullAudioDevice();
+
+    virtual ~NullAudioDevice();
+
+    int open(const AudioDeviceSpec *desired, AudioDeviceSpec *obtained) override;
+
+    void start() override;
+
+    void stop() override;
+
+    void pause() override;
+
+    void resume() override;
+
+    void setVolume(float volume) override;
+
+    float getVolume() override;
+
+    void setStereoVolume(float left_volume, float right_volume) override;
+
+    void run() override;
+
+    /**
+     * 设置取到数据后的回调，所有空音频设备共用，用于在测试中检查输出的数据
+     * @param capture 为 NULL 时取消
+     * @param userdata
+     */
+    static void setCapture(AudioPCMCallback capture, void *userdata);
+
+private:
+    static std::mutex captureMutex;
+    static AudioPCMCallback captureCallback;
+    static void *captureUserdata;
+
+
+    Mutex mMutex;
+    Condition mCondition;
+    Thread *mAudioThread;               // 模拟播放的线程
+    AudioDeviceSpec mAudioDeviceSpec;   // 打开时的参数
+    uint8_t *mBuffer;                   // 回调取数据的缓冲区
+    int mBytesPerBuffer;                // 一次回调取数据的大小
+    int mAbortRequest;
+    int mPauseRequest;
+    float mVolume;
+};
+
+#endif //NULLAUDIODEVICE_H
@@ -0,0 +1,156 @@
+#ifndef SHAREDAUDIODEVICE_H
+#define SHAREDAUDIODEVICE_H
+
+#include <mutex>
+#include <vector>
+#include "AudioDevice.h"
+
+// 共享音频输出的格式，各个播放器重采样成这个格式后混音
+#define SHARED_AUDIO_SAMPLE_RATE 48000
+#define SHARED_AUDIO_CHANNELS 2
+// 按帧计数推算的时间与实际时间相差超过该值时重新对齐，单位微秒
+#define SHARED_AUDIO_MAX_CLOCK_DRIFT 100000
+// 每个输入的环形缓冲可以存放的回调数据块数量
+#define SHARED_AUDIO_RING_CHUNKS 2
+
+class SharedAudioDevice;
+
+/**
+ * 进程内共享的软件混音输出
+ * 多个播放器同时播放时只打开一个音频输出设备，各个播放器作为混音输入，输出线程从各个输入的环形缓冲中按各自的增益和暂停状态取数据混音，
+ * 不调用播放器的解码路径，某个输入没有数据时以静音混入，不影响其它输入。
+ * 回调时间由输出的帧计数推算，所有输入的音频时钟基于同一个时间轴。第一个输入加入时打开设备，最后一个输入移除时关闭
+ */
+class SharedAudioOutput {
+public:
+    static SharedAudioOutput *getInstance();
+
+    void destroy();
+
+    /**
+     * 加入混音输入，还没有打开输出设备时先打开
+     * @param input
+     * @param obtained 输出设备的参数
+     * @return 缓冲区大小，< 0 为失败
+     */
+    int addInput(SharedAudioDevice *input, AudioDeviceSpec *obtained);
+
+    /**
+     * 移除混音输入，返回后不会再回调这个输入，没有输入时关闭输出设备
+     * @param input
+     */
+    void removeInput(SharedAudioDevice *input);
+
+private:
+    SharedAudioOutput();
+
+    virtual ~SharedAudioOutput();
+
+    /**
+     * 输出设备的回调
+     */
+    static void mixCallback(void *userdata, uint8_t *stream, int len);
+
+    /**
+     * 从所有输入的环形缓冲取数据混音，不会阻塞
+     * @param stream
+     * @param len
+     */
+    void mix(uint8_t *stream, int len);
+
+    static SharedAudioOutput *instance;
+    static std::mutex mutex;
+
+    Mutex mDeviceMutex;                         // 保护输出设备的打开和关闭
+    AudioDevice *mDevice;                       // 输出设备
+    AudioDeviceSpec mSpec;                      // 输出设备的参数
+    int mBufferSize;                            // 输出设备的缓冲区大小
+
+    Mutex mMutex;                               // 保护输入列表，混音期间持有
+    std::vector<SharedAudioDevice *> mInputs;   // 混音输入
+    int64_t mClockBase;                         // 帧计数开始时的时间，单位微秒
+    int64_t mFramesMixed;                       // 从 mClockBase 开始已经混音的帧数
+};
+
+/**
+ * 共享音频输出的混音输入
+ * 每个播放器一个，替代独立的 SLES 设备，格式固定为共享输出的格式，增益、暂停状态各自独立，
+ * 变速由播放器自身的变速变调处理。每个输入有自己的取数据线程，在线程中调用播放器的回调（可以阻塞）写入环形缓冲，
+ * 回调时间为这块数据预计开始混音的时间，由共享输出按帧计数推算的时间加上环形缓冲中已有数据的时长得到
+ */
+class SharedAudioDevice : public AudioDevice {
+public:
+    SharedAudioDevice();
+
+    virtual ~SharedAudioDevice();
+
+    int open(const AudioDeviceSpec *desired, AudioDeviceSpec *obtained) override;
+
+    void start() override;
+
+    void stop() override;
+
+    void pause() override;
+
+    void resume() override;
+
+    /**
+     * 清空环形缓冲，正在进行的回调取到的数据也丢弃
+     */
+    void flush() override;
+
+    void setVolume(float volume) override;
+
+    float getVolume() override;
+
+    void setStereoVolume(float left_volume, float right_volume) override;
+
+    int64_t getCallbackTime() override;
+
+    /**
+     * 取数据线程，环形缓冲有空间时调用播放器的回调
+     */
+    void run() override;
+
+private:
+    friend class SharedAudioOutput;
+
+    /**
+     * 在共享输出的混音线程中调用，从环形缓冲取数据按增益混入输出，数据不足的部分为静音，不会阻塞
+     * @param output 输出缓冲
+     * @param len
+     * @param callbackTime 共享输出按帧计数推算的这次混音的开始时间
+     */
+    void mixTo(uint8_t *output, int len, int64_t callbackTime);
+
+    /**
+     * 把 len 个字节的数据按增益混入输出
+     */
+    void mixSamples(uint8_t *output, const uint8_t *data, int len);
+
+private:
+    Mutex mMutex;                       // 保护环形缓冲和状态，调用播放器的回调期间不持有
+    Condition mCondition;               //
+    Thread *mThread;                    // 取数据线程
+    AudioDeviceSpec mAudioDeviceSpec;   // 播放器打开时的参数
+    bool mOpened;                       // 是否已经加入共享输出
+    bool mStarted;                      //
+    bool mPaused;                       //
+    bool mAbortRequest;                 // 退出取数据线程
+    float mLeftVolume;                  //
+    float mRightVolume;                 //
+    int mLeftGain;                      // Q14 定点增益
+    int mRightGain;                     //
+    int64_t mCallbackTime;              // 当前回调的数据预计开始混音的时间，单位微秒，只在取数据线程中使用
+
+    uint8_t *mChunk;                    // 播放器回调写入的数据块
+    int mChunkSize;                     // 数据块大小，即打开时返回的缓冲区大小
+    uint8_t *mRing;                     // 环形缓冲
+    int mRingSize;                      // 环形缓冲的容量
+    int mReadPos;                       // 读取位置
+    int mFill;                          // 环形缓冲中的数据大小
+    int mSerial;                        // 清空时加一，回调期间发生清空时丢弃这次的数据
+    int64_t mNextMixTime;               // 环形缓冲中第一个字节预计开始混音的时间，还没有混音时为 AV_NOPTS_VALUE
+};
+
+#endif //SHAREDAUDIODEVICE_H
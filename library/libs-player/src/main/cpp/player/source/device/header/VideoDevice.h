@@ -20,6 +20,16 @@ public:
      */
     virtual void terminate();
 
+    /**
+     * 预先创建渲染上下文和输入着色器程序，可以在打开文件的同时调用
+     */
+    virtual void prewarm();
+
+    /**
+     * 解除渲染上下文和当前线程的关联，需要在渲染线程中调用，之后其它线程才能使用这个上下文
+     */
+    virtual void unbindContext();
+
     /**
      * 设置时间戳
      * @param timeStamp
@@ -66,6 +76,17 @@ public:
      */
     virtual int onRequestRender(bool flip);
 
+    /**
+     * 重新绘制最后一帧，Surface 重新创建或者大小改变后由渲染线程调用，不需要重绘时直接返回
+     * @return 0 为重绘了一帧
+     */
+    virtual int onRedraw();
+
+    /**
+     * 释放滤镜链的中间 FBO，需要在渲染线程中调用，下一帧到来或者重绘时重新创建，最后一帧保留用于重绘
+     */
+    virtual void onTrimMemory();
+
 };
 
 #endif //FFMPEG4_VIDEODEVICE_H
@@ -0,0 +1,563 @@
+#include <sys/stat.h>
+#include <time.h>
+#include <algorithm>
+#include <AndroidLog.h>
+#include "include/BPMDetect.h"
+#include "BeatAnalyzer.h"
+#include "ProbeCache.h"
+#include "PlayerRuntime.h"
+
+BeatAnalyzer *BeatAnalyzer::instance = 0;
+std::mutex BeatAnalyzer::mutex;
+
+/**
+ * 解码帧下混成单声道
+ * @param frame 解码帧
+ * @param planar 是否平面格式
+ * @param offset 无符号格式的零点
+ * @param scale 归一化到 -1 ~ 1 的系数
+ * @param mono 输出 nb_samples 个采样点
+ */
+template<typename T>
+static void downmixFrame(const AVFrame *frame, bool planar, float offset, float scale, float *mono) {
+    int channels = frame->channels;
+    int count = frame->nb_samples;
+    if (planar) {
+        const T *src = (const T *) frame->extended_data[0];
+        for (int i = 0; i < count; i++) {
+            mono[i] = (float) src[i];
+        }
+        for (int c = 1; c < channels; c++) {
+            src = (const T *) frame->extended_data[c];
+            for (int i = 0; i < count; i++) {
+                mono[i] += (float) src[i];
+            }
+        }
+    } else {
+        const T *src = (const T *) frame->data[0];
+        for (int i = 0; i < count; i++) {
+            float sum = 0;
+            for (int c = 0; c < channels; c++) {
+                sum += (float) src[c];
+            }
+            mono[i] = sum;
+            src += channels;
+        }
+    }
+    float gain = scale / channels;
+    float bias = offset * channels;
+    for (int i = 0; i < count; i++) {
+        mono[i] = (mono[i] - bias) * gain;
+    }
+}
+
+/**
+ * @return 当前线程占用的 CPU 时间，单位微秒
+ */
+static int64_t getThreadCpuTime() {
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) < 0) {
+        return av_gettime_relative();
+    }
+    return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+BeatAnalyzer::BeatAnalyzer() {
+    mThread = NULL;
+    mAbortRequest = false;
+    mCancelRequest = false;
+}
+
+BeatAnalyzer::~BeatAnalyzer() {
+    mMutex.lock();
+    mAbortRequest = true;
+    mCancelRequest = true;
+    mCondition.broadcast();
+    mMutex.unlock();
+    if (mThread) {
+        mThread->join();
+        delete mThread;
+        mThread = NULL;
+    }
+    mEntries.clear();
+}
+
+BeatAnalyzer *BeatAnalyzer::getInstance() {
+    if (!instance) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!instance) {
+            instance = new(std::nothrow) BeatAnalyzer();
+        }
+    }
+    return instance;
+}
+
+void BeatAnalyzer::destroy() {
+    if (instance) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (instance) {
+            delete instance;
+            instance = nullptr;
+        }
+    }
+}
+
+void BeatAnalyzer::getFileIdentity(const char *url, int64_t *size, int64_t *mtime) {
+    *size = 0;
+    *mtime = 0;
+    const char *protocol = avio_find_protocol_name(url);
+    if (protocol && !strcmp(protocol, "file")) {
+        const char *path = url;
+        av_strstart(url, "file:", &path);
+        struct stat st;
+        if (stat(path, &st) == 0) {
+            *size = st.st_size;
+            *mtime = st.st_mtime;
+        }
+    }
+}
+
+std::list<BeatEntry>::iterator BeatAnalyzer::find(const char *url) {
+    std::list<BeatEntry>::iterator it = mEntries.begin();
+    for (; it != mEntries.end(); ++it) {
+        if (it->url == url) {
+            break;
+        }
+    }
+    return it;
+}
+
+int BeatAnalyzer::analyze(const char *url) {
+    if (!url) {
+        return -1;
+    }
+    int64_t size, mtime;
+    getFileIdentity(url, &size, &mtime);
+    Mutex::Autolock lock(mMutex);
+    std::list<BeatEntry>::iterator it = find(url);
+    if (it != mEntries.end()) {
+        mEntries.splice(mEntries.begin(), mEntries, it);
+        bool changed = it->size != size || it->mtime != mtime;
+        if (!changed && it->state != BEAT_ANALYSIS_FAILED) {
+            return 0;
+        }
+        // 文件已经改变或者上次失败，重新分析
+        if (changed && mCurrent == url) {
+            mCancelRequest = true;
+        }
+        it->size = size;
+        it->mtime = mtime;
+        it->state = BEAT_ANALYSIS_PENDING;
+    } else {
+        BeatEntry entry;
+        entry.url = url;
+        entry.size = size;
+        entry.mtime = mtime;
+        entry.state = BEAT_ANALYSIS_PENDING;
+        entry.analysis.bpm = 0;
+        entry.analysis.duration = 0;
+        entry.analysis.cpuTime = 0;
+        entry.analysis.speed = 0;
+        mEntries.push_front(entry);
+        trim();
+    }
+    if (!mThread) {
+        mThread = new Thread(this, Priority_Low);
+        mThread->start();
+    }
+    mCondition.broadcast();
+    return 0;
+}
+
+BeatAnalysisState BeatAnalyzer::getAnalysis(const char *url, BeatAnalysis *analysis) {
+    if (!url) {
+        return BEAT_ANALYSIS_NONE;
+    }
+    int64_t size, mtime;
+    getFileIdentity(url, &size, &mtime);
+    Mutex::Autolock lock(mMutex);
+    std::list<BeatEntry>::iterator it = find(url);
+    if (it == mEntries.end() || it->size != size || it->mtime != mtime) {
+        return BEAT_ANALYSIS_NONE;
+    }
+    if (it->state == BEAT_ANALYSIS_DONE && analysis) {
+        *analysis = it->analysis;
+    }
+    return it->state;
+}
+
+void BeatAnalyzer::remove(const char *url) {
+    if (!url) {
+        return;
+    }
+    Mutex::Autolock lock(mMutex);
+    std::list<BeatEntry>::iterator it = find(url);
+    if (it != mEntries.end()) {
+        mEntries.erase(it);
+    }
+    if (mCurrent == url) {
+        mCancelRequest = true;
+    }
+}
+
+void BeatAnalyzer::clear() {
+    Mutex::Autolock lock(mMutex);
+    mEntries.clear();
+    if (!mCurrent.empty()) {
+        mCancelRequest = true;
+    }
+}
+
+void BeatAnalyzer::trim() {
+    std::list<BeatEntry>::iterator it = mEntries.end();
+    while (mEntries.size() > BEAT_ANALYZER_MAX_ENTRIES && it != mEntries.begin()) {
+        --it;
+        if (it->url != mCurrent) {
+            it = mEntries.erase(it);
+        }
+    }
+}
+
+void BeatAnalyzer::run() {
+    for (;;) {
+        mMutex.lock();
+        std::list<BeatEntry>::iterator it = mEntries.end();
+        while (!mAbortRequest) {
+            for (it = mEntries.begin(); it != mEntries.end(); ++it) {
+                if (it->state == BEAT_ANALYSIS_PENDING) {
+                    break;
+                }
+            }
+            if (it != mEntries.end()) {
+                break;
+            }
+            mCondition.wait(mMutex);
+        }
+        if (mAbortRequest) {
+            mMutex.unlock();
+            break;
+        }
+        std::string url = it->url;
+        mCurrent = url;
+        mCancelRequest = false;
+        mMutex.unlock();
+
+        // 打开和解码期间需要 FFmpeg 的全局初始化和锁管理，没有播放器时由这里引用
+        BeatAnalysis analysis;
+        PlayerRuntime::getInstance()->acquire();
+        int ret = process(url.c_str(), &analysis);
+        PlayerRuntime::getInstance()->release();
+
+        mMutex.lock();
+        mCurrent.clear();
+        it = find(url.c_str());
+        // 分析过程中被取消或者文件改变时丢弃结果，仍然在等待的会重新分析
+        if (it != mEntries.end() && it->state == BEAT_ANALYSIS_PENDING && !mCancelRequest) {
+            if (ret == 0) {
+                it->state = BEAT_ANALYSIS_DONE;
+                it->analysis = analysis;
+            } else {
+                it->state = BEAT_ANALYSIS_FAILED;
+            }
+        }
+        mCancelRequest = false;
+        trim();
+        mMutex.unlock();
+    }
+}
+
+int BeatAnalyzer::interruptCallback(void *ctx) {
+    BeatAnalyzer *analyzer = (BeatAnalyzer *) ctx;
+    return analyzer->mAbortRequest || analyzer->mCancelRequest;
+}
+
+int BeatAnalyzer::process(const char *url, BeatAnalysis *analysis) {
+    int64_t cpuStart = getThreadCpuTime();
+    int64_t wallStart = av_gettime_relative();
+    AVFormatContext *ic = NULL;
+    AVCodecContext *avctx = NULL;
+    AVCodec *codec = NULL;
+    AVPacket *pkt = av_packet_alloc();
+    AVFrame *frame = av_frame_alloc();
+    soundtouch::BPMDetect *detector = NULL;
+    soundtouch::SAMPLETYPE block[BEAT_ANALYZER_BLOCK];
+    std::vector<float> mono;
+    std::vector<float> onset;
+    std::vector<int> beatFrames;
+    int blockSize = 0;
+    int streamIndex = -1;
+    int sampleRate = 0;     // 解码输出的采样率
+    int factor = 1;         // 降采样的倍数
+    int rate = 0;           // 降采样后的采样率
+    int hop = 1;            // 起音包络一帧的采样点数
+    float decimateSum = 0;
+    int decimateCount = 0;
+    float envelope = 0;
+    float envelopeCoef = 0;
+    float energy = 0;
+    int hopCount = 0;
+    float lastLevel = 0;
+    int64_t totalSamples = 0;       // 解码的采样点数
+    int64_t startTime = AV_NOPTS_VALUE;  // 第一帧的播放位置，单位毫秒
+    bool eof = false;
+    int ret = 0;
+
+    analysis->bpm = 0;
+    analysis->beats.clear();
+    analysis->duration = 0;
+    analysis->cpuTime = 0;
+    analysis->speed = 0;
+
+    do {
+        if (!pkt || !frame) {
+            ret = AVERROR(ENOMEM);
+            break;
+        }
+        ic = avformat_alloc_context();
+        if (!ic) {
+            ret = AVERROR(ENOMEM);
+            break;
+        }
+        ic->interrupt_callback.callback = interruptCallback;
+        ic->interrupt_callback.opaque = this;
+        ret = avformat_open_input(&ic, url, ProbeCache::getInstance()->findInputFormat(url), NULL);
+        if (ret < 0) {
+            break;
+        }
+        ret = avformat_find_stream_info(ic, NULL);
+        if (ret < 0) {
+            break;
+        }
+        streamIndex = av_find_best_stream(ic, AVMEDIA_TYPE_AUDIO, -1, -1, &codec, 0);
+        if (streamIndex < 0 || !codec) {
+            ret = streamIndex < 0 ? streamIndex : AVERROR_DECODER_NOT_FOUND;
+            break;
+        }
+        // 只读取分析的音频流，其它媒体流在解复用时直接丢弃
+        for (int i = 0; i < ic->nb_streams; i++) {
+            ic->streams[i]->discard = i == streamIndex ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+        }
+        AVStream *stream = ic->streams[streamIndex];
+
+        avctx = avcodec_alloc_context3(codec);
+        if (!avctx) {
+            ret = AVERROR(ENOMEM);
+            break;
+        }
+        ret = avcodec_parameters_to_context(avctx, stream->codecpar);
+        if (ret < 0) {
+            break;
+        }
+        avctx->pkt_timebase = stream->time_base;
+        // 支持下混的解码器(如 ac3、dts)直接输出单声道
+        avctx->request_channel_layout = AV_CH_LAYOUT_MONO;
+        ret = avcodec_open2(avctx, codec, NULL);
+        if (ret < 0) {
+            break;
+        }
+
+        while (!mAbortRequest && !mCancelRequest) {
+            if (!eof) {
+                ret = av_read_frame(ic, pkt);
+                if (ret < 0) {
+                    // 读取失败时按结束处理，分析已经解码的部分
+                    eof = true;
+                } else if (pkt->stream_index != streamIndex) {
+                    av_packet_unref(pkt);
+                    continue;
+                }
+                // 损坏的数据包直接跳过
+                avcodec_send_packet(avctx, eof ? NULL : pkt);
+                av_packet_unref(pkt);
+            }
+            while ((ret = avcodec_receive_frame(avctx, frame)) >= 0) {
+                bool planar = av_sample_fmt_is_planar((AVSampleFormat) frame->format) != 0;
+                if (!detector) {
+                    sampleRate = frame->sample_rate;
+                    factor = FFMAX(sampleRate / BEAT_ANALYZER_RATE, 1);
+                    rate = sampleRate / factor;
+                    if (rate < BEAT_ANALYZER_MIN_RATE) {
+                        LOGE("BeatAnalyzer->unsupported sample rate: %d", sampleRate);
+                        ret = AVERROR(EINVAL);
+                        break;
+                    }
+                    hop = FFMAX(rate / BEAT_ANALYZER_ENVELOPE_RATE, 1);
+                    envelopeCoef = 1.0f - expf(-1.0f / (BEAT_ANALYZER_ENVELOPE_TIME * rate));
+                    detector = new soundtouch::BPMDetect(1, rate);
+                    int64_t pts = frame->best_effort_timestamp;
+                    startTime = pts != AV_NOPTS_VALUE ? av_rescale_q(pts, stream->time_base, (AVRational) {1, 1000}) : 0;
+                    if (ic->start_time > 0 && ic->start_time != AV_NOPTS_VALUE) {
+                        startTime -= av_rescale(ic->start_time, 1000, AV_TIME_BASE);
+                    }
+                }
+                // 采样率中途改变的帧不参与分析
+                if (frame->sample_rate != sampleRate) {
+                    av_frame_unref(frame);
+                    continue;
+                }
+                if ((int) mono.size() < frame->nb_samples) {
+                    mono.resize(frame->nb_samples);
+                }
+                switch (av_get_packed_sample_fmt((AVSampleFormat) frame->format)) {
+                    case AV_SAMPLE_FMT_U8:
+                        downmixFrame<uint8_t>(frame, planar, 128.0f, 1.0f / 128.0f, mono.data());
+                        break;
+                    case AV_SAMPLE_FMT_S16:
+                        downmixFrame<int16_t>(frame, planar, 0.0f, 1.0f / 32768.0f, mono.data());
+                        break;
+                    case AV_SAMPLE_FMT_S32:
+                        downmixFrame<int32_t>(frame, planar, 0.0f, 1.0f / 2147483648.0f, mono.data());
+                        break;
+                    case AV_SAMPLE_FMT_FLT:
+                        downmixFrame<float>(frame, planar, 0.0f, 1.0f, mono.data());
+                        break;
+                    case AV_SAMPLE_FMT_DBL:
+                        downmixFrame<double>(frame, planar, 0.0f, 1.0f, mono.data());
+                        break;
+                    default:
+                        memset(mono.data(), 0, frame->nb_samples * sizeof(float));
+                        break;
+                }
+                // 平均降采样，同时送入 BPMDetect 和计算起音包络
+                for (int i = 0; i < frame->nb_samples; i++) {
+                    decimateSum += mono[i];
+                    if (++decimateCount < factor) {
+                        continue;
+                    }
+                    float value = decimateSum / factor;
+                    decimateSum = 0;
+                    decimateCount = 0;
+                    // 幅度包络上升的部分，放大到与波形相近的范围
+                    float rise = envelopeCoef * (fabsf(value) - envelope);
+                    envelope += rise;
+                    rise = FFMAX(rise, 0.0f) * 100.0f;
+#ifdef SOUNDTOUCH_INTEGER_SAMPLES
+                    block[blockSize++] = (soundtouch::SAMPLETYPE) av_clip_int16(lrintf(rise * 32767.0f));
+#else
+                    block[blockSize++] = rise;
+#endif
+                    if (blockSize == BEAT_ANALYZER_BLOCK) {
+                        detector->inputSamples(block, blockSize);
+                        blockSize = 0;
+                    }
+                    // 起音强度为对数能量的增量，只保留增加的部分
+                    energy += value * value;
+                    if (++hopCount == hop) {
+                        float level = log1pf(1000.0f * energy / hop);
+                        onset.push_back(FFMAX(level - lastLevel, 0.0f));
+                        lastLevel = level;
+                        energy = 0;
+                        hopCount = 0;
+                    }
+                }
+                totalSamples += frame->nb_samples;
+                av_frame_unref(frame);
+            }
+            if (ret == AVERROR(EINVAL) || ret == AVERROR_EOF || (eof && ret == AVERROR(EAGAIN))) {
+                break;
+            }
+        }
+        if (mAbortRequest || mCancelRequest) {
+            ret = AVERROR_EXIT;
+            break;
+        }
+        if (!detector) {
+            ret = ret == AVERROR(EINVAL) ? ret : AVERROR_INVALIDDATA;
+            break;
+        }
+        if (blockSize > 0) {
+            detector->inputSamples(block, blockSize);
+        }
+        ret = 0;
+
+        analysis->bpm = detector->getBpm();
+        analysis->duration = av_rescale(totalSamples, 1000, sampleRate);
+        if (analysis->bpm > 0) {
+            double period = 60.0 * rate / hop / analysis->bpm;
+            trackBeats(onset, period, beatFrames);
+            analysis->beats.reserve(beatFrames.size());
+            for (size_t i = 0; i < beatFrames.size(); i++) {
+                analysis->beats.push_back(startTime + av_rescale(beatFrames[i], (int64_t) hop * 1000, rate));
+            }
+        }
+    } while (0);
+
+    delete detector;
+    avcodec_free_context(&avctx);
+    avformat_close_input(&ic);
+    av_packet_free(&pkt);
+    av_frame_free(&frame);
+
+    if (ret < 0) {
+        if (ret != AVERROR_EXIT) {
+            LOGE("BeatAnalyzer->analyze %s failed: %d", url, ret);
+        }
+        return ret;
+    }
+    analysis->cpuTime = FFMAX(getThreadCpuTime() - cpuStart, 1);
+    analysis->speed = (float) (analysis->duration * 1000.0 / analysis->cpuTime);
+    LOGD("BeatAnalyzer->%s: %.1f bpm, %d beats, %lld ms audio in %lld ms cpu / %lld ms wall, %.1fx",
+         url, analysis->bpm, (int) analysis->beats.size(), (long long) analysis->duration,
+         (long long) (analysis->cpuTime / 1000), (long long) ((av_gettime_relative() - wallStart) / 1000),
+         analysis->speed);
+    return 0;
+}
+
+void BeatAnalyzer::trackBeats(std::vector<float> &onset, double period, std::vector<int> &beats) {
+    beats.clear();
+    int count = (int) onset.size();
+    if (count == 0 || period < 1) {
+        return;
+    }
+    // 起音包络按标准差归一化，惩罚系数与音量无关
+    double sum = 0, squareSum = 0;
+    for (int i = 0; i < count; i++) {
+        sum += onset[i];
+        squareSum += onset[i] * onset[i];
+    }
+    double mean = sum / count;
+    double deviation = sqrt(FFMAX(squareSum / count - mean * mean, 0.0));
+    if (deviation <= 0) {
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        onset[i] = (float) (onset[i] / deviation);
+    }
+
+    // 上一个节拍在半个到两个周期之前，间隔偏离周期按对数距离的平方惩罚
+    int minLag = FFMAX((int) lrint(period / 2), 1);
+    int maxLag = FFMAX((int) lrint(period * 2), minLag);
+    std::vector<float> penalty(maxLag + 1, 0.0f);
+    for (int lag = minLag; lag <= maxLag; lag++) {
+        double r = log(lag / period);
+        penalty[lag] = (float) (BEAT_ANALYZER_TIGHTNESS * r * r);
+    }
+    std::vector<float> score(count);
+    std::vector<int> backlink(count, -1);
+    for (int t = 0; t < count; t++) {
+        float best = 0;
+        int link = -1;
+        int lagEnd = FFMIN(maxLag, t);
+        for (int lag = minLag; lag <= lagEnd; lag++) {
+            float s = score[t - lag] - penalty[lag];
+            if (s > best) {
+                best = s;
+                link = t - lag;
+            }
+        }
+        score[t] = onset[t] + best;
+        backlink[t] = link;
+    }
+
+    // 从最后一个周期内得分最高的帧往回找
+    int last = count - 1;
+    for (int t = FFMAX(count - (int) lrint(period), 0); t < count; t++) {
+        if (score[t] > score[last]) {
+            last = t;
+        }
+    }
+    for (int t = last; t >= 0; t = backlink[t]) {
+        beats.push_back(t);
+    }
+    std::reverse(beats.begin(), beats.end());
+}
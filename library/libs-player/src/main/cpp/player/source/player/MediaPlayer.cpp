@@ -1,50 +1,23 @@
+#include <algorithm>
+#include <vector>
 #include "MediaPlayer.h"
 
-/**
- * FFmpeg 操作锁管理回调
- * @param mtx 这是一个二级指针，即指针的指针，传递二级指针的目的是为了改变一级指针的值
- * @param op
- * @return
- */
-static int lockmgrCallback(void **mtx, enum AVLockOp op) {
-    switch (op) {
-        case AV_LOCK_CREATE: {
-            *mtx = new Mutex();
-            if (!*mtx) {
-                LOGD("MediaPlayer->failed to create mutex.");
-                return 1;
-            }
-            return 0;
-        }
-
-        case AV_LOCK_OBTAIN: {
-            if (!*mtx) {
-                return 1;
-            }
-            return ((Mutex *) (*mtx))->lock() != 0;
-        }
+extern "C" {
+#include "libavutil/intreadwrite.h"
+}
 
-        case AV_LOCK_RELEASE: {
-            if (!*mtx) {
-                return 1;
-            }
-            return ((Mutex *) (*mtx))->unlock() != 0;
-        }
+StartupTask::StartupTask(MediaPlayer *player, Task task) {
+    this->mPlayer = player;
+    this->mTask = task;
+}
 
-        case AV_LOCK_DESTROY: {
-            if (!*mtx) {
-                delete (*mtx);
-                *mtx = NULL;
-            }
-            return 0;
-        }
-    }
-    return 1;
+void StartupTask::run() {
+    (mPlayer->*mTask)();
 }
 
 MediaPlayer::MediaPlayer() {
-    av_register_all();
-    avformat_network_init();
+    // FFmpeg 全局初始化以及锁管理回调在进程内只执行一次
+    PlayerRuntime::getInstance()->acquire();
     // 主要用来保存播放器的信息
     mPlayerState = new PlayerState();
     mDuration = -1;
@@ -53,12 +26,52 @@ MediaPlayer::MediaPlayer() {
     mFormatCtx = NULL;
     mLastPaused = -1;
     mAttachmentRequest = 0;
+    mFormatOpts = NULL;
+    mLastReadPos = AV_NOPTS_VALUE;
 
 #if defined(__ANDROID__)
     mAudioDevice = new SLESDevice();
 #else
     mAudioDevice = new AudioDevice();
 #endif
+    mSharedAudio = false;
+    mVideoDevice = NULL;
+    mAudioDeviceRet = -1;
+    mAudioChannelLayout = 0;
+    mAudioChannels = 0;
+    mAudioSampleRate = 0;
+    mAudioRendered = false;
+    mPrewarmTask = new StartupTask(this, &MediaPlayer::prewarmVideoDevice);
+    mDeviceTask = new StartupTask(this, &MediaPlayer::openAudioOutput);
+    mPrewarmThread = NULL;
+    mDeviceThread = NULL;
+    mPreloadRequest = false;
+    mPreloadFinished = false;
+    mPreloadBufferSize = 0;
+    mBudgetActive = false;
+    mTimelineCtx = NULL;
+    mTimelineOrigin = 0;
+    mAudioEnd = AV_NOPTS_VALUE;
+    mVideoEnd = AV_NOPTS_VALUE;
+    mPlaylistIndex = 0;
+    mPrerollStarted = false;
+    mNextItem.offset = 0;
+    mNextFormatCtx = NULL;
+    mPrerollTask = new StartupTask(this, &MediaPlayer::prerollNextItem);
+    mPrerollThread = NULL;
+    for (int i = 0; i < FF_ARRAY_ELEMS(mPrerollInterrupts); i++) {
+        mPrerollInterrupts[i].playerState = mPlayerState;
+        mPrerollInterrupts[i].deadline = 0;
+    }
+    mPrerollInterrupt = &mPrerollInterrupts[0];
+    mAudioSwitchIndex = -1;
+    mOpeningAudioIndex = -1;
+    mOpenedAudioDecoder = NULL;
+    mAudioSwitchOpened = false;
+    mNextAudioDecoder = NULL;
+    mAudioSwitchTask = new StartupTask(this, &MediaPlayer::openNextAudioDecoder);
+    mAudioSwitchThread = NULL;
+    mMixTracksChanged = false;
 
     mMediaSync = new MediaSync(mPlayerState);
     mAudioResampler = NULL;
@@ -66,23 +79,27 @@ MediaPlayer::MediaPlayer() {
     mVideoRecorder = NULL;
 //    mScreenshotRecorder = NULL;
     mIsExit = true;
-
-    // 注册一个多线程锁管理回调，主要是解决多个视频源时保持 avcodec_open/close 的原子操作
-    if (av_lockmgr_register(lockmgrCallback)) {
-        LOGE("MediaPlayer->Could not initialize lock manager!");
-    }
-
 }
 
 MediaPlayer::~MediaPlayer() {
     LOGD("MediaPlayer->播放器析构");
-    avformat_network_deinit();
-    av_lockmgr_register(NULL);
+    waitStartupTask(&mPrewarmThread);
+    waitStartupTask(&mDeviceThread);
+    waitStartupTask(&mPrerollThread);
+    waitStartupTask(&mAudioSwitchThread);
+    delete mPrewarmTask;
+    delete mDeviceTask;
+    delete mPrerollTask;
+    delete mAudioSwitchTask;
+    PlayerRuntime::getInstance()->release();
 }
 
 status_t MediaPlayer::reset() {
     // 先停止
     stop();
+    // 起播失败时辅助线程可能还没有结束
+    waitStartupTask(&mPrewarmThread);
+    waitStartupTask(&mDeviceThread);
     if (mMediaSync) {
         mMediaSync->reset();
         delete mMediaSync;
@@ -107,11 +124,13 @@ status_t MediaPlayer::reset() {
         delete mAudioResampler;
         mAudioResampler = NULL;
     }
+    releaseTimeline();
     if (mFormatCtx != NULL) {
         avformat_close_input(&mFormatCtx);
         avformat_free_context(mFormatCtx);
         mFormatCtx = NULL;
     }
+    av_dict_free(&mFormatOpts);
     if (mPlayerState) {
         delete mPlayerState;
         mPlayerState = NULL;
@@ -119,6 +138,49 @@ status_t MediaPlayer::reset() {
     return NO_ERROR;
 }
 
+status_t MediaPlayer::softReset() {
+    // 先停止读数据线程
+    stop();
+    waitStartupTask(&mPrewarmThread);
+    waitStartupTask(&mDeviceThread);
+    // 只停止线程，解码上下文、音频播放器以及重采样器保留
+    mMediaSync->stop();
+    mMediaSync->flush();
+    if (mAudioDecoder != NULL) {
+        mAudioDecoder->stop();
+    }
+    if (mVideoDecoder != NULL) {
+        mVideoDecoder->stop();
+    }
+    if (mAudioDevice != NULL) {
+        mAudioDevice->stop();
+    }
+    releaseTimeline();
+    if (mFormatCtx != NULL) {
+        avformat_close_input(&mFormatCtx);
+        mFormatCtx = NULL;
+    }
+    av_dict_free(&mFormatOpts);
+
+    // 播放状态和新创建的播放器一致，消息队列保持停止，重新 setDataSource 时才开始，
+    // 软重置在回收线程中执行，消息线程不会在这期间阻塞在旧的消息队列上
+    av_freep(&mPlayerState->headers);
+    mPlayerState->reset();
+    if (mPlayerState->message_queue) {
+        mPlayerState->message_queue->flush();
+    }
+    mDuration = -1;
+    mLastPaused = -1;
+    mAttachmentRequest = 0;
+    mLastReadPos = AV_NOPTS_VALUE;
+    mAudioRendered = false;
+    mPreloadRequest = false;
+    mPreloadFinished = false;
+    mPreloadBufferSize = 0;
+    LOGD("MediaPlayer->soft reset, keep audio decoder: %d, video decoder: %d", mAudioDecoder != NULL, mVideoDecoder != NULL);
+    return NO_ERROR;
+}
+
 void MediaPlayer::setDataSource(const char *url, int64_t offset, const char *headers) {
     // 因为 Autolock 属于一个局部变量，在这里执行了lock上锁操作，当方法执行完，这个局部变量要销毁，会执行析构函数，而在析构函数中会执行解锁操作unlock
     Mutex::Autolock lock(mMutex);
@@ -127,11 +189,36 @@ void MediaPlayer::setDataSource(const char *url, int64_t offset, const char *hea
     if (headers) { //一般没有headers
         mPlayerState->headers = av_strdup(headers);
     }
+    // 软重置后复用的播放器，消息队列在这里重新开始
+    if (mPlayerState->message_queue) {
+        mPlayerState->message_queue->start();
+    }
+}
+
+void MediaPlayer::enqueueDataSource(const char *url, int64_t offset, const char *headers) {
+    if (!url) {
+        return;
+    }
+    PlaylistItem item;
+    item.url = url;
+    item.offset = offset;
+    if (headers) {
+        item.headers = headers;
+    }
+    Mutex::Autolock lock(mPlaylistMutex);
+    mPlaylist.push_back(item);
 }
 
+void MediaPlayer::clearPlaylist() {
+    Mutex::Autolock lock(mPlaylistMutex);
+    mPlaylist.clear();
+}
 
 void MediaPlayer::setVideoDevice(VideoDevice *videoDevice) {
     Mutex::Autolock lock(mMutex);
+    mPrewarmMutex.lock();
+    mVideoDevice = videoDevice;
+    mPrewarmMutex.unlock();
     mMediaSync->setVideoDevice(videoDevice);
 }
 
@@ -140,8 +227,19 @@ status_t MediaPlayer::prepare() {
     if (!mPlayerState->url) {
         return BAD_VALUE;
     }
+    // 取用预加载的播放器，唤醒读数据线程继续播放
+    if (mPreloadRequest && mReadThread) {
+        mPreloadRequest = false;
+        if (mVideoDecoder) {
+            mVideoDecoder->getFrameQueue()->setLimit(FRAME_QUEUE_SIZE);
+        }
+        mCondition.broadcast();
+        return NO_ERROR;
+    }
     mPlayerState->abort_request = 0;
+    mPlayerState->startup_time = av_gettime_relative();
     LOGD("MediaPlayer->准备播放");
+    updateAudioDevice();
     // 开启读数据线程准备
     if (!mReadThread) {
         LOGD("MediaPlayer->准备播放 --- 初始化线程并开始播放");
@@ -151,6 +249,41 @@ status_t MediaPlayer::prepare() {
     return NO_ERROR;
 }
 
+status_t MediaPlayer::preload(int64_t bufferSize) {
+    mMutex.lock();
+    mPreloadRequest = true;
+    mPreloadFinished = false;
+    mPreloadBufferSize = bufferSize;
+    // 预加载的播放器被取用后直接显示第一帧
+    mPlayerState->fast_start = 1;
+    mMutex.unlock();
+    return prepare();
+}
+
+bool MediaPlayer::isPreloaded() {
+    Mutex::Autolock lock(mMutex);
+    if (!mPreloadFinished) {
+        return false;
+    }
+    return !mVideoDecoder || mVideoDecoder->getFrameSize() > 0
+           || (mVideoDecoder->getStream()->disposition & AV_DISPOSITION_ATTACHED_PIC);
+}
+
+int64_t MediaPlayer::getPreloadMemorySize() {
+    Mutex::Autolock lock(mMutex);
+    int64_t size = 0;
+    if (mAudioDecoder) {
+        size += mAudioDecoder->getMemorySize();
+    }
+    if (mVideoDecoder) {
+        size += mVideoDecoder->getMemorySize();
+        // 已解码的视频帧按 YUV420P 估算，软重置后媒体流已经释放，使用解码上下文中的宽高
+        AVCodecContext *avctx = mVideoDecoder->getCodecContext();
+        size += (int64_t) mVideoDecoder->getFrameSize() * avctx->width * avctx->height * 3 / 2;
+    }
+    return size;
+}
+
 status_t MediaPlayer::prepareAsync() {
     Mutex::Autolock lock(mMutex);
     if (!mPlayerState->url) {
@@ -167,10 +300,17 @@ status_t MediaPlayer::prepareAsync() {
 
 void MediaPlayer::start() {
     Mutex::Autolock lock(mMutex);
+    // 开始播放后参与分配进程内存预算中正在播放的部分
+    if (!mBudgetActive) {
+        MemoryBudget::getInstance()->addActivePlayer();
+        mBudgetActive = true;
+    }
+    mPreloadRequest = false;
+    restoreMemory();
     mPlayerState->abort_request = 0;
     mPlayerState->pause_request = 0;
     mIsExit = false;
-    mCondition.signal(); //通知
+    mCondition.broadcast(); //通知
 }
 
 void MediaPlayer::pause() {
@@ -181,20 +321,25 @@ void MediaPlayer::pause() {
 
 void MediaPlayer::resume() {
     Mutex::Autolock lock(mMutex);
+    restoreMemory();
     mPlayerState->pause_request = 0;
-    mCondition.signal();
+    mCondition.broadcast();
 }
 
 void MediaPlayer::stop() {
     mMutex.lock();
     mPlayerState->abort_request = 1;
-    mCondition.signal();
+    mCondition.broadcast();
     mMutex.unlock();
 
     mMutex.lock();
     while (!mIsExit) {
         mCondition.wait(mMutex);
     }
+    if (mBudgetActive) {
+        MemoryBudget::getInstance()->removeActivePlayer();
+        mBudgetActive = false;
+    }
     mMutex.unlock();
 
     /*停止消息线程*/
@@ -214,6 +359,28 @@ void MediaPlayer::stop() {
     }
 }
 
+void MediaPlayer::detach() {
+    mMutex.lock();
+    mPlayerState->pause_request = 1;
+    // 视频输出设备会交给下一个播放器，等待正在进行的预热完成后再断开，之后不再预热
+    mPrewarmMutex.lock();
+    mVideoDevice = NULL;
+    mPrewarmMutex.unlock();
+    mCondition.broadcast();
+    mMutex.unlock();
+    // 停止消息分发，之后的消息不再通知出去
+    if (mPlayerState->message_queue) {
+        mPlayerState->message_queue->stop();
+    }
+    if (mAudioDevice) {
+        mAudioDevice->pause();
+    }
+    // 视频输出设备由调用者持有，这里只断开，不再往设备渲染
+    if (mMediaSync) {
+        mMediaSync->setVideoDevice(NULL);
+    }
+}
+
 void MediaPlayer::seekTo(float timeMs) {
     // when is a live media stream, duration is -1
     if (!mPlayerState->real_time && mDuration < 0) {
@@ -230,7 +397,16 @@ void MediaPlayer::seekTo(float timeMs) {
     if (!mPlayerState->seek_request) {
         int64_t start_time = 0;
         int64_t seek_pos = av_rescale(timeMs, AV_TIME_BASE, 1000);
-        start_time = mFormatCtx ? mFormatCtx->start_time : 0;
+        // 播放列表中定位的是正在播放的条目
+        mMutex.lock();
+        // 暂停中定位需要解码新的一帧
+        restoreMemory();
+        if (!mTimeline.empty()) {
+            start_time = mTimeline.front().startTime;
+        } else {
+            start_time = mFormatCtx ? mFormatCtx->start_time : 0;
+        }
+        mMutex.unlock();
         if (start_time > 0 && start_time != AV_NOPTS_VALUE) {
             seek_pos += start_time;
         }
@@ -245,6 +421,30 @@ void MediaPlayer::seekTo(float timeMs) {
 
 }
 
+void MediaPlayer::trimMemory(MemoryPressure pressure) {
+    if (pressure == MEMORY_PRESSURE_NONE) {
+        return;
+    }
+    Mutex::Autolock lock(mMutex);
+    // 正在播放的播放器只跟随内存预算收缩队列
+    if (!mPlayerState->pause_request || mPlayerState->abort_request) {
+        return;
+    }
+    if (mMediaSync) {
+        mMediaSync->trimMemory(pressure);
+    }
+    if (mAudioResampler) {
+        mAudioResampler->trimMemory();
+    }
+}
+
+void MediaPlayer::restoreMemory() {
+    // 只恢复自身的队列限制，全局的内存压力由 onTrimMemory 或者应用显式调用恢复
+    if (mVideoDecoder) {
+        mVideoDecoder->getFrameQueue()->setLimit(FRAME_QUEUE_SIZE);
+    }
+}
+
 void MediaPlayer::setLooping(int looping) {
     mMutex.lock();
     mPlayerState->loop = looping;
@@ -253,22 +453,19 @@ void MediaPlayer::setLooping(int looping) {
 }
 
 void MediaPlayer::setVolume(float volume) {
-    if (mAudioDevice) {
-        mAudioDevice->setVolume(volume);
-    }
+    setStereoVolume(volume, volume);
 }
 
 float MediaPlayer::getVolume() {
-    if (mAudioDevice) {
-        return mAudioDevice->getVolume();
-    }
-    return 0;
+    Mutex::Autolock lock(mMutex);
+    return (mPlayerState->left_volume + mPlayerState->right_volume) * 50.0f;
 }
 
 void MediaPlayer::setStereoVolume(float leftVolume, float rightVolume) {
-    if (mAudioDevice) {
-        mAudioDevice->setStereoVolume(leftVolume, rightVolume);
-    }
+    // 音量为百分比，由音频回调中的软件增益渐变过去，不再使用音频输出设备的音量接口
+    Mutex::Autolock lock(mMutex);
+    mPlayerState->left_volume = av_clipf(leftVolume / 100.0f, 0.0f, 1.0f);
+    mPlayerState->right_volume = av_clipf(rightVolume / 100.0f, 0.0f, 1.0f);
 }
 
 void MediaPlayer::setMute(int mute) {
@@ -292,6 +489,109 @@ void MediaPlayer::setPitch(float pitch) {
     mMutex.unlock();
 }
 
+void MediaPlayer::setAudioFilter(const char *filters) {
+    mMutex.lock();
+    mPlayerState->setOption(OPT_CATEGORY_PLAYER, "af", filters);
+    if (mAudioResampler) {
+        mAudioResampler->setAudioFilter(filters);
+    }
+    mMutex.unlock();
+}
+
+void MediaPlayer::setAudioAnalyzer(int enable) {
+    mMutex.lock();
+    mPlayerState->audio_analyzer = enable ? 1 : 0;
+    if (mAudioResampler) {
+        mAudioResampler->setAnalyzerEnabled(enable != 0);
+    }
+    mMutex.unlock();
+}
+
+status_t MediaPlayer::getAudioAnalysis(AudioAnalysis *analysis, long *position) {
+    Mutex::Autolock lock(mMutex);
+    if (!mAudioResampler || mAudioResampler->getAudioAnalysis(analysis) < 0) {
+        return INVALID_OPERATION;
+    }
+    // 与 getCurrentPosition 一样减去起始延时和正在播放的条目的偏移
+    int64_t start_time = mTimelineCtx ? mTimelineCtx->start_time : (mFormatCtx ? mFormatCtx->start_time : 0);
+    int64_t start_diff = 0;
+    if (start_time > 0 && start_time != AV_NOPTS_VALUE) {
+        start_diff = av_rescale(start_time, 1000, AV_TIME_BASE);
+    }
+    start_diff += av_rescale(mPlayerState->timeline_offset, 1000, AV_TIME_BASE);
+    int64_t pos = isnan(analysis->pts) ? 0 : (int64_t) (analysis->pts * 1000);
+    *position = (long) FFMAX(pos - start_diff, 0);
+    return NO_ERROR;
+}
+
+status_t MediaPlayer::selectAudioTrack(int streamIndex) {
+    Mutex::Autolock lock(mMutex);
+    if (!mFormatCtx || !mAudioDecoder || streamIndex < 0 || streamIndex >= mFormatCtx->nb_streams
+        || mFormatCtx->streams[streamIndex]->codecpar->codec_type != AVMEDIA_TYPE_AUDIO) {
+        return BAD_VALUE;
+    }
+    // 由读数据包线程处理，重复选择当前的音轨时取消切换
+    mAudioSwitchIndex = streamIndex;
+    return NO_ERROR;
+}
+
+int MediaPlayer::getSelectedAudioTrack() {
+    Mutex::Autolock lock(mMutex);
+    if (mAudioSwitchIndex >= 0) {
+        return mAudioSwitchIndex;
+    }
+    if (mNextAudioDecoder) {
+        return mNextAudioDecoder->getStreamIndex();
+    }
+    return mAudioDecoder ? mAudioDecoder->getStreamIndex() : -1;
+}
+
+int MediaPlayer::getAudioTracks(int *indexes, int size) {
+    Mutex::Autolock lock(mMutex);
+    int count = 0;
+    if (!mFormatCtx) {
+        return count;
+    }
+    for (int i = 0; i < mFormatCtx->nb_streams; i++) {
+        if (mFormatCtx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
+            if (count < size) {
+                indexes[count] = i;
+            }
+            count++;
+        }
+    }
+    return count;
+}
+
+status_t MediaPlayer::setMixTrack(int streamIndex, float gain) {
+    Mutex::Autolock lock(mMutex);
+    if (!mFormatCtx || streamIndex < 0 || streamIndex >= mFormatCtx->nb_streams
+        || mFormatCtx->streams[streamIndex]->codecpar->codec_type != AVMEDIA_TYPE_AUDIO) {
+        return BAD_VALUE;
+    }
+    gain = av_clipf(gain, 0.0f, MIX_GAIN_MAX);
+    // 当前播放的音轨直接设置主音轨增益
+    if (mAudioDecoder && mAudioDecoder->getStreamIndex() == streamIndex) {
+        if (!mAudioResampler) {
+            return INVALID_OPERATION;
+        }
+        mAudioResampler->getAudioMixer()->setPrimaryGain(gain);
+        return NO_ERROR;
+    }
+    mMixTracks[streamIndex] = gain;
+    mMixTracksChanged = true;
+    return NO_ERROR;
+}
+
+status_t MediaPlayer::removeMixTrack(int streamIndex) {
+    Mutex::Autolock lock(mMutex);
+    if (mMixTracks.erase(streamIndex) == 0) {
+        return BAD_VALUE;
+    }
+    mMixTracksChanged = true;
+    return NO_ERROR;
+}
+
 int MediaPlayer::getRotate() {
     Mutex::Autolock lock(mMutex);
     if (mVideoDecoder) {
@@ -324,13 +624,14 @@ long MediaPlayer::getCurrentPosition() {
         currentPosition = mPlayerState->seek_pos;
     } else {
 
-        // 起始延时
-        int64_t start_time = mFormatCtx->start_time;
+        // 起始延时，播放列表以第一个条目为准，再减去正在播放的条目的偏移
+        int64_t start_time = mTimelineCtx ? mTimelineCtx->start_time : mFormatCtx->start_time;
 
         int64_t start_diff = 0;
         if (start_time > 0 && start_time != AV_NOPTS_VALUE) {
             start_diff = av_rescale(start_time, 1000, AV_TIME_BASE);
         }
+        start_diff += av_rescale(mPlayerState->timeline_offset, 1000, AV_TIME_BASE);
 
         // 计算主时钟的时间
         int64_t pos = 0;
@@ -370,11 +671,40 @@ int MediaPlayer::getMetadata(AVDictionary **metadata) {
     return NO_ERROR;
 }
 
+/**
+ * 解复用中断回调，FFmpeg 在阻塞的 IO 操作中会周期性调用
+ * 退出请求立即中断；当前阻塞阶段超过截止时间也会中断，并记录超时的阶段
+ * @param ctx PlayerState
+ * @return 非 0 则中断阻塞操作
+ */
 static int avformat_interrupt_cb(void *ctx) {
     PlayerState *playerState = (PlayerState *) ctx;
     if (playerState->abort_request) {
         return AVERROR_EOF;
     }
+    if (playerState->checkInterruptTimeout()) {
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * 提前打开下一个条目时的中断回调，响应退出请求
+ * 打开和查找媒体流信息时按单独的截止时间中断，拼接之后由读数据线程读取，按读数据线程的阶段检测超时
+ * @param ctx PrerollInterrupt
+ * @return
+ */
+static int preroll_interrupt_cb(void *ctx) {
+    PrerollInterrupt *interrupt = (PrerollInterrupt *) ctx;
+    if (interrupt->playerState->abort_request) {
+        return AVERROR_EOF;
+    }
+    if (interrupt->deadline > 0) {
+        return av_gettime_relative() >= interrupt->deadline ? 1 : 0;
+    }
+    if (interrupt->playerState->checkInterruptTimeout()) {
+        return 1;
+    }
     return 0;
 }
 
@@ -393,10 +723,17 @@ void MediaPlayer::run() {
 }
 
 void MediaPlayer::notifyErrorMessage(const char *message) {
-    if (mPlayerState->message_queue) {
-        mPlayerState->message_queue->postMessage(MSG_ERROR, 0, 0, (void *) message,
-                                                 sizeof(message) / message[0]);
+    if (!mPlayerState->message_queue) {
+        return;
+    }
+    // 超时单独上报，方便上层区分网络超时和其他错误
+    if (mPlayerState->timeout_phase != INTERRUPT_PHASE_NONE) {
+        LOGE("MediaPlayer->%s timed out in phase %d", mPlayerState->url, mPlayerState->timeout_phase);
+        mPlayerState->message_queue->postMessage(MSG_ERROR, ERROR_TIMED_OUT, mPlayerState->timeout_phase);
+        return;
     }
+    mPlayerState->message_queue->postMessage(MSG_ERROR, ERROR_UNKNOWN, 0, (void *) message,
+                                             sizeof(message) / message[0]);
 }
 
 /**
@@ -425,11 +762,23 @@ int MediaPlayer::startPlayer() {
         return ret; // 返回
     }
 
+    /* 预加载只需要解码出第一帧，帧队列限制为一帧，被取用时恢复 */
+    mMutex.lock();
+    if (mPreloadRequest && mVideoDecoder) {
+        mVideoDecoder->getFrameQueue()->setLimit(1);
+    }
+    mMutex.unlock();
+
     /* 3、开始解码 */
     startDecode();
 
+    /* 预加载：缓冲第一个 GOP，等待被取用 */
+    if (mPreloadRequest) {
+        preloadAVPackets();
+    }
+
     /* 4、打开多媒体播放设备 */
-    ret = openMediaDevice();
+    ret = mPlayerState->abort_request ? 0 : openMediaDevice();
     if (ret < 0) {
         mIsExit = true;
         mCondition.signal();
@@ -460,9 +809,18 @@ int MediaPlayer::demux() {
     AVDictionaryEntry *t;
     AVDictionary **opts;
     int scan_all_pmts_set = 0;
+    int probeCached = -1;
+    int retry = 0;
+
+    // 快速起播时，在打开文件和查找媒体流信息的同时创建渲染上下文
+    if (mPlayerState->fast_start && !mPrewarmThread && mVideoDevice
+        && !mPlayerState->video_disable && !mPlayerState->display_disable) {
+        mPrewarmThread = startStartupTask(mPrewarmTask);
+    }
 
     // 线程加锁
     mMutex.lock();
+    mPlayerState->timeout_phase = INTERRUPT_PHASE_NONE;
 
     do {
         // 解封装功能结构体
@@ -498,11 +856,13 @@ int MediaPlayer::demux() {
         }
 
         // 设置 rtmp/rtsp 的超时值
-        if (av_stristart(mPlayerState->url, "rtmp", NULL) ||
-            av_stristart(mPlayerState->url, "rtsp", NULL)) {
-            // There is total different meaning for 'timeout' option in rtmp
-            LOGW("MediaPlayer->remove 'timeout' option for rtmp.");
-            av_dict_set(&mPlayerState->format_opts, "timeout", NULL, 0); // 设置为null
+        // rtmp/rtsp 的 'timeout' 是监听等待连接的超时，这里转换成对应的读写超时，而不是直接丢弃
+        if ((t = av_dict_get(mPlayerState->format_opts, "timeout", NULL, AV_DICT_MATCH_CASE))
+            && (av_stristart(mPlayerState->url, "rtmp", NULL) || av_stristart(mPlayerState->url, "rtsp", NULL))) {
+            const char *key = av_stristart(mPlayerState->url, "rtsp", NULL) ? "stimeout" : "rw_timeout";
+            LOGW("MediaPlayer->map 'timeout' option to '%s' for %s.", key, mPlayerState->url);
+            av_dict_set(&mPlayerState->format_opts, key, t->value, AV_DICT_DONT_OVERWRITE);
+            av_dict_set(&mPlayerState->format_opts, "timeout", NULL, 0);
         }
 
         // 参数说明：
@@ -510,12 +870,24 @@ int MediaPlayer::demux() {
         // const char *url, 传入的地址。支持http,RTSP,以及普通的本地文件。地址最终会存入到AVFormatContext结构体当中
         // AVInputFormat *fmt, 指定输入的封装格式。一般传NULL，由FFmpeg自行探测
         // AVDictionary **options, 其它参数设置。它是一个字典，用于参数传递，不传则写NULL。参见：libavformat/options_table.h,其中包含了它支持的参数设置
+        // 保存一份解复用参数，avformat_open_input 会消耗掉已识别的参数，重连时需要重新使用
+        av_dict_free(&mFormatOpts);
+        av_dict_copy(&mFormatOpts, mPlayerState->format_opts, 0);
+
+        // 优先使用缓存的封装格式，跳过封装格式的探测
+        AVInputFormat *inputFormat = mPlayerState->input_format;
+        if (!inputFormat && mPlayerState->probe_cache) {
+            inputFormat = ProbeCache::getInstance()->findInputFormat(mPlayerState->url);
+        }
+
         /*打开文件*/
-        ret = avformat_open_input(&mFormatCtx, mPlayerState->url, mPlayerState->input_format, &mPlayerState->format_opts);
+        mPlayerState->beginInterruptPhase(INTERRUPT_PHASE_OPEN);
+        ret = avformat_open_input(&mFormatCtx, mPlayerState->url, inputFormat, &mPlayerState->format_opts);
+        mPlayerState->endInterruptPhase();
         // LOGE("MediaPlayer->字典的大小%d",mPlayerState->format_opts->count)
         if (ret < 0) {
             printError(mPlayerState->url, ret);
-            ret = -1;
+            ret = mPlayerState->timeout_phase != INTERRUPT_PHASE_NONE ? AVERROR(ETIMEDOUT) : -1;
             break;
         }
         LOGD("MediaPlayer->open url success[%s]", mPlayerState->url);
@@ -524,6 +896,7 @@ int MediaPlayer::demux() {
         if (mPlayerState->message_queue) {
             mPlayerState->message_queue->postMessage(MSG_OPEN_INPUT);
         }
+        mPlayerState->postStartupTiming(STARTUP_PHASE_OPEN_INPUT);
 
         // 又设置为null
         if (scan_all_pmts_set) {
@@ -545,31 +918,74 @@ int MediaPlayer::demux() {
 
         // 插入全局的附加信息
         av_format_inject_global_side_data(mFormatCtx);
-        // 设置媒体流信息参数
-        opts = setupStreamInfoOptions(mFormatCtx, mPlayerState->codec_opts);
-
-        /* 查找媒体流信息 */
-        ret = avformat_find_stream_info(mFormatCtx, opts);
-        // 释放字典内存
-        if (opts != NULL) {
-            for (int i = 0; i < mFormatCtx->nb_streams; i++) {
-                if (opts[i] != NULL) {
-                    av_dict_free(&opts[i]);
+
+        // 查找缓存的探测结果
+        if (mPlayerState->probe_cache) {
+            probeCached = ProbeCache::getInstance()->lookup(mFormatCtx, mPlayerState->url,
+                                                             mPlayerState->probe_cache == PROBE_CACHE_NETWORK);
+        }
+
+        if (probeCached >= 0) {
+            // 命中缓存，媒体流需要读取数据包才能创建时(如flv)，使用最小的探测参数查找媒体流
+            if ((int) mFormatCtx->nb_streams < probeCached) {
+                mFormatCtx->probesize = PROBE_CACHE_PROBESIZE;
+                mFormatCtx->max_analyze_duration = PROBE_CACHE_ANALYZE_DURATION;
+                mPlayerState->beginInterruptPhase(INTERRUPT_PHASE_PROBE);
+                ret = avformat_find_stream_info(mFormatCtx, NULL);
+                mPlayerState->endInterruptPhase();
+                if (ret < 0 && mPlayerState->timeout_phase != INTERRUPT_PHASE_NONE) {
+                    ret = AVERROR(ETIMEDOUT);
+                    break;
                 }
             }
-            av_freep(&opts);
-        }
+            // 恢复缓存的解码参数
+            if (ret >= 0) {
+                ret = ProbeCache::getInstance()->restore(mFormatCtx, mPlayerState->url);
+            }
+            // 文件和缓存不一致，重新打开文件完整探测
+            if (ret < 0) {
+                LOGW("MediaPlayer->%s: probe cache mismatch, probe again", mPlayerState->url);
+                ProbeCache::getInstance()->remove(mPlayerState->url);
+                retry = 1;
+                break;
+            }
+            LOGD("MediaPlayer->restore stream info from probe cache[%s]", mPlayerState->url);
+        } else {
+            // 设置媒体流信息参数
+            opts = setupStreamInfoOptions(mFormatCtx, mPlayerState->codec_opts);
+
+            /* 查找媒体流信息 */
+            mPlayerState->beginInterruptPhase(INTERRUPT_PHASE_PROBE);
+            ret = avformat_find_stream_info(mFormatCtx, opts);
+            mPlayerState->endInterruptPhase();
+            // 释放字典内存
+            if (opts != NULL) {
+                for (int i = 0; i < mFormatCtx->nb_streams; i++) {
+                    if (opts[i] != NULL) {
+                        av_dict_free(&opts[i]);
+                    }
+                }
+                av_freep(&opts);
+            }
 
-        if (ret < 0) {
-            LOGW("MediaPlayer->%s: could not find codec parameters", mPlayerState->url);
-            ret = -1;
-            break;
+            if (ret < 0) {
+                LOGW("MediaPlayer->%s: could not find codec parameters", mPlayerState->url);
+                ret = mPlayerState->timeout_phase != INTERRUPT_PHASE_NONE ? AVERROR(ETIMEDOUT) : -1;
+                break;
+            }
+
+            // 保存探测结果，下次打开时跳过查找媒体流信息
+            if (mPlayerState->probe_cache) {
+                ProbeCache::getInstance()->store(mFormatCtx, mPlayerState->url,
+                                                 mPlayerState->probe_cache == PROBE_CACHE_NETWORK);
+            }
         }
 
         // 查找媒体流信息回调
         if (mPlayerState->message_queue) {
             mPlayerState->message_queue->postMessage(MSG_FIND_STREAM_INFO);
         }
+        mPlayerState->postStartupTiming(STARTUP_PHASE_FIND_STREAM_INFO);
 
         // 判断是否实时流，判断是否需要设置无限缓冲区
         mPlayerState->real_time = isRealTime(mFormatCtx);
@@ -615,16 +1031,34 @@ int MediaPlayer::demux() {
             // 加锁
             mPlayerState->mutex.lock();
             // 视频时间定位
+            mPlayerState->beginInterruptPhase(INTERRUPT_PHASE_SEEK);
             ret = avformat_seek_file(mFormatCtx, -1, INT64_MIN, timestamp, INT64_MAX, 0);
+            mPlayerState->endInterruptPhase();
             mPlayerState->mutex.unlock();
             if (ret < 0) {
                 LOGW("MediaPlayer->%s: could not seek to position %0.3f", mPlayerState->url, (double) timestamp / AV_TIME_BASE);
+                // 定位超时说明连接已不可用，作为解封装失败处理
+                if (mPlayerState->timeout_phase != INTERRUPT_PHASE_NONE) {
+                    ret = AVERROR(ETIMEDOUT);
+                    break;
+                }
             }
         }
 
     } while (false);
     mMutex.unlock();
 
+    // 缓存的探测结果已经失效，恢复解复用参数后重新打开
+    if (retry) {
+        avformat_close_input(&mFormatCtx);
+        av_dict_free(&mPlayerState->format_opts);
+        av_dict_copy(&mPlayerState->format_opts, mFormatOpts, 0);
+        if (scan_all_pmts_set) {
+            av_dict_set(&mPlayerState->format_opts, "scan_all_pmts", NULL, AV_DICT_MATCH_CASE);
+        }
+        return demux();
+    }
+
     /*返回结果*/
     return ret;
 }
@@ -673,10 +1107,27 @@ int MediaPlayer::prepareDecoder() {
         return ret;
     }
 
+    // 软重置保留下来的解码器，新的媒体中没有对应的流时直接销毁
+    if (audioIndex < 0 && mAudioDecoder) {
+        if (mAudioResampler) {
+            mAudioResampler->setAudioDecoder(NULL);
+        }
+        delete mAudioDecoder;
+        mAudioDecoder = NULL;
+    }
+    if (videoIndex < 0 && mVideoDecoder) {
+        delete mVideoDecoder;
+        mVideoDecoder = NULL;
+    }
+
     /* 准备视频和音频的解码器 */
     if (audioIndex >= 0) {
         prepareDecoder(audioIndex);
     }
+    // 快速起播时，打开视频解码器的同时打开音频输出设备
+    if (mPlayerState->fast_start && mAudioDecoder && !mDeviceThread) {
+        mDeviceThread = startStartupTask(mDeviceTask);
+    }
     if (videoIndex >= 0) {
         prepareDecoder(videoIndex);
     }
@@ -687,10 +1138,13 @@ int MediaPlayer::prepareDecoder() {
         ret = -1;
         return ret;
     }
+    // 没有选中的音轨不再读取
+    discardAudioStreams();
     // 准备解码器消息通知
     if (mPlayerState->message_queue) {
         mPlayerState->message_queue->postMessage(MSG_PREPARE_DECODER);
     }
+    mPlayerState->postStartupTiming(STARTUP_PHASE_PREPARE_DECODER);
 
     mMutex.unlock();
     return ret;
@@ -747,9 +1201,13 @@ int MediaPlayer::openMediaDevice() {
     // 打开音频输出设备
     if (mAudioDecoder != NULL) {
         LOGD("MediaPlayer->打开音频设备");
-        AVCodecContext *avctx = mAudioDecoder->getCodecContext(); // 解码上下文
-        // 打开音频设备
-        ret = openAudioDevice(avctx->channel_layout, avctx->channels, avctx->sample_rate);
+        if (mDeviceThread) {
+            // 快速起播时已经在辅助线程中打开，等待打开完成
+            waitStartupTask(&mDeviceThread);
+        } else {
+            openAudioOutput();
+        }
+        ret = mAudioDeviceRet;
         if (ret < 0) {
             LOGW("MediaPlayer->could not open audio device");
             // 如果音频设备打开失败，则调整时钟的同步类型
@@ -776,6 +1234,10 @@ int MediaPlayer::openMediaDevice() {
             mVideoDecoder->setMasterClock(mMediaSync->getExternalClock());
         }
     }
+    mPlayerState->postStartupTiming(STARTUP_PHASE_OPEN_DEVICE);
+
+    // 渲染上下文预热完成后才开始渲染，避免两个线程同时关联同一个上下文
+    waitStartupTask(&mPrewarmThread);
 
     /*开始视频的同步播放*/
     mMediaSync->start(mVideoDecoder, mAudioDecoder);
@@ -786,10 +1248,12 @@ int MediaPlayer::openMediaDevice() {
         if (mPlayerState->message_queue) {
             mPlayerState->message_queue->postMessage(MSG_REQUEST_START);
         }
-        // 循环等待开始
+        // 等待开始，start/resume/stop 会唤醒
+        mMutex.lock();
         while ((!mPlayerState->abort_request) && mPlayerState->pause_request) {
-            av_usleep(10 * 1000);
+            mCondition.wait(mMutex);
         }
+        mMutex.unlock();
     }
 
     if (mPlayerState->message_queue) {
@@ -800,33 +1264,109 @@ int MediaPlayer::openMediaDevice() {
 }
 
 /**
- * 读取av数据
- * @return
+ * 预加载数据包
  */
-int MediaPlayer::readAVPackets() {
-    // 读数据包流程
-    mEOF = 0;
-    int ret = 0;
+void MediaPlayer::preloadAVPackets() {
     AVPacket pkt1, *pkt = &pkt1;
-    int64_t stream_start_time;
-    int playInRange = 0;
-    int64_t pkt_ts;
-    int waitToSeek = 0;
+    int keyFrames = 0;
+    bool gopFinished = false;
+
+    // 封面只有一个数据包，不需要等待下一个关键帧
+    if (mVideoDecoder && (mVideoDecoder->getStream()->disposition & AV_DISPOSITION_ATTACHED_PIC)) {
+        AVPacket copy;
+        if (av_packet_ref(&copy, &mVideoDecoder->getStream()->attached_pic) >= 0) {
+            mVideoDecoder->pushPacket(&copy);
+        }
+        mAttachmentRequest = 0;
+        gopFinished = true;
+    }
 
-//    int frame_index = 0;//统计帧数
-//
-    /* 循环读取数据包压入队列，以供播放音视频 */
-    for (;;) {
+    while (!mPlayerState->abort_request && mPreloadRequest && !gopFinished) {
+        // 超过预加载的缓冲大小
+        int64_t size = (mAudioDecoder ? mAudioDecoder->getMemorySize() : 0) + (mVideoDecoder ? mVideoDecoder->getMemorySize() : 0);
+        if (size >= mPreloadBufferSize) {
+            break;
+        }
 
-        // 退出播放器
-        if (mPlayerState->abort_request) {
+        mPlayerState->beginInterruptPhase(INTERRUPT_PHASE_READ);
+        int ret = av_read_frame(mFormatCtx, pkt);
+        mPlayerState->endInterruptPhase();
+        // 出错或者读到结尾，留给 readAVPackets 处理
+        if (ret < 0) {
             break;
         }
 
-        // 是否暂停网络流
-        if (mPlayerState->pause_request != mLastPaused) {
-            mLastPaused = mPlayerState->pause_request;
-            if (mPlayerState->pause_request) { // 暂停
+        int64_t pkt_ts = pkt->pts == AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
+        if (pkt_ts != AV_NOPTS_VALUE) {
+            mLastReadPos = av_rescale_q(pkt_ts, mFormatCtx->streams[pkt->stream_index]->time_base, AV_TIME_BASE_Q);
+        }
+
+        if (mVideoDecoder && pkt->stream_index == mVideoDecoder->getStreamIndex()) {
+            // 读到第二个关键帧，说明第一个 GOP 已经完整
+            if ((pkt->flags & AV_PKT_FLAG_KEY) && ++keyFrames > 1) {
+                gopFinished = true;
+            }
+            mVideoDecoder->pushPacket(pkt);
+        } else if (mAudioDecoder && pkt->stream_index == mAudioDecoder->getStreamIndex()) {
+            mAudioDecoder->pushPacket(pkt);
+            // 纯音频缓冲足够的数据包即可
+            if (!mVideoDecoder && mAudioDecoder->hasEnoughPackets()) {
+                gopFinished = true;
+            }
+        } else {
+            av_packet_unref(pkt);
+        }
+    }
+
+    // 等待被取用，解码线程在帧队列满或者没有数据包时也会阻塞，空闲时不占用 CPU
+    mMutex.lock();
+    mPreloadFinished = true;
+    LOGD("MediaPlayer->preload finished[%s]", mPlayerState->url);
+    while (!mPlayerState->abort_request && mPreloadRequest) {
+        mCondition.wait(mMutex);
+    }
+    mMutex.unlock();
+}
+
+/**
+ * 读取av数据
+ * @return
+ */
+int MediaPlayer::readAVPackets() {
+    // 读数据包流程
+    mEOF = 0;
+    int ret = 0;
+    AVPacket pkt1, *pkt = &pkt1;
+    int64_t stream_start_time;
+    int playInRange = 0;
+    int64_t pkt_ts;
+    int waitToSeek = 0;
+
+    initTimeline();
+
+//    int frame_index = 0;//统计帧数
+//
+    /* 循环读取数据包压入队列，以供播放音视频 */
+    for (;;) {
+
+        // 退出播放器
+        if (mPlayerState->abort_request) {
+            break;
+        }
+
+        // 播放列表切换到下一个条目
+        updatePlayingItem();
+
+        // 切换音轨
+        updateAudioTrack();
+
+        // 打开或者移除混音音轨
+        updateMixTracks();
+
+        // 是否暂停网络流
+        if (mPlayerState->pause_request != mLastPaused) {
+            mLastPaused = mPlayerState->pause_request;
+            if (mPlayerState->pause_request) { // 暂停
                 av_read_pause(mFormatCtx);
             } else {
                 av_read_play(mFormatCtx);
@@ -849,9 +1389,14 @@ int MediaPlayer::readAVPackets() {
                     mPlayerState->seek_rel > 0 ? seek_target - mPlayerState->seek_rel + 2 : INT64_MIN;
             int64_t seek_max =
                     mPlayerState->seek_rel < 0 ? seek_target - mPlayerState->seek_rel - 2 : INT64_MAX;
+            // 播放列表回到正在播放的条目
+            rewindTimeline();
+            // 定位后新旧音轨的数据都要丢弃，正在切换的音轨在定位后重新打开
+            cancelAudioSwitch(true);
             // 定位
             mPlayerState->mutex.lock();
             // avformat_seek_file定位
+            mPlayerState->beginInterruptPhase(INTERRUPT_PHASE_SEEK);
             ret = avformat_seek_file(
                     mFormatCtx,
                     -1,
@@ -860,7 +1405,14 @@ int MediaPlayer::readAVPackets() {
                     seek_max,
                     mPlayerState->seek_flags
             );
+            mPlayerState->endInterruptPhase();
             mPlayerState->mutex.unlock();
+            // 定位超时说明连接已不可用，重连并定位到目标位置
+            int reconnectFailed = 0;
+            if (ret < 0 && mPlayerState->timeout_phase != INTERRUPT_PHASE_NONE) {
+                ret = reconnect(seek_target);
+                reconnectFailed = ret < 0;
+            }
             if (ret < 0) {
                 LOGE("MediaPlayer->%s: error while seeking", mPlayerState->url);
             } else {
@@ -871,10 +1423,22 @@ int MediaPlayer::readAVPackets() {
                 if (mVideoDecoder) {
                     mVideoDecoder->flush();
                 }
+                for (size_t i = 0; i < mMixDecoders.size(); i++) {
+                    mMixDecoders[i]->flush();
+                }
+                if (mAudioResampler) {
+                    mAudioResampler->getAudioMixer()->flush();
+                }
+
+                mAudioEnd = AV_NOPTS_VALUE;
+                mVideoEnd = AV_NOPTS_VALUE;
 
-                // 更新外部时钟值
+                // 更新外部时钟值，播放列表中换算到时间轴上
                 if (mPlayerState->seek_flags & AVSEEK_FLAG_BYTE) {
                     mMediaSync->updateExternalClock(NAN);
+                } else if (!mTimeline.empty()) {
+                    const SpliceItem &playing = mTimeline.front();
+                    mMediaSync->updateExternalClock((seek_target - playing.startTime + playing.offset) / (double) AV_TIME_BASE);
                 } else {
                     mMediaSync->updateExternalClock(seek_target / (double) AV_TIME_BASE);
                 }
@@ -883,6 +1447,7 @@ int MediaPlayer::readAVPackets() {
             }
 
             mAttachmentRequest = 1;
+            mPlayerState->seek_serial++;
             mPlayerState->seek_request = 0;
             mCondition.signal();
             mEOF = 0;
@@ -894,6 +1459,10 @@ int MediaPlayer::readAVPackets() {
                         ret
                 );
             }
+            // 定位超时并且重连失败，退出读取
+            if (reconnectFailed) {
+                break;
+            }
         }
 
         // 取得封面数据包
@@ -911,12 +1480,20 @@ int MediaPlayer::readAVPackets() {
             mAttachmentRequest = 0;
         }
 
+        // 数据包队列的上限由进程内存预算按码率分配
+        int64_t maxQueueSize = MemoryBudget::getInstance()->getPacketQueueLimit(mFormatCtx->bit_rate);
+
         /* 暂停会在这里循环 */
         // 如果队列中存在足够的数据包，则等待消耗
         // 备注：这里要等待一定时长的缓冲队列，要不然会导致 OpenSLES 播放音频出现卡顿等现象
         // 暂停的时候，也会一直执行里面的 continue，因为队列满了但没消耗
+        int64_t queueSize = (mAudioDecoder ? mAudioDecoder->getMemorySize() : 0) + (mVideoDecoder ? mVideoDecoder->getMemorySize() : 0)
+                            + (mNextAudioDecoder ? mNextAudioDecoder->getMemorySize() : 0);
+        for (size_t i = 0; i < mMixDecoders.size(); i++) {
+            queueSize += mMixDecoders[i]->getMemorySize();
+        }
         if (mPlayerState->infinite_buffer < 1 &&
-            ((mAudioDecoder ? mAudioDecoder->getMemorySize() : 0) + (mVideoDecoder ? mVideoDecoder->getMemorySize() : 0) > MAX_QUEUE_SIZE
+            (queueSize > maxQueueSize
              || (!mAudioDecoder || mAudioDecoder->hasEnoughPackets()) && (!mVideoDecoder || mVideoDecoder->hasEnoughPackets()))) {
             // 当播放器执行暂停的时候，也会不断执行这里，
             // 因为暂停的时候音视频就会停止消耗数据，然后音视频队列就会超过最大值从而等待
@@ -926,7 +1503,12 @@ int MediaPlayer::readAVPackets() {
 
         /* 读取数据包 */
         if (!waitToSeek) { // 没有等待定位
+            // 暂停时网络流可能长时间没有数据，此时不做读取超时检测
+            // 之前的超时已经处理过(重连成功或者预加载时读取超时)，只检测这一次读取
+            mPlayerState->timeout_phase = INTERRUPT_PHASE_NONE;
+            mPlayerState->beginInterruptPhase(mPlayerState->pause_request ? INTERRUPT_PHASE_NONE : INTERRUPT_PHASE_READ);
             ret = av_read_frame(mFormatCtx, pkt); //返回0即为OK，小于0就是出错了或者读到了文件的结尾
+            mPlayerState->endInterruptPhase();
         } else {
             ret = -1;
         }
@@ -934,19 +1516,45 @@ int MediaPlayer::readAVPackets() {
         /* 出错或者文件读完了 */
         // 获取读文件的返回值ret，成功ret等于0，否则为负数
         if (ret < 0) {
+            // 网络中断或者读取超时，尝试原地重连，从最后播放的位置继续
+            if (!mPlayerState->abort_request && (mPlayerState->timeout_phase != INTERRUPT_PHASE_NONE
+                                                 || (mFormatCtx->pb && mFormatCtx->pb->error))) {
+                double clock = mMediaSync->getMasterClock();
+                // 主时钟是时间轴上的位置，拼接过条目时使用最后读取的位置
+                bool spliced = mTimeline.size() > 1 || (!mTimeline.empty() && mTimeline.front().offset != mTimeline.front().startTime);
+                int64_t position = isnan(clock) || spliced ? mLastReadPos : (int64_t) (clock * AV_TIME_BASE);
+                if (reconnect(position) == 0) {
+                    continue;
+                }
+            }
+            // 读取超时，直接退出
+            if (mPlayerState->timeout_phase != INTERRUPT_PHASE_NONE) {
+                ret = AVERROR(ETIMEDOUT);
+                break;
+            }
+            // 播放列表还有下一个条目或者循环播放时，直接拼接到时间轴上继续读取，不等待缓冲的数据播放完
+            if ((ret == AVERROR_EOF || avio_feof(mFormatCtx->pb) || waitToSeek) && !mEOF && spliceNextItem() == 0) {
+                waitToSeek = 0;
+                discardAudioStreams();
+                continue;
+            }
+            // 读取出错，则直接退出，退出for循环，出错时 avio_feof 同样为真，需要在通知播放完成之前判断
+            if (mFormatCtx->pb && mFormatCtx->pb->error) {
+                ret = -1;
+                break;
+            }
             // 如果没能读出数据包，判断是否是结尾
             if ((ret == AVERROR_EOF || avio_feof(mFormatCtx->pb)) && !mEOF) {
+                // 视频解码器和滤镜中缓存的最后几帧需要送入结束标志才能取出
+                if (mVideoDecoder) {
+                    mVideoDecoder->pushNullPacket();
+                }
                 // 通知播放完成
                 if (mPlayerState->message_queue) {
                     mPlayerState->message_queue->postMessage(MSG_COMPLETED);
                 }
                 mEOF = 1;
             }
-            // 读取出错，则直接退出，退出for循环
-            if (mFormatCtx->pb && mFormatCtx->pb->error) {
-                ret = -1;
-                break;
-            }
 
             // 如果不处于暂停状态，并且队列中没有数据
             // 有几个情况：循环播放、自动退出、播放完毕
@@ -981,6 +1589,12 @@ int MediaPlayer::readAVPackets() {
                       (double) (mPlayerState->start_time != AV_NOPTS_VALUE ? mPlayerState->start_time : 0) / 1000000
                       <= ((double) mPlayerState->duration / 1000000);
 
+        // 记录最后读取的位置，重连时在主时钟无效的情况下使用
+        if (pkt_ts != AV_NOPTS_VALUE) {
+            mLastReadPos = av_rescale_q(pkt_ts, mFormatCtx->streams[pkt->stream_index]->time_base, AV_TIME_BASE_Q);
+            checkPreroll(mLastReadPos);
+        }
+
 //        mPlayerState->mutex.lock();
 //        if (mVideoRecorder != NULL && mOutputCtx != NULL) {
 //            if (mVideoRecorder->isRecording) {
@@ -1024,10 +1638,8 @@ int MediaPlayer::readAVPackets() {
 //        mPlayerState->mutex.unlock();
 //
         /* 将音频或者视频数据包压入队列 */
-        if (playInRange && mAudioDecoder && pkt->stream_index == mAudioDecoder->getStreamIndex()) {
-            mAudioDecoder->pushPacket(pkt);
-        } else if (playInRange && mVideoDecoder && pkt->stream_index == mVideoDecoder->getStreamIndex()) {
-            mVideoDecoder->pushPacket(pkt);
+        if (playInRange) {
+            pushTimelinePacket(pkt);
         } else {
             av_packet_unref(pkt);
         }
@@ -1039,6 +1651,9 @@ int MediaPlayer::readAVPackets() {
 
     LOGD("MediaPlayer->循环结束");
 
+    cancelAudioSwitch(false);
+    releaseMixTracks();
+
     if (mAudioDecoder) {
         mAudioDecoder->stop();
     }
@@ -1059,6 +1674,85 @@ int MediaPlayer::readAVPackets() {
 
 
 int MediaPlayer::prepareDecoder(int streamIndex) {
+    AVCodecContext *avctx = NULL; // 解码上下文
+    int ret = 0;
+
+    if (streamIndex < 0 || streamIndex >= mFormatCtx->nb_streams) {
+        return -1;
+    }
+
+    // 软重置保留下来的解码器参数兼容时，刷新后直接复用，不需要重新打开解码器
+    AVStream *stream = mFormatCtx->streams[streamIndex];
+    MediaDecoder *oldDecoder = NULL;
+    if (stream->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
+        oldDecoder = mAudioDecoder;
+    } else if (stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+        oldDecoder = mVideoDecoder;
+    }
+    if (oldDecoder) {
+        if (isDecoderReusable(oldDecoder, stream)) {
+            // 视频解码器复用时按新的解复用上下文推算帧率，先替换上下文
+            if (oldDecoder == mVideoDecoder) {
+                mVideoDecoder->setFormatContext(mFormatCtx);
+                mAttachmentRequest = 1;
+            }
+            oldDecoder->reuse(stream, streamIndex);
+            stream->discard = AVDISCARD_DEFAULT;
+            LOGD("MediaPlayer->reuse decoder %s for stream %d", avcodec_get_name(stream->codecpar->codec_id), streamIndex);
+            return 0;
+        }
+        // 参数不兼容，销毁后重新创建
+        if (oldDecoder == mAudioDecoder) {
+            if (mAudioResampler) {
+                mAudioResampler->setAudioDecoder(NULL);
+            }
+            mAudioDecoder = NULL;
+        } else {
+            mVideoDecoder = NULL;
+        }
+        delete oldDecoder;
+    }
+
+    ret = openCodecContext(streamIndex, &avctx);
+
+    // 准备失败，通知出错
+    if (ret < 0) {
+        if (mPlayerState->message_queue) {
+            const char errorMsg[] = "failed to open stream!";
+            mPlayerState->message_queue->postMessage(MSG_ERROR, 0, 0, (void *) errorMsg, sizeof(errorMsg) / errorMsg[0]);
+        }
+        return ret;
+    }
+
+    // 根据解码器类型创建解码器
+    mFormatCtx->streams[streamIndex]->discard = AVDISCARD_DEFAULT; // 抛弃无用的数据比如像0大小的packet
+
+    /*根据解码器类型，创建对应的解码器*/
+    switch (avctx->codec_type) {
+        case AVMEDIA_TYPE_AUDIO: {
+            if (mAudioDecoder == NULL) {
+                mAudioDecoder = new AudioDecoder(avctx, mFormatCtx->streams[streamIndex], streamIndex, mPlayerState);
+            }
+            // 如果已经有解码器了，就重置解码器的参数
+            break;
+        }
+
+        case AVMEDIA_TYPE_VIDEO: {
+            if (mVideoDecoder == NULL) {
+                mVideoDecoder = new VideoDecoder(mFormatCtx, avctx, mFormatCtx->streams[streamIndex], streamIndex, mPlayerState);
+            }
+            mAttachmentRequest = 1;
+            break;
+        }
+
+        default: {
+            break;
+        }
+    }
+    return ret;
+}
+
+int MediaPlayer::openCodecContext(int streamIndex, AVCodecContext **avctxOut) {
     AVCodecContext *avctx; // 解码上下文
     AVCodec *codec = NULL; // 解码器
     AVDictionary *opts = NULL; // 参数字典
@@ -1066,10 +1760,6 @@ int MediaPlayer::prepareDecoder(int streamIndex) {
     int ret = 0;
     const char *forcedCodecName = NULL;
 
-    if (streamIndex < 0 || streamIndex >= mFormatCtx->nb_streams) {
-        return -1;
-    }
-
     /* 创建解码上下文 */
     avctx = avcodec_alloc_context3(NULL);
     if (!avctx) {
@@ -1179,6 +1869,11 @@ int MediaPlayer::prepareDecoder(int streamIndex) {
             av_dict_set(&opts, "refcounted_frames", "1", 0);
         }
 
+        // 视频帧从共享的缓冲池分配，跳转和切换播放源之后继续复用
+        if (mPlayerState->frame_pool) {
+            FrameBufferPool::getInstance()->attach(avctx, codec);
+        }
+
         /*打开解码器*/
         if ((ret = avcodec_open2(avctx, codec, &opts)) < 0) {
             break;
@@ -1188,45 +1883,978 @@ int MediaPlayer::prepareDecoder(int streamIndex) {
             ret = AVERROR_OPTION_NOT_FOUND;
             break;
         }
+    } while (false);
+
+    // 失败了就要释放解码上下文
+    if (ret < 0) {
+        avcodec_free_context(&avctx);
+    }
+    // 释放参数
+    av_dict_free(&opts);
+    *avctxOut = avctx;
+    return ret;
+}
 
-        // 根据解码器类型创建解码器
-        mFormatCtx->streams[streamIndex]->discard = AVDISCARD_DEFAULT; // 抛弃无用的数据比如像0大小的packet
+void MediaPlayer::initTimeline() {
+    if (!mTimeline.empty() || !mFormatCtx) {
+        return;
+    }
+    SpliceItem item;
+    item.item.url = mPlayerState->url;
+    item.item.offset = mPlayerState->offset;
+    if (mPlayerState->headers) {
+        item.item.headers = mPlayerState->headers;
+    }
+    item.formatCtx = mFormatCtx;
+    item.audioIndex = mAudioDecoder ? mAudioDecoder->getStreamIndex() : -1;
+    item.videoIndex = mVideoDecoder ? mVideoDecoder->getStreamIndex() : -1;
+    // 第一个条目的数据包不需要换算
+    item.startTime = mFormatCtx->start_time != AV_NOPTS_VALUE && mFormatCtx->start_time > 0 ? mFormatCtx->start_time : 0;
+    item.offset = item.startTime;
+    item.splicePoint = item.startTime;
+    item.duration = mDuration;
+    item.index = 0;
+    item.looped = false;
 
-        /*根据解码器类型，创建对应的解码器*/
-        switch (avctx->codec_type) {
-            case AVMEDIA_TYPE_AUDIO: {
-                if (mAudioDecoder == NULL) {
-                    mAudioDecoder = new AudioDecoder(avctx, mFormatCtx->streams[streamIndex], streamIndex, mPlayerState);
-                }
-                // 如果已经有解码器了，就重置解码器的参数
+    mMutex.lock();
+    mTimeline.push_back(item);
+    mTimelineCtx = mFormatCtx;
+    mTimelineOrigin = item.offset;
+    mMutex.unlock();
+    mPlaylistIndex = 0;
+    mPrerollStarted = false;
+    mAudioEnd = AV_NOPTS_VALUE;
+    mVideoEnd = AV_NOPTS_VALUE;
+}
+
+void MediaPlayer::checkPreroll(int64_t readPos) {
+    if (mPrerollStarted || mTimeline.empty()) {
+        return;
+    }
+    // 时长未知时，读取结束后再打开下一个条目
+    const SpliceItem &current = mTimeline.back();
+    if (current.duration < 0) {
+        return;
+    }
+    if (readPos - current.startTime < current.duration * 1000 - mPlayerState->preroll_lead_time) {
+        return;
+    }
+    startPreroll();
+}
+
+void MediaPlayer::startPreroll() {
+    mPlaylistMutex.lock();
+    if (mPlaylist.empty()) {
+        mPlaylistMutex.unlock();
+        return;
+    }
+    mNextItem = mPlaylist.front();
+    mPlaylist.pop_front();
+    mPlaylistMutex.unlock();
+
+    mPrerollStarted = true;
+    mNextFormatCtx = NULL;
+    // 不能与正在读取的条目共用中断回调参数
+    mPrerollInterrupt = mFormatCtx && mFormatCtx->interrupt_callback.opaque == &mPrerollInterrupts[0]
+                        ? &mPrerollInterrupts[1] : &mPrerollInterrupts[0];
+    mPrerollThread = startStartupTask(mPrerollTask);
+}
+
+void MediaPlayer::prerollNextItem() {
+    int64_t start = av_gettime_relative();
+    AVFormatContext *ic = NULL;
+    if (openPlaylistItem(mNextItem, &ic) < 0) {
+        LOGW("MediaPlayer->preroll %s failed", mNextItem.url.c_str());
+        ic = NULL;
+    } else {
+        LOGD("MediaPlayer->preroll %s in %lld ms", mNextItem.url.c_str(), (long long) ((av_gettime_relative() - start) / 1000));
+    }
+    mNextFormatCtx = ic;
+}
+
+int MediaPlayer::openPlaylistItem(const PlaylistItem &item, AVFormatContext **ic) {
+    int ret;
+    AVFormatContext *ctx = avformat_alloc_context();
+    if (!ctx) {
+        return AVERROR(ENOMEM);
+    }
+    // 打开和查找媒体流信息的总时长不超过首个条目两个阶段的超时之和，服务器无响应时不会一直等待
+    PrerollInterrupt *interrupt = mPrerollInterrupt;
+    int64_t timeout = mPlayerState->open_timeout > 0 && mPlayerState->probe_timeout > 0
+                      ? mPlayerState->open_timeout + mPlayerState->probe_timeout : 0;
+    interrupt->deadline = timeout > 0 ? av_gettime_relative() + timeout : INT64_MAX;
+    ctx->interrupt_callback.callback = preroll_interrupt_cb;
+    ctx->interrupt_callback.opaque = interrupt;
+    if (item.offset > 0) {
+        ctx->skip_initial_bytes = item.offset;
+    }
+
+    // 使用第一个条目的解复用参数，文件头信息按条目设置
+    AVDictionary *opts = NULL;
+    av_dict_copy(&opts, mFormatOpts, 0);
+    av_dict_set(&opts, "headers", item.headers.empty() ? NULL : item.headers.c_str(), 0);
+    AVInputFormat *inputFormat = mPlayerState->input_format;
+    if (!inputFormat && mPlayerState->probe_cache) {
+        inputFormat = ProbeCache::getInstance()->findInputFormat(item.url.c_str());
+    }
+    ret = avformat_open_input(&ctx, item.url.c_str(), inputFormat, &opts);
+    av_dict_free(&opts);
+    if (ret < 0) {
+        // 打开失败时 ctx 已经被释放
+        printError(item.url.c_str(), ret);
+        if (av_gettime_relative() >= interrupt->deadline) {
+            LOGW("MediaPlayer->open %s timed out", item.url.c_str());
+        }
+        interrupt->deadline = 0;
+        return ret;
+    }
+    if (mPlayerState->genpts) {
+        ctx->flags |= AVFMT_FLAG_GENPTS;
+    }
+    av_format_inject_global_side_data(ctx);
+
+    int nbStreams = ctx->nb_streams;
+    AVDictionary **streamOpts = setupStreamInfoOptions(ctx, mPlayerState->codec_opts);
+    ret = avformat_find_stream_info(ctx, streamOpts);
+    if (streamOpts != NULL) {
+        for (int i = 0; i < nbStreams; i++) {
+            av_dict_free(&streamOpts[i]);
+        }
+        av_freep(&streamOpts);
+    }
+    if (ret < 0) {
+        LOGW("MediaPlayer->%s: could not find codec parameters", item.url.c_str());
+        if (av_gettime_relative() >= interrupt->deadline) {
+            LOGW("MediaPlayer->find stream info of %s timed out", item.url.c_str());
+        }
+        interrupt->deadline = 0;
+        avformat_close_input(&ctx);
+        return ret;
+    }
+    if (ctx->pb) {
+        ctx->pb->eof_reached = 0;
+    }
+    interrupt->deadline = 0;
+    *ic = ctx;
+    return 0;
+}
+
+bool MediaPlayer::isSpliceCompatible(AVFormatContext *ic, int *audioIndex, int *videoIndex) {
+    MediaDecoder *decoders[] = {mAudioDecoder, mVideoDecoder};
+    enum AVMediaType types[] = {AVMEDIA_TYPE_AUDIO, AVMEDIA_TYPE_VIDEO};
+    int *indexes[] = {audioIndex, videoIndex};
+    for (int i = 0; i < FF_ARRAY_ELEMS(decoders); i++) {
+        *indexes[i] = -1;
+        if (!decoders[i]) {
+            continue;
+        }
+        int index = av_find_best_stream(ic, types[i], -1, -1, NULL, 0);
+        if (index < 0) {
+            return false;
+        }
+        AVCodecContext *avctx = decoders[i]->getCodecContext();
+        AVCodecParameters *codecpar = ic->streams[index]->codecpar;
+        if (codecpar->codec_id != avctx->codec_id) {
+            return false;
+        }
+        // 码流格式需要一致，比如 H.264 的 avcC 和 Annex B 不能混用，分辨率和采样参数变化由解码器和重采样器处理
+        bool hasOldExtradata = avctx->extradata && avctx->extradata_size > 0;
+        bool hasNewExtradata = codecpar->extradata && codecpar->extradata_size > 0;
+        if (hasOldExtradata != hasNewExtradata) {
+            return false;
+        }
+        if (types[i] == AVMEDIA_TYPE_VIDEO && hasNewExtradata && avctx->extradata[0] != codecpar->extradata[0]) {
+            return false;
+        }
+        *indexes[i] = index;
+    }
+    return *audioIndex >= 0 || *videoIndex >= 0;
+}
+
+int MediaPlayer::spliceNextItem() {
+    if (mTimeline.empty()) {
+        return -1;
+    }
+    SpliceItem &current = mTimeline.back();
+    SpliceItem next;
+    next.formatCtx = NULL;
+
+    // 取出已经提前打开的下一个条目，读取结束时还没有开始打开的话现在打开并等待，打开失败或者不兼容的条目跳过
+    for (;;) {
+        if (!mPrerollThread && !mNextFormatCtx) {
+            startPreroll();
+            if (!mPrerollThread) {
                 break;
             }
+        }
+        waitStartupTask(&mPrerollThread);
+        if (mPlayerState->abort_request) {
+            return -1;
+        }
+        if (mNextFormatCtx && isSpliceCompatible(mNextFormatCtx, &next.audioIndex, &next.videoIndex)) {
+            next.item = mNextItem;
+            next.formatCtx = mNextFormatCtx;
+            mNextFormatCtx = NULL;
+            break;
+        }
+        if (mNextFormatCtx) {
+            LOGW("MediaPlayer->%s is not compatible with current decoders, skip it", mNextItem.url.c_str());
+            avformat_close_input(&mNextFormatCtx);
+        }
+    }
 
-            case AVMEDIA_TYPE_VIDEO: {
-                if (mVideoDecoder == NULL) {
-                    mVideoDecoder = new VideoDecoder(mFormatCtx, avctx, mFormatCtx->streams[streamIndex], streamIndex, mPlayerState);
-                }
-                mAttachmentRequest = 1;
-                break;
+    int64_t playStart = 0;
+    if (next.formatCtx) {
+        AVFormatContext *ic = next.formatCtx;
+        next.startTime = ic->start_time != AV_NOPTS_VALUE && ic->start_time > 0 ? ic->start_time : 0;
+        // 拼接点对齐音频第一个有效采样点，音频流的起始时间已经跳过编码器延迟，解码器按数据包的 skip samples 丢弃这些采样点
+        if (next.audioIndex >= 0) {
+            AVStream *audioStream = ic->streams[next.audioIndex];
+            if (audioStream->start_time != AV_NOPTS_VALUE && audioStream->start_time > 0) {
+                next.startTime = av_rescale_q(audioStream->start_time, audioStream->time_base, AV_TIME_BASE_Q);
+            }
+        }
+        next.duration = ic->duration != AV_NOPTS_VALUE ? av_rescale(ic->duration, 1000, AV_TIME_BASE) : -1;
+        next.index = ++mPlaylistIndex;
+        next.looped = false;
+        // 新的参数集随第一个数据包送给解码器
+        if (next.audioIndex >= 0) {
+            mAudioDecoder->setNewExtradata(ic->streams[next.audioIndex]->codecpar);
+        }
+        if (next.videoIndex >= 0) {
+            mVideoDecoder->setNewExtradata(ic->streams[next.videoIndex]->codecpar);
+        }
+    } else if (mPlayerState->loop && !mPlayerState->real_time) {
+        // 循环播放：当前条目从头重新拼接到时间轴上，解码器不清空
+        playStart = mPlayerState->start_time != AV_NOPTS_VALUE ? mPlayerState->start_time : 0;
+        mPlayerState->mutex.lock();
+        int ret = avformat_seek_file(mFormatCtx, -1, INT64_MIN, current.startTime + playStart, INT64_MAX, 0);
+        mPlayerState->mutex.unlock();
+        if (ret < 0) {
+            LOGE("MediaPlayer->%s: error while seeking to loop", mPlayerState->url);
+            return -1;
+        }
+        next = current;
+        next.looped = true;
+    } else {
+        return -1;
+    }
+
+    // 拼接点取音频的结束位置，保证音频采样连续，没有音频时取视频的结束位置
+    int64_t end = mAudioDecoder && mAudioEnd != AV_NOPTS_VALUE ? mAudioEnd : mVideoEnd;
+    if (end == AV_NOPTS_VALUE) {
+        end = current.splicePoint + (current.duration > 0 ? current.duration * 1000 : 0);
+    }
+    next.splicePoint = end;
+    next.offset = end - playStart;
+
+    mMutex.lock();
+    mTimeline.push_back(next);
+    mFormatCtx = next.formatCtx;
+    mMutex.unlock();
+    // 新的条目重新同步暂停状态，并重新开始提前打开下一个条目
+    mLastPaused = -1;
+    mPrerollStarted = false;
+    LOGD("MediaPlayer->splice %s at %0.3f", next.item.url.c_str(), (double) end / AV_TIME_BASE);
+    return 0;
+}
+
+void MediaPlayer::updatePlayingItem() {
+    if (mTimeline.size() < 2) {
+        return;
+    }
+    const SpliceItem &next = *(++mTimeline.begin());
+    double clock = mMediaSync->getMasterClock();
+    if (isnan(clock) || (int64_t) (clock * AV_TIME_BASE) < next.splicePoint) {
+        return;
+    }
+
+    mMutex.lock();
+    AVFormatContext *previous = mTimeline.front().formatCtx;
+    mTimeline.pop_front();
+    const SpliceItem &playing = mTimeline.front();
+    mDuration = playing.duration;
+    mPlayerState->video_duration = mDuration;
+    mPlayerState->timeline_offset = playing.offset - mTimelineOrigin;
+    mMutex.unlock();
+    closeSpliceContext(previous);
+
+    if (playing.looped || !mPlayerState->message_queue) {
+        return;
+    }
+    mPlayerState->message_queue->postMessage(MSG_PLAYLIST_ITEM_STARTED, playing.index);
+    if (playing.videoIndex >= 0) {
+        AVCodecParameters *codecpar = playing.formatCtx->streams[playing.videoIndex]->codecpar;
+        mPlayerState->message_queue->postMessage(MSG_VIDEO_SIZE_CHANGED, codecpar->width, codecpar->height);
+        mPlayerState->message_queue->postMessage(MSG_SAR_CHANGED, codecpar->sample_aspect_ratio.num, codecpar->sample_aspect_ratio.den);
+    }
+}
+
+void MediaPlayer::rewindTimeline() {
+    if (mTimeline.size() < 2) {
+        return;
+    }
+    // 已经拼接但还没有播放的条目，连同提前打开的条目一起按顺序放回播放列表
+    waitStartupTask(&mPrerollThread);
+    std::list<SpliceItem> pending;
+    mMutex.lock();
+    pending.splice(pending.begin(), mTimeline, ++mTimeline.begin(), mTimeline.end());
+    mFormatCtx = mTimeline.front().formatCtx;
+    mMutex.unlock();
+
+    std::list<PlaylistItem> requeue;
+    for (std::list<SpliceItem>::iterator it = pending.begin(); it != pending.end(); ++it) {
+        if (!it->looped) {
+            requeue.push_back(it->item);
+        }
+        closeSpliceContext(it->formatCtx);
+        // 同一个上下文可能被多个条目引用，关闭后其它条目不再关闭
+        for (std::list<SpliceItem>::iterator other = it; other != pending.end(); ++other) {
+            if (other != it && other->formatCtx == it->formatCtx) {
+                other->formatCtx = NULL;
+            }
+        }
+    }
+    if (mPrerollStarted) {
+        if (mNextFormatCtx) {
+            avformat_close_input(&mNextFormatCtx);
+        }
+        requeue.push_back(mNextItem);
+    }
+    mPlaylistMutex.lock();
+    mPlaylist.splice(mPlaylist.begin(), requeue);
+    mPlaylistMutex.unlock();
+
+    mPlaylistIndex = mTimeline.front().index;
+    mPrerollStarted = false;
+    mLastPaused = -1;
+}
+
+int MediaPlayer::pushTimelinePacket(AVPacket *pkt) {
+    if (mTimeline.empty()) {
+        av_packet_unref(pkt);
+        return 0;
+    }
+    const SpliceItem &current = mTimeline.back();
+    MediaDecoder *decoder = NULL;
+    int64_t *end = NULL;
+    if (mAudioDecoder && pkt->stream_index == current.audioIndex) {
+        decoder = mAudioDecoder;
+        end = &mAudioEnd;
+    } else if (mVideoDecoder && pkt->stream_index == current.videoIndex) {
+        decoder = mVideoDecoder;
+        end = &mVideoEnd;
+    } else if (mNextAudioDecoder && current.formatCtx == mTimelineCtx
+               && pkt->stream_index == mNextAudioDecoder->getStreamIndex()) {
+        // 切换中的音轨从当前读取的位置开始接收数据包，不计入拼接点
+        decoder = mNextAudioDecoder;
+    } else if (current.formatCtx == mTimelineCtx) {
+        // 混音音轨同样不计入拼接点
+        decoder = findMixDecoder(pkt->stream_index);
+    }
+    if (!decoder) {
+        av_packet_unref(pkt);
+        return 0;
+    }
+
+    // 编码器在结尾补齐的采样点，解码器按 skip samples 丢弃，不计入拼接点
+    int64_t discard = 0;
+    if (end == &mAudioEnd) {
+        int size = 0;
+        uint8_t *skip = av_packet_get_side_data(pkt, AV_PKT_DATA_SKIP_SAMPLES, &size);
+        int sampleRate = current.formatCtx->streams[pkt->stream_index]->codecpar->sample_rate;
+        if (skip && size >= 10 && sampleRate > 0) {
+            discard = av_rescale_q(AV_RL32(skip + 4), (AVRational) {1, sampleRate}, decoder->getStream()->time_base);
+        }
+    }
+
+    // 换算到第一个条目的媒体流时间基和时间轴上
+    AVRational tb = decoder->getStream()->time_base;
+    if (current.formatCtx != mTimelineCtx || current.offset != current.startTime) {
+        av_packet_rescale_ts(pkt, current.formatCtx->streams[pkt->stream_index]->time_base, tb);
+        int64_t shift = av_rescale_q(current.offset - current.startTime, AV_TIME_BASE_Q, tb);
+        if (pkt->pts != AV_NOPTS_VALUE) {
+            pkt->pts += shift;
+        }
+        if (pkt->dts != AV_NOPTS_VALUE) {
+            pkt->dts += shift;
+        }
+        pkt->stream_index = decoder->getStreamIndex();
+    }
+
+    // 记录送入解码器的数据结束位置，作为下一个条目的拼接点
+    int64_t ts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+    if (ts != AV_NOPTS_VALUE && end) {
+        int64_t duration = pkt->duration;
+        if (duration <= 0 && decoder == mVideoDecoder) {
+            AVRational frameRate = av_guess_frame_rate(mTimelineCtx, decoder->getStream(), NULL);
+            if (frameRate.num > 0 && frameRate.den > 0) {
+                duration = av_rescale_q(1, av_inv_q(frameRate), tb);
+            }
+        }
+        int64_t pktEnd = av_rescale_q(ts + FFMAX(duration - discard, 0), tb, AV_TIME_BASE_Q);
+        if (*end == AV_NOPTS_VALUE || pktEnd > *end) {
+            *end = pktEnd;
+        }
+    }
+    decoder->pushPacket(pkt);
+    return 1;
+}
+
+void MediaPlayer::releaseTimeline() {
+    waitStartupTask(&mPrerollThread);
+    if (mNextFormatCtx) {
+        avformat_close_input(&mNextFormatCtx);
+    }
+    mMutex.lock();
+    std::list<SpliceItem> items;
+    items.swap(mTimeline);
+    AVFormatContext *timelineCtx = mTimelineCtx;
+    mTimelineCtx = NULL;
+    mMutex.unlock();
+
+    // 同一个上下文可能被多个条目引用，mFormatCtx 由调用者关闭
+    std::vector<AVFormatContext *> contexts;
+    contexts.push_back(timelineCtx);
+    for (std::list<SpliceItem>::iterator it = items.begin(); it != items.end(); ++it) {
+        contexts.push_back(it->formatCtx);
+    }
+    for (size_t i = 0; i < contexts.size(); i++) {
+        AVFormatContext *ic = contexts[i];
+        if (!ic || ic == mFormatCtx || std::find(contexts.begin(), contexts.begin() + i, ic) != contexts.begin() + i) {
+            continue;
+        }
+        avformat_close_input(&ic);
+    }
+
+    clearPlaylist();
+    mPlaylistIndex = 0;
+    mPrerollStarted = false;
+    mAudioEnd = AV_NOPTS_VALUE;
+    mVideoEnd = AV_NOPTS_VALUE;
+    mPlayerState->timeline_offset = 0;
+}
+
+void MediaPlayer::closeSpliceContext(AVFormatContext *ic) {
+    if (!ic || ic == mTimelineCtx || ic == mFormatCtx) {
+        return;
+    }
+    for (std::list<SpliceItem>::iterator it = mTimeline.begin(); it != mTimeline.end(); ++it) {
+        if (it->formatCtx == ic) {
+            return;
+        }
+    }
+    avformat_close_input(&ic);
+}
+
+void MediaPlayer::openNextAudioDecoder() {
+    AVCodecContext *avctx = NULL;
+    AudioDecoder *decoder = NULL;
+    int streamIndex = mOpeningAudioIndex;
+    int ret = openCodecContext(streamIndex, &avctx);
+    if (ret >= 0) {
+        decoder = new AudioDecoder(avctx, mFormatCtx->streams[streamIndex], streamIndex, mPlayerState);
+    } else {
+        LOGW("MediaPlayer->failed to open audio stream %d: %d", streamIndex, ret);
+    }
+    mMutex.lock();
+    mOpenedAudioDecoder = decoder;
+    mAudioSwitchOpened = true;
+    mMutex.unlock();
+}
+
+void MediaPlayer::updateAudioTrack() {
+    // 音频回调已经接入新的音轨
+    if (mNextAudioDecoder && mAudioResampler && mAudioResampler->getAudioDecoder() == mNextAudioDecoder) {
+        finishAudioSwitch();
+    }
+
+    // 新音轨的解码器打开完成，开始接收数据包，等待音频回调接入
+    mMutex.lock();
+    bool opened = mAudioSwitchOpened;
+    mMutex.unlock();
+    if (mAudioSwitchThread && opened) {
+        waitStartupTask(&mAudioSwitchThread);
+        mMutex.lock();
+        AudioDecoder *decoder = mOpenedAudioDecoder;
+        mOpenedAudioDecoder = NULL;
+        mAudioSwitchOpened = false;
+        // 打开期间又选择了别的音轨时丢弃
+        bool wanted = decoder && mAudioSwitchIndex == mOpeningAudioIndex;
+        if (wanted || !decoder) {
+            mAudioSwitchIndex = -1;
+        }
+        if (wanted) {
+            mNextAudioDecoder = decoder;
+        }
+        mMutex.unlock();
+        if (wanted) {
+            decoder->start();
+            discardAudioStreams();
+            mAudioResampler->setNextAudioDecoder(decoder);
+            LOGD("MediaPlayer->switching audio track %d -> %d", mAudioDecoder->getStreamIndex(), decoder->getStreamIndex());
+        } else if (decoder) {
+            delete decoder;
+        }
+    }
+    if (mAudioSwitchThread) {
+        return;
+    }
+
+    mMutex.lock();
+    int index = mAudioSwitchIndex;
+    mMutex.unlock();
+    if (index < 0) {
+        return;
+    }
+    // 播放列表拼接了其它文件时，解码器的媒体流和正在读取的文件不对应，不支持切换
+    if (!mAudioDecoder || !mAudioResampler || mTimeline.size() > 1 || mFormatCtx != mTimelineCtx) {
+        LOGW("MediaPlayer->audio track switching is not supported now");
+        mMutex.lock();
+        if (mAudioSwitchIndex == index) {
+            mAudioSwitchIndex = -1;
+        }
+        mMutex.unlock();
+        return;
+    }
+    // 已经在切换到其它音轨时，先取消
+    if (mNextAudioDecoder && mNextAudioDecoder->getStreamIndex() != index) {
+        cancelAudioSwitch(true);
+    }
+    if ((mNextAudioDecoder && mNextAudioDecoder->getStreamIndex() == index)
+        || (!mNextAudioDecoder && mAudioDecoder->getStreamIndex() == index)) {
+        mMutex.lock();
+        if (mAudioSwitchIndex == index) {
+            mAudioSwitchIndex = -1;
+        }
+        mMutex.unlock();
+        return;
+    }
+    mOpeningAudioIndex = index;
+    mAudioSwitchThread = startStartupTask(mAudioSwitchTask);
+}
+
+void MediaPlayer::finishAudioSwitch() {
+    AudioDecoder *oldDecoder;
+    mMutex.lock();
+    oldDecoder = mAudioDecoder;
+    mAudioDecoder = mNextAudioDecoder;
+    mNextAudioDecoder = NULL;
+    mMutex.unlock();
+    if (mMediaSync) {
+        mMediaSync->setAudioDecoder(mAudioDecoder);
+    }
+    // 时间轴上当前文件的条目(循环播放)改用新的音频流
+    int streamIndex = mAudioDecoder->getStreamIndex();
+    for (std::list<SpliceItem>::iterator it = mTimeline.begin(); it != mTimeline.end(); ++it) {
+        if (it->formatCtx == mTimelineCtx) {
+            it->audioIndex = streamIndex;
+        }
+    }
+    oldDecoder->stop();
+    delete oldDecoder;
+    // 新的主音轨可能正在混音
+    mMutex.lock();
+    mMixTracksChanged = !mMixTracks.empty() || !mMixDecoders.empty();
+    mMutex.unlock();
+    discardAudioStreams();
+    LOGD("MediaPlayer->audio track switched to %d", streamIndex);
+    if (mPlayerState->message_queue) {
+        mPlayerState->message_queue->postMessage(MSG_AUDIO_TRACK_CHANGED, streamIndex);
+    }
+}
+
+void MediaPlayer::cancelAudioSwitch(bool keepRequest) {
+    // 等待正在打开的解码器，请求保留在 mAudioSwitchIndex 中
+    if (mAudioSwitchThread) {
+        waitStartupTask(&mAudioSwitchThread);
+        mMutex.lock();
+        AudioDecoder *decoder = mOpenedAudioDecoder;
+        mOpenedAudioDecoder = NULL;
+        mAudioSwitchOpened = false;
+        mMutex.unlock();
+        delete decoder;
+    }
+    if (mNextAudioDecoder) {
+        if (mAudioResampler) {
+            mAudioResampler->setNextAudioDecoder(NULL);
+        }
+        if (mAudioResampler && mAudioResampler->getAudioDecoder() == mNextAudioDecoder) {
+            // 音频回调已经接入
+            finishAudioSwitch();
+        } else {
+            AudioDecoder *decoder;
+            mMutex.lock();
+            decoder = mNextAudioDecoder;
+            mNextAudioDecoder = NULL;
+            if (keepRequest && mAudioSwitchIndex < 0) {
+                mAudioSwitchIndex = decoder->getStreamIndex();
             }
+            mMutex.unlock();
+            decoder->stop();
+            delete decoder;
+        }
+    }
+    if (!keepRequest) {
+        mMutex.lock();
+        mAudioSwitchIndex = -1;
+        mMutex.unlock();
+    }
+    discardAudioStreams();
+}
+
+void MediaPlayer::discardAudioStreams() {
+    if (!mFormatCtx) {
+        return;
+    }
+    // 正在读取的文件中对应音频解码器的媒体流
+    int current = -1;
+    int next = -1;
+    if (!mTimeline.empty()) {
+        if (mTimeline.back().formatCtx == mFormatCtx) {
+            current = mTimeline.back().audioIndex;
+        }
+    } else if (mAudioDecoder) {
+        current = mAudioDecoder->getStreamIndex();
+    }
+    if (mNextAudioDecoder && mFormatCtx == mTimelineCtx) {
+        next = mNextAudioDecoder->getStreamIndex();
+    }
+    for (int i = 0; i < mFormatCtx->nb_streams; i++) {
+        AVStream *stream = mFormatCtx->streams[i];
+        if (stream->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
+            bool mixing = mFormatCtx == mTimelineCtx && findMixDecoder(i) != NULL;
+            stream->discard = (i == current || i == next || mixing) ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+        }
+    }
+}
+
+void MediaPlayer::updateMixTracks() {
+    mMutex.lock();
+    bool changed = mMixTracksChanged;
+    std::map<int, float> request = mMixTracks;
+    mMutex.unlock();
+    // 混音音轨的媒体流属于第一个条目，播放列表拼接了其它文件时等回到第一个文件再处理
+    if (!changed || !mAudioDecoder || !mAudioResampler || mFormatCtx != mTimelineCtx) {
+        return;
+    }
+    mMutex.lock();
+    mMixTracksChanged = false;
+    mMutex.unlock();
+
+    AudioMixer *mixer = mAudioResampler->getAudioMixer();
+    int primary = mAudioDecoder->getStreamIndex();
+    int next = mNextAudioDecoder ? mNextAudioDecoder->getStreamIndex() : -1;
+    // 移除不再需要的音轨，成为主音轨的也移除
+    for (std::vector<AudioDecoder *>::iterator it = mMixDecoders.begin(); it != mMixDecoders.end();) {
+        AudioDecoder *decoder = *it;
+        std::map<int, float>::iterator r = request.find(decoder->getStreamIndex());
+        if (r == request.end() || r->first == primary || r->first == next) {
+            mixer->removeTrack(decoder);
+            delete decoder;
+            it = mMixDecoders.erase(it);
+        } else {
+            mixer->setTrackGain(decoder, r->second);
+            ++it;
+        }
+    }
+    // 打开新的音轨，从当前读取的位置开始混音
+    for (std::map<int, float>::iterator r = request.begin(); r != request.end(); ++r) {
+        int streamIndex = r->first;
+        if (streamIndex == primary || streamIndex == next || findMixDecoder(streamIndex)
+            || streamIndex >= mFormatCtx->nb_streams
+            || mFormatCtx->streams[streamIndex]->codecpar->codec_type != AVMEDIA_TYPE_AUDIO) {
+            continue;
+        }
+        AVCodecContext *avctx = NULL;
+        int ret = openCodecContext(streamIndex, &avctx);
+        if (ret < 0) {
+            LOGW("MediaPlayer->failed to open mix track %d: %d", streamIndex, ret);
+            continue;
+        }
+        AudioDecoder *decoder = new AudioDecoder(avctx, mFormatCtx->streams[streamIndex], streamIndex, mPlayerState);
+        decoder->start();
+        mMixDecoders.push_back(decoder);
+        mixer->addTrack(decoder, r->second);
+    }
+    discardAudioStreams();
+}
+
+void MediaPlayer::releaseMixTracks() {
+    for (size_t i = 0; i < mMixDecoders.size(); i++) {
+        if (mAudioResampler) {
+            mAudioResampler->getAudioMixer()->removeTrack(mMixDecoders[i]);
+        }
+        mMixDecoders[i]->stop();
+        delete mMixDecoders[i];
+    }
+    mMixDecoders.clear();
+    // 保留请求，重新播放时再打开
+    mMutex.lock();
+    mMixTracksChanged = !mMixTracks.empty();
+    mMutex.unlock();
+}
+
+AudioDecoder *MediaPlayer::findMixDecoder(int streamIndex) {
+    for (size_t i = 0; i < mMixDecoders.size(); i++) {
+        if (mMixDecoders[i]->getStreamIndex() == streamIndex) {
+            return mMixDecoders[i];
+        }
+    }
+    return NULL;
+}
+
+bool MediaPlayer::isNetworkStream() {
+    if (mPlayerState->real_time) {
+        return true;
+    }
+    const char *protocol = avio_find_protocol_name(mPlayerState->url);
+    return protocol && strcmp(protocol, "file") && strcmp(protocol, "pipe")
+           && strcmp(protocol, "fd") && strcmp(protocol, "data");
+}
 
-            default: {
+bool MediaPlayer::isDecoderReusable(MediaDecoder *decoder, AVStream *stream) {
+    AVCodecContext *avctx = decoder->getCodecContext();
+    AVCodecParameters *codecpar = stream->codecpar;
+    if (!avctx || avctx->codec_type != codecpar->codec_type || avctx->codec_id != codecpar->codec_id) {
+        return false;
+    }
+    if (codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+        if (avctx->width != codecpar->width || avctx->height != codecpar->height) {
+            return false;
+        }
+        if (codecpar->format >= 0 && avctx->pix_fmt != AV_PIX_FMT_NONE && codecpar->format != avctx->pix_fmt) {
+            return false;
+        }
+    } else {
+        if (avctx->sample_rate != codecpar->sample_rate || avctx->channels != codecpar->channels) {
+            return false;
+        }
+        if (codecpar->format >= 0 && avctx->sample_fmt != AV_SAMPLE_FMT_NONE && codecpar->format != avctx->sample_fmt) {
+            return false;
+        }
+    }
+    // 档次和级别决定解码器分配的参考帧等资源，两边都已知时需要一致
+    if (avctx->profile != FF_PROFILE_UNKNOWN && codecpar->profile != FF_PROFILE_UNKNOWN
+        && avctx->profile != codecpar->profile) {
+        return false;
+    }
+    if (avctx->level != FF_LEVEL_UNKNOWN && codecpar->level != FF_LEVEL_UNKNOWN && avctx->level != codecpar->level) {
+        return false;
+    }
+    // 解码器只在打开时解析 extradata，参数集和码流格式(比如 H.264 的 avcC 和 Annex B)都需要完全一致
+    int oldSize = avctx->extradata ? avctx->extradata_size : 0;
+    int newSize = codecpar->extradata ? codecpar->extradata_size : 0;
+    if (oldSize != newSize) {
+        return false;
+    }
+    return newSize == 0 || memcmp(avctx->extradata, codecpar->extradata, (size_t) newSize) == 0;
+}
+
+bool MediaPlayer::isSameStreamLayout(AVFormatContext *ic) {
+    if (!ic || ic->nb_streams != mFormatCtx->nb_streams) {
+        return false;
+    }
+    std::vector<MediaDecoder *> decoders(mMixDecoders.begin(), mMixDecoders.end());
+    decoders.push_back(mAudioDecoder);
+    decoders.push_back(mVideoDecoder);
+    for (size_t i = 0; i < decoders.size(); i++) {
+        if (!decoders[i]) {
+            continue;
+        }
+        int streamIndex = decoders[i]->getStreamIndex();
+        AVCodecParameters *oldpar = mFormatCtx->streams[streamIndex]->codecpar;
+        AVCodecParameters *newpar = ic->streams[streamIndex]->codecpar;
+        if (newpar->codec_type != oldpar->codec_type || newpar->codec_id != oldpar->codec_id) {
+            return false;
+        }
+        // 解码器的时间基沿用原来的媒体流
+        if (av_cmp_q(ic->streams[streamIndex]->time_base, mFormatCtx->streams[streamIndex]->time_base) != 0) {
+            return false;
+        }
+        if (newpar->codec_type == AVMEDIA_TYPE_VIDEO
+            && (newpar->width != oldpar->width || newpar->height != oldpar->height)) {
+            return false;
+        }
+        if (newpar->codec_type == AVMEDIA_TYPE_AUDIO
+            && (newpar->sample_rate != oldpar->sample_rate || newpar->channels != oldpar->channels)) {
+            return false;
+        }
+        if (newpar->extradata_size != oldpar->extradata_size
+            || (newpar->extradata_size > 0 && memcmp(newpar->extradata, oldpar->extradata, newpar->extradata_size))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int MediaPlayer::reconnect(int64_t position) {
+    int ret = -1;
+    if (mPlayerState->reconnect_count <= 0 || !isNetworkStream()) {
+        return ret;
+    }
+    // 解码器使用的是第一个条目的媒体流，播放列表后面的条目不支持原地重连
+    if (mTimelineCtx && mFormatCtx != mTimelineCtx) {
+        LOGW("MediaPlayer->%s: reconnect is not supported for playlist item", mPlayerState->url);
+        return ret;
+    }
+
+    // 重连后从新的位置读取，正在切换的音轨重新打开
+    cancelAudioSwitch(true);
+
+    // 对外通知缓冲开始
+    if (mPlayerState->message_queue) {
+        mPlayerState->message_queue->postMessage(MSG_BUFFERING_START);
+    }
+
+    int64_t delay = 0;
+    for (int i = 0; i < mPlayerState->reconnect_count && !mPlayerState->abort_request; i++) {
+        // 退避等待，第一次立即重连，退出播放时立即唤醒
+        if (delay > 0) {
+            int64_t deadline = av_gettime_relative() + delay;
+            mMutex.lock();
+            while (!mPlayerState->abort_request && av_gettime_relative() < deadline) {
+                mCondition.waitRelative(mMutex, (deadline - av_gettime_relative()) * 1000);
+            }
+            mMutex.unlock();
+            if (mPlayerState->abort_request) {
                 break;
             }
         }
-    } while (false);
+        delay = delay > 0 ? FFMIN(delay * 2, RECONNECT_DELAY_MAX) : RECONNECT_DELAY_MIN;
+        LOGW("MediaPlayer->reconnect %s, attempt %d", mPlayerState->url, i + 1);
 
-    // 准备失败，则需要释放创建的解码上下文
-    if (ret < 0) {
-        if (mPlayerState->message_queue) {
-            const char errorMsg[] = "failed to open stream!";
-            mPlayerState->message_queue->postMessage(MSG_ERROR, 0, 0, (void *) errorMsg, sizeof(errorMsg) / errorMsg[0]);
+        AVFormatContext *ic = avformat_alloc_context();
+        if (!ic) {
+            ret = AVERROR(ENOMEM);
+            break;
         }
-        // 失败了就要释放解码上下文
-        avcodec_free_context(&avctx);
+        ic->interrupt_callback = mFormatCtx->interrupt_callback;
+        if (mPlayerState->offset > 0) {
+            ic->skip_initial_bytes = mPlayerState->offset;
+        }
+
+        // 直接使用上一次探测到的封装格式，不再重新探测
+        AVDictionary *opts = NULL;
+        av_dict_copy(&opts, mFormatOpts, 0);
+        mPlayerState->beginInterruptPhase(INTERRUPT_PHASE_OPEN);
+        ret = avformat_open_input(&ic, mPlayerState->url, mFormatCtx->iformat, &opts);
+        mPlayerState->endInterruptPhase();
+        av_dict_free(&opts);
+        if (ret < 0) {
+            // 打开失败时 ic 已经被释放
+            printError(mPlayerState->url, ret);
+            continue;
+        }
+
+        if (mPlayerState->genpts) {
+            ic->flags |= AVFMT_FLAG_GENPTS;
+        }
+        av_format_inject_global_side_data(ic);
+
+        // 文件头已经给出相同数量的媒体流时，只需要补全参数用于比较，使用最小的探测参数查找媒体流信息
+        if (ic->nb_streams == mFormatCtx->nb_streams) {
+            ic->probesize = PROBE_CACHE_PROBESIZE;
+            ic->max_analyze_duration = PROBE_CACHE_ANALYZE_DURATION;
+        }
+        AVDictionary **streamOpts = setupStreamInfoOptions(ic, mPlayerState->codec_opts);
+        mPlayerState->beginInterruptPhase(INTERRUPT_PHASE_PROBE);
+        ret = avformat_find_stream_info(ic, streamOpts);
+        mPlayerState->endInterruptPhase();
+        if (streamOpts != NULL) {
+            for (int j = 0; j < ic->nb_streams; j++) {
+                av_dict_free(&streamOpts[j]);
+            }
+            av_freep(&streamOpts);
+        }
+        if (ret < 0) {
+            avformat_close_input(&ic);
+            continue;
+        }
+        // 查找媒体流信息之后参数才完整，媒体流已经变化时无法继续使用原来的解码器
+        if (!isSameStreamLayout(ic)) {
+            LOGE("MediaPlayer->%s: stream layout changed, give up reconnecting", mPlayerState->url);
+            avformat_close_input(&ic);
+            ret = -1;
+            break;
+        }
+
+        // 定位到最后播放的位置，实时流直接从最新的位置开始
+        if (position != AV_NOPTS_VALUE && !mPlayerState->real_time) {
+            mPlayerState->mutex.lock();
+            mPlayerState->beginInterruptPhase(INTERRUPT_PHASE_SEEK);
+            ret = avformat_seek_file(ic, -1, INT64_MIN, position, INT64_MAX, 0);
+            mPlayerState->endInterruptPhase();
+            mPlayerState->mutex.unlock();
+            if (ret < 0) {
+                LOGW("MediaPlayer->%s: could not seek to position %0.3f", mPlayerState->url, (double) position / AV_TIME_BASE);
+                avformat_close_input(&ic);
+                continue;
+            }
+        }
+
+        // 丢弃旧连接中缓冲的数据
+        if (mAudioDecoder) {
+            mAudioDecoder->flush();
+        }
+        if (mVideoDecoder) {
+            mVideoDecoder->flush();
+        }
+        for (size_t j = 0; j < mMixDecoders.size(); j++) {
+            mMixDecoders[j]->flush();
+        }
+
+        // 替换解复用上下文，解码线程只在解码器的锁内访问媒体流，
+        // setStream 返回后不会再使用旧的媒体流，之后才能关闭旧的上下文
+        AVFormatContext *oldCtx;
+        mMutex.lock();
+        if (mAudioDecoder) {
+            mAudioDecoder->setStream(ic->streams[mAudioDecoder->getStreamIndex()]);
+        }
+        if (mVideoDecoder) {
+            mVideoDecoder->setStream(ic->streams[mVideoDecoder->getStreamIndex()]);
+            mVideoDecoder->setFormatContext(ic);
+        }
+        for (size_t j = 0; j < mMixDecoders.size(); j++) {
+            mMixDecoders[j]->setStream(ic->streams[mMixDecoders[j]->getStreamIndex()]);
+        }
+        oldCtx = mFormatCtx;
+        mFormatCtx = ic;
+        // 时间轴上的条目(循环播放)同样替换成新的上下文
+        if (mTimelineCtx == oldCtx) {
+            mTimelineCtx = ic;
+        }
+        for (std::list<SpliceItem>::iterator it = mTimeline.begin(); it != mTimeline.end(); ++it) {
+            if (it->formatCtx == oldCtx) {
+                it->formatCtx = ic;
+            }
+        }
+        mMutex.unlock();
+        avformat_close_input(&oldCtx);
+        discardAudioStreams();
+
+        // 更新外部时钟和视频帧的计时器
+        if (position != AV_NOPTS_VALUE && !mPlayerState->real_time) {
+            mMediaSync->updateExternalClock(position / (double) AV_TIME_BASE);
+        } else {
+            mMediaSync->updateExternalClock(NAN);
+        }
+        mMediaSync->refreshVideoTimer();
+
+        mLastPaused = -1;
+        mEOF = 0;
+        mAttachmentRequest = 1;
+        // 重连成功后之前的超时不再上报
+        mPlayerState->timeout_phase = INTERRUPT_PHASE_NONE;
+        ret = 0;
+        LOGD("MediaPlayer->reconnect success[%s]", mPlayerState->url);
+        break;
+    }
+
+    // 对外通知缓冲结束
+    if (mPlayerState->message_queue) {
+        mPlayerState->message_queue->postMessage(MSG_BUFFERING_END);
     }
-    // 释放参数
-    av_dict_free(&opts);
     return ret;
 }
 
@@ -1315,6 +2943,8 @@ int MediaPlayer::openAudioDevice(int64_t wanted_channel_layout, int wanted_nb_ch
     // 初始化音频重采样器
     if (!mAudioResampler) {
         mAudioResampler = new AudioResampler(mPlayerState, mAudioDecoder, mMediaSync);
+    } else {
+        mAudioResampler->setAudioDecoder(mAudioDecoder);
     }
     // 设置需要重采样的参数
     mAudioResampler->setResampleParams(&spec, wanted_channel_layout);
@@ -1332,12 +2962,88 @@ void MediaPlayer::pcmQueueCallback(uint8_t *stream, int len) {
         memset(stream, 0, sizeof(len));
         return;
     }
-    mAudioResampler->pcmQueueCallback(stream, len);
+    mAudioResampler->pcmQueueCallback(stream, len, mAudioDevice->getCallbackTime());
+    // 第一帧音频已输出，暂停时输出的是静音数据
+    if (!mAudioRendered && !mPlayerState->pause_request && !mPlayerState->abort_request) {
+        mAudioRendered = true;
+        if (mPlayerState->message_queue) {
+            mPlayerState->message_queue->postMessage(MSG_AUDIO_RENDERING_START);
+        }
+        mPlayerState->postStartupTiming(STARTUP_PHASE_AUDIO_RENDERING);
+    }
     if (mPlayerState->message_queue && mPlayerState->sync_type != AV_SYNC_VIDEO) {
         mPlayerState->message_queue->postMessage(MSG_CURRENT_POSITION, getCurrentPosition(), mPlayerState->video_duration);
     }
 }
 
+void MediaPlayer::openAudioOutput() {
+    AVCodecContext *avctx = mAudioDecoder->getCodecContext(); // 解码上下文
+    // 软重置后音频参数没有变化时，复用已经打开的音频输出设备
+    if (mAudioDeviceRet > 0 && mAudioResampler
+        && mAudioChannelLayout == avctx->channel_layout
+        && mAudioChannels == avctx->channels
+        && mAudioSampleRate == avctx->sample_rate) {
+        mAudioResampler->setAudioDecoder(mAudioDecoder);
+        mAudioDevice->flush();
+        LOGD("MediaPlayer->reuse audio device");
+        return;
+    }
+    // 打开音频设备
+    mAudioDeviceRet = openAudioDevice(avctx->channel_layout, avctx->channels, avctx->sample_rate);
+    if (mAudioDeviceRet > 0) {
+        mAudioChannelLayout = avctx->channel_layout;
+        mAudioChannels = avctx->channels;
+        mAudioSampleRate = avctx->sample_rate;
+    }
+}
+
+void MediaPlayer::updateAudioDevice() {
+    bool shared = mPlayerState->shared_audio != 0;
+    if (mAudioDevice && shared == mSharedAudio) {
+        return;
+    }
+    if (mAudioDevice) {
+        mAudioDevice->stop();
+        delete mAudioDevice;
+    }
+    if (shared) {
+        mAudioDevice = new SharedAudioDevice();
+    } else {
+#if defined(__ANDROID__)
+        mAudioDevice = new SLESDevice();
+#else
+        mAudioDevice = new AudioDevice();
+#endif
+    }
+    mSharedAudio = shared;
+    // 新的设备需要重新打开
+    mAudioDeviceRet = -1;
+    LOGD("MediaPlayer->use %s audio device", shared ? "shared" : "exclusive");
+}
+
+void MediaPlayer::prewarmVideoDevice() {
+    // 读文件线程持有 mMutex 打开文件，这里只持有预热的锁
+    Mutex::Autolock lock(mPrewarmMutex);
+    if (mVideoDevice) {
+        mVideoDevice->prewarm();
+    }
+}
+
+Thread *MediaPlayer::startStartupTask(StartupTask *task) {
+    Thread *thread = new Thread(task);
+    thread->start();
+    return thread;
+}
+
+void MediaPlayer::waitStartupTask(Thread **thread) {
+    if (*thread == NULL) {
+        return;
+    }
+    (*thread)->join();
+    delete *thread;
+    *thread = NULL;
+}
+
 int MediaPlayer::startRecord(const char *filePath) {
     LOGD("MediaPlayer->start record --- file path=[%s]", filePath);
     mVideoRecorder = new VideoRecorder(mFormatCtx, &filePath);
@@ -0,0 +1,169 @@
+#include <AndroidLog.h>
+#include "MemoryBudget.h"
+#include "FrameBufferPool.h"
+#include "FrameQueue.h"
+#include "PlayerPreloadPool.h"
+#include "ProbeCache.h"
+
+MemoryBudget *MemoryBudget::instance = 0;
+std::mutex MemoryBudget::mutex;
+
+MemoryBudget::MemoryBudget() {
+    mBudget = MEMORY_DEFAULT_BUDGET;
+    mPressure = MEMORY_PRESSURE_NONE;
+    mActivePlayers = 0;
+    mActiveShare = mBudget * MEMORY_ACTIVE_PERCENT / 100;
+    mFrameShare = mBudget * MEMORY_FRAME_PERCENT / 100;
+    mPreloadShare = mBudget * MEMORY_PRELOAD_PERCENT / 100;
+}
+
+MemoryBudget::~MemoryBudget() {
+
+}
+
+MemoryBudget *MemoryBudget::getInstance() {
+    if (!instance) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!instance) {
+            instance = new(std::nothrow) MemoryBudget();
+            // 帧缓冲池可能先于内存预算创建，创建后立即按分到的内存设置它的上限
+            if (instance) {
+                FrameBufferPool::getInstance()->setMemoryBudget(instance->mFrameShare);
+            }
+        }
+    }
+    return instance;
+}
+
+void MemoryBudget::destroy() {
+    if (instance) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (instance) {
+            delete instance;
+            instance = nullptr;
+        }
+    }
+}
+
+void MemoryBudget::setBudget(int64_t budget) {
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        mBudget = budget > 0 ? budget : 0;
+    }
+    rebalance();
+}
+
+int64_t MemoryBudget::getBudget() {
+    std::unique_lock<std::mutex> lock(mLock);
+    return mBudget;
+}
+
+void MemoryBudget::setPressure(MemoryPressure pressure) {
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        if (mPressure == pressure) {
+            return;
+        }
+        mPressure = pressure;
+    }
+    LOGD("MemoryBudget->pressure: %d", pressure);
+    rebalance();
+}
+
+MemoryPressure MemoryBudget::getPressure() {
+    std::unique_lock<std::mutex> lock(mLock);
+    return mPressure;
+}
+
+MemoryPressure MemoryBudget::trimMemory(int level) {
+    MemoryPressure pressure = MEMORY_PRESSURE_NONE;
+    if (level == TRIM_MEMORY_RUNNING_CRITICAL || level >= TRIM_MEMORY_MODERATE) {
+        pressure = MEMORY_PRESSURE_CRITICAL;
+    } else if (level >= TRIM_MEMORY_RUNNING_MODERATE) {
+        pressure = MEMORY_PRESSURE_MODERATE;
+    }
+    if (pressure == MEMORY_PRESSURE_NONE) {
+        return pressure;
+    }
+    // 压力等级只升不降，回到正常由应用显式调用 setPressure 设置
+    if (pressure > getPressure()) {
+        setPressure(pressure);
+    }
+    PlayerPreloadPool::getInstance()->clear();
+    FrameBufferPool::getInstance()->trim();
+    if (pressure >= MEMORY_PRESSURE_CRITICAL) {
+        ProbeCache::getInstance()->clear();
+    }
+    return pressure;
+}
+
+void MemoryBudget::addActivePlayer() {
+    std::unique_lock<std::mutex> lock(mLock);
+    mActivePlayers++;
+}
+
+void MemoryBudget::removeActivePlayer() {
+    std::unique_lock<std::mutex> lock(mLock);
+    if (mActivePlayers > 0) {
+        mActivePlayers--;
+    }
+}
+
+int64_t MemoryBudget::getPacketQueueLimit(int64_t bitRate) {
+    std::unique_lock<std::mutex> lock(mLock);
+    int64_t limit = mActiveShare / FFMAX(mActivePlayers, 1);
+    // 码率已知时只缓冲一定时长的数据，低码率的文件不需要占用整份内存
+    if (bitRate > 0) {
+        limit = FFMIN(limit, av_rescale(bitRate / 8, PACKET_QUEUE_MAX_DURATION, AV_TIME_BASE));
+    }
+    return FFMIN(FFMAX(limit, (int64_t) PACKET_QUEUE_MIN_SIZE), (int64_t) MAX_QUEUE_SIZE);
+}
+
+int64_t MemoryBudget::getPacketQueueDuration() {
+    std::unique_lock<std::mutex> lock(mLock);
+    return mPressure >= MEMORY_PRESSURE_CRITICAL ? PACKET_QUEUE_MIN_DURATION / 2 : PACKET_QUEUE_MIN_DURATION;
+}
+
+int MemoryBudget::getFrameQueueSize(int width, int height, int format) {
+    if (format < 0) {
+        format = AV_PIX_FMT_YUV420P;
+    }
+    int frameSize = av_image_get_buffer_size((enum AVPixelFormat) format, width, height, 1);
+    if (frameSize <= 0) {
+        return VIDEO_QUEUE_SIZE;
+    }
+    std::unique_lock<std::mutex> lock(mLock);
+    // 一半留给解码器的参考帧，剩下的按帧大小换算成帧数
+    int64_t share = mFrameShare / FFMAX(mActivePlayers, 1) / 2;
+    int64_t count = share / frameSize;
+    return (int) FFMIN(FFMAX(count, (int64_t) FRAME_QUEUE_MIN_SIZE), (int64_t) FRAME_QUEUE_SIZE);
+}
+
+int64_t MemoryBudget::getPreloadBudget() {
+    std::unique_lock<std::mutex> lock(mLock);
+    return mPreloadShare;
+}
+
+void MemoryBudget::rebalance() {
+    int64_t frameShare;
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        mActiveShare = mBudget * MEMORY_ACTIVE_PERCENT / 100;
+        mFrameShare = mBudget * MEMORY_FRAME_PERCENT / 100;
+        mPreloadShare = mBudget * MEMORY_PRELOAD_PERCENT / 100;
+        if (mPressure >= MEMORY_PRESSURE_MODERATE) {
+            mFrameShare /= 2;
+            mPreloadShare = 0;
+        }
+        if (mPressure >= MEMORY_PRESSURE_CRITICAL) {
+            mActiveShare /= 2;
+            mFrameShare /= 2;
+        }
+        frameShare = mFrameShare;
+        LOGD("MemoryBudget->rebalance budget: %lld, active: %lld, frame: %lld, preload: %lld",
+             (long long) mBudget, (long long) mActiveShare, (long long) mFrameShare, (long long) mPreloadShare);
+    }
+    // 各部分各自持有锁，不能在 mLock 内调用
+    FrameBufferPool::getInstance()->setMemoryBudget(frameShare);
+    PlayerPreloadPool::getInstance()->shrink();
+}
@@ -0,0 +1,194 @@
+#include <AndroidLog.h>
+#include "PlayerPreloadPool.h"
+#include "PlayerReaper.h"
+#include "MemoryBudget.h"
+
+PlayerPreloadPool *PlayerPreloadPool::instance = 0;
+std::mutex PlayerPreloadPool::mutex;
+
+PlayerPreloadPool::PlayerPreloadPool() {
+    mMaxPlayers = PRELOAD_DEFAULT_MAX_PLAYERS;
+    mMemoryBudget = PRELOAD_DEFAULT_MEMORY_BUDGET;
+}
+
+PlayerPreloadPool::~PlayerPreloadPool() {
+    clear();
+}
+
+PlayerPreloadPool *PlayerPreloadPool::getInstance() {
+    if (!instance) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!instance) {
+            instance = new(std::nothrow) PlayerPreloadPool();
+        }
+    }
+    return instance;
+}
+
+void PlayerPreloadPool::destroy() {
+    if (instance) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (instance) {
+            delete instance;
+            instance = nullptr;
+        }
+    }
+}
+
+void PlayerPreloadPool::setPolicy(int maxPlayers, int64_t memoryBudget) {
+    std::vector<MediaPlayer *> evicted;
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        mMaxPlayers = maxPlayers > 0 ? maxPlayers : 0;
+        mMemoryBudget = memoryBudget > 0 ? memoryBudget : 0;
+        trim(evicted);
+    }
+    release(evicted);
+}
+
+int64_t PlayerPreloadPool::getMemoryBudget() {
+    return FFMIN(mMemoryBudget, MemoryBudget::getInstance()->getPreloadBudget());
+}
+
+std::list<PreloadEntry>::iterator PlayerPreloadPool::find(const char *url) {
+    std::list<PreloadEntry>::iterator it = mEntries.begin();
+    for (; it != mEntries.end(); ++it) {
+        if (it->url == url) {
+            break;
+        }
+    }
+    return it;
+}
+
+int PlayerPreloadPool::preload(const char *url, int64_t offset, const char *headers) {
+    if (!url) {
+        return -1;
+    }
+    std::vector<MediaPlayer *> evicted;
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        int64_t memoryBudget = getMemoryBudget();
+        if (mMaxPlayers <= 0 || memoryBudget <= 0) {
+            return -1;
+        }
+        std::list<PreloadEntry>::iterator it = find(url);
+        if (it != mEntries.end()) {
+            mEntries.splice(mEntries.begin(), mEntries, it);
+            return 0;
+        }
+
+        MediaPlayer *player = new MediaPlayer();
+        player->setDataSource(url, offset, headers);
+        // 内存上限平均分给每个预加载的播放器，限制每个播放器缓冲的数据包大小
+        if (player->preload(memoryBudget / mMaxPlayers) != NO_ERROR) {
+            evicted.push_back(player);
+        } else {
+            PreloadEntry entry;
+            entry.url = url;
+            entry.player = player;
+            mEntries.push_front(entry);
+            LOGD("PlayerPreloadPool->preload %s", url);
+            trim(evicted);
+        }
+    }
+    release(evicted);
+    return 0;
+}
+
+MediaPlayer *PlayerPreloadPool::acquire(const char *url) {
+    if (!url) {
+        return NULL;
+    }
+    std::unique_lock<std::mutex> lock(mLock);
+    std::list<PreloadEntry>::iterator it = find(url);
+    if (it == mEntries.end()) {
+        return NULL;
+    }
+    MediaPlayer *player = it->player;
+    mEntries.erase(it);
+    LOGD("PlayerPreloadPool->acquire %s, ready: %d", url, player->isPreloaded());
+    return player;
+}
+
+bool PlayerPreloadPool::isReady(const char *url) {
+    if (!url) {
+        return false;
+    }
+    std::unique_lock<std::mutex> lock(mLock);
+    std::list<PreloadEntry>::iterator it = find(url);
+    return it != mEntries.end() && it->player->isPreloaded();
+}
+
+void PlayerPreloadPool::remove(const char *url) {
+    if (!url) {
+        return;
+    }
+    std::vector<MediaPlayer *> evicted;
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        std::list<PreloadEntry>::iterator it = find(url);
+        if (it != mEntries.end()) {
+            evicted.push_back(it->player);
+            mEntries.erase(it);
+        }
+    }
+    release(evicted);
+}
+
+void PlayerPreloadPool::clear() {
+    std::vector<MediaPlayer *> evicted;
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        std::list<PreloadEntry>::iterator it = mEntries.begin();
+        for (; it != mEntries.end(); ++it) {
+            evicted.push_back(it->player);
+        }
+        mEntries.clear();
+    }
+    release(evicted);
+}
+
+int64_t PlayerPreloadPool::getMemorySize() {
+    std::unique_lock<std::mutex> lock(mLock);
+    int64_t size = 0;
+    std::list<PreloadEntry>::iterator it = mEntries.begin();
+    for (; it != mEntries.end(); ++it) {
+        size += it->player->getPreloadMemorySize();
+    }
+    return size;
+}
+
+void PlayerPreloadPool::shrink() {
+    std::vector<MediaPlayer *> evicted;
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        trim(evicted);
+    }
+    release(evicted);
+}
+
+void PlayerPreloadPool::trim(std::vector<MediaPlayer *> &evicted) {
+    int64_t memoryBudget = getMemoryBudget();
+    int64_t size = 0;
+    std::list<PreloadEntry>::iterator it = mEntries.begin();
+    for (; it != mEntries.end(); ++it) {
+        size += it->player->getPreloadMemorySize();
+    }
+    // 至少保留最近的一个，它缓冲的数据包已经受单个播放器的上限限制，内存预算收回时全部移除
+    while (!mEntries.empty() && ((int) mEntries.size() > mMaxPlayers || memoryBudget <= 0
+                                 || (mEntries.size() > 1 && size > memoryBudget))) {
+        PreloadEntry &entry = mEntries.back();
+        size -= entry.player->getPreloadMemorySize();
+        LOGD("PlayerPreloadPool->evict %s", entry.url.c_str());
+        evicted.push_back(entry.player);
+        mEntries.pop_back();
+    }
+}
+
+void PlayerPreloadPool::release(std::vector<MediaPlayer *> &players) {
+    for (size_t i = 0; i < players.size(); i++) {
+        players[i]->detach();
+        PlayerReaper::getInstance()->release(players[i]);
+    }
+    players.clear();
+}
@@ -0,0 +1,188 @@
+#include <AndroidLog.h>
+#include "PlayerReaper.h"
+
+PlayerReaper *PlayerReaper::instance = 0;
+std::mutex PlayerReaper::mutex;
+
+PlayerReaper::PlayerReaper() {
+    mThread = NULL;
+    mAbortRequest = false;
+    mPendingMemory = 0;
+}
+
+PlayerReaper::~PlayerReaper() {
+    mMutex.lock();
+    mAbortRequest = true;
+    mCondition.signal();
+    mMutex.unlock();
+    // 回收线程退出前会销毁所有等待中的播放器
+    if (mThread) {
+        mThread->join();
+        delete mThread;
+        mThread = NULL;
+    }
+}
+
+PlayerReaper *PlayerReaper::getInstance() {
+    if (!instance) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!instance) {
+            instance = new(std::nothrow) PlayerReaper();
+        }
+    }
+    return instance;
+}
+
+void PlayerReaper::destroy() {
+    if (instance) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (instance) {
+            delete instance;
+            instance = nullptr;
+        }
+    }
+}
+
+void PlayerReaper::release(MediaPlayer *player, VideoDevice *videoDevice) {
+    if (!player) {
+        delete videoDevice;
+        return;
+    }
+    ReapEntry entry;
+    entry.player = player;
+    entry.videoDevice = videoDevice;
+    entry.listener = NULL;
+    entry.memorySize = player->getPreloadMemorySize();
+
+    mMutex.lock();
+    // 超出上限时不再排队，避免快速切换时积压过多的线程和内存
+    if (mAbortRequest || (int) mEntries.size() >= REAPER_MAX_PENDING_PLAYERS
+        || (!mEntries.empty() && mPendingMemory + entry.memorySize > REAPER_MAX_PENDING_MEMORY)) {
+        mMutex.unlock();
+        LOGW("PlayerReaper->too many pending players: %d, %lld bytes, release synchronously",
+             (int) mEntries.size(), (long long) mPendingMemory);
+        reap(entry);
+        return;
+    }
+    mEntries.push_back(entry);
+    mPendingMemory += entry.memorySize;
+    if (!mThread) {
+        mThread = new Thread(this);
+        mThread->start();
+    }
+    mCondition.signal();
+    mMutex.unlock();
+}
+
+void PlayerReaper::recycle(MediaPlayer *player, RecycleListener *listener) {
+    if (!player) {
+        return;
+    }
+    if (!listener) {
+        release(player);
+        return;
+    }
+    ReapEntry entry;
+    entry.player = player;
+    entry.videoDevice = NULL;
+    entry.listener = listener;
+    entry.memorySize = player->getPreloadMemorySize();
+
+    mMutex.lock();
+    // 回收线程已经退出，在调用线程中软重置
+    if (mAbortRequest) {
+        mMutex.unlock();
+        player->softReset();
+        ReapEntry displaced;
+        displaced.player = listener->onPlayerRecycled(player);
+        displaced.videoDevice = NULL;
+        displaced.listener = NULL;
+        if (displaced.player) {
+            reap(displaced);
+        }
+        return;
+    }
+    // 软重置不受等待数量的限制，否则调用线程仍然要等待播放器的线程退出
+    mEntries.push_back(entry);
+    mPendingMemory += entry.memorySize;
+    if (!mThread) {
+        mThread = new Thread(this);
+        mThread->start();
+    }
+    mCondition.signal();
+    mMutex.unlock();
+}
+
+void PlayerReaper::cancelRecycle(RecycleListener *listener) {
+    // 交还在持有 mMutex 时进行，这里返回后不会再有回调
+    Mutex::Autolock lock(mMutex);
+    std::list<ReapEntry>::iterator it = mEntries.begin();
+    for (; it != mEntries.end(); ++it) {
+        if (it->listener == listener) {
+            it->listener = NULL;
+        }
+    }
+}
+
+int PlayerReaper::getPendingCount() {
+    Mutex::Autolock lock(mMutex);
+    return (int) mEntries.size();
+}
+
+int64_t PlayerReaper::getPendingMemory() {
+    Mutex::Autolock lock(mMutex);
+    return mPendingMemory;
+}
+
+void PlayerReaper::reap(ReapEntry &entry) {
+    int64_t start = av_gettime_relative();
+    entry.player->reset();
+    delete entry.player;
+    entry.player = NULL;
+    // 视频输出设备在播放器的线程都退出后才能销毁
+    if (entry.videoDevice) {
+        delete entry.videoDevice;
+        entry.videoDevice = NULL;
+    }
+    LOGD("PlayerReaper->player released in %lld ms", (long long) ((av_gettime_relative() - start) / 1000));
+}
+
+void PlayerReaper::run() {
+    while (true) {
+        mMutex.lock();
+        while (mEntries.empty() && !mAbortRequest) {
+            mCondition.wait(mMutex);
+        }
+        if (mEntries.empty()) {
+            mMutex.unlock();
+            break;
+        }
+        ReapEntry entry = mEntries.front();
+        mMutex.unlock();
+
+        if (entry.listener) {
+            entry.player->softReset();
+        } else {
+            reap(entry);
+        }
+
+        // 销毁完成后才移出队列，等待中的内存一直计算到真正释放
+        mMutex.lock();
+        // 软重置期间可能已经取消交还
+        RecycleListener *listener = mEntries.front().listener;
+        ReapEntry displaced;
+        displaced.player = listener ? listener->onPlayerRecycled(entry.player) : NULL;
+        displaced.videoDevice = NULL;
+        displaced.listener = NULL;
+        mEntries.pop_front();
+        mPendingMemory -= entry.memorySize;
+        mMutex.unlock();
+
+        if (entry.listener && !listener) {
+            reap(entry);
+        }
+        if (displaced.player) {
+            reap(displaced);
+        }
+    }
+}
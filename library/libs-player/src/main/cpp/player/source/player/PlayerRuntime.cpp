@@ -0,0 +1,260 @@
+#include <AndroidLog.h>
+#include "PlayerRuntime.h"
+
+#if defined(__ANDROID__)
+
+#include "EglHelper.h"
+#include "InputRenderNode.h"
+#include "DisplayRenderNode.h"
+
+#endif
+
+/**
+ * FFmpeg 操作锁管理回调
+ * @param mtx 这是一个二级指针，即指针的指针，传递二级指针的目的是为了改变一级指针的值
+ * @param op
+ * @return
+ */
+static int lockmgrCallback(void **mtx, enum AVLockOp op) {
+    switch (op) {
+        case AV_LOCK_CREATE: {
+            *mtx = new Mutex();
+            if (!*mtx) {
+                LOGD("PlayerRuntime->failed to create mutex.");
+                return 1;
+            }
+            return 0;
+        }
+
+        case AV_LOCK_OBTAIN: {
+            if (!*mtx) {
+                return 1;
+            }
+            return ((Mutex *) (*mtx))->lock() != 0;
+        }
+
+        case AV_LOCK_RELEASE: {
+            if (!*mtx) {
+                return 1;
+            }
+            return ((Mutex *) (*mtx))->unlock() != 0;
+        }
+
+        case AV_LOCK_DESTROY: {
+            if (*mtx) {
+                delete (Mutex *) (*mtx);
+                *mtx = NULL;
+            }
+            return 0;
+        }
+    }
+    return 1;
+}
+
+PlayerRuntime *PlayerRuntime::instance = 0;
+std::mutex PlayerRuntime::mutex;
+
+PlayerRuntime::PlayerRuntime() {
+    mRefCount = 0;
+    mPrewarmed = false;
+    mPrewarmThread = NULL;
+#if defined(__ANDROID__)
+    mSLObject = NULL;
+    mSLEngine = NULL;
+    mSLOutputMixObject = NULL;
+#endif
+}
+
+PlayerRuntime::~PlayerRuntime() {
+    if (mPrewarmThread) {
+        mPrewarmThread->join();
+        delete mPrewarmThread;
+        mPrewarmThread = NULL;
+    }
+    std::unique_lock<std::mutex> lock(mLock);
+    releaseAudioEngine();
+}
+
+PlayerRuntime *PlayerRuntime::getInstance() {
+    if (!instance) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!instance) {
+            instance = new(std::nothrow) PlayerRuntime();
+        }
+    }
+    return instance;
+}
+
+void PlayerRuntime::destroy() {
+    if (instance) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (instance) {
+            delete instance;
+            instance = nullptr;
+        }
+    }
+}
+
+void PlayerRuntime::acquire() {
+    std::unique_lock<std::mutex> lock(mLock);
+    if (mRefCount++ > 0) {
+        return;
+    }
+    LOGD("PlayerRuntime->init");
+    av_register_all();
+    avformat_network_init();
+    // 注册一个多线程锁管理回调，主要是解决多个视频源时保持 avcodec_open/close 的原子操作
+    if (av_lockmgr_register(lockmgrCallback)) {
+        LOGE("PlayerRuntime->Could not initialize lock manager!");
+    }
+}
+
+void PlayerRuntime::release() {
+    std::unique_lock<std::mutex> lock(mLock);
+    if (mRefCount <= 0 || --mRefCount > 0) {
+        return;
+    }
+    LOGD("PlayerRuntime->deinit");
+    releaseAudioEngine();
+    avformat_network_deinit();
+    av_lockmgr_register(NULL);
+}
+
+void PlayerRuntime::prewarm() {
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        if (mPrewarmed) {
+            return;
+        }
+        mPrewarmed = true;
+    }
+    // 预热持有的引用不释放，保证预热的资源在进程内一直可用
+    acquire();
+    mPrewarmThread = new Thread(this);
+    mPrewarmThread->start();
+}
+
+void PlayerRuntime::run() {
+    int64_t start = av_gettime_relative();
+#if defined(__ANDROID__)
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        createAudioEngine();
+    }
+    prewarmRender();
+#endif
+    LOGD("PlayerRuntime->prewarm finished in %lld ms", (long long) ((av_gettime_relative() - start) / 1000));
+}
+
+#if defined(__ANDROID__)
+
+int PlayerRuntime::getAudioEngine(SLEngineItf *engine, SLObjectItf *outputMix) {
+    std::unique_lock<std::mutex> lock(mLock);
+    if (createAudioEngine() < 0) {
+        return -1;
+    }
+    *engine = mSLEngine;
+    *outputMix = mSLOutputMixObject;
+    return 0;
+}
+
+#endif
+
+int PlayerRuntime::createAudioEngine() {
+#if defined(__ANDROID__)
+    if (mSLOutputMixObject != NULL) {
+        return 0;
+    }
+    SLresult result;
+    // 创建引擎engineObject
+    result = slCreateEngine(&mSLObject, 0, NULL, 0, NULL, NULL);
+    if ((result) != SL_RESULT_SUCCESS) {
+        LOGE("PlayerRuntime->%s: slCreateEngine() failed", __func__);
+        mSLObject = NULL;
+        return -1;
+    }
+    // 实现引擎engineObject
+    result = (*mSLObject)->Realize(mSLObject, SL_BOOLEAN_FALSE);
+    if (result != SL_RESULT_SUCCESS) {
+        LOGE("PlayerRuntime->%s: mSLObject->Realize() failed", __func__);
+        releaseAudioEngine();
+        return -1;
+    }
+    // 获取引擎接口SLEngineItf
+    result = (*mSLObject)->GetInterface(mSLObject, SL_IID_ENGINE, &mSLEngine);
+    if (result != SL_RESULT_SUCCESS) {
+        LOGE("PlayerRuntime->%s: mSLObject->GetInterface() failed", __func__);
+        releaseAudioEngine();
+        return -1;
+    }
+
+    const SLInterfaceID mids[1] = {SL_IID_ENVIRONMENTALREVERB};
+    const SLboolean mreq[1] = {SL_BOOLEAN_FALSE};
+    // 创建混音器outputMixObject
+    result = (*mSLEngine)->CreateOutputMix(mSLEngine, &mSLOutputMixObject, 1, mids, mreq);
+    if (result != SL_RESULT_SUCCESS) {
+        LOGE("PlayerRuntime->%s: mSLEngine->CreateOutputMix() failed", __func__);
+        mSLOutputMixObject = NULL;
+        releaseAudioEngine();
+        return -1;
+    }
+    // 实现混音器outputMixObject
+    result = (*mSLOutputMixObject)->Realize(mSLOutputMixObject, SL_BOOLEAN_FALSE);
+    if (result != SL_RESULT_SUCCESS) {
+        LOGE("PlayerRuntime->%s: mSLOutputMixObject->Realize() failed", __func__);
+        releaseAudioEngine();
+        return -1;
+    }
+    LOGD("PlayerRuntime->OpenSL engine created");
+#endif
+    return 0;
+}
+
+void PlayerRuntime::releaseAudioEngine() {
+#if defined(__ANDROID__)
+    if (mSLOutputMixObject != NULL) {
+        (*mSLOutputMixObject)->Destroy(mSLOutputMixObject);
+        mSLOutputMixObject = NULL;
+    }
+    if (mSLObject != NULL) {
+        (*mSLObject)->Destroy(mSLObject);
+        mSLObject = NULL;
+        mSLEngine = NULL;
+    }
+#endif
+}
+
+void PlayerRuntime::prewarmRender() {
+#if defined(__ANDROID__)
+    // 创建临时上下文，用完即销毁，不和播放器的渲染上下文共享资源，只是让驱动缓存着色器的编译结果
+    EglHelper *eglHelper = new EglHelper();
+    if (!eglHelper->init(FLAG_TRY_GLES3)) {
+        delete eglHelper;
+        return;
+    }
+    // 着色器程序需要在关联了上下文的线程中创建，借用一个离屏 Surface
+    EGLSurface eglSurface = eglHelper->createSurface(1, 1);
+    if (eglSurface != EGL_NO_SURFACE) {
+        eglHelper->makeCurrent(eglSurface);
+        // 编译最常见的 YUV420P 输入和显示输出程序，驱动会缓存编译结果，播放器再次编译时直接命中
+        Texture texture;
+        memset(&texture, 0, sizeof(Texture));
+        texture.width = 1;
+        texture.height = 1;
+        texture.format = FMT_YUV420P;
+        InputRenderNode *inputNode = new InputRenderNode();
+        inputNode->initFilter(&texture);
+        DisplayRenderNode *displayNode = new DisplayRenderNode();
+        displayNode->init();
+        glFinish();
+        inputNode->destroy();
+        displayNode->destroy();
+        delete inputNode;
+        delete displayNode;
+        eglHelper->makeNothingCurrent();
+        eglHelper->destroySurface(eglSurface);
+    }
+    eglHelper->release();
+    delete eglHelper;
+#endif
+}
@@ -13,6 +13,12 @@ PlayerState::~PlayerState() {
         delete message_queue;
         message_queue = nullptr;
     }
+    if (vfilters) {
+        av_freep(&vfilters);
+    }
+    if (afilters) {
+        av_freep(&afilters);
+    }
 }
 
 void PlayerState::init() {
@@ -31,6 +37,12 @@ void PlayerState::init() {
 
     audio_codec_name = NULL;
     video_codec_name = NULL;
+    vfilters = NULL;
+    afilters = NULL;
+    // 音量与音频输出设备一样在重置后保持不变
+    left_volume = 1.0f;
+    right_volume = 1.0f;
+    seek_serial = 0;
     message_queue = new AVMessageQueue();
 }
 
@@ -82,6 +94,25 @@ void PlayerState::reset() {
     frame_drop = 1;
     reorder_video_pts = 1;
     video_duration = 0;
+    open_timeout = DEFAULT_OPEN_TIMEOUT;
+    probe_timeout = DEFAULT_PROBE_TIMEOUT;
+    read_timeout = DEFAULT_READ_TIMEOUT;
+    seek_timeout = DEFAULT_SEEK_TIMEOUT;
+    interrupt_phase = INTERRUPT_PHASE_NONE;
+    interrupt_deadline = 0;
+    timeout_phase = INTERRUPT_PHASE_NONE;
+    reconnect_count = DEFAULT_RECONNECT_COUNT;
+    probe_cache = PROBE_CACHE_LOCAL;
+    fast_start = 0;
+    startup_time = 0;
+    preroll_lead_time = DEFAULT_PREROLL_LEAD_TIME;
+    timeline_offset = 0;
+    frame_pool = 0;
+    filter_threads = 0;
+    shared_audio = 0;
+    time_stretcher = TIME_STRETCHER_AUTO;
+    speech = 0;
+    audio_analyzer = 0;
 }
 
 void PlayerState::setOption(int category, const char *type, const char *option) {
@@ -149,6 +180,16 @@ void PlayerState::parse_string(const char *type, const char *option) {
         audio_codec_name = av_strdup(option);
     } else if (!strcmp("vcodec", type)) {   // 指定视频解码器名称
         video_codec_name = av_strdup(option);
+    } else if (!strcmp("vf", type)) { // 视频滤镜
+        av_freep(&vfilters);
+        if (option && *option) {
+            vfilters = av_strdup(option);
+        }
+    } else if (!strcmp("af", type)) { // 音频滤镜
+        av_freep(&afilters);
+        if (option && *option) {
+            afilters = av_strdup(option);
+        }
     } else if (!strcmp("sync", type)) { // 制定同步类型
         if (!strcmp("audio", option)) {
             sync_type = AV_SYNC_AUDIO;
@@ -159,6 +200,14 @@ void PlayerState::parse_string(const char *type, const char *option) {
         } else {    // 其他则使用默认的音频同步
             sync_type = AV_SYNC_AUDIO;
         }
+    } else if (!strcmp("stretcher", type)) { // 变速变调算法
+        if (!strcmp("soundtouch", option)) {
+            time_stretcher = TIME_STRETCHER_SOUNDTOUCH;
+        } else if (!strcmp("atempo", option)) {
+            time_stretcher = TIME_STRETCHER_ATEMPO;
+        } else {
+            time_stretcher = TIME_STRETCHER_AUTO;
+        }
     } else if (!strcmp("f", type)) { // f 指定输入文件格式
         input_format = av_find_input_format(option);
         if (!input_format) {
@@ -190,7 +239,87 @@ void PlayerState::parse_int(const char *type, int64_t option) {
         frame_drop = (option != 0) ? 1 : 0;
     } else if (!strcmp("infbuf", type)) { // 无限缓冲区标志
         infinite_buffer = (option > 0) ? 1 : ((option < 0) ? -1 : 0);
+    } else if (!strcmp("opentimeout", type)) { // 打开文件超时，单位毫秒
+        open_timeout = option * 1000;
+    } else if (!strcmp("probetimeout", type)) { // 查找媒体流信息超时，单位毫秒
+        probe_timeout = option * 1000;
+    } else if (!strcmp("readtimeout", type)) { // 读取数据包超时，单位毫秒
+        read_timeout = option * 1000;
+    } else if (!strcmp("seektimeout", type)) { // 定位超时，单位毫秒
+        seek_timeout = option * 1000;
+    } else if (!strcmp("reconnect", type)) { // 网络流断开后的重连次数
+        reconnect_count = option > 0 ? (int) option : 0;
+    } else if (!strcmp("probecache", type)) { // 探测结果缓存范围，0 关闭，1 本地文件，2 包括网络流
+        probe_cache = (option >= PROBE_CACHE_NONE && option <= PROBE_CACHE_NETWORK) ? (int) option : PROBE_CACHE_LOCAL;
+    } else if (!strcmp("faststart", type)) { // 快速起播
+        fast_start = (option != 0) ? 1 : 0;
+    } else if (!strcmp("prerolltime", type)) { // 播放列表提前打开下一个条目的时间，单位毫秒
+        preroll_lead_time = option > 0 ? option * 1000 : 0;
+    } else if (!strcmp("framepool", type)) { // 视频帧缓冲池
+        frame_pool = (option != 0) ? 1 : 0;
+    } else if (!strcmp("filterthreads", type)) { // 滤镜线程数
+        filter_threads = option > 0 ? (int) option : 0;
+    } else if (!strcmp("sharedaudio", type)) { // 使用进程内共享的软件混音输出
+        shared_audio = (option != 0) ? 1 : 0;
+    } else if (!strcmp("speech", type)) { // 语音内容
+        speech = (option != 0) ? 1 : 0;
+    } else if (!strcmp("analyzer", type)) { // 分析输出音频的电平和频谱
+        audio_analyzer = (option != 0) ? 1 : 0;
     } else {
         LOGE("unknown option - '%s'", type);
     }
 }
+
+void PlayerState::beginInterruptPhase(InterruptPhase phase) {
+    int64_t timeout = 0;
+    switch (phase) {
+        case INTERRUPT_PHASE_OPEN: {
+            timeout = open_timeout;
+            break;
+        }
+        case INTERRUPT_PHASE_PROBE: {
+            timeout = probe_timeout;
+            break;
+        }
+        case INTERRUPT_PHASE_READ: {
+            timeout = read_timeout;
+            break;
+        }
+        case INTERRUPT_PHASE_SEEK: {
+            timeout = seek_timeout;
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+    // timeout_phase 不在这里清除，重连等后续操作失败时仍然按超时上报，由准备和重连成功时清除
+    interrupt_deadline = timeout > 0 ? av_gettime_relative() + timeout : 0;
+    interrupt_phase = phase;
+}
+
+void PlayerState::endInterruptPhase() {
+    interrupt_phase = INTERRUPT_PHASE_NONE;
+    interrupt_deadline = 0;
+}
+
+int PlayerState::checkInterruptTimeout() {
+    if (interrupt_phase == INTERRUPT_PHASE_NONE || interrupt_deadline <= 0) {
+        return 0;
+    }
+    if (av_gettime_relative() < interrupt_deadline) {
+        return 0;
+    }
+    timeout_phase = interrupt_phase;
+    return 1;
+}
+
+
+void PlayerState::postStartupTiming(StartupPhase phase) {
+    if (!message_queue || startup_time <= 0) {
+        return;
+    }
+    int elapsed = (int) ((av_gettime_relative() - startup_time) / 1000);
+    LOGD("PlayerState->startup phase %d: %d ms", phase, elapsed);
+    message_queue->postMessage(MSG_STARTUP_TIMING, phase, elapsed);
+}
@@ -0,0 +1,263 @@
+#include <sys/stat.h>
+#include <AndroidLog.h>
+#include "ProbeCache.h"
+
+extern "C" {
+#include <libavutil/crc.h>
+};
+
+std::atomic<ProbeCache *> ProbeCache::instance(nullptr);
+std::mutex ProbeCache::mutex;
+
+ProbeCache::ProbeCache() {
+
+}
+
+ProbeCache::~ProbeCache() {
+    clear();
+}
+
+ProbeCache *ProbeCache::getInstance() {
+    // 实例在解复用线程和预加载线程里都会创建，用 acquire/release 保证拿到的是构造完成的对象
+    ProbeCache *cache = instance.load(std::memory_order_acquire);
+    if (!cache) {
+        std::unique_lock<std::mutex> lock(mutex);
+        cache = instance.load(std::memory_order_relaxed);
+        if (!cache) {
+            cache = new(std::nothrow) ProbeCache();
+            instance.store(cache, std::memory_order_release);
+        }
+    }
+    return cache;
+}
+
+void ProbeCache::destroy() {
+    std::unique_lock<std::mutex> lock(mutex);
+    ProbeCache *cache = instance.exchange(nullptr, std::memory_order_acq_rel);
+    delete cache;
+}
+
+int ProbeCache::getFileIdentity(AVFormatContext *ic, const char *url, bool network, int64_t *size, int64_t *mtime) {
+    const char *protocol = avio_find_protocol_name(url);
+    // pipe/fd 的路径不能唯一标识文件内容，rtsp 等没有 protocol 的实时流也不缓存
+    if (!protocol || !strcmp(protocol, "pipe") || !strcmp(protocol, "fd") || !strcmp(protocol, "data")) {
+        return -1;
+    }
+    // 本地文件以文件大小和修改时间作为校验
+    if (!strcmp(protocol, "file")) {
+        const char *path = url;
+        av_strstart(url, "file:", &path);
+        struct stat st;
+        if (stat(path, &st) < 0) {
+            return -1;
+        }
+        *size = st.st_size;
+        *mtime = st.st_mtime;
+        return 0;
+    }
+    // 网络流拿不到 ETag/Last-Modified，只能以文件大小校验，同样大小的内容被替换时无法发现，默认不缓存
+    // 没有大小的直播流不缓存
+    if (!network || !ic || !ic->pb) {
+        return -1;
+    }
+    *size = avio_size(ic->pb);
+    *mtime = 0;
+    return *size > 0 ? 0 : -1;
+}
+
+uint32_t ProbeCache::getExtradataCrc(AVCodecParameters *codecpar) {
+    if (!codecpar->extradata || codecpar->extradata_size <= 0) {
+        return 0;
+    }
+    return av_crc(av_crc_get_table(AV_CRC_32_IEEE_LE), UINT32_MAX, codecpar->extradata, codecpar->extradata_size);
+}
+
+bool ProbeCache::isSameStream(AVCodecParameters *codecpar, const ProbeStream &cached) {
+    AVCodecParameters *par = cached.codecpar;
+    if (codecpar->codec_type != AVMEDIA_TYPE_UNKNOWN && codecpar->codec_type != par->codec_type) {
+        return false;
+    }
+    if (codecpar->codec_id != AV_CODEC_ID_NONE && codecpar->codec_id != par->codec_id) {
+        return false;
+    }
+    // 同样大小的文件被替换成不同编码参数的内容时，参数集和分辨率、采样率会不同
+    if (codecpar->extradata_size > 0
+        && (codecpar->extradata_size != par->extradata_size || getExtradataCrc(codecpar) != cached.extradata_crc)) {
+        return false;
+    }
+    if (codecpar->codec_type == AVMEDIA_TYPE_VIDEO && codecpar->width > 0 && codecpar->height > 0
+        && (codecpar->width != par->width || codecpar->height != par->height)) {
+        return false;
+    }
+    if (codecpar->codec_type == AVMEDIA_TYPE_AUDIO
+        && ((codecpar->sample_rate > 0 && codecpar->sample_rate != par->sample_rate)
+            || (codecpar->channels > 0 && codecpar->channels != par->channels))) {
+        return false;
+    }
+    return true;
+}
+
+std::list<ProbeEntry>::iterator ProbeCache::find(const char *url) {
+    std::list<ProbeEntry>::iterator it = mEntries.begin();
+    for (; it != mEntries.end(); ++it) {
+        if (it->url == url) {
+            break;
+        }
+    }
+    return it;
+}
+
+void ProbeCache::freeEntry(ProbeEntry &entry) {
+    for (size_t i = 0; i < entry.streams.size(); i++) {
+        avcodec_parameters_free(&entry.streams[i].codecpar);
+    }
+    entry.streams.clear();
+}
+
+AVInputFormat *ProbeCache::findInputFormat(const char *url) {
+    int64_t size, mtime;
+    if (!url || getFileIdentity(NULL, url, false, &size, &mtime) < 0) {
+        return NULL;
+    }
+    std::unique_lock<std::mutex> lock(mLock);
+    std::list<ProbeEntry>::iterator it = find(url);
+    if (it == mEntries.end() || it->size != size || it->mtime != mtime) {
+        return NULL;
+    }
+    return av_find_input_format(it->formatName.c_str());
+}
+
+int ProbeCache::lookup(AVFormatContext *ic, const char *url, bool network) {
+    int64_t size, mtime;
+    if (!ic || !ic->iformat || !url || getFileIdentity(ic, url, network, &size, &mtime) < 0) {
+        return -1;
+    }
+    std::unique_lock<std::mutex> lock(mLock);
+    std::list<ProbeEntry>::iterator it = find(url);
+    if (it == mEntries.end()) {
+        return -1;
+    }
+    // 文件已经变化，缓存失效
+    if (it->size != size || it->mtime != mtime || it->formatName != ic->iformat->name) {
+        LOGD("ProbeCache->%s changed, drop cached probe result", url);
+        freeEntry(*it);
+        mEntries.erase(it);
+        return -1;
+    }
+    // 移到最前面
+    mEntries.splice(mEntries.begin(), mEntries, it);
+    return (int) mEntries.front().streams.size();
+}
+
+int ProbeCache::restore(AVFormatContext *ic, const char *url) {
+    std::unique_lock<std::mutex> lock(mLock);
+    std::list<ProbeEntry>::iterator it = find(url);
+    if (it == mEntries.end()) {
+        return -1;
+    }
+
+    // 校验媒体流数量以及文件头给出的解码参数是否和缓存一致
+    bool matched = ic->nb_streams == it->streams.size();
+    for (unsigned int i = 0; matched && i < ic->nb_streams; i++) {
+        matched = isSameStream(ic->streams[i]->codecpar, it->streams[i]);
+    }
+    if (!matched) {
+        LOGW("ProbeCache->%s does not match cached streams", url);
+        freeEntry(*it);
+        mEntries.erase(it);
+        return -1;
+    }
+
+    for (unsigned int i = 0; i < ic->nb_streams; i++) {
+        AVStream *stream = ic->streams[i];
+        ProbeStream &cached = it->streams[i];
+        if (avcodec_parameters_copy(stream->codecpar, cached.codecpar) < 0) {
+            return -1;
+        }
+        if (!stream->avg_frame_rate.num) {
+            stream->avg_frame_rate = cached.avg_frame_rate;
+        }
+        if (!stream->r_frame_rate.num) {
+            stream->r_frame_rate = cached.r_frame_rate;
+        }
+        if (stream->start_time == AV_NOPTS_VALUE) {
+            stream->start_time = cached.start_time;
+        }
+        if (stream->duration == AV_NOPTS_VALUE) {
+            stream->duration = cached.duration;
+        }
+    }
+    if (ic->start_time == AV_NOPTS_VALUE) {
+        ic->start_time = it->start_time;
+    }
+    if (ic->duration == AV_NOPTS_VALUE) {
+        ic->duration = it->duration;
+    }
+    if (ic->bit_rate <= 0) {
+        ic->bit_rate = it->bit_rate;
+    }
+    return 0;
+}
+
+void ProbeCache::store(AVFormatContext *ic, const char *url, bool network) {
+    int64_t size, mtime;
+    if (!ic || !ic->iformat || !url || ic->nb_streams == 0 || getFileIdentity(ic, url, network, &size, &mtime) < 0) {
+        return;
+    }
+
+    ProbeEntry entry;
+    entry.url = url;
+    entry.size = size;
+    entry.mtime = mtime;
+    entry.formatName = ic->iformat->name;
+    entry.start_time = ic->start_time;
+    entry.duration = ic->duration;
+    entry.bit_rate = ic->bit_rate;
+    for (unsigned int i = 0; i < ic->nb_streams; i++) {
+        AVStream *stream = ic->streams[i];
+        ProbeStream cached;
+        cached.codecpar = avcodec_parameters_alloc();
+        if (!cached.codecpar || avcodec_parameters_copy(cached.codecpar, stream->codecpar) < 0) {
+            avcodec_parameters_free(&cached.codecpar);
+            freeEntry(entry);
+            return;
+        }
+        cached.extradata_crc = getExtradataCrc(stream->codecpar);
+        cached.avg_frame_rate = stream->avg_frame_rate;
+        cached.r_frame_rate = stream->r_frame_rate;
+        cached.start_time = stream->start_time;
+        cached.duration = stream->duration;
+        entry.streams.push_back(cached);
+    }
+
+    std::unique_lock<std::mutex> lock(mLock);
+    std::list<ProbeEntry>::iterator it = find(url);
+    if (it != mEntries.end()) {
+        freeEntry(*it);
+        mEntries.erase(it);
+    }
+    mEntries.push_front(entry);
+    // 超过最大数量时移除最久没有使用的
+    while (mEntries.size() > PROBE_CACHE_MAX_ENTRIES) {
+        freeEntry(mEntries.back());
+        mEntries.pop_back();
+    }
+}
+
+void ProbeCache::remove(const char *url) {
+    std::unique_lock<std::mutex> lock(mLock);
+    std::list<ProbeEntry>::iterator it = find(url);
+    if (it != mEntries.end()) {
+        freeEntry(*it);
+        mEntries.erase(it);
+    }
+}
+
+void ProbeCache::clear() {
+    std::unique_lock<std::mutex> lock(mLock);
+    std::list<ProbeEntry>::iterator it = mEntries.begin();
+    for (; it != mEntries.end(); ++it) {
+        freeEntry(*it);
+    }
+    mEntries.clear();
+}
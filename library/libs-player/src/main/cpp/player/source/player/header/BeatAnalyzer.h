@@ -0,0 +1,146 @@
+#ifndef BEATANALYZER_H
+#define BEATANALYZER_H
+
+#include <atomic>
+#include <mutex>
+#include <list>
+#include <string>
+#include <vector>
+#include "PlayerState.h"
+
+// 最多缓存的分析结果数量
+#define BEAT_ANALYZER_MAX_ENTRIES 16
+// 解码后先降采样到不低于该采样率，再送入 BPMDetect
+#define BEAT_ANALYZER_RATE 11025
+// BPMDetect 内部再降到约 1000Hz，每次最多送入 BEAT_ANALYZER_BLOCK 个采样点时输入采样率不能低于该值
+#define BEAT_ANALYZER_MIN_RATE 4000
+// 每次送入 BPMDetect 的采样点数
+#define BEAT_ANALYZER_BLOCK 1024
+// 送入 BPMDetect 的幅度包络的平滑时间，单位秒
+#define BEAT_ANALYZER_ENVELOPE_TIME 0.01f
+// 起音包络的帧率，决定节拍位置的精度
+#define BEAT_ANALYZER_ENVELOPE_RATE 100
+// 节拍间隔偏离速度对应的周期时的惩罚系数，越大节拍越均匀
+#define BEAT_ANALYZER_TIGHTNESS 100.0f
+
+/**
+ * 分析状态
+ */
+typedef enum BeatAnalysisState {
+    BEAT_ANALYSIS_NONE = 0,     // 没有请求分析
+    BEAT_ANALYSIS_PENDING = 1,  // 等待或者正在分析
+    BEAT_ANALYSIS_DONE = 2,     // 分析完成
+    BEAT_ANALYSIS_FAILED = 3,   // 打开或者解码失败
+} BeatAnalysisState;
+
+/**
+ * 分析结果
+ */
+typedef struct BeatAnalysis {
+    float bpm;                      // 每分钟节拍数，检测失败时为 0
+    std::vector<int64_t> beats;     // 节拍位置，单位毫秒，与播放位置一致，已经减去文件的起始时间
+    int64_t duration;               // 分析的音频时长，单位毫秒
+    int64_t cpuTime;                // 分析占用的 CPU 时间，单位微秒
+    float speed;                    // 每秒 CPU 时间处理的音频秒数
+} BeatAnalysis;
+
+/**
+ * 缓存的分析结果，以 url + 文件大小 + 修改时间 作为标识
+ */
+typedef struct BeatEntry {
+    std::string url;                // 文件路径
+    int64_t size;                   // 文件大小，网络流为 0
+    int64_t mtime;                  // 文件修改时间，网络流为 0
+    BeatAnalysisState state;        // 分析状态
+    BeatAnalysis analysis;          // 分析结果
+} BeatEntry;
+
+/**
+ * 离线速度和节拍分析
+ * 在后台线程中用独立的解复用和解码器只解码音频，视频等其它媒体流设置为 AVDISCARD_ALL，解码帧直接下混成单声道并降采样，
+ * 取幅度包络的上升部分送入 SoundTouch 的 BPMDetect 得到速度(BPMDetect 本身没有做包络，直接对波形做自相关时容易检测错)，
+ * 同时计算起音包络，按速度用动态规划找出节拍的位置。
+ * 不按播放速度等待，远快于实时，结果按文件缓存
+ */
+class BeatAnalyzer : public Runnable {
+public:
+    static BeatAnalyzer *getInstance();
+
+    void destroy();
+
+    /**
+     * 请求分析，已经有结果或者正在分析时不重复处理，最近请求的先分析
+     * @param url 文件路径
+     * @return 0 为已接受
+     */
+    int analyze(const char *url);
+
+    /**
+     * 获取分析结果
+     * @param url 文件路径
+     * @param analysis 分析完成时写入结果
+     * @return 分析状态
+     */
+    BeatAnalysisState getAnalysis(const char *url, BeatAnalysis *analysis);
+
+    /**
+     * 取消分析并移除缓存
+     * @param url 文件路径
+     */
+    void remove(const char *url);
+
+    /**
+     * 取消所有分析并清空缓存
+     */
+    void clear();
+
+    void run() override;
+
+private:
+    BeatAnalyzer();
+
+    virtual ~BeatAnalyzer();
+
+    /**
+     * 解码并分析
+     * @param url 文件路径
+     * @param analysis 分析结果
+     * @return 0 为成功
+     */
+    int process(const char *url, BeatAnalysis *analysis);
+
+    /**
+     * 按起音包络和速度找出节拍的位置
+     * @param onset 起音包络
+     * @param period 速度对应的节拍周期，单位为包络的帧
+     * @param beats 输出节拍所在的帧
+     */
+    static void trackBeats(std::vector<float> &onset, double period, std::vector<int> &beats);
+
+    /**
+     * 获取文件标识，本地文件为文件大小和修改时间，其它输入只按路径区分
+     */
+    static void getFileIdentity(const char *url, int64_t *size, int64_t *mtime);
+
+    static int interruptCallback(void *ctx);
+
+    std::list<BeatEntry>::iterator find(const char *url);
+
+    /**
+     * 按最久没有使用的顺序移除超出的缓存，正在分析的保留
+     */
+    void trim();
+
+    static BeatAnalyzer *instance;
+    static std::mutex mutex;
+
+    Mutex mMutex;                       //
+    Condition mCondition;               //
+    Thread *mThread;                    // 分析线程
+    std::atomic<bool> mAbortRequest;    // 退出分析线程，解码循环和中断回调中不加锁读取
+    std::atomic<bool> mCancelRequest;   // 取消正在分析的文件
+    std::string mCurrent;               // 正在分析的文件
+    std::list<BeatEntry> mEntries;      // 最近使用的放在最前面
+};
+
+#endif //BEATANALYZER_H
@@ -6,6 +6,7 @@
 #include "PlayerState.h"
 #include "AudioDecoder.h"
 #include "VideoDecoder.h"
+#include "FrameBufferPool.h"
 
 #if defined(__ANDROID__)
 
@@ -19,14 +20,76 @@
 
 #endif
 
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
 #include <android/native_window.h>
 #include <android/native_window_jni.h>
 #include "MediaSync.h"
+#include "ProbeCache.h"
+#include "PlayerRuntime.h"
+#include "MemoryBudget.h"
+#include "SharedAudioDevice.h"
 #include "convertor/AudioResampler.h"
 #include "recorder/VideoRecorder.h"
 #include "recorder/ScreenshotRecorder.h"
 
 
+class MediaPlayer;
+
+/**
+ * 快速起播时在辅助线程中执行的任务
+ */
+class StartupTask : public Runnable {
+public:
+    typedef void (MediaPlayer::*Task)();
+
+    StartupTask(MediaPlayer *player, Task task);
+
+    void run() override;
+
+private:
+    MediaPlayer *mPlayer;
+    Task mTask;
+};
+
+/**
+ * 播放列表中等待播放的条目
+ */
+typedef struct PlaylistItem {
+    std::string url;        // 文件路径
+    int64_t offset;         // 文件偏移量
+    std::string headers;    // 文件头信息
+} PlaylistItem;
+
+/**
+ * 已经拼接到时间轴上的条目
+ * 解码器始终使用第一个条目的媒体流，后面条目的数据包按 pts - startTime + offset 换算到第一个条目的时间轴上
+ */
+typedef struct SpliceItem {
+    PlaylistItem item;              // 条目信息
+    AVFormatContext *formatCtx;     // 解复用上下文，循环播放时和上一个条目相同
+    int audioIndex;                 // 音频流在 formatCtx 中的索引，-1 表示没有
+    int videoIndex;                 // 视频流在 formatCtx 中的索引，-1 表示没有
+    int64_t startTime;              // 条目自身的起始时间，单位 AV_TIME_BASE
+    int64_t offset;                 // 条目起始时间对应的时间轴位置，单位 AV_TIME_BASE
+    int64_t splicePoint;            // 开始播放这个条目的时间轴位置，单位 AV_TIME_BASE
+    int64_t duration;               // 条目时长，单位毫秒，-1 表示未知
+    int index;                      // 条目序号，第一个为 0
+    bool looped;                    // 是否为循环播放拼接的条目
+} SpliceItem;
+
+/**
+ * 提前打开条目时中断回调的参数
+ * IO 层在打开时保存回调参数，拼接后读数据线程读取同一个条目时仍然使用它，
+ * 正在读取的条目和正在打开的条目各用一个，打开的截止时间不会影响正在读取的条目
+ */
+typedef struct PrerollInterrupt {
+    PlayerState *playerState;       //
+    int64_t deadline;               // 打开和查找媒体流信息的截止时间(av_gettime_relative)，不限制时为 INT64_MAX，打开结束后为 0
+} PrerollInterrupt;
+
 class MediaPlayer : public Runnable {
 public:
     MediaPlayer();
@@ -35,14 +98,55 @@ public:
 
     status_t reset();
 
+    /**
+     * 软重置：停止读数据、解码和同步线程，关闭文件，保留解码器、音频输出设备、重采样器以及渲染环境，
+     * 之后重新 setDataSource 时，参数兼容的解码器和音频输出设备直接复用，不需要重新初始化。
+     * 调用前需要先 detach，消息队列在重新 setDataSource 时开始
+     * @return
+     */
+    status_t softReset();
+
     void setDataSource(const char *url, int64_t offset = 0, const char *headers = NULL);
 
+    /**
+     * 添加到播放列表，当前条目结束前提前打开，解码参数兼容时无缝衔接播放
+     * @param url 文件路径
+     * @param offset 文件偏移量
+     * @param headers 文件头信息
+     */
+    void enqueueDataSource(const char *url, int64_t offset = 0, const char *headers = NULL);
+
+    /**
+     * 清空等待播放的条目，已经提前打开的下一个条目仍会播放
+     */
+    void clearPlaylist();
+
     void setVideoDevice(VideoDevice *videoDevice);
 
     status_t prepare();
 
     status_t prepareAsync();
 
+    /**
+     * 预加载：打开文件、查找媒体流信息、缓冲第一个 GOP 并解码出第一帧后挂起，
+     * 直到调用 prepare 或 start 时才打开输出设备继续播放，挂起期间不占用任何线程
+     * @param bufferSize 预加载时最多缓冲的数据包大小，单位字节
+     * @return
+     */
+    status_t preload(int64_t bufferSize);
+
+    /**
+     * 预加载是否已完成，即第一个 GOP 已缓冲并且第一帧已解码
+     * @return
+     */
+    bool isPreloaded();
+
+    /**
+     * 预加载占用的内存，包括缓冲的数据包和已解码的视频帧
+     * @return 单位字节
+     */
+    int64_t getPreloadMemorySize();
+
     void start();
 
     void pause();
@@ -51,8 +155,21 @@ public:
 
     void stop();
 
+    /**
+     * 和外部解除关联：停止消息分发、暂停输出、断开视频输出设备，不等待线程退出，
+     * 之后可以在其它线程中调用 reset 释放资源
+     */
+    void detach();
+
     void seekTo(float timeMs);
 
+    /**
+     * 内存紧张时释放暂停中不需要的资源：还没有显示的视频帧、SoundTouch 和重采样缓冲，严重时释放渲染用的纹理和 FBO，
+     * 数据包队列随进程内存预算收缩，恢复播放时不需要重新准备
+     * @param pressure 内存压力等级
+     */
+    void trimMemory(MemoryPressure pressure);
+
     void setLooping(int looping);
 
     void setVolume(float volume);
@@ -67,6 +184,63 @@ public:
 
     void setPitch(float pitch);
 
+    /**
+     * 设置音频滤镜，播放中调用时不中断声音
+     * @param filters 滤镜描述，为空时停用滤镜
+     */
+    void setAudioFilter(const char *filters);
+
+    /**
+     * 开启或者关闭输出音频的电平和频谱分析，在单独的线程中计算，不影响音频回调
+     * @param enable
+     */
+    void setAudioAnalyzer(int enable);
+
+    /**
+     * 取出最新的电平和频谱
+     * @param analysis
+     * @param position 分析结果对应的播放位置，单位毫秒
+     * @return NO_ERROR 为成功，没有开启或者还没有结果时为 INVALID_OPERATION
+     */
+    status_t getAudioAnalysis(AudioAnalysis *analysis, long *position);
+
+    /**
+     * 切换音轨，不需要定位：在辅助线程中打开新音轨的解码器，从当前读取的位置开始接收数据包，
+     * 解码追上播放位置后在音频回调中对齐并交叉淡化切换，没有选中的音轨不再读取
+     * @param streamIndex 音频流索引
+     * @return NO_ERROR 为已接受切换请求
+     */
+    status_t selectAudioTrack(int streamIndex);
+
+    /**
+     * @return 当前播放的音频流索引，切换中返回切换的目标，没有音频时为 -1
+     */
+    int getSelectedAudioTrack();
+
+    /**
+     * 获取所有音频流的索引
+     * @param indexes 保存音频流索引
+     * @param size indexes 的大小
+     * @return 音频流的数量
+     */
+    int getAudioTracks(int *indexes, int size);
+
+    /**
+     * 同时解码额外的音轨并混入输出，如伴奏、解说音轨，按主音轨的时间戳对齐到采样点，
+     * 已经在混音时只更新增益，streamIndex 为当前播放的音轨时设置主音轨的增益
+     * @param streamIndex 音频流索引
+     * @param gain 增益，0 ~ 2
+     * @return NO_ERROR 为已接受
+     */
+    status_t setMixTrack(int streamIndex, float gain);
+
+    /**
+     * 停止混入额外的音轨
+     * @param streamIndex 音频流索引
+     * @return
+     */
+    status_t removeMixTrack(int streamIndex);
+
     int getRotate();
 
     int getVideoWidth();
@@ -155,11 +329,29 @@ private:
      */
     int readAVPackets();
 
+    /**
+     * 预加载时读取第一个 GOP 的数据包，完成后等待被取用
+     */
+    void preloadAVPackets();
+
+    /**
+     * 恢复播放或者定位时放开视频帧队列的限制
+     */
+    void restoreMemory();
+
     /**
      * @return
      */
     int startPlayer();
 
+    /**
+     * 创建并打开媒体流的解码上下文
+     * @param streamIndex 媒体流索引
+     * @param avctx 打开的解码上下文
+     * @return 0 为成功
+     */
+    int openCodecContext(int streamIndex, AVCodecContext **avctx);
+
     /**
      * prepare decoder with stream_index
      * @param streamIndex
@@ -180,6 +372,176 @@ private:
             int wanted_sample_rate
     );
 
+    /**
+     * 是否网络流，只有网络流才会自动重连
+     * @return
+     */
+    bool isNetworkStream();
+
+    /**
+     * 重新打开的输入与当前正在解码的媒体流参数是否一致
+     * @param ic 重新打开的解复用上下文
+     * @return 一致则可以继续使用原来的解码器
+     */
+    bool isSameStreamLayout(AVFormatContext *ic);
+
+    /**
+     * 软重置保留下来的解码器能否直接解码新的媒体流
+     * @param decoder 保留下来的解码器
+     * @param stream 新的媒体流
+     * @return 解码器相同、分辨率或采样参数一致时可以复用
+     */
+    bool isDecoderReusable(MediaDecoder *decoder, AVStream *stream);
+
+    /**
+     * 网络中断后原地重连，保留解码器、音频设备以及渲染环境，重新打开输入并定位到最后播放的位置
+     * @param position 重连后定位的位置，单位 AV_TIME_BASE，AV_NOPTS_VALUE 表示不定位
+     * @return 0 为重连成功
+     */
+    int reconnect(int64_t position);
+
+    /**
+     * 以当前打开的文件作为时间轴的第一个条目
+     */
+    void initTimeline();
+
+    /**
+     * 当前读取的条目快结束时，在辅助线程中提前打开播放列表的下一个条目
+     * @param readPos 最后读取的数据包时间，单位 AV_TIME_BASE
+     */
+    void checkPreroll(int64_t readPos);
+
+    /**
+     * 取出播放列表的下一个条目，在辅助线程中打开
+     */
+    void startPreroll();
+
+    /**
+     * 打开下一个条目并查找媒体流信息，在辅助线程中执行，结果保存在 mNextFormatCtx 中
+     */
+    void prerollNextItem();
+
+    /**
+     * 打开播放列表的条目
+     * @param item 条目
+     * @param ic 打开的解复用上下文
+     * @return 0 为成功
+     */
+    int openPlaylistItem(const PlaylistItem &item, AVFormatContext **ic);
+
+    /**
+     * 下一个条目能否直接送给当前的解码器
+     * @param ic 下一个条目的解复用上下文
+     * @param audioIndex 对应音频解码器的媒体流索引
+     * @param videoIndex 对应视频解码器的媒体流索引
+     * @return 每个解码器都有编码格式相同的媒体流时可以衔接
+     */
+    bool isSpliceCompatible(AVFormatContext *ic, int *audioIndex, int *videoIndex);
+
+    /**
+     * 当前条目读取完时，把下一个条目(或者循环播放时的当前条目)拼接到时间轴上继续读取
+     * @return 0 为拼接成功，否则按原来的流程结束播放
+     */
+    int spliceNextItem();
+
+    /**
+     * 播放位置越过拼接点时，切换正在播放的条目并通知
+     */
+    void updatePlayingItem();
+
+    /**
+     * 定位时回到正在播放的条目，已经拼接但还没有播放的条目放回播放列表
+     */
+    void rewindTimeline();
+
+    /**
+     * 把数据包换算到时间轴上并送给对应的解码器
+     * @param pkt 当前读取条目的数据包
+     * @return 1 为已送给解码器，0 为丢弃
+     */
+    int pushTimelinePacket(AVPacket *pkt);
+
+    /**
+     * 关闭时间轴上除 mFormatCtx 以外的所有解复用上下文，清空播放列表
+     */
+    void releaseTimeline();
+
+    /**
+     * 关闭不再被时间轴引用的解复用上下文
+     * @param ic
+     */
+    void closeSpliceContext(AVFormatContext *ic);
+
+    /**
+     * 打开切换音轨后的音频解码器，在辅助线程中执行，结果保存在 mOpenedAudioDecoder 中
+     */
+    void openNextAudioDecoder();
+
+    /**
+     * 在读数据包线程中处理切换音轨的请求、打开完成以及音频回调中切换完成
+     */
+    void updateAudioTrack();
+
+    /**
+     * 音频回调已经换成新的解码器，释放旧的解码器
+     */
+    void finishAudioSwitch();
+
+    /**
+     * 取消正在进行的切换，定位、重连以及退出读取时调用
+     * @param keepRequest 是否保留切换请求，之后重新打开
+     */
+    void cancelAudioSwitch(bool keepRequest);
+
+    /**
+     * 没有在解码的音频流设置为 AVDISCARD_ALL，解复用时直接丢弃
+     */
+    void discardAudioStreams();
+
+    /**
+     * 在读数据包线程中打开或者移除混音音轨，更新增益
+     */
+    void updateMixTracks();
+
+    /**
+     * 移除全部混音音轨，退出读取时调用
+     */
+    void releaseMixTracks();
+
+    /**
+     * @param streamIndex 当前读取文件的媒体流索引
+     * @return 对应的混音音轨解码器
+     */
+    AudioDecoder *findMixDecoder(int streamIndex);
+
+    /**
+     * 打开音频输出设备，结果保存在 mAudioDeviceRet 中，快速起播时在辅助线程中执行
+     */
+    void openAudioOutput();
+
+    /**
+     * 按 sharedaudio 选项切换独立的音频输出设备或者共享音频输出的混音输入，选项在创建播放器之后设置，需要在准备时切换
+     */
+    void updateAudioDevice();
+
+    /**
+     * 预先创建渲染上下文和输入着色器程序，快速起播时在查找媒体流信息的同时执行
+     */
+    void prewarmVideoDevice();
+
+    /**
+     * 在辅助线程中执行起播任务
+     * @param task 任务
+     * @return 任务所在的线程
+     */
+    Thread *startStartupTask(StartupTask *task);
+
+    /**
+     * 等待起播任务执行完成
+     * @param thread 任务所在的线程，完成后置空
+     */
+    void waitStartupTask(Thread **thread);
+
 private:
     Mutex mMutex;
     Condition mCondition;
@@ -194,10 +556,60 @@ private:
     int mLastPaused;                         // 上一次暂停状态
     int mEOF;                                // 数据包读到结尾标志
     int mAttachmentRequest;                  // 视频封面数据包请求
+    AVDictionary *mFormatOpts;               // 打开文件时的解复用参数，重连时使用
+    int64_t mLastReadPos;                    // 最后读取的数据包时间，单位 AV_TIME_BASE
 
     AudioDevice *mAudioDevice;               // 音频输出设备
+    bool mSharedAudio;                       // mAudioDevice 是否为共享音频输出的混音输入
+    VideoDevice *mVideoDevice;               // 视频输出设备
+    int mAudioDeviceRet;                     // 打开音频输出设备的结果
+    int64_t mAudioChannelLayout;             // 已打开的音频输出设备对应的声道布局
+    int mAudioChannels;                      // 已打开的音频输出设备对应的声道数
+    int mAudioSampleRate;                    // 已打开的音频输出设备对应的采样率
+    bool mAudioRendered;                     // 第一帧音频是否已输出
+    StartupTask *mPrewarmTask;               // 预热渲染环境的任务
+    StartupTask *mDeviceTask;                // 打开音频输出设备的任务
+    Thread *mPrewarmThread;                  // 预热渲染环境的线程
+    Mutex mPrewarmMutex;                     // 预热渲染环境时持有，修改 mVideoDevice 时同时持有，断开设备时等待预热完成
+    Thread *mDeviceThread;                   // 打开音频输出设备的线程
+
+    bool mPreloadRequest;                    // 预加载中，等待被取用
+    bool mPreloadFinished;                   // 预加载的数据包已读取完成
+    int64_t mPreloadBufferSize;              // 预加载时最多缓冲的数据包大小
+    bool mBudgetActive;                      // 是否已计入进程内存预算中正在播放的播放器
     AudioResampler *mAudioResampler;         // 音频重采样器
 
+    // 切换音轨
+    int mAudioSwitchIndex;                   // 请求切换的音频流索引，-1 表示没有
+    int mOpeningAudioIndex;                  // 辅助线程正在打开的音频流索引
+    AudioDecoder *mOpenedAudioDecoder;       // 辅助线程打开的音频解码器
+    bool mAudioSwitchOpened;                 // 辅助线程是否已经打开完成
+    AudioDecoder *mNextAudioDecoder;         // 接收数据包、等待音频回调接入的解码器
+    StartupTask *mAudioSwitchTask;           // 打开新音轨解码器的任务
+    Thread *mAudioSwitchThread;              // 打开新音轨解码器的线程
+
+    // 多音轨混音
+    std::map<int, float> mMixTracks;         // 请求混音的音频流索引和增益
+    bool mMixTracksChanged;                  // 混音请求是否改变
+    std::vector<AudioDecoder *> mMixDecoders; // 混音音轨的解码器，只在读数据包线程中使用
+
+    // 播放列表
+    Mutex mPlaylistMutex;                    // 播放列表锁
+    std::list<PlaylistItem> mPlaylist;       // 等待播放的条目
+    std::list<SpliceItem> mTimeline;         // 已经拼接到时间轴上的条目，第一个为正在播放，最后一个为正在读取
+    AVFormatContext *mTimelineCtx;           // 解码器所属的解复用上下文，时间轴的基准
+    int64_t mTimelineOrigin;                 // 第一个条目在时间轴上的偏移
+    int64_t mAudioEnd;                       // 已送给音频解码器的数据在时间轴上的结束位置
+    int64_t mVideoEnd;                       // 已送给视频解码器的数据在时间轴上的结束位置
+    int mPlaylistIndex;                      // 最后拼接的条目序号
+    bool mPrerollStarted;                    // 当前读取的条目是否已经开始提前打开下一个条目
+    PlaylistItem mNextItem;                  // 提前打开的下一个条目
+    AVFormatContext *mNextFormatCtx;         // 提前打开的下一个条目的解复用上下文
+    StartupTask *mPrerollTask;               // 提前打开下一个条目的任务
+    Thread *mPrerollThread;                  // 提前打开下一个条目的线程
+    PrerollInterrupt mPrerollInterrupts[2];  // 提前打开条目的中断回调参数，两个轮流使用
+    PrerollInterrupt *mPrerollInterrupt;     // 这次打开使用的中断回调参数
+
     MediaSync *mMediaSync;                   // 媒体同步器
 
 //    bool mIsRecording = false;               // 录制中
@@ -0,0 +1,134 @@
+#ifndef MEMORYBUDGET_H
+#define MEMORYBUDGET_H
+
+#include <mutex>
+#include "PlayerState.h"
+
+// 默认的进程内存上限，单位字节
+#define MEMORY_DEFAULT_BUDGET (128 * 1024 * 1024)
+// 正在播放的播放器、帧缓冲池、预加载各自分到的百分比
+#define MEMORY_ACTIVE_PERCENT 50
+#define MEMORY_FRAME_PERCENT 30
+#define MEMORY_PRELOAD_PERCENT 20
+// 单个播放器数据包队列的下限，单位字节
+#define PACKET_QUEUE_MIN_SIZE (1 * 1024 * 1024)
+// 按码率计算数据包队列大小时缓冲的时长，单位微秒
+#define PACKET_QUEUE_MAX_DURATION (10 * AV_TIME_BASE)
+// 数据包队列至少缓冲的时长，单位微秒
+#define PACKET_QUEUE_MIN_DURATION AV_TIME_BASE
+// 视频帧队列的下限
+#define FRAME_QUEUE_MIN_SIZE 2
+
+// 系统回调 onTrimMemory 的等级，与 ComponentCallbacks2 中的定义一致
+#define TRIM_MEMORY_RUNNING_MODERATE 5
+#define TRIM_MEMORY_RUNNING_CRITICAL 15
+#define TRIM_MEMORY_MODERATE 60
+
+/**
+ * 内存压力等级
+ */
+typedef enum {
+    MEMORY_PRESSURE_NONE = 0,       // 正常
+    MEMORY_PRESSURE_MODERATE = 1,   // 不再预加载，释放空闲的缓存
+    MEMORY_PRESSURE_CRITICAL = 2,   // 正在播放的队列也减半
+} MemoryPressure;
+
+/**
+ * 进程级内存预算
+ * 所有播放器共享一个内存上限，按比例分给正在播放的播放器、帧缓冲池和预加载池，
+ * 数据包队列按码率换算成字节数，视频帧队列按帧大小换算成帧数，内存压力升高时各部分按等级收缩
+ */
+class MemoryBudget {
+public:
+    static MemoryBudget *getInstance();
+
+    void destroy();
+
+    /**
+     * 设置进程内存上限，重新分配各部分的内存
+     * @param budget 单位字节
+     */
+    void setBudget(int64_t budget);
+
+    /**
+     * @return 进程内存上限，单位字节
+     */
+    int64_t getBudget();
+
+    /**
+     * 设置内存压力等级，收缩或者恢复各部分的内存
+     * @param pressure
+     */
+    void setPressure(MemoryPressure pressure);
+
+    /**
+     * @return 当前的内存压力等级
+     */
+    MemoryPressure getPressure();
+
+    /**
+     * 响应系统的内存回收请求：按等级设置内存压力，释放空闲的帧缓冲、预加载，严重时清空探测缓存
+     * @param level onTrimMemory 的等级
+     * @return 对应的内存压力等级，播放器据此释放自身的资源
+     */
+    MemoryPressure trimMemory(int level);
+
+    /**
+     * 播放器开始播放，参与分配正在播放部分的内存
+     */
+    void addActivePlayer();
+
+    /**
+     * 播放器停止播放
+     */
+    void removeActivePlayer();
+
+    /**
+     * 获取正在播放的播放器数据包队列的上限
+     * @param bitRate 媒体的码率，未知时为 0
+     * @return 单位字节
+     */
+    int64_t getPacketQueueLimit(int64_t bitRate);
+
+    /**
+     * @return 数据包队列至少缓冲的时长，单位微秒
+     */
+    int64_t getPacketQueueDuration();
+
+    /**
+     * 根据帧大小计算视频帧队列的长度
+     * @param width
+     * @param height
+     * @param format 像素格式，未知时按 YUV420P 计算
+     * @return 帧数
+     */
+    int getFrameQueueSize(int width, int height, int format);
+
+    /**
+     * @return 预加载可以使用的内存，单位字节
+     */
+    int64_t getPreloadBudget();
+
+private:
+    MemoryBudget();
+
+    virtual ~MemoryBudget();
+
+    /**
+     * 重新分配各部分的内存，并通知帧缓冲池和预加载池收缩
+     */
+    void rebalance();
+
+    static MemoryBudget *instance;
+    static std::mutex mutex;
+
+    std::mutex mLock;
+    int64_t mBudget;                // 进程内存上限
+    MemoryPressure mPressure;       // 内存压力等级
+    int mActivePlayers;             // 正在播放的播放器数量
+    int64_t mActiveShare;           // 正在播放的播放器分到的内存
+    int64_t mFrameShare;            // 帧缓冲池分到的内存
+    int64_t mPreloadShare;          // 预加载分到的内存
+};
+
+#endif //MEMORYBUDGET_H
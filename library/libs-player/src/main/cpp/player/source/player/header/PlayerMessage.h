@@ -35,5 +35,13 @@
 #define MSG_REQUEST_SEEK                0x203   // 请求定位
 
 #define MSG_CURRENT_POSITION             0x300   // 当前时钟
+#define MSG_STARTUP_TIMING              0x301   // 起播耗时，arg1 为阶段(StartupPhase)，arg2 为耗时(毫秒)
+#define MSG_PLAYLIST_ITEM_STARTED       0x302   // 播放列表无缝切换到下一个条目，arg1 为条目序号(第一个为 0)
+#define MSG_AUDIO_TRACK_CHANGED         0x303   // 切换音轨完成，arg1 为新的音频流索引
+
+// MSG_ERROR 的错误码(arg1)
+
+#define ERROR_UNKNOWN                   0       // 未知错误
+#define ERROR_TIMED_OUT                 -110    // 超时，arg2 为超时阶段(InterruptPhase)
 
 #endif //PLAYERMESSAGE_H
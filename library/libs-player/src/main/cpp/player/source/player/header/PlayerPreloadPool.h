@@ -0,0 +1,117 @@
+#ifndef PLAYERPRELOADPOOL_H
+#define PLAYERPRELOADPOOL_H
+
+#include <mutex>
+#include <list>
+#include <string>
+#include <vector>
+#include "MediaPlayer.h"
+
+// 默认最多预加载的播放器数量
+#define PRELOAD_DEFAULT_MAX_PLAYERS 3
+// 默认预加载占用的内存上限，单位字节
+#define PRELOAD_DEFAULT_MEMORY_BUDGET (24 * 1024 * 1024)
+
+/**
+ * 预加载的播放器
+ */
+typedef struct PreloadEntry {
+    std::string url;        // 文件路径
+    MediaPlayer *player;    // 预加载的播放器
+} PreloadEntry;
+
+/**
+ * 预加载播放器池
+ * 提前打开即将播放的文件，缓冲第一个 GOP 并解码出第一帧，显示时直接取用已准备好的播放器
+ */
+class PlayerPreloadPool {
+public:
+    static PlayerPreloadPool *getInstance();
+
+    void destroy();
+
+    /**
+     * 设置预加载策略，超出时按最久没有使用的顺序移除
+     * @param maxPlayers 最多预加载的播放器数量
+     * @param memoryBudget 预加载占用的内存上限，单位字节
+     */
+    void setPolicy(int maxPlayers, int64_t memoryBudget);
+
+    /**
+     * 预加载，已经在预加载的文件只更新使用顺序
+     * @param url 文件路径
+     * @param offset 文件偏移量
+     * @param headers 文件头信息
+     * @return 0 为成功
+     */
+    int preload(const char *url, int64_t offset = 0, const char *headers = NULL);
+
+    /**
+     * 取出预加载的播放器，取出后由调用者负责释放
+     * @param url 文件路径
+     * @return 播放器，没有预加载则返回 NULL
+     */
+    MediaPlayer *acquire(const char *url);
+
+    /**
+     * 预加载是否已完成
+     * @param url 文件路径
+     * @return
+     */
+    bool isReady(const char *url);
+
+    /**
+     * 取消预加载
+     * @param url 文件路径
+     */
+    void remove(const char *url);
+
+    /**
+     * 取消所有预加载
+     */
+    void clear();
+
+    /**
+     * @return 预加载占用的内存，单位字节
+     */
+    int64_t getMemorySize();
+
+    /**
+     * 按当前的内存预算移除超出的预加载，内存预算变化时调用
+     */
+    void shrink();
+
+private:
+    PlayerPreloadPool();
+
+    virtual ~PlayerPreloadPool();
+
+    std::list<PreloadEntry>::iterator find(const char *url);
+
+    /**
+     * @return 实际可用的内存上限，不超过进程内存预算分给预加载的部分
+     */
+    int64_t getMemoryBudget();
+
+    /**
+     * 超出数量或者内存上限时移除最久没有使用的预加载
+     * @param evicted 被移除的播放器，在锁外释放
+     */
+    void trim(std::vector<MediaPlayer *> &evicted);
+
+    /**
+     * 释放播放器，交给回收线程销毁
+     * @param players
+     */
+    void release(std::vector<MediaPlayer *> &players);
+
+    static PlayerPreloadPool *instance;
+    static std::mutex mutex;
+
+    std::mutex mLock;
+    std::list<PreloadEntry> mEntries;   // 最近使用的放在最前面
+    int mMaxPlayers;                    // 最多预加载的播放器数量
+    int64_t mMemoryBudget;              // 预加载占用的内存上限
+};
+
+#endif //PLAYERPRELOADPOOL_H
@@ -0,0 +1,104 @@
+#ifndef PLAYERREAPER_H
+#define PLAYERREAPER_H
+
+#include <mutex>
+#include <list>
+#include "MediaPlayer.h"
+
+// 最多等待销毁的播放器数量
+#define REAPER_MAX_PENDING_PLAYERS 4
+// 等待销毁的播放器占用的内存上限，单位字节
+#define REAPER_MAX_PENDING_MEMORY (32 * 1024 * 1024)
+
+/**
+ * 软重置完成后接收播放器
+ */
+class RecycleListener {
+public:
+    virtual ~RecycleListener() {}
+
+    /**
+     * 软重置完成，在回收线程中调用，回调中不能再调用 PlayerReaper 的方法
+     * @param player 软重置后的播放器
+     * @return 被替换下来的播放器，由回收线程销毁，没有则返回 NULL
+     */
+    virtual MediaPlayer *onPlayerRecycled(MediaPlayer *player) = 0;
+};
+
+/**
+ * 等待销毁的播放器
+ */
+typedef struct ReapEntry {
+    MediaPlayer *player;        // 播放器
+    VideoDevice *videoDevice;   // 播放器使用的视频输出设备，可以为空
+    RecycleListener *listener;  // 不为空时只软重置，完成后交还给它；为空时销毁播放器
+    int64_t memorySize;         // 播放器占用的内存
+} ReapEntry;
+
+/**
+ * 播放器回收线程
+ * 等待线程退出、关闭解码器、销毁音频和渲染资源都比较耗时，释放播放器时交给后台线程执行，
+ * 等待销毁的数量或内存超出上限时在调用线程中直接销毁
+ */
+class PlayerReaper : public Runnable {
+public:
+    static PlayerReaper *getInstance();
+
+    void destroy();
+
+    /**
+     * 释放播放器，播放器需要先调用 detach 解除关联
+     * @param player 播放器，释放后不能再使用
+     * @param videoDevice 跟随播放器一起销毁的视频输出设备，在播放器销毁后销毁
+     */
+    void release(MediaPlayer *player, VideoDevice *videoDevice = NULL);
+
+    /**
+     * 在回收线程中软重置播放器，完成后交还给 listener，播放器需要先调用 detach 解除关联
+     * @param player 播放器
+     * @param listener 接收软重置后的播放器
+     */
+    void recycle(MediaPlayer *player, RecycleListener *listener);
+
+    /**
+     * 取消交还给 listener，还没有交还的播放器直接销毁，返回后不会再回调 listener
+     * @param listener
+     */
+    void cancelRecycle(RecycleListener *listener);
+
+    /**
+     * @return 等待销毁的播放器数量
+     */
+    int getPendingCount();
+
+    /**
+     * @return 等待销毁的播放器占用的内存，单位字节
+     */
+    int64_t getPendingMemory();
+
+protected:
+    void run() override;
+
+private:
+    PlayerReaper();
+
+    virtual ~PlayerReaper();
+
+    /**
+     * 销毁播放器以及视频输出设备
+     * @param entry
+     */
+    void reap(ReapEntry &entry);
+
+    static PlayerReaper *instance;
+    static std::mutex mutex;
+
+    Mutex mMutex;
+    Condition mCondition;
+    Thread *mThread;                    // 回收线程
+    bool mAbortRequest;                 // 退出标志
+    std::list<ReapEntry> mEntries;      // 等待销毁的播放器
+    int64_t mPendingMemory;             // 等待销毁的播放器占用的内存
+};
+
+#endif //PLAYERREAPER_H
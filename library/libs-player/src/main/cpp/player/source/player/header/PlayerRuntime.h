@@ -0,0 +1,92 @@
+#ifndef PLAYERRUNTIME_H
+#define PLAYERRUNTIME_H
+
+#include <mutex>
+#include "PlayerState.h"
+
+#if defined(__ANDROID__)
+
+#include <SLES/OpenSLES.h>
+#include <SLES/OpenSLES_Android.h>
+
+#endif
+
+/**
+ * 播放器进程级运行环境
+ * FFmpeg 全局初始化、锁管理回调以及 OpenSL 引擎在进程内只创建一次，按引用计数管理，
+ * 第一个引用时初始化，最后一个引用释放时反初始化
+ */
+class PlayerRuntime : public Runnable {
+public:
+    static PlayerRuntime *getInstance();
+
+    void destroy();
+
+    /**
+     * 增加引用，第一次引用时初始化 FFmpeg 并注册锁管理回调
+     */
+    void acquire();
+
+    /**
+     * 减少引用，最后一个引用释放时反初始化 FFmpeg 并销毁 OpenSL 引擎
+     */
+    void release();
+
+    /**
+     * 预热：在后台线程中提前创建共享的 OpenSL 引擎和混音器，并在临时上下文中编译常用的输入/输出着色器程序，
+     * 渲染部分只预热驱动，上下文和着色器程序不会交给播放器使用；预热会一直持有一个引用，多次调用只执行一次
+     */
+    void prewarm();
+
+#if defined(__ANDROID__)
+
+    /**
+     * 获取共享的 OpenSL 引擎和混音器，还没有创建时会先创建
+     * @param engine 引擎接口
+     * @param outputMix 混音器
+     * @return 0 为成功
+     */
+    int getAudioEngine(SLEngineItf *engine, SLObjectItf *outputMix);
+
+#endif
+
+protected:
+    void run() override;
+
+private:
+    PlayerRuntime();
+
+    virtual ~PlayerRuntime();
+
+    /**
+     * 创建 OpenSL 引擎和混音器，需要持有 mLock
+     * @return 0 为成功
+     */
+    int createAudioEngine();
+
+    /**
+     * 销毁 OpenSL 引擎和混音器，需要持有 mLock
+     */
+    void releaseAudioEngine();
+
+    /**
+     * 在临时上下文的离屏 Surface 中编译输入/输出着色器程序，让驱动缓存编译结果，上下文用完即销毁
+     */
+    void prewarmRender();
+
+    static PlayerRuntime *instance;
+    static std::mutex mutex;
+
+    std::mutex mLock;
+    int mRefCount;                      // 引用计数
+    bool mPrewarmed;                    // 是否已经预热
+    Thread *mPrewarmThread;             // 预热线程
+
+#if defined(__ANDROID__)
+    SLObjectItf mSLObject;              // 引擎对象
+    SLEngineItf mSLEngine;              // 引擎接口
+    SLObjectItf mSLOutputMixObject;     // 混音器
+#endif
+};
+
+#endif //PLAYERRUNTIME_H
@@ -59,6 +59,58 @@ typedef enum {
     AV_SYNC_EXTERNAL,   // 同步到外部时钟
 } SyncType;
 
+// 默认各阶段超时时长，单位微秒
+#define DEFAULT_OPEN_TIMEOUT  (15 * AV_TIME_BASE)
+#define DEFAULT_PROBE_TIMEOUT (15 * AV_TIME_BASE)
+#define DEFAULT_READ_TIMEOUT  (10 * AV_TIME_BASE)
+#define DEFAULT_SEEK_TIMEOUT  (10 * AV_TIME_BASE)
+
+// 播放列表默认提前打开下一个条目的时间，单位微秒
+#define DEFAULT_PREROLL_LEAD_TIME (5 * AV_TIME_BASE)
+
+// 网络流断开后默认的重连次数
+#define DEFAULT_RECONNECT_COUNT 5
+
+// 探测结果缓存范围(probe_cache)
+#define PROBE_CACHE_NONE    0   // 不使用缓存
+#define PROBE_CACHE_LOCAL   1   // 只缓存本地文件，以文件大小和修改时间校验
+#define PROBE_CACHE_NETWORK 2   // 网络流也缓存，拿不到 ETag/Last-Modified，只能以大小校验
+// 重连退避时长，单位微秒，第一次立即重连，之后按倍数递增
+#define RECONNECT_DELAY_MIN (200 * 1000)
+#define RECONNECT_DELAY_MAX (3 * AV_TIME_BASE)
+
+/**
+ * 解复用阻塞阶段，中断回调根据当前阶段的截止时间判断是否超时
+ */
+typedef enum {
+    INTERRUPT_PHASE_NONE = 0,   // 不做超时检测
+    INTERRUPT_PHASE_OPEN = 1,   // avformat_open_input
+    INTERRUPT_PHASE_PROBE = 2,  // avformat_find_stream_info
+    INTERRUPT_PHASE_READ = 3,   // av_read_frame
+    INTERRUPT_PHASE_SEEK = 4,   // avformat_seek_file
+} InterruptPhase;
+
+/**
+ * 起播阶段，用于统计首帧耗时(TTFF)
+ */
+typedef enum {
+    STARTUP_PHASE_OPEN_INPUT = 1,       // 打开文件完成
+    STARTUP_PHASE_FIND_STREAM_INFO = 2, // 查找媒体流信息完成
+    STARTUP_PHASE_PREPARE_DECODER = 3,  // 打开解码器完成
+    STARTUP_PHASE_OPEN_DEVICE = 4,      // 打开音频输出设备完成
+    STARTUP_PHASE_VIDEO_RENDERING = 5,  // 第一帧视频已渲染
+    STARTUP_PHASE_AUDIO_RENDERING = 6,  // 第一帧音频已输出
+} StartupPhase;
+
+/**
+ * 变速变调算法，数值与 Java 层 TimeStretcher 保持一致
+ */
+typedef enum {
+    TIME_STRETCHER_AUTO = 0,        // 按速度、音调和内容自动选择
+    TIME_STRETCHER_SOUNDTOUCH = 1,  // SoundTouch，支持变调
+    TIME_STRETCHER_ATEMPO = 2,      // libavfilter atempo，只变速不变调，高倍速时开销更低
+} TimeStretcherType;
+
 struct AVDictionary {
     int count;
     // 可用于配置音视频参数，此结构体是一个 key-value 的形式
@@ -78,6 +130,29 @@ public:
 
     void setOptionLong(int category, const char *type, int64_t option);
 
+    /**
+     * 进入阻塞阶段，按该阶段的超时时长设置截止时间
+     * @param phase 阻塞阶段
+     */
+    void beginInterruptPhase(InterruptPhase phase);
+
+    /**
+     * 离开阻塞阶段，清除截止时间
+     */
+    void endInterruptPhase();
+
+    /**
+     * 当前阶段是否已超过截止时间，超时则记录到 timeout_phase
+     * @return 1 为超时
+     */
+    int checkInterruptTimeout();
+
+    /**
+     * 通知起播阶段的耗时，arg1 为阶段，arg2 为距离开始准备的毫秒数
+     * @param phase 起播阶段
+     */
+    void postStartupTiming(StartupPhase phase);
+
 private:
     void init();
 
@@ -126,12 +201,45 @@ public:
     int seek_flags;     // 定位标志
     int64_t seek_pos;   // 定位位置
     int64_t seek_rel;   // 定位偏移
+    int seek_serial;    // 定位完成的次数，音频输出据此丢弃定位前的数据
 
     int auto_exit;          // 是否自动退出
     int loop;               // 循环播放
     int mute;               // 静音播放
+    float left_volume;      // 左声道音量，0 ~ 1，在输出前由软件增益处理
+    float right_volume;     // 右声道音量，0 ~ 1
     int frame_drop;         // 舍帧操作
     int reorder_video_pts;  // 视频帧重排pts
+
+    int64_t open_timeout;   // 打开文件超时，单位微秒，<= 0 不限制
+    int64_t probe_timeout;  // 查找媒体流信息超时，单位微秒，<= 0 不限制
+    int64_t read_timeout;   // 读取数据包超时，单位微秒，<= 0 不限制
+    int64_t seek_timeout;   // 定位超时，单位微秒，<= 0 不限制
+
+    InterruptPhase interrupt_phase; // 当前阻塞阶段
+    int64_t interrupt_deadline;     // 当前阶段的截止时间(av_gettime_relative)，0 表示不限制
+    InterruptPhase timeout_phase;   // 发生超时的阶段，INTERRUPT_PHASE_NONE 表示没有超时，上报错误之前一直保留
+
+    int reconnect_count;    // 网络流断开后的重连次数，0 为不重连
+    int probe_cache;        // 探测结果缓存范围(PROBE_CACHE_XXX)，命中时跳过 avformat_find_stream_info
+
+    int fast_start;         // 快速起播，解码器与设备并行打开，视频第一帧不等待开始播放就先显示
+    int64_t startup_time;   // 开始准备的时间(av_gettime_relative)，用于统计起播耗时
+
+    int64_t preroll_lead_time;  // 播放列表在当前条目结束前多久打开下一个条目，单位微秒
+    int64_t timeline_offset;    // 正在播放的条目在时间轴上相对第一个条目的偏移，单位微秒，计算播放位置时减去
+
+    int frame_pool;         // 视频帧是否从共享的帧缓冲池分配，默认关闭
+
+    char *vfilters;         // 视频滤镜描述，如 "yadif,hqdn3d"，为空时不使用滤镜
+    int filter_threads;     // 滤镜线程数，0 为自动
+    char *afilters;         // 音频滤镜描述，如 "loudnorm"，为空时不使用滤镜
+
+    int shared_audio;       // 是否使用进程内共享的软件混音输出，多个播放器同时播放时只打开一个音频输出设备
+
+    TimeStretcherType time_stretcher;   // 变速变调算法
+    int speech;             // 内容以语音为主，自动选择变速算法以及 SoundTouch 的参数按语音调整
+    int audio_analyzer;     // 是否分析输出音频的电平和频谱
 };
 
 #endif //PLAYERSTATE_H
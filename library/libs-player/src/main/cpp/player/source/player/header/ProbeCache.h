@@ -0,0 +1,129 @@
+#ifndef PROBECACHE_H
+#define PROBECACHE_H
+
+#include <atomic>
+#include <mutex>
+#include <list>
+#include <string>
+#include <vector>
+#include "PlayerState.h"
+
+// 最多缓存的探测结果数量
+#define PROBE_CACHE_MAX_ENTRIES 32
+
+// 命中缓存以后，媒体流需要读取数据包才能创建时(如flv)使用的最小探测参数
+#define PROBE_CACHE_PROBESIZE 32768
+#define PROBE_CACHE_ANALYZE_DURATION (AV_TIME_BASE / 10)
+
+/**
+ * 缓存的媒体流参数
+ */
+typedef struct ProbeStream {
+    AVCodecParameters *codecpar;    // 解码参数，包括 extradata
+    uint32_t extradata_crc;         // extradata 的 CRC32 校验值
+    AVRational avg_frame_rate;      // 平均帧率
+    AVRational r_frame_rate;        // 实际帧率
+    int64_t start_time;             // 媒体流起始时间
+    int64_t duration;               // 媒体流时长
+} ProbeStream;
+
+/**
+ * 缓存的探测结果，以 url + 文件大小 + 修改时间 作为标识
+ */
+typedef struct ProbeEntry {
+    std::string url;                    // 文件路径
+    int64_t size;                       // 文件大小
+    int64_t mtime;                      // 文件修改时间，网络流为 0
+    std::string formatName;             // 封装格式名称
+    int64_t start_time;                 // 起始时间
+    int64_t duration;                   // 时长
+    int64_t bit_rate;                   // 码率
+    std::vector<ProbeStream> streams;   // 媒体流参数
+} ProbeEntry;
+
+/**
+ * avformat_find_stream_info 探测结果缓存
+ * 重复打开同一个文件时跳过媒体流信息的查找，直接恢复解码参数后打开解码器
+ */
+class ProbeCache {
+public:
+    static ProbeCache *getInstance();
+
+    void destroy();
+
+    /**
+     * 打开文件前查找缓存的封装格式，只有本地文件在打开前就能校验文件大小和修改时间
+     * @param url 文件路径
+     * @return 封装格式，没有缓存则返回 NULL
+     */
+    AVInputFormat *findInputFormat(const char *url);
+
+    /**
+     * 查找与已打开文件匹配的缓存
+     * @param ic 已打开的解复用上下文
+     * @param url 文件路径
+     * @param network 是否查找网络流的缓存(PROBE_CACHE_NETWORK)
+     * @return 缓存的媒体流数量，没有命中则返回 -1
+     */
+    int lookup(AVFormatContext *ic, const char *url, bool network);
+
+    /**
+     * 将缓存的解码参数恢复到媒体流中，媒体流和缓存不一致时移除缓存
+     * @param ic 已打开的解复用上下文
+     * @param url 文件路径
+     * @return 0 为恢复成功
+     */
+    int restore(AVFormatContext *ic, const char *url);
+
+    /**
+     * 保存完整的探测结果
+     * @param ic 已查找媒体流信息的解复用上下文
+     * @param url 文件路径
+     * @param network 是否缓存网络流(PROBE_CACHE_NETWORK)，网络流只能以文件大小校验
+     */
+    void store(AVFormatContext *ic, const char *url, bool network);
+
+    /**
+     * 移除缓存
+     * @param url 文件路径
+     */
+    void remove(const char *url);
+
+    /**
+     * 清空所有缓存
+     */
+    void clear();
+
+private:
+    ProbeCache();
+
+    virtual ~ProbeCache();
+
+    /**
+     * 获取文件标识，pipe/fd 等无法标识的输入不缓存
+     * @param network 是否允许网络流，不允许时只有本地文件可以缓存
+     * @return 0 为可以缓存
+     */
+    int getFileIdentity(AVFormatContext *ic, const char *url, bool network, int64_t *size, int64_t *mtime);
+
+    /**
+     * 打开文件后已知的解码参数是否和缓存一致，文件头里没有给出的参数不比较
+     * @param codecpar 打开文件后得到的解码参数
+     * @param cached 缓存的媒体流参数
+     */
+    static bool isSameStream(AVCodecParameters *codecpar, const ProbeStream &cached);
+
+    static uint32_t getExtradataCrc(AVCodecParameters *codecpar);
+
+    std::list<ProbeEntry>::iterator find(const char *url);
+
+    void freeEntry(ProbeEntry &entry);
+
+    static std::atomic<ProbeCache *> instance;
+    static std::mutex mutex;
+
+    std::mutex mLock;
+    std::list<ProbeEntry> mEntries;     // 最近使用的放在最前面
+};
+
+#endif //PROBECACHE_H
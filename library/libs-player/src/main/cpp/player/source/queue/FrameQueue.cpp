@@ -3,6 +3,7 @@
 FrameQueue::FrameQueue(int max_size, int keep_last) {
     memset(mQueue, 0, sizeof(Frame) * FRAME_QUEUE_SIZE);
     this->mMaxSize = FFMIN(max_size, FRAME_QUEUE_SIZE);
+    this->mLimit = mMaxSize;
     this->mKeepLast = (keep_last != 0);
     // 为数组元素frame分配空间
     for (int i = 0; i < this->mMaxSize; ++i) {
@@ -52,7 +53,7 @@ Frame *FrameQueue::lastFrame() {
 Frame *FrameQueue::peekWritable() {
     mMutex.lock();
     // 如果当前队列的大小已经超过了允许最大的值mMaxSize,那么就先等待
-    while (mSize >= mMaxSize && !mAbortRequest) {
+    while (mSize >= mLimit && !mAbortRequest) {
         mCondition.wait(mMutex);
     }
     mMutex.unlock();
@@ -107,4 +108,11 @@ void FrameQueue::unrefFrame(Frame *vp) {
 
 int FrameQueue::getShowIndex() const {
     return mShowIndex;
+}
+
+void FrameQueue::setLimit(int limit) {
+    mMutex.lock();
+    mLimit = FFMAX(FFMIN(limit, mMaxSize), 1);
+    mCondition.signal();
+    mMutex.unlock();
 }
\ No newline at end of file
@@ -92,6 +92,12 @@ public:
      */
     int getShowIndex() const;
 
+    /**
+     * 限制队列中最多缓冲的帧数，不超过创建时的长度，内存紧张时减少缓冲
+     * @param limit
+     */
+    void setLimit(int limit);
+
 private:
     /**
      * @param vp
@@ -107,6 +113,7 @@ private:
     int mW_index;                   //
     int mSize;                      //
     int mMaxSize;                   //
+    int mLimit;                     // 当前允许缓冲的帧数
     int mKeepLast;                  // 表示是否保持最后一个元素
     int mShowIndex;                 //
 };
@@ -106,3 +106,7 @@ bool RenderNode::hasFrameBuffer() const {
     return (frameBuffer != nullptr);
 }
 
+bool RenderNode::hasFrameBuffer(int width, int height) const {
+    return frameBuffer != nullptr && frameBuffer->getWidth() == width && frameBuffer->getHeight() == height;
+}
+
@@ -106,8 +106,8 @@ void RenderNodeList::setTextureSize(int width, int height) {
     RenderNode *node = head;
     while (node != nullptr) {
         node->setTextureSize(width, height);
-        // 创建渲染结点的FBO
-        if (node->getNodeType() != NODE_DISPLAY && !node->hasFrameBuffer()) {
+        // 创建渲染结点的FBO，大小变化时重新创建
+        if (node->getNodeType() != NODE_DISPLAY && !node->hasFrameBuffer(width, height)) {
             FrameBuffer *frameBuffer = new FrameBuffer(width, height);
             frameBuffer->init();
             // 每个节点都有一个FBO，用来保存节点滤镜的渲染结果
@@ -117,6 +117,16 @@ void RenderNodeList::setTextureSize(int width, int height) {
     }
 }
 
+void RenderNodeList::releaseFrameBuffers() {
+    RenderNode *node = head;
+    while (node != nullptr) {
+        if (node->hasFrameBuffer()) {
+            node->setFrameBuffer(nullptr);
+        }
+        node = node->nextNode;
+    }
+}
+
 void RenderNodeList::setDisplaySize(int width, int height) {
     RenderNode *node = head;
     // 遍历所有的节点并设置视口的大小
@@ -111,6 +111,14 @@ public:
      */
     bool hasFrameBuffer() const;
 
+    /**
+     * 是否有与指定大小一致的 FBO
+     * @param width
+     * @param height
+     * @return
+     */
+    bool hasFrameBuffer(int width, int height) const;
+
 
 public:
     // 前继结点
@@ -48,6 +48,11 @@ public:
      */
     void setTextureSize(int width, int height);
 
+    /**
+     * 释放所有节点的 FBO，着色器程序保留，下次设置纹理大小时重新创建
+     */
+    void releaseFrameBuffers();
+
     /**
      * 设置显示大小
      * @param width
@@ -1,4 +1,5 @@
 #include "MediaSync.h"
+#include "FrameBufferPool.h"
 
 MediaSync::MediaSync(PlayerState *playerState) {
     this->mPlayerState = playerState;
@@ -18,6 +19,9 @@ MediaSync::MediaSync(PlayerState *playerState) {
     mFrameTimer = 0;
 
     mVideoDevice = NULL;
+    mDetachedDevice = NULL;
+    mFirstFrameRendered = false;
+    mTrimPressure = MEMORY_PRESSURE_NONE;
     swsContext = NULL;
     mBuffer = NULL;
     pFrameARGB = NULL;
@@ -31,6 +35,7 @@ void MediaSync::reset() {
     mVideoDecoder = NULL;
     mAudioDecoder = NULL;
     mVideoDevice = NULL;
+    mDetachedDevice = NULL;
 
     if (pFrameARGB) {
         av_frame_free(&pFrameARGB);
@@ -53,6 +58,7 @@ void MediaSync::start(VideoDecoder *video_decoder, AudioDecoder *audio_decoder)
     this->mAudioDecoder = audio_decoder;
     mIsAbortRequest = false;
     mIsExit = false;
+    mFirstFrameRendered = false;
     mCondition.signal();
     mMutex.unlock();
     if (video_decoder && !mSyncThread) {
@@ -62,6 +68,11 @@ void MediaSync::start(VideoDecoder *video_decoder, AudioDecoder *audio_decoder)
     }
 }
 
+void MediaSync::setAudioDecoder(AudioDecoder *audio_decoder) {
+    Mutex::Autolock lock(mMutex);
+    this->mAudioDecoder = audio_decoder;
+}
+
 void MediaSync::stop() {
     mMutex.lock();
     mIsAbortRequest = true;
@@ -81,9 +92,39 @@ void MediaSync::stop() {
     }
 }
 
+void MediaSync::flush() {
+    Mutex::Autolock lock(mMutex);
+    mAudioClock->init();
+    mVideoClock->init();
+    mExtClock->init();
+    mForceRefresh = 0;
+    mFrameTimerRefresh = 1;
+    mFrameTimer = 0;
+    mFirstFrameRendered = false;
+}
+
 void MediaSync::setVideoDevice(VideoDevice *device) {
     Mutex::Autolock lock(mMutex);
+    // 渲染上下文关联在同步线程上，需要由同步线程解除关联，其它线程才能继续使用这个设备
+    if (mSyncThread && mVideoDevice && mVideoDevice != device) {
+        mDetachedDevice = mVideoDevice;
+    }
     this->mVideoDevice = device;
+    // 等待同步线程解除关联，否则下一个播放器关联同一个上下文时会失败(EGL_BAD_ACCESS)
+    while (mDetachedDevice != NULL && !mIsExit) {
+        mCondition.wait(mMutex);
+    }
+    // 同步线程已经退出，线程退出时上下文随之释放
+    mDetachedDevice = NULL;
+}
+
+void MediaSync::unbindDetachedDevice() {
+    Mutex::Autolock lock(mMutex);
+    if (mDetachedDevice != NULL) {
+        mDetachedDevice->unbindContext();
+        mDetachedDevice = NULL;
+        mCondition.broadcast();
+    }
 }
 
 void MediaSync::setMaxDuration(double maxDuration) {
@@ -97,6 +138,37 @@ void MediaSync::refreshVideoTimer() {
     mMutex.unlock();
 }
 
+void MediaSync::trimMemory(MemoryPressure pressure) {
+    Mutex::Autolock lock(mMutex);
+    if (pressure > mTrimPressure) {
+        mTrimPressure = pressure;
+    }
+}
+
+void MediaSync::performTrim() {
+    mMutex.lock();
+    MemoryPressure pressure = mTrimPressure;
+    mTrimPressure = MEMORY_PRESSURE_NONE;
+    mMutex.unlock();
+    // 正在播放时丢帧会卡顿，只处理暂停的播放器
+    if (pressure == MEMORY_PRESSURE_NONE || !mPlayerState->pause_request) {
+        return;
+    }
+    if (mVideoDecoder) {
+        // 解码线程最多再缓冲一帧，还没有显示的帧全部丢弃，恢复播放时重新放开
+        FrameQueue *frameQueue = mVideoDecoder->getFrameQueue();
+        frameQueue->setLimit(1);
+        while (frameQueue->getFrameSize() > 0) {
+            frameQueue->popFrame();
+        }
+    }
+    if (pressure >= MEMORY_PRESSURE_CRITICAL && mVideoDevice) {
+        mVideoDevice->onTrimMemory();
+    }
+    // 丢弃的帧回到缓冲池后释放
+    FrameBufferPool::getInstance()->trim();
+}
+
 void MediaSync::updateAudioClock(double pts, double time) {
     mAudioClock->setClock(pts, time);
     mExtClock->syncToSlave(mAudioClock);
@@ -145,6 +217,9 @@ void MediaSync::run() {
     double remaining_time = 0.0;
 
     while (true) {
+        unbindDetachedDevice();
+        performTrim();
+
         if (mIsAbortRequest || mPlayerState->abort_request) { //停止
             if (mVideoDevice != NULL) {
                 LOGE("MediaSync->mIsAbortRequest%d mAbortRequest%d", mIsAbortRequest, mPlayerState->abort_request);
@@ -158,14 +233,35 @@ void MediaSync::run() {
         }
         remaining_time = REFRESH_RATE; //刷新率
 
+        // Surface 重新创建后立即在新窗口上重绘最后一帧，暂停或者缓冲时也不会黑屏
+        if (mVideoDevice != NULL) {
+            mVideoDevice->onRedraw();
+        }
+
         // 暂停的时候会停留在这里
         if (!mPlayerState->pause_request || mForceRefresh) {
             refreshVideo(&remaining_time);
+        } else if (mPlayerState->fast_start && !mFirstFrameRendered) {
+            renderFirstFrame();
         }
     }
 
+    // 在锁内设置退出标志，等待解除设备关联的线程不会错过通知
+    mMutex.lock();
     mIsExit = true;
-    mCondition.signal();
+    mCondition.broadcast();
+    mMutex.unlock();
+}
+
+void MediaSync::renderFirstFrame() {
+    if (mPlayerState->display_disable || !mVideoDecoder || mVideoDecoder->getFrameSize() <= 0) {
+        return;
+    }
+    // 第一次出队只是标记显示，帧仍保留在队列中，开始播放后从这一帧继续同步
+    if (!mVideoDecoder->getFrameQueue()->getShowIndex()) {
+        mVideoDecoder->getFrameQueue()->popFrame();
+    }
+    renderVideo();
 }
 
 void MediaSync::refreshVideo(double *remaining_time) {
@@ -282,6 +378,8 @@ void MediaSync::refreshVideo(double *remaining_time) {
 //        if (start_time > 0 && start_time != AV_NOPTS_VALUE) {
             start_diff = av_rescale(start_time, 1000, AV_TIME_BASE);
         }
+        // 播放列表中减去正在播放的条目的偏移
+        start_diff += av_rescale(mPlayerState->timeline_offset, 1000, AV_TIME_BASE);
         // 计算主时钟的时间
         int64_t pos;
         double clock = getMasterClock();
@@ -311,6 +409,7 @@ void MediaSync::refreshVideo(double *remaining_time) {
 }
 
 void MediaSync::checkExternalClockSpeed() {
+    Mutex::Autolock lock(mMutex);
     if ((mVideoDecoder && mVideoDecoder->getPacketSize() <= EXTERNAL_CLOCK_MIN_FRAMES) ||
         (mAudioDecoder && mAudioDecoder->getPacketSize() <= EXTERNAL_CLOCK_MIN_FRAMES)) {
 
@@ -379,6 +478,8 @@ long MediaSync::getCurrentPosition() {
 //        if (start_time > 0 && start_time != AV_NOPTS_VALUE) {
             start_diff = av_rescale(start_time, 1000, AV_TIME_BASE);
         }
+        // 播放列表中减去正在播放的条目的偏移
+        start_diff += av_rescale(mPlayerState->timeline_offset, 1000, AV_TIME_BASE);
 
         // 计算主时钟的时间
         int64_t pos;
@@ -547,6 +648,14 @@ void MediaSync::renderVideo() {
         // 设置视频播放的时间戳
         mVideoDevice->setTimeStamp(isnan(vp->pts) ? 0 : vp->pts);
         mVideoDevice->onRequestRender(vp->frame->linesize[0] < 0);
+        // 第一帧已渲染
+        if (!mFirstFrameRendered) {
+            mFirstFrameRendered = true;
+            if (mPlayerState->message_queue) {
+                mPlayerState->message_queue->postMessage(MSG_VIDEO_RENDERING_START);
+            }
+            mPlayerState->postStartupTiming(STARTUP_PHASE_VIDEO_RENDERING);
+        }
     }
     // 当文件没有音频的时候，用视频时间戳来通知当前播放时间
     if (mAudioDecoder == NULL && mPlayerState->message_queue) {
@@ -7,6 +7,7 @@
 #include "AudioDecoder.h"
 
 #include "VideoDevice.h"
+#include "MemoryBudget.h"
 
 /**
  * 视频媒体同步器
@@ -33,12 +34,24 @@ public:
      */
     void start(VideoDecoder *video_decoder, AudioDecoder *audio_decoder);
 
+    /**
+     * 切换音轨后替换音频解码器
+     * @param audio_decoder
+     */
+    void setAudioDecoder(AudioDecoder *audio_decoder);
+
     /**
      */
     void stop();
 
     /**
-     * 设置视频输出设备
+     * 清空时钟和视频帧计时，复用播放器播放新的文件时调用
+     */
+    void flush();
+
+    /**
+     * 设置视频输出设备，替换掉的设备由同步线程解除渲染上下文的关联，
+     * 等到解除关联之后才返回，返回后替换掉的设备可以交给其它播放器使用
      * @param device
      */
     void setVideoDevice(VideoDevice *device);
@@ -56,6 +69,12 @@ public:
      */
     void refreshVideoTimer();
 
+    /**
+     * 请求释放暂停时不需要的内存，由同步线程丢弃还没有显示的视频帧，严重时释放渲染用的纹理和 FBO
+     * @param pressure
+     */
+    void trimMemory(MemoryPressure pressure);
+
     /**
      * 更新音频时钟
      * @param pts 当前播放的时间点，单位秒
@@ -111,6 +130,16 @@ public:
     void renderVideo();
 
 private:
+    /**
+     * 快速起播时，等待开始播放的过程中先显示解码出来的第一帧，不需要等待音频就绪
+     */
+    void renderFirstFrame();
+
+    /**
+     * 在同步线程中解除被替换的视频输出设备和渲染上下文的关联
+     */
+    void unbindDetachedDevice();
+
     /**
      * @param remaining_time
      */
@@ -133,6 +162,11 @@ private:
      */
     double calculateDuration(Frame *vp, Frame *nextvp);
 
+    /**
+     * 在同步线程中执行释放内存的请求
+     */
+    void performTrim();
+
 
 private:
     PlayerState *mPlayerState;    // 播放器状态
@@ -156,6 +190,9 @@ private:
     double mFrameTimer;           // 视频时钟
 
     VideoDevice *mVideoDevice;    // 视频输出设备
+    VideoDevice *mDetachedDevice; // 被替换的视频输出设备，等待解除渲染上下文的关联
+    bool mFirstFrameRendered;     // 第一帧视频是否已渲染
+    MemoryPressure mTrimPressure; // 等待同步线程执行的释放内存请求
 
     AVFrame *pFrameARGB;         //
     uint8_t *mBuffer;             //
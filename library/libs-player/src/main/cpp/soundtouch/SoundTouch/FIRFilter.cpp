@@ -318,6 +318,15 @@ FIRFilter * FIRFilter::newInstance()
     else
 #endif // SOUNDTOUCH_ALLOW_MMX
 
+#ifdef SOUNDTOUCH_ALLOW_AVX2
+    if (uExtensions & SUPPORT_AVX2)
+    {
+        // AVX2 + FMA support
+        return ::new FIRFilterAVX2;
+    }
+    else
+#endif // SOUNDTOUCH_ALLOW_AVX2
+
 #ifdef SOUNDTOUCH_ALLOW_SSE
     if (uExtensions & SUPPORT_SSE)
     {
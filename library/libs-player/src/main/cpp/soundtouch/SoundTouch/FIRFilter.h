@@ -141,6 +141,26 @@ public:
 
 #endif // SOUNDTOUCH_ALLOW_SSE
 
+
+#ifdef SOUNDTOUCH_ALLOW_AVX2
+    /// Class that implements AVX2/FMA optimized functions exclusive for floating point samples type.
+    class FIRFilterAVX2 : public FIRFilter
+    {
+    protected:
+        float *filterCoeffsUnalign;
+        float *filterCoeffsAlign;
+
+        virtual uint evaluateFilterStereo(float *dest, const float *src, uint numSamples) const;
+    public:
+        FIRFilterAVX2();
+        ~FIRFilterAVX2();
+
+        virtual void setCoefficients(const float *coeffs, uint newLength, uint uResultDivFactor);
+    };
+
+#endif // SOUNDTOUCH_ALLOW_AVX2
+
+
 }
 
 #endif  // FIRFilter_H
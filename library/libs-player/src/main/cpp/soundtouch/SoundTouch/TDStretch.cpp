@@ -789,6 +789,15 @@ TDStretch * TDStretch::newInstance()
 #endif // SOUNDTOUCH_ALLOW_MMX
 
 
+#ifdef SOUNDTOUCH_ALLOW_AVX2
+    if (uExtensions & SUPPORT_AVX2)
+    {
+        // AVX2 + FMA support
+        return ::new TDStretchAVX2;
+    }
+    else
+#endif // SOUNDTOUCH_ALLOW_AVX2
+
 #ifdef SOUNDTOUCH_ALLOW_SSE
     if (uExtensions & SUPPORT_SSE)
     {
@@ -285,5 +285,18 @@ public:
 
 #endif /// SOUNDTOUCH_ALLOW_SSE
 
+
+#ifdef SOUNDTOUCH_ALLOW_AVX2
+    /// Class that implements AVX2/FMA optimized routines for floating point samples type.
+    class TDStretchAVX2 : public TDStretch
+    {
+    protected:
+        double calcCrossCorr(const float *mixingPos, const float *compare, double &norm);
+        double calcCrossCorrAccumulate(const float *mixingPos, const float *compare, double &norm);
+    };
+
+#endif /// SOUNDTOUCH_ALLOW_AVX2
+
+
 }
 #endif  /// TDStretch_H
@@ -0,0 +1,219 @@
+////////////////////////////////////////////////////////////////////////////////
+///
+/// AVX2/FMA optimized routines for x86 CPUs (Haswell, Excavator and later).
+/// All AVX2 optimized functions have been gathered into this single source
+/// code file, in the same manner as the SSE routines in 'sse_optimized.cpp'.
+///
+/// The routines are compiled with a function-level target attribute, so the
+/// library itself can still be built for the plain SSE baseline. They're only
+/// used when 'detectCPUextensions' reports SUPPORT_AVX2 at runtime.
+///
+////////////////////////////////////////////////////////////////////////////////
+//
+// License :
+//
+//  SoundTouch audio processing library
+//  Copyright (c) Olli Parviainen
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "cpu_detect.h"
+#include "STTypes.h"
+
+using namespace soundtouch;
+
+#ifdef SOUNDTOUCH_ALLOW_AVX2
+
+#include "TDStretch.h"
+#include "FIRFilter.h"
+#include <immintrin.h>
+#include <math.h>
+
+#define AVX2_TARGET __attribute__((target("avx2,fma")))
+
+// Horizontal sum of the 8 lanes
+AVX2_TARGET static inline float hsum256(__m256 v)
+{
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// implementation of AVX2 optimized functions of class 'TDStretchAVX2'
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Calculates cross correlation of two buffers. Unaligned loads are cheap on
+// AVX2 capable CPUs, so unlike the SSE version every offset is evaluated.
+AVX2_TARGET double TDStretchAVX2::calcCrossCorr(const float *pV1, const float *pV2, double &anorm)
+{
+    int count = channels * overlapLength;
+    int i;
+    __m256 vSum1, vSum2, vNorm1, vNorm2;
+
+    vSum1 = vSum2 = vNorm1 = vNorm2 = _mm256_setzero_ps();
+
+    // two independent accumulator chains to hide the FMA latency
+    for (i = 0; i + 16 <= count; i += 16)
+    {
+        __m256 v1 = _mm256_loadu_ps(pV1 + i);
+        __m256 v2 = _mm256_loadu_ps(pV1 + i + 8);
+        vSum1  = _mm256_fmadd_ps(v1, _mm256_loadu_ps(pV2 + i), vSum1);
+        vNorm1 = _mm256_fmadd_ps(v1, v1, vNorm1);
+        vSum2  = _mm256_fmadd_ps(v2, _mm256_loadu_ps(pV2 + i + 8), vSum2);
+        vNorm2 = _mm256_fmadd_ps(v2, v2, vNorm2);
+    }
+
+    double corr = hsum256(_mm256_add_ps(vSum1, vSum2));
+    double norm = hsum256(_mm256_add_ps(vNorm1, vNorm2));
+    for (; i < count; i ++)
+    {
+        corr += pV1[i] * pV2[i];
+        norm += pV1[i] * pV1[i];
+    }
+
+    anorm = norm;
+    return corr / sqrt((norm < 1e-9 ? 1.0 : norm));
+}
+
+
+// Same as 'calcCrossCorr', but updates the previous round's normalizer value
+// by removing the first and adding the last samples instead of recalculating it.
+AVX2_TARGET double TDStretchAVX2::calcCrossCorrAccumulate(const float *pV1, const float *pV2, double &norm)
+{
+    int count = channels * overlapLength;
+    int i;
+    __m256 vSum1, vSum2;
+
+    // cancel first normalizer tap from previous round
+    for (i = 1; i <= channels; i ++)
+    {
+        norm -= pV1[-i] * pV1[-i];
+    }
+
+    vSum1 = vSum2 = _mm256_setzero_ps();
+    for (i = 0; i + 16 <= count; i += 16)
+    {
+        vSum1 = _mm256_fmadd_ps(_mm256_loadu_ps(pV1 + i), _mm256_loadu_ps(pV2 + i), vSum1);
+        vSum2 = _mm256_fmadd_ps(_mm256_loadu_ps(pV1 + i + 8), _mm256_loadu_ps(pV2 + i + 8), vSum2);
+    }
+    double corr = hsum256(_mm256_add_ps(vSum1, vSum2));
+    for (; i < count; i ++)
+    {
+        corr += pV1[i] * pV2[i];
+    }
+
+    // update normalizer with last samples of this round
+    for (int j = 0; j < channels; j ++)
+    {
+        i --;
+        norm += pV1[i] * pV1[i];
+    }
+
+    return corr / sqrt((norm < 1e-9 ? 1.0 : norm));
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// implementation of AVX2 optimized functions of class 'FIRFilterAVX2'
+//
+//////////////////////////////////////////////////////////////////////////////
+
+FIRFilterAVX2::FIRFilterAVX2() : FIRFilter()
+{
+    filterCoeffsAlign = NULL;
+    filterCoeffsUnalign = NULL;
+}
+
+
+FIRFilterAVX2::~FIRFilterAVX2()
+{
+    delete[] filterCoeffsUnalign;
+    filterCoeffsAlign = NULL;
+    filterCoeffsUnalign = NULL;
+}
+
+
+// (overloaded) Calculates filter coefficients for AVX2 routine
+void FIRFilterAVX2::setCoefficients(const float *coeffs, uint newLength, uint uResultDivFactor)
+{
+    uint i;
+    float fDivider;
+
+    FIRFilter::setCoefficients(coeffs, newLength, uResultDivFactor);
+
+    // Scale the filter coefficients so that it won't be necessary to scale the filtering result,
+    // and duplicate each coefficient for left & right channels like in the SSE routine
+    delete[] filterCoeffsUnalign;
+    filterCoeffsUnalign = new float[2 * newLength + 4];
+    filterCoeffsAlign = (float *)SOUNDTOUCH_ALIGN_POINTER_16(filterCoeffsUnalign);
+
+    fDivider = (float)resultDivider;
+
+    for (i = 0; i < newLength; i ++)
+    {
+        filterCoeffsAlign[2 * i + 0] =
+        filterCoeffsAlign[2 * i + 1] = coeffs[i + 0] / fDivider;
+    }
+}
+
+
+// AVX2-optimized version of the filter routine for stereo sound
+AVX2_TARGET uint FIRFilterAVX2::evaluateFilterStereo(float *dest, const float *source, uint numSamples) const
+{
+    int count = (int)((numSamples - length) & (uint)-2);
+    int j;
+
+    assert(count % 2 == 0);
+
+    if (count < 2) return 0;
+
+    assert(source != NULL);
+    assert(dest != NULL);
+    assert((length % 8) == 0);
+    assert(filterCoeffsAlign != NULL);
+
+    // filter is evaluated for two stereo samples with each iteration, thus use of 'j += 2'
+    for (j = 0; j < count; j += 2)
+    {
+        const float *pSrc = source + j * 2;
+        const float *pFil = filterCoeffsAlign;
+        __m256 sum1, sum2;
+        uint i;
+
+        sum1 = sum2 = _mm256_setzero_ps();
+
+        // each round handles 4 filter taps for 2 stereo samples:
+        // sum1 accumulates the primary sample offset, sum2 the next one
+        for (i = 0; i < length / 4; i ++)
+        {
+            __m256 vFil = _mm256_loadu_ps(pFil);
+            sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(pSrc), vFil, sum1);
+            sum2 = _mm256_fmadd_ps(_mm256_loadu_ps(pSrc + 2), vFil, sum2);
+            pSrc += 8;
+            pFil += 8;
+        }
+
+        // fold the 8 lanes (L R L R L R L R) into 4 and then into one stereo pair each
+        __m128 s1 = _mm_add_ps(_mm256_castps256_ps128(sum1), _mm256_extractf128_ps(sum1, 1));
+        __m128 s2 = _mm_add_ps(_mm256_castps256_ps128(sum2), _mm256_extractf128_ps(sum2, 1));
+        _mm_storeu_ps(dest + j * 2, _mm_add_ps(
+                    _mm_shuffle_ps(s1, s2, _MM_SHUFFLE(1,0,3,2)),   // s2_1 s2_0 s1_3 s1_2
+                    _mm_shuffle_ps(s1, s2, _MM_SHUFFLE(3,2,1,0))    // s2_3 s2_2 s1_1 s1_0
+                    ));
+    }
+
+    return (uint)count;
+}
+
+#endif  // SOUNDTOUCH_ALLOW_AVX2
@@ -85,7 +85,12 @@ uint detectCPUextensions(void)
 #if ((defined(__GNUC__) && defined(__x86_64__)) \
     || defined(_M_X64))  \
     && defined(SOUNDTOUCH_ALLOW_X86_OPTIMIZATIONS)
-    return 0x19 & ~_dwDisabledISA;
+    uint res = 0x19;
+#ifdef SOUNDTOUCH_ALLOW_AVX2
+    // AVX2 isn't part of the x86-64 baseline, check at runtime (also checks OS support for YMM state)
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) res = res | SUPPORT_AVX2;
+#endif
+    return res & ~_dwDisabledISA;
 
 /// If building for a 32bit system and the user wants optimizations.
 /// Keep the _dwDisabledISA test (2 more operations, could be eliminated).
@@ -107,6 +112,9 @@ uint detectCPUextensions(void)
     if (edx & bit_MMX)  res = res | SUPPORT_MMX;
     if (edx & bit_SSE)  res = res | SUPPORT_SSE;
     if (edx & bit_SSE2) res = res | SUPPORT_SSE2;
+#ifdef SOUNDTOUCH_ALLOW_AVX2
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) res = res | SUPPORT_AVX2;
+#endif
 
 #else
     // Window / VS version of cpuid. Notice that Visual Studio 2005 or later required 
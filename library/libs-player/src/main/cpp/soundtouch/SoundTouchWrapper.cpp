@@ -1,6 +1,7 @@
 #include "SoundTouchWrapper.h"
 
 SoundTouchWrapper::SoundTouchWrapper() {
+    mSoundTouch = NULL;
     create();
 }
 
@@ -10,6 +11,10 @@ SoundTouchWrapper::~SoundTouchWrapper() {
 
 void SoundTouchWrapper::create() {
     mSoundTouch = new SoundTouch();
+    mSpeed = 1.0f;
+    mPitch = 1.0f;
+    mChannels = 0;
+    mSampleRate = 0;
 }
 
 void SoundTouchWrapper::destroy() {
@@ -20,37 +25,61 @@ void SoundTouchWrapper::destroy() {
     }
 }
 
-int SoundTouchWrapper::translate(short *data, float speed, float pitch, int len,
-                                 int bytes_per_sample, int n_channel, int n_sampleRate) {
-    // 每个声道采样数量
-    int put_n_sample = len / n_channel;
-    int nb;
-    int pcm_data_size = 0;
+void SoundTouchWrapper::setParams(float speed, float pitch, int channels, int sampleRate) {
+    if (mSoundTouch == NULL) {
+        return;
+    }
+    // 声道数和采样率变化时缓冲的数据不能继续使用
+    if (channels != mChannels || sampleRate != mSampleRate) {
+        mSoundTouch->clear();
+        mSoundTouch->setChannels(channels);
+        mSoundTouch->setSampleRate(sampleRate);
+        mChannels = channels;
+        mSampleRate = sampleRate;
+    }
+    if (pitch != mPitch) {
+        mSoundTouch->setPitch(pitch);
+        mPitch = pitch;
+    }
+    if (speed != mSpeed) {
+        mSoundTouch->setRate(speed);
+        mSpeed = speed;
+    }
+}
+
+void SoundTouchWrapper::putSamples(const SAMPLETYPE *data, int nbSamples) {
+    if (mSoundTouch == NULL || mChannels <= 0) {
+        return;
+    }
+    mSoundTouch->putSamples(data, (uint) nbSamples);
+}
+
+int SoundTouchWrapper::availableSamples() {
     if (mSoundTouch == NULL) {
         return 0;
     }
-    // 设置音调
-    mSoundTouch->setPitch(pitch);
-    // 设置速度
-    mSoundTouch->setRate(speed);
-    // 设置采样率
-    mSoundTouch->setSampleRate(n_sampleRate);
-    // 设置声道数
-    mSoundTouch->setChannels(n_channel);
-    // 压入采样数据
-    mSoundTouch->putSamples((SAMPLETYPE *) data, put_n_sample);
+    return (int) mSoundTouch->numSamples();
+}
 
-    do {
-        // 获取转换后的数据
-        nb = mSoundTouch->receiveSamples((SAMPLETYPE *) data, n_sampleRate / n_channel);
-        // 计算转换后的数量大小
-        pcm_data_size += nb * n_channel * bytes_per_sample;
-    } while (nb != 0);
+int SoundTouchWrapper::receiveSamples(SAMPLETYPE *output, int maxSamples) {
+    if (mSoundTouch == NULL || maxSamples <= 0) {
+        return 0;
+    }
+    return (int) mSoundTouch->receiveSamples(output, (uint) maxSamples);
+}
 
-    // 返回转换后的数量大小
-    return pcm_data_size;
+void SoundTouchWrapper::clear() {
+    if (mSoundTouch) {
+        mSoundTouch->clear();
+    }
+}
+
+void SoundTouchWrapper::flush() {
+    if (mSoundTouch) {
+        mSoundTouch->flush();
+    }
 }
 
 SoundTouch *SoundTouchWrapper::getSoundTouch() {
     return mSoundTouch;
-}
\ No newline at end of file
+}
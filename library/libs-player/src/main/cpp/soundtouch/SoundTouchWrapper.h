@@ -21,23 +21,49 @@ public:
     void destroy();
 
     /**
-     * 转换
-     * @param data              待采样 PCM 数据
-     * @param speed             速度
-     * @param pitch             音调
-     * @param len               长度
-     * @param bytes_per_sample  采样字节数
-     * @param n_channel         声道数
-     * @param n_sampleRate      采样率
-     * @return
+     * 设置参数，只有参数变化时才重新配置 SoundTouch
+     * @param speed         速度
+     * @param pitch         音调
+     * @param channels      声道数
+     * @param sampleRate    采样率
      */
-    int translate(short *data, float speed, float pitch, int len, int bytes_per_sample, int n_channel, int n_sampleRate);
+    void setParams(float speed, float pitch, int channels, int sampleRate);
+
+    /**
+     * 压入采样数据
+     * @param data          交错存放的 SAMPLETYPE 数据
+     * @param nbSamples     每个声道的采样点数
+     */
+    void putSamples(const SAMPLETYPE *data, int nbSamples);
+
+    /**
+     * @return 可以取出的每个声道的采样点数
+     */
+    int availableSamples();
+
+    /**
+     * 取出转换后的数据
+     * @param output        交错存放的 SAMPLETYPE 数据
+     * @param maxSamples    每个声道最多取出的采样点数
+     * @return 取出的每个声道的采样点数
+     */
+    int receiveSamples(SAMPLETYPE *output, int maxSamples);
+
+    /// 清空缓冲的数据
+    void clear();
+
+    /// 处理完缓冲的输入，结果留在输出中等待取出
+    void flush();
 
     /// 获取SoundTouch对象
     SoundTouch *getSoundTouch();
 
 private:
     SoundTouch *mSoundTouch;
+    float mSpeed;           // 当前配置的参数
+    float mPitch;           //
+    int mChannels;          //
+    int mSampleRate;        //
 };
 
 
@@ -99,8 +99,9 @@ namespace soundtouch
         ///   also in GNU environment, then please #undef the INTEGER_SAMPLE
         ///   and FLOAT_SAMPLE defines first as in comments above.
         // [cain start]
-        #define SOUNDTOUCH_INTEGER_SAMPLES     1    //< 16bit integer samples
-        //#define SOUNDTOUCH_FLOAT_SAMPLES       1    //< 32bit float samples
+        //#define SOUNDTOUCH_INTEGER_SAMPLES     1    //< 16bit integer samples
+        // 播放器由重采样直接输出 float 数据送入 SoundTouch，避免 16 位整型的精度损失和格式转换
+        #define SOUNDTOUCH_FLOAT_SAMPLES       1    //< 32bit float samples
         // [cain end]
     #endif
 
@@ -162,6 +163,15 @@ namespace soundtouch
         #ifdef SOUNDTOUCH_ALLOW_X86_OPTIMIZATIONS
             // Allow SSE optimizations
             #define SOUNDTOUCH_ALLOW_SSE       1
+
+            // [cain start]
+            // Allow AVX2/FMA optimizations. The routines are compiled with a
+            // function-level target attribute and chosen at runtime, so the
+            // rest of the library doesn't need to be built with -mavx2.
+            #if defined(__GNUC__) || defined(__clang__)
+                #define SOUNDTOUCH_ALLOW_AVX2  1
+            #endif
+            // [cain end]
         #endif
 
     #endif  // SOUNDTOUCH_INTEGER_SAMPLES
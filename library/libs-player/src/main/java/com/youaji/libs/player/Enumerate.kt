@@ -46,4 +46,22 @@ enum class WaterMarkLocation(val id: Int) {
     LEFT_BOTTOM(1),
     RIGHT_TOP(2),
     RIGHT_BOTTOM(3),
-}
\ No newline at end of file
+}
+/**
+ * 变速算法
+ */
+enum class TimeStretcher(val id: Int, val desc: String) {
+    AUTO(0, "自动"),
+    SOUNDTOUCH(1, "SoundTouch"),
+    ATEMPO(2, "atempo"),
+}
+
+/**
+ * 速度和节拍分析状态
+ */
+enum class BeatAnalysisState(val id: Int, val desc: String) {
+    NONE(0, "没有请求分析"),
+    PENDING(1, "分析中"),
+    DONE(2, "分析完成"),
+    FAILED(3, "分析失败"),
+}
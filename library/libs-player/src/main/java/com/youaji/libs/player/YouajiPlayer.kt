@@ -17,6 +17,9 @@ import java.lang.ref.WeakReference
 open class YouajiPlayer : BasicMediaPlayer() {
     companion object {
 
+        /** 打开、读取或定位超时，OnErrorListener.onError 的 err 为该值 */
+        const val MEDIA_ERROR_TIMED_OUT = -110
+
         init {
             System.loadLibrary("soundtouch")
             System.loadLibrary("player")
@@ -26,6 +29,150 @@ open class YouajiPlayer : BasicMediaPlayer() {
         @JvmStatic
         private external fun nativeInit()
 
+        /**
+         * 预加载即将播放的地址，打开文件并解码出第一帧，之后以同样的地址 setDataSource 时直接使用
+         * @param path 播放地址
+         */
+        @JvmStatic
+        fun preload(path: String) {
+            nativePreload(path)
+        }
+
+        /**
+         * 取消预加载
+         * @param path 播放地址，为 null 时取消所有预加载
+         */
+        @JvmStatic
+        fun cancelPreload(path: String?) {
+            nativeCancelPreload(path)
+        }
+
+        /**
+         * 设置预加载策略，超出时移除最久没有使用的预加载
+         * @param maxPlayers 最多预加载的数量
+         * @param memoryBudget 预加载占用的内存上限，单位字节
+         */
+        @JvmStatic
+        fun setPreloadPolicy(maxPlayers: Int, memoryBudget: Long) {
+            nativeSetPreloadPolicy(maxPlayers, memoryBudget)
+        }
+
+        /**
+         * 设置所有播放器共享的内存上限，按比例分给正在播放的数据包队列、解码帧缓存和预加载，
+         * 数据包队列按码率、帧队列按分辨率从中分配
+         * @param budget 内存上限，单位字节
+         */
+        @JvmStatic
+        fun setMemoryBudget(budget: Long) {
+            nativeSetMemoryBudget(budget)
+        }
+
+        /**
+         * 内存紧张时释放所有播放器共享的缓存：预加载、空闲的帧缓冲，严重时清空探测缓存，
+         * 可以在 Application 的 onTrimMemory 中调用
+         * @param level onTrimMemory 的等级
+         */
+        @JvmStatic
+        fun trimCaches(level: Int) {
+            nativeTrimCaches(level)
+        }
+
+        /**
+         * 内存压力解除后恢复数据包队列和帧队列的上限，例如应用回到前台时调用，
+         * 内存压力只在 [trimCaches] 和 [trimMemory] 中升高，播放器恢复播放时不会自动恢复
+         */
+        @JvmStatic
+        fun resetMemoryPressure() {
+            nativeResetMemoryPressure()
+        }
+
+        /**
+         * 预热播放器运行环境，在后台创建共享的音频引擎，并在临时的渲染上下文中编译常用着色器程序，
+         * 临时上下文用完即销毁，不与播放器共享，只是让驱动提前加载并缓存编译结果，播放器仍然会创建自己的上下文；
+         * 建议在应用启动后调用，之后创建的播放器不再承担音频引擎的创建和首次编译着色器的耗时
+         */
+        @JvmStatic
+        fun prewarm() {
+            nativePrewarm()
+        }
+
+        /**
+         * 用合成的 48000Hz 双声道音频测试变速算法的开销，阻塞调用线程，不要在主线程调用，
+         * 可以按结果通过 "stretcher" 选项指定算法
+         * @param stretcher 算法
+         * @param speed 速度
+         * @return 处理每秒音频占用的 CPU 时间，单位微秒，< 0 为失败
+         */
+        @JvmStatic
+        fun benchmarkTimeStretcher(stretcher: TimeStretcher, speed: Float): Long {
+            return nativeBenchmarkTimeStretcher(stretcher.id, speed)
+        }
+
+        /**
+         * 在后台线程中分析音频的速度和节拍，只解码音频，远快于实时播放，结果按文件缓存，
+         * 已经分析过的文件立即可以通过 [getBeatAnalysis] 取得结果
+         * @param path 文件地址
+         */
+        @JvmStatic
+        fun analyzeBeats(path: String) {
+            nativeAnalyzeBeats(path)
+        }
+
+        /**
+         * 取消分析并移除缓存的结果
+         * @param path 文件地址，为 null 时取消所有分析
+         */
+        @JvmStatic
+        fun cancelBeatAnalysis(path: String?) {
+            nativeCancelBeatAnalysis(path)
+        }
+
+        /**
+         * 获取速度和节拍的分析结果，不阻塞
+         * @param path 文件地址
+         * @return 分析结果，state 不是 [BeatAnalysisState.DONE] 时其余字段为空
+         */
+        @JvmStatic
+        fun getBeatAnalysis(path: String): BeatAnalysis {
+            val info = DoubleArray(5)
+            val beats = nativeGetBeatAnalysis(path, info) ?: LongArray(0)
+            val state = BeatAnalysisState.values().firstOrNull { it.id == info[0].toInt() } ?: BeatAnalysisState.NONE
+            return BeatAnalysis(state, info[1].toFloat(), beats, info[2].toLong(), info[3].toLong(), info[4].toFloat())
+        }
+
+        @JvmStatic
+        private external fun nativePreload(path: String)
+
+        @JvmStatic
+        private external fun nativeCancelPreload(path: String?)
+
+        @JvmStatic
+        private external fun nativeSetPreloadPolicy(maxPlayers: Int, memoryBudget: Long)
+
+        @JvmStatic
+        private external fun nativeSetMemoryBudget(budget: Long)
+
+        @JvmStatic
+        private external fun nativeTrimCaches(level: Int)
+
+        @JvmStatic
+        private external fun nativeResetMemoryPressure()
+
+        @JvmStatic
+        private external fun nativePrewarm()
+
+        @JvmStatic
+        private external fun nativeBenchmarkTimeStretcher(type: Int, speed: Float): Long
+
+        @JvmStatic
+        private external fun nativeAnalyzeBeats(path: String)
+
+        @JvmStatic
+        private external fun nativeCancelBeatAnalysis(path: String?)
+
+        @JvmStatic
+        private external fun nativeGetBeatAnalysis(path: String, info: DoubleArray): LongArray?
+
         @JvmStatic
         private fun nativePostEvent(mediaPlayerRef: Any, what: Int, arg1: Int, arg2: Int, obj: Any) {
             val mp = (mediaPlayerRef as WeakReference<*>).get() as YouajiPlayer? ?: return
@@ -36,6 +183,24 @@ open class YouajiPlayer : BasicMediaPlayer() {
         }
     }
 
+    /**
+     * 速度和节拍的分析结果
+     * @param state 分析状态
+     * @param bpm 每分钟节拍数，检测失败时为 0
+     * @param beats 节拍位置，单位毫秒，与播放位置一致
+     * @param duration 分析的音频时长，单位毫秒
+     * @param cpuTime 分析占用的 CPU 时间，单位微秒
+     * @param speed 每秒 CPU 时间处理的音频秒数
+     */
+    class BeatAnalysis(
+        val state: BeatAnalysisState,
+        val bpm: Float,
+        val beats: LongArray,
+        val duration: Long,
+        val cpuTime: Long,
+        val speed: Float,
+    )
+
     private var eventHandler: EventHandler? = null
 
     // 渲染结点类型，跟Native层[NodeType.h RenderNodeType]数值保持一致。
@@ -264,6 +429,106 @@ open class YouajiPlayer : BasicMediaPlayer() {
         eventHandler?.removeCallbacksAndMessages(null)
     }
 
+    /**
+     * 添加到播放列表，当前条目播放结束后无缝衔接播放，
+     * 开始播放下一个条目时通过 OnInfoListener 回调 MEDIA_INFO_STARTED_AS_NEXT，extra 为条目序号
+     */
+    fun enqueueDataSource(path: String) {
+        nativeEnqueueDataSource(path)
+    }
+
+    /**
+     * 内存紧张时释放资源，在 onTrimMemory 中调用，同时会释放共享的缓存。
+     * 暂停中的播放器丢弃还没有显示的视频帧和音频缓冲，严重时释放渲染用的纹理和 FBO，
+     * 恢复播放时不需要重新准备
+     * @param level onTrimMemory 的等级
+     */
+    fun trimMemory(level: Int) {
+        nativeTrimMemory(level)
+    }
+
+    /** 清空播放列表中等待播放的条目 */
+    fun clearPlaylist() {
+        nativeClearPlaylist()
+    }
+
+    /** 设置提前打开下一个条目的时间，单位毫秒，需要在 prepare 之前调用 */
+    fun setPlaylistPrerollTime(millisecond: Long) {
+        nativeSetPrerollTime(millisecond)
+    }
+
+    /**
+     * 设置 FFmpeg 视频滤镜，在解码之后、渲染之前处理，需要在 prepare 之前调用
+     * @param filters 滤镜描述，如 "yadif"、"hqdn3d"、"transpose=1"、"scale=1280:-2"，多个滤镜用逗号分隔，为空时不使用滤镜
+     * @param threads 滤镜线程数，0 为自动
+     */
+    fun setVideoFilter(filters: String?, threads: Int = 0) {
+        nativeSetVideoFilter(filters, threads)
+    }
+
+    /**
+     * 设置 FFmpeg 音频滤镜，如 "loudnorm"、"acompressor"、"equalizer=f=1000:t=q:w=1:g=3"，播放中调用时不中断声音，
+     * 新滤镜的预读完成后与旧滤镜交叉淡化，处理耗时持续超过音频时长的一半时自动停用
+     * @param filters 滤镜描述，多个滤镜用逗号分隔，为空时停用滤镜
+     */
+    fun setAudioFilter(filters: String?) {
+        nativeSetAudioFilter(filters)
+    }
+
+    /**
+     * 开启或者关闭输出音频的电平和频谱分析，在单独的线程中计算，关闭时没有额外开销；也可以在 prepare 之前通过播放器参数 "analyzer" 开启
+     * @param enabled 是否开启
+     */
+    fun setAudioAnalyzer(enabled: Boolean) {
+        nativeSetAudioAnalyzer(enabled)
+    }
+
+    /**
+     * 取出最新的电平和频谱，结果对应正在播放的声音，可以在界面刷新时直接调用，不会阻塞音频输出
+     * @param levels 至少 4 个元素，依次写入左右声道的均方根电平和左右声道的峰值电平，0 ~ 1
+     * @param spectrum 写入从直流开始的 512 个频点的幅度，频点间隔为采样率 / 1024，满幅正弦波约为 1，为空时不取频谱
+     * @return 结果对应的播放位置，单位毫秒，没有开启或者还没有结果时为 -1
+     */
+    fun getAudioAnalysis(levels: FloatArray, spectrum: FloatArray? = null): Long {
+        return nativeGetAudioAnalysis(levels, spectrum)
+    }
+
+    /**
+     * 切换音轨，不需要定位也不中断声音：新音轨解码追上播放位置后交叉淡化接入，完成时通过 OnInfoListener 回调
+     * MEDIA_INFO_AUDIO_TRACK_CHANGED(10003)，extra 为新的音频流索引。播放列表拼接了其它文件时不支持
+     * @param streamIndex 音频流索引，见 [getAudioTracks]
+     * @return 是否接受切换请求
+     */
+    fun selectAudioTrack(streamIndex: Int): Boolean {
+        return nativeSelectAudioTrack(streamIndex) == 0
+    }
+
+    /** 当前选择的音频流索引，切换中返回切换的目标，没有音频时为 -1 */
+    fun getSelectedAudioTrack(): Int {
+        return nativeGetSelectedAudioTrack()
+    }
+
+    /** 所有音频流的索引 */
+    fun getAudioTracks(): IntArray {
+        return nativeGetAudioTracks()
+    }
+
+    /**
+     * 同时播放额外的音轨，如伴奏、解说，按当前音轨的时间戳对齐混音；已经在混音时只更新增益，
+     * streamIndex 为当前播放的音轨时设置它自身的增益
+     * @param streamIndex 音频流索引，见 [getAudioTracks]
+     * @param gain 增益，0 ~ 2
+     * @return 是否接受
+     */
+    fun setMixTrack(streamIndex: Int, gain: Float = 1f): Boolean {
+        return nativeSetMixTrack(streamIndex, gain) == 0
+    }
+
+    /** 停止混入额外的音轨 */
+    fun removeMixTrack(streamIndex: Int): Boolean {
+        return nativeRemoveMixTrack(streamIndex) == 0
+    }
+
     private var nativeContext: Long = 0 //对应native层的EMediaPlayer对象
 
     private external fun nativeSetup(mediaPlayer: Any)
@@ -272,6 +537,11 @@ open class YouajiPlayer : BasicMediaPlayer() {
     private external fun nativeSetDataSource(fd: FileDescriptor, offset: Long, length: Long)
     private external fun nativeSetDataSource(path: String, keys: Array<String>, values: Array<String>)
     private external fun nativeSetDataSource(path: String)
+    private external fun nativeEnqueueDataSource(path: String)
+    private external fun nativeClearPlaylist()
+    private external fun nativeSetPrerollTime(millisecond: Long)
+    private external fun nativeSetVideoFilter(filters: String?, threads: Int)
+    private external fun nativeTrimMemory(level: Int)
     private external fun nativePrepare()
     private external fun nativePrepareAsync()
     private external fun nativeStart()
@@ -290,6 +560,14 @@ open class YouajiPlayer : BasicMediaPlayer() {
     private external fun nativeGetLooping(): Boolean
     private external fun nativeSetMute(mute: Boolean)
     private external fun nativeSetPitch(pitch: Float)
+    private external fun nativeSetAudioFilter(filters: String?)
+    private external fun nativeSetAudioAnalyzer(enable: Boolean)
+    private external fun nativeGetAudioAnalysis(levels: FloatArray, spectrum: FloatArray?): Long
+    private external fun nativeSelectAudioTrack(streamIndex: Int): Int
+    private external fun nativeGetSelectedAudioTrack(): Int
+    private external fun nativeGetAudioTracks(): IntArray
+    private external fun nativeSetMixTrack(streamIndex: Int, gain: Float): Int
+    private external fun nativeRemoveMixTrack(streamIndex: Int): Int
     private external fun nativeSetRate(rate: Float)
     private external fun nativeGetRotate(): Int
     private external fun nativeGetDuration(): Long
@@ -391,6 +669,9 @@ open class YouajiPlayer : BasicMediaPlayer() {
         private val MEDIA_INFO = 200
         private val MEDIA_CURRENT = 300
 
+        // MEDIA_ERROR 的 what
+        private val MEDIA_ERROR_UNKNOWN = 1
+
         override fun handleMessage(msg: Message) {
 //            Log.i("YouajiPlayer.Message", "=== what:${msg.what} arg1:${msg.arg1} arg2:${msg.arg2} === ")
             if (player.nativeContext == 0L) {
@@ -443,7 +724,12 @@ open class YouajiPlayer : BasicMediaPlayer() {
                     // opencore/pvmi/pvmf/include/pvmf_return_codes.h
                     Log.e("YouajiPlayer.TAG", "===Error (" + msg.arg1 + "," + msg.arg2 + ")")
 //                    var error_was_handled = false
-                    errorListener?.onError(player, msg.arg1, msg.arg2.toString())
+                    if (msg.arg1 == MEDIA_ERROR_UNKNOWN && msg.arg2 == MEDIA_ERROR_TIMED_OUT) {
+                        // 打开、读取或定位超时，以超时码上报，方便上层提示网络问题或重试
+                        errorListener?.onError(player, MEDIA_ERROR_TIMED_OUT, "timed out")
+                    } else {
+                        errorListener?.onError(player, msg.arg1, msg.arg2.toString())
+                    }
 //                    if (mOnErrorListener != null) {
 //                        error_was_handled = mOnErrorListener.onError(mMediaPlayer, msg.arg1, msg.arg2)
 //                    }
@@ -0,0 +1,138 @@
+#include <math.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "AudioAnalyzer.h"
+
+#define SAMPLE_RATE 48000
+#define CHANNELS 2
+// 每次回调写入的采样点数，约 10ms
+#define CALLBACK_FRAMES 480
+// 设备中缓冲的采样点数
+#define DEVICE_LATENCY 960
+// 正好落在第 32 个频点上的正弦波，不会泄漏到相邻频点
+#define TONE_BIN 32
+#define TONE_FREQ ((double) SAMPLE_RATE * TONE_BIN / AUDIO_ANALYZER_FFT_SIZE)
+#define LEFT_AMPLITUDE 0.5
+#define RIGHT_AMPLITUDE 0.25
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: ", __FILE__, __LINE__); \
+        fprintf(stderr, __VA_ARGS__); \
+        fprintf(stderr, "\n"); \
+        failures++; \
+    } \
+} while (0)
+
+static bool near(double value, double expected, double tolerance) {
+    return fabs(value - expected) <= fabs(expected) * tolerance;
+}
+
+/**
+ * 按实际时间模拟音频回调写入，返回最后写入的结束时间
+ */
+static double writeTone(AudioAnalyzer *analyzer, int64_t *position, int callbacks) {
+    std::vector<int16_t> buffer(CALLBACK_FRAMES * CHANNELS);
+    double endPts = 0;
+    for (int n = 0; n < callbacks; n++) {
+        for (int i = 0; i < CALLBACK_FRAMES; i++) {
+            double phase = 2 * M_PI * TONE_FREQ * (double) (*position + i) / SAMPLE_RATE;
+            buffer[i * 2] = (int16_t) lrint(LEFT_AMPLITUDE * 32767 * sin(phase));
+            buffer[i * 2 + 1] = (int16_t) lrint(RIGHT_AMPLITUDE * 32767 * sin(phase));
+        }
+        *position += CALLBACK_FRAMES;
+        endPts = (double) *position / SAMPLE_RATE;
+        analyzer->write(buffer.data(), CALLBACK_FRAMES, CHANNELS, SAMPLE_RATE, endPts, 1.0f, DEVICE_LATENCY);
+        usleep(CALLBACK_FRAMES * 1000000 / SAMPLE_RATE);
+    }
+    return endPts;
+}
+
+int main() {
+    // 创建和开启的耗时，AudioResampler 在回调锁之外完成这一步
+    int64_t start = av_gettime_relative();
+    AudioAnalyzer *analyzer = new AudioAnalyzer();
+    analyzer->start();
+    int64_t createTime = av_gettime_relative() - start;
+
+    AudioAnalysis analysis;
+    CHECK(analyzer->getAnalysis(&analysis) < 0, "result available before any data was written");
+
+    // 读取方与分析线程、写入方同时运行，不会互相阻塞
+    std::atomic<bool> stopReader(false);
+    std::atomic<int> reads(0);
+    std::thread reader([&]() {
+        AudioAnalysis result;
+        while (!stopReader.load()) {
+            if (analyzer->getAnalysis(&result) == 0) {
+                reads++;
+            }
+            usleep(1000);
+        }
+    });
+
+    int64_t position = 0;
+    double endPts = writeTone(analyzer, &position, 40);
+    // 等待分析线程处理最后写入的数据
+    usleep(AUDIO_ANALYZER_INTERVAL * 2);
+    CHECK(analyzer->getAnalysis(&analysis) == 0, "no analysis after %d callbacks", 40);
+
+    // 电平：正弦波的均方根为幅度除以 sqrt(2)
+    CHECK(near(analysis.rms[0], LEFT_AMPLITUDE / M_SQRT2, 0.02), "left rms %f", analysis.rms[0]);
+    CHECK(near(analysis.rms[1], RIGHT_AMPLITUDE / M_SQRT2, 0.02), "right rms %f", analysis.rms[1]);
+    CHECK(near(analysis.peak[0], LEFT_AMPLITUDE, 0.01), "left peak %f", analysis.peak[0]);
+    CHECK(near(analysis.peak[1], RIGHT_AMPLITUDE, 0.01), "right peak %f", analysis.peak[1]);
+
+    // 频谱：左右声道平均后的幅度，汉宁窗的主瓣只覆盖相邻的频点
+    int maxBin = 0;
+    for (int i = 1; i < AUDIO_ANALYZER_BINS; i++) {
+        if (analysis.spectrum[i] > analysis.spectrum[maxBin]) {
+            maxBin = i;
+        }
+    }
+    double amplitude = (LEFT_AMPLITUDE + RIGHT_AMPLITUDE) / 2;
+    CHECK(maxBin == TONE_BIN, "spectrum peak at bin %d, expected %d", maxBin, TONE_BIN);
+    CHECK(near(analysis.spectrum[TONE_BIN], amplitude, 0.02), "spectrum peak %f, expected %f",
+          analysis.spectrum[TONE_BIN], amplitude);
+    for (int i = 0; i < AUDIO_ANALYZER_BINS; i++) {
+        if (abs(i - TONE_BIN) > 1 && analysis.spectrum[i] > 0.001f) {
+            CHECK(false, "leakage at bin %d: %f", i, analysis.spectrum[i]);
+            break;
+        }
+    }
+
+    // 时间：分析窗口结束在正在播放的位置，落后于写入的位置不超过设备缓冲和分析间隔
+    CHECK(analysis.pts <= endPts && analysis.pts >= endPts - (double) DEVICE_LATENCY / SAMPLE_RATE - 0.1,
+          "analysis pts %f, last written %f", analysis.pts, endPts);
+
+    // 丢弃数据后不再分析之前的数据，写满一个窗口后继续输出
+    analyzer->flush();
+    double flushedPts = analysis.pts;
+    endPts = writeTone(analyzer, &position, 10);
+    usleep(AUDIO_ANALYZER_INTERVAL * 2);
+    CHECK(analyzer->getAnalysis(&analysis) == 0 && analysis.pts > flushedPts,
+          "no new analysis after flush: %f <= %f", analysis.pts, flushedPts);
+
+    stopReader.store(true);
+    reader.join();
+    CHECK(reads.load() > 0, "reader never got a result");
+
+    start = av_gettime_relative();
+    analyzer->stop();
+    delete analyzer;
+    int64_t destroyTime = av_gettime_relative() - start;
+
+    printf("create+start: %lld us, stop+delete: %lld us, %d reads\n", (long long) createTime,
+           (long long) destroyTime, reads.load());
+    if (failures) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("AudioAnalyzerTest passed\n");
+    return 0;
+}
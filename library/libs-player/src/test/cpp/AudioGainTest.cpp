@@ -0,0 +1,233 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "AudioGain.h"
+
+extern "C" {
+#include "libavutil/common.h"
+}
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: ", __FILE__, __LINE__); \
+        fprintf(stderr, __VA_ARGS__); \
+        fprintf(stderr, "\n"); \
+        failures++; \
+    } \
+} while (0)
+
+/**
+ * 混音内核的参考实现：乘积按 Q14 四舍五入后饱和，再与输出相加饱和
+ */
+static int16_t refMix(int16_t dst, int16_t src, int gain) {
+    int scaled = av_clip_int16((src * gain + (1 << (MIX_GAIN_SHIFT - 1))) >> MIX_GAIN_SHIFT);
+    return (int16_t) av_clip_int16(dst + scaled);
+}
+
+static void fillRandom(std::vector<int16_t> &buf) {
+    for (size_t i = 0; i < buf.size(); i++) {
+        // 包含满幅度的采样点，检查饱和
+        int r = rand() % 16;
+        buf[i] = r == 0 ? INT16_MAX : r == 1 ? INT16_MIN : (int16_t) (rand() % 65536 - 32768);
+    }
+}
+
+/**
+ * SIMD 和尾部的标量路径与参考实现逐个采样点一致，左右声道增益相同时双声道内核与单一增益的内核一致
+ */
+static void testMixKernels() {
+    const int gains[] = {0, 1, 4096, 8192, 1 << MIX_GAIN_SHIFT, 20000, INT16_MAX};
+    const int counts[] = {1, 7, 8, 9, 64, 1023};
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        int count = counts[c];
+        std::vector<int16_t> src(count), dst(count), out(count), stereo(count);
+        for (size_t g = 0; g < sizeof(gains) / sizeof(gains[0]); g++) {
+            int gain = gains[g];
+            fillRandom(src);
+            fillRandom(dst);
+            out = dst;
+            AudioGain::mixSamples(out.data(), src.data(), count, gain);
+            for (int i = 0; i < count; i++) {
+                CHECK(out[i] == refMix(dst[i], src[i], gain), "mixSamples count %d gain %d [%d]: %d != %d",
+                      count, gain, i, out[i], refMix(dst[i], src[i], gain));
+            }
+
+            if (count % 2 == 0) {
+                stereo = dst;
+                AudioGain::mixStereoSamples(stereo.data(), src.data(), count / 2, gain, gain);
+                CHECK(memcmp(stereo.data(), out.data(), count * sizeof(int16_t)) == 0,
+                      "mixStereoSamples with equal gains differs from mixSamples, count %d gain %d", count, gain);
+
+                int right = gains[(g + 3) % (sizeof(gains) / sizeof(gains[0]))];
+                stereo = dst;
+                AudioGain::mixStereoSamples(stereo.data(), src.data(), count / 2, gain, right);
+                for (int i = 0; i < count; i++) {
+                    int16_t expected = refMix(dst[i], src[i], (i & 1) ? right : gain);
+                    CHECK(stereo[i] == expected, "mixStereoSamples count %d gain %d/%d [%d]: %d != %d",
+                          count, gain, right, i, stereo[i], expected);
+                }
+            }
+
+            out = src;
+            AudioGain::scaleSamples(out.data(), count, gain);
+            for (int i = 0; i < count; i++) {
+                CHECK(out[i] == refMix(0, src[i], gain), "scaleSamples count %d gain %d [%d]: %d != %d",
+                      count, gain, i, out[i], refMix(0, src[i], gain));
+            }
+        }
+    }
+}
+
+/**
+ * 半个最低位的乘积向上舍入，而不是截断
+ */
+static void testMixRounding() {
+    int16_t src[2] = {1001, 1001};
+    int16_t dst[2] = {0, 0};
+    AudioGain::mixStereoSamples(dst, src, 1, AudioGain::toFixedGain(0.5f), AudioGain::toFixedGain(0.25f));
+    CHECK(dst[0] == 501 && dst[1] == 250, "stereo rounding: %d %d, expected 501 250", dst[0], dst[1]);
+
+    CHECK(AudioGain::toFixedGain(1.0f) == 1 << MIX_GAIN_SHIFT, "toFixedGain(1.0)");
+    CHECK(AudioGain::toFixedGain(-1.0f) == 0, "toFixedGain clamps negative gain");
+    CHECK(AudioGain::toFixedGain(MIX_GAIN_MAX) == INT16_MAX, "toFixedGain clamps to INT16_MAX");
+}
+
+/**
+ * applyGain 的参考实现：增益按 start + step * i 计算，乘积饱和后就近取整，0.5 取偶数
+ */
+static int16_t refGain(int16_t sample, float gain) {
+    float value = sample * gain;
+    value = value < -32768.0f ? -32768.0f : value > 32767.0f ? 32767.0f : value;
+    return (int16_t) lrintf(value);
+}
+
+static float refChannelGain(const float *start, const float *step, int channels, int c, int i) {
+    if (channels == 1 || c >= 2) {
+        return (start[0] + start[1]) * 0.5f + (step[0] + step[1]) * 0.5f * i;
+    }
+    return start[c] + step[c] * i;
+}
+
+/**
+ * 各个声道数下向量路径和标量尾部与参考实现比较，固定增益时逐位一致，
+ * 渐变时编译器可能把标量路径的乘加合并为 FMA，允许 1 个最低位的差别
+ */
+static void testApplyGain() {
+    const int channelCounts[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    const int frameCounts[] = {1, 3, 4, 7, 8, 9, 63, 480};
+    // 0.5 的增益使奇数采样点的乘积正好落在 0.5 上，检查舍入方式；2.0 检查饱和
+    const float gains[][2] = {{0.5f, 0.5f}, {1.5f, 0.5f}, {0.3f, 0.7f}, {2.0f, 0.0f}, {1.0f, 1.0f}};
+    for (size_t ch = 0; ch < sizeof(channelCounts) / sizeof(channelCounts[0]); ch++) {
+        int channels = channelCounts[ch];
+        for (size_t f = 0; f < sizeof(frameCounts) / sizeof(frameCounts[0]); f++) {
+            int frames = frameCounts[f];
+            std::vector<int16_t> src(frames * channels), out;
+            for (size_t g = 0; g < sizeof(gains) / sizeof(gains[0]); g++) {
+                for (int ramp = 0; ramp < 2; ramp++) {
+                    fillRandom(src);
+                    float step[2] = {0.0f, 0.0f};
+                    if (ramp) {
+                        step[0] = (gains[(g + 1) % 5][0] - gains[g][0]) / frames;
+                        step[1] = (gains[(g + 1) % 5][1] - gains[g][1]) / frames;
+                    }
+                    out = src;
+                    AudioGain::applyGain(out.data(), frames, channels, gains[g], step);
+                    for (int i = 0; i < frames * channels; i++) {
+                        int16_t expected = refGain(src[i], refChannelGain(gains[g], step, channels, i % channels,
+                                                                          i / channels));
+                        int diff = abs(out[i] - expected);
+                        if (ramp ? diff > 1 : diff != 0) {
+                            CHECK(false, "applyGain %dch %d frames gain %g/%g ramp %d [%d]: %d != %d", channels,
+                                  frames, gains[g][0], gains[g][1], ramp, i, out[i], expected);
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // 0.5 的乘积按偶数取整
+    int16_t ties[4] = {1, 3, -1, -3};
+    const float half[2] = {0.5f, 0.5f};
+    const float zero[2] = {0.0f, 0.0f};
+    AudioGain::applyGain(ties, 4, 1, half, zero);
+    CHECK(ties[0] == 0 && ties[1] == 2 && ties[2] == 0 && ties[3] == -2, "ties: %d %d %d %d, expected 0 2 0 -2",
+          ties[0], ties[1], ties[2], ties[3]);
+}
+
+/**
+ * 分块处理的渐变与一次处理的结果一致，块之间没有跳变，中途改变目标从当前增益继续渐变
+ */
+static void testRampContinuity() {
+    const int channels = 2;
+    const int rampFrames = 480;
+    const int totalFrames = 1200;
+    const int chunks[] = {37, 1, 100, 8, 255, 3, 64};
+    std::vector<int16_t> whole(totalFrames * channels, 16384), chunked(totalFrames * channels, 16384);
+
+    AudioGain once;
+    once.setTarget(1.0f, 0.5f, rampFrames);
+    once.process(whole.data(), totalFrames, channels);
+
+    AudioGain gain;
+    gain.setTarget(1.0f, 0.5f, rampFrames);
+    int pos = 0;
+    for (int n = 0; pos < totalFrames; n++) {
+        int count = chunks[n % (sizeof(chunks) / sizeof(chunks[0]))];
+        if (count > totalFrames - pos) {
+            count = totalFrames - pos;
+        }
+        gain.process(chunked.data() + pos * channels, count, channels);
+        pos += count;
+    }
+    CHECK(gain.getRampFrames() == 0, "ramp did not finish: %d frames left", gain.getRampFrames());
+    // 每个采样点的增量约为 16384 / 480 = 34
+    const int maxStep = 16384 / rampFrames + 2;
+    for (int i = 0; i < totalFrames * channels; i++) {
+        CHECK(abs(chunked[i] - whole[i]) <= 1, "chunked ramp differs at %d: %d != %d", i, chunked[i], whole[i]);
+        if (i >= channels) {
+            int delta = chunked[i] - chunked[i - channels];
+            CHECK(delta >= 0 && delta <= maxStep, "ramp jumps at %d: %d -> %d", i, chunked[i - channels], chunked[i]);
+        }
+    }
+    CHECK(chunked[totalFrames * channels - 2] == 16384 && chunked[totalFrames * channels - 1] == 8192,
+          "ramp end: %d %d, expected 16384 8192", chunked[totalFrames * channels - 2],
+          chunked[totalFrames * channels - 1]);
+
+    // 渐变中途改成淡出，从当前增益开始下降，不跳回起点
+    AudioGain fade;
+    std::vector<int16_t> buf(rampFrames * 2, 16384);
+    fade.setTarget(1.0f, 1.0f, rampFrames);
+    fade.process(buf.data(), rampFrames / 2, 1);
+    int16_t last = buf[rampFrames / 2 - 1];
+    fade.setTarget(0.0f, 0.0f, rampFrames);
+    fade.process(buf.data() + rampFrames / 2, rampFrames + rampFrames / 2, 1);
+    CHECK(abs(buf[rampFrames / 2] - last) <= maxStep, "retarget jumps: %d -> %d", last, buf[rampFrames / 2]);
+    for (int i = rampFrames / 2 + 1; i < rampFrames * 2; i++) {
+        if (buf[i] > buf[i - 1]) {
+            CHECK(false, "fade out increases at %d: %d -> %d", i, buf[i - 1], buf[i]);
+            break;
+        }
+    }
+    CHECK(buf[rampFrames * 2 - 1] == 0 && fade.isSilent(), "fade out did not reach silence: %d",
+          buf[rampFrames * 2 - 1]);
+}
+
+int main() {
+    srand(1);
+    testMixKernels();
+    testMixRounding();
+    testApplyGain();
+    testRampContinuity();
+    if (failures) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("AudioGainTest passed\n");
+    return 0;
+}
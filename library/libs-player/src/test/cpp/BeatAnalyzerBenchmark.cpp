@@ -0,0 +1,165 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+#include "BeatAnalyzer.h"
+#include "PlayerRuntime.h"
+
+#define SAMPLE_RATE 44100
+#define CHANNELS 2
+// 合成的节拍音轨，时长与一首歌接近
+#define TRACK_SECONDS 180
+#define TRACK_BPM 120
+// 每一拍的敲击声：衰减的 1kHz 正弦波
+#define CLICK_FREQ 1000
+#define CLICK_MS 30
+// 重复分析的次数，取最快的一次
+#define RUN_COUNT 3
+// 等待单次分析完成的最长时间，单位毫秒
+#define ANALYZE_TIMEOUT 60000
+
+static void writeLe(FILE *fp, uint32_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        fputc((value >> (i * 8)) & 0xff, fp);
+    }
+}
+
+/**
+ * 生成 16 位 PCM 的 WAV 文件，每拍一个敲击声，背景为低电平噪声
+ * @return 0 为成功
+ */
+static int writeClickTrack(const char *path) {
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        return -1;
+    }
+    uint32_t frames = SAMPLE_RATE * TRACK_SECONDS;
+    uint32_t dataSize = frames * CHANNELS * 2;
+    fwrite("RIFF", 1, 4, fp);
+    writeLe(fp, 36 + dataSize, 4);
+    fwrite("WAVEfmt ", 1, 8, fp);
+    writeLe(fp, 16, 4);
+    writeLe(fp, 1, 2);
+    writeLe(fp, CHANNELS, 2);
+    writeLe(fp, SAMPLE_RATE, 4);
+    writeLe(fp, SAMPLE_RATE * CHANNELS * 2, 4);
+    writeLe(fp, CHANNELS * 2, 2);
+    writeLe(fp, 16, 2);
+    fwrite("data", 1, 4, fp);
+    writeLe(fp, dataSize, 4);
+
+    int beatFrames = SAMPLE_RATE * 60 / TRACK_BPM;
+    int clickFrames = SAMPLE_RATE * CLICK_MS / 1000;
+    std::vector<int16_t> buffer(SAMPLE_RATE * CHANNELS);
+    srand(1);
+    for (uint32_t start = 0; start < frames; start += SAMPLE_RATE) {
+        for (int i = 0; i < SAMPLE_RATE; i++) {
+            int offset = (int) ((start + i) % beatFrames);
+            double value = ((double) rand() / RAND_MAX - 0.5) * 0.01;
+            if (offset < clickFrames) {
+                value += 0.8 * exp(-5.0 * offset / clickFrames) * sin(2 * M_PI * CLICK_FREQ * offset / SAMPLE_RATE);
+            }
+            buffer[i * 2] = buffer[i * 2 + 1] = (int16_t) lrint(value * 32767);
+        }
+        fwrite(buffer.data(), sizeof(int16_t), buffer.size(), fp);
+    }
+    int ret = ferror(fp) ? -1 : 0;
+    fclose(fp);
+    return ret;
+}
+
+/**
+ * 请求分析并等待完成，分析线程自己持有 PlayerRuntime 的引用，这里不做 FFmpeg 初始化
+ * @return 分析状态
+ */
+static BeatAnalysisState analyzeAndWait(const char *path, BeatAnalysis *analysis, int64_t *wallTime) {
+    BeatAnalyzer *analyzer = BeatAnalyzer::getInstance();
+    analyzer->remove(path);
+    int64_t start = av_gettime_relative();
+    if (analyzer->analyze(path) < 0) {
+        return BEAT_ANALYSIS_FAILED;
+    }
+    BeatAnalysisState state = BEAT_ANALYSIS_PENDING;
+    for (int waited = 0; waited < ANALYZE_TIMEOUT; waited++) {
+        state = analyzer->getAnalysis(path, analysis);
+        if (state != BEAT_ANALYSIS_PENDING) {
+            break;
+        }
+        usleep(1000);
+    }
+    *wallTime = av_gettime_relative() - start;
+    return state;
+}
+
+int main() {
+    char path[] = "/tmp/BeatAnalyzerBenchmarkXXXXXX.wav";
+    int fd = mkstemps(path, 4);
+    if (fd < 0) {
+        fprintf(stderr, "failed to create a temporary file\n");
+        return 1;
+    }
+    close(fd);
+    if (writeClickTrack(path) < 0) {
+        fprintf(stderr, "failed to write %s\n", path);
+        unlink(path);
+        return 1;
+    }
+
+    int failures = 0;
+    BeatAnalysis best;
+    int64_t bestWall = 0;
+    for (int run = 0; run < RUN_COUNT; run++) {
+        BeatAnalysis analysis;
+        int64_t wallTime = 0;
+        BeatAnalysisState state = analyzeAndWait(path, &analysis, &wallTime);
+        if (state != BEAT_ANALYSIS_DONE) {
+            fprintf(stderr, "run %d: analysis state %d\n", run, state);
+            failures++;
+            break;
+        }
+        printf("run %d: %.1f bpm, %d beats, %lld ms audio, %lld ms cpu, %lld ms wall, %.1fx\n", run,
+               analysis.bpm, (int) analysis.beats.size(), (long long) analysis.duration,
+               (long long) (analysis.cpuTime / 1000), (long long) (wallTime / 1000), analysis.speed);
+        if (run == 0 || analysis.speed > best.speed) {
+            best = analysis;
+            bestWall = wallTime;
+        }
+    }
+
+    if (!failures) {
+        // 速度和节拍间隔与合成的音轨一致，节拍位置误差在包络的一帧左右
+        int64_t interval = 60000 / TRACK_BPM;
+        if (fabs(best.bpm - TRACK_BPM) > 2) {
+            fprintf(stderr, "detected %.1f bpm, expected %d\n", best.bpm, TRACK_BPM);
+            failures++;
+        }
+        size_t expectedBeats = TRACK_SECONDS * TRACK_BPM / 60;
+        if (best.beats.size() + 2 < expectedBeats || best.beats.size() > expectedBeats + 2) {
+            fprintf(stderr, "%d beats, expected %d\n", (int) best.beats.size(), (int) expectedBeats);
+            failures++;
+        }
+        for (size_t i = 0; i < best.beats.size(); i++) {
+            int64_t error = (best.beats[i] + interval / 2) % interval - interval / 2;
+            if (llabs(error) > 1000 / BEAT_ANALYZER_ENVELOPE_RATE * 2) {
+                fprintf(stderr, "beat %d at %lld ms is %lld ms off the grid\n", (int) i,
+                        (long long) best.beats[i], (long long) error);
+                failures++;
+                break;
+            }
+        }
+        printf("best: %lld ms audio in %lld ms cpu / %lld ms wall, %.1fx realtime\n",
+               (long long) best.duration, (long long) (best.cpuTime / 1000), (long long) (bestWall / 1000),
+               best.speed);
+    }
+
+    BeatAnalyzer::getInstance()->destroy();
+    PlayerRuntime::getInstance()->destroy();
+    unlink(path);
+    if (failures) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <string.h>
+#include "FrameBufferPool.h"
+
+// 模拟切换播放源的次数，每次重新打开解码上下文
+#define SEGMENT_COUNT 20
+// 每个播放源分配的帧数
+#define FRAMES_PER_SEGMENT 60
+// 同时被引用的帧数，对应解码器的参考帧和帧队列
+#define FRAMES_IN_FLIGHT 8
+
+static AVCodec *findDecoder() {
+    AVCodec *codec = avcodec_find_decoder(AV_CODEC_ID_H264);
+    if (!codec) {
+        codec = avcodec_find_decoder(AV_CODEC_ID_MPEG4);
+    }
+    return codec;
+}
+
+/**
+ * 按播放源依次打开解码上下文并通过 get_buffer2 分配视频帧
+ * @param usePool 是否使用帧缓冲池
+ * @param elapsed 输出总耗时，单位微秒
+ * @return 0 为成功
+ */
+static int runSegments(AVCodec *codec, bool usePool, int64_t *elapsed) {
+    AVFrame *frames[FRAMES_IN_FLIGHT] = {NULL};
+    for (int i = 0; i < FRAMES_IN_FLIGHT; i++) {
+        frames[i] = av_frame_alloc();
+        if (!frames[i]) {
+            return -1;
+        }
+    }
+    int ret = 0;
+    int64_t total = 0;
+    for (int segment = 0; segment < SEGMENT_COUNT && ret == 0; segment++) {
+        AVCodecContext *avctx = avcodec_alloc_context3(codec);
+        if (!avctx) {
+            ret = -1;
+            break;
+        }
+        avctx->width = 1920;
+        avctx->height = 1080;
+        avctx->pix_fmt = AV_PIX_FMT_YUV420P;
+        avctx->thread_count = 1;
+        if (usePool) {
+            FrameBufferPool::getInstance()->attach(avctx, codec);
+        }
+        if (avcodec_open2(avctx, codec, NULL) < 0) {
+            fprintf(stderr, "open %s failed\n", codec->name);
+            avcodec_free_context(&avctx);
+            ret = -1;
+            break;
+        }
+        int64_t start = av_gettime_relative();
+        for (int n = 0; n < FRAMES_PER_SEGMENT; n++) {
+            AVFrame *frame = frames[n % FRAMES_IN_FLIGHT];
+            av_frame_unref(frame);
+            frame->width = avctx->width;
+            frame->height = avctx->height;
+            frame->format = AV_PIX_FMT_YUV420P;
+            if (avctx->get_buffer2(avctx, frame, AV_GET_BUFFER_FLAG_REF) < 0) {
+                fprintf(stderr, "get_buffer2 failed\n");
+                ret = -1;
+                break;
+            }
+            // 写入一行，模拟解码输出
+            memset(frame->data[0], n, (size_t) frame->linesize[0]);
+            if (usePool) {
+                for (int i = 0; i < 3; i++) {
+                    if (((intptr_t) frame->data[i] | frame->linesize[i]) % FRAME_POOL_ALIGN != 0) {
+                        fprintf(stderr, "plane %d is not aligned to %d\n", i, FRAME_POOL_ALIGN);
+                        ret = -1;
+                    }
+                }
+            }
+        }
+        total += av_gettime_relative() - start;
+        // 切换播放源时解码器释放所有帧
+        for (int i = 0; i < FRAMES_IN_FLIGHT; i++) {
+            av_frame_unref(frames[i]);
+        }
+        avcodec_free_context(&avctx);
+    }
+    for (int i = 0; i < FRAMES_IN_FLIGHT; i++) {
+        av_frame_free(&frames[i]);
+    }
+    *elapsed = total;
+    return ret;
+}
+
+int main() {
+    AVCodec *codec = findDecoder();
+    if (!codec) {
+        printf("no video decoder available, skip\n");
+        return 0;
+    }
+
+    int64_t defaultTime = 0;
+    int64_t poolTime = 0;
+    if (runSegments(codec, false, &defaultTime) < 0 || runSegments(codec, true, &poolTime) < 0) {
+        return 1;
+    }
+
+    FramePoolStats stats;
+    FrameBufferPool::getInstance()->getStats(&stats);
+    int frames = SEGMENT_COUNT * FRAMES_PER_SEGMENT;
+    printf("%s 1920x1080, %d frames in %d segments\n", codec->name, frames, SEGMENT_COUNT);
+    printf("default get_buffer2: %.2f us/frame\n", (double) defaultTime / frames);
+    printf("FrameBufferPool:     %.2f us/frame, alloc: %lld (%lld us), reuse: %lld, peak: %lld bytes\n",
+           (double) poolTime / frames, (long long) stats.allocCount, (long long) stats.allocTime,
+           (long long) stats.reuseCount, (long long) stats.peakSize);
+    FrameBufferPool::getInstance()->destroy();
+
+    // 切换播放源之后应该复用之前的缓冲区，新分配只发生在第一个播放源
+    if (stats.reuseCount <= 0 || stats.allocCount > FRAMES_IN_FLIGHT * 3) {
+        fprintf(stderr, "buffers are not reused across segments\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+#include "SampleConverter.h"
+#include "SampleConverterReference.h"
+
+#ifdef SAMPLE_CONVERTER_TEST_SWR
+extern "C" {
+#include "libswresample/swresample.h"
+}
+#endif
+
+// 每帧的采样点数，与 AAC 解码输出一致
+#define FRAME_SAMPLES 1024
+// 转换的帧数，48000Hz 时约 1 分钟
+#define FRAME_COUNT 2800
+
+struct BenchmarkCase {
+    const char *name;
+    AVSampleFormat srcFmt;
+    int srcChannels;
+    AVSampleFormat dstFmt;
+    int dstChannels;
+};
+
+static const BenchmarkCase CASES[] = {
+        {"fltp stereo -> s16 stereo", AV_SAMPLE_FMT_FLTP, 2, AV_SAMPLE_FMT_S16, 2},
+        {"fltp mono -> s16 stereo",   AV_SAMPLE_FMT_FLTP, 1, AV_SAMPLE_FMT_S16, 2},
+        {"fltp stereo -> s16 mono",   AV_SAMPLE_FMT_FLTP, 2, AV_SAMPLE_FMT_S16, 1},
+        {"s16p stereo -> s16 stereo", AV_SAMPLE_FMT_S16P, 2, AV_SAMPLE_FMT_S16, 2},
+        {"s16p mono -> s16 stereo",   AV_SAMPLE_FMT_S16P, 1, AV_SAMPLE_FMT_S16, 2},
+        {"fltp stereo -> flt stereo", AV_SAMPLE_FMT_FLTP, 2, AV_SAMPLE_FMT_FLT, 2},
+};
+
+static int64_t nowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#ifdef SAMPLE_CONVERTER_TEST_SWR
+static int64_t channelLayout(int channels) {
+    return channels == 1 ? AV_CH_LAYOUT_MONO : AV_CH_LAYOUT_STEREO;
+}
+#endif
+
+/**
+ * @param mode 0 为 SampleConverter，1 为标量参考实现，2 为 swresample
+ * @return 每帧的耗时，单位纳秒，< 0 为不支持
+ */
+static double runCase(const BenchmarkCase &cs, int mode, const std::vector<const uint8_t *> &src, uint8_t *dst) {
+#ifdef SAMPLE_CONVERTER_TEST_SWR
+    SwrContext *swr = NULL;
+    if (mode == 2) {
+        swr = swr_alloc_set_opts(NULL, channelLayout(cs.dstChannels), cs.dstFmt, 48000,
+                                 channelLayout(cs.srcChannels), cs.srcFmt, 48000, 0, NULL);
+        if (!swr || swr_init(swr) < 0) {
+            swr_free(&swr);
+            return -1;
+        }
+    }
+#else
+    if (mode == 2) {
+        return -1;
+    }
+#endif
+    int64_t start = nowUs();
+    for (int i = 0; i < FRAME_COUNT; i++) {
+        if (mode == 0) {
+            SampleConverter::convert(dst, cs.dstFmt, cs.dstChannels, src.data(), cs.srcFmt, cs.srcChannels,
+                                     FRAME_SAMPLES);
+        } else if (mode == 1) {
+            refConvert(dst, cs.dstFmt, cs.dstChannels, src.data(), cs.srcFmt, cs.srcChannels, FRAME_SAMPLES);
+        }
+#ifdef SAMPLE_CONVERTER_TEST_SWR
+        else {
+            swr_convert(swr, &dst, FRAME_SAMPLES, (const uint8_t **) src.data(), FRAME_SAMPLES);
+        }
+#endif
+    }
+    int64_t elapsed = nowUs() - start;
+#ifdef SAMPLE_CONVERTER_TEST_SWR
+    swr_free(&swr);
+#endif
+    return (double) elapsed * 1000.0 / FRAME_COUNT;
+}
+
+int main() {
+    srand(1);
+    std::vector<std::vector<float> > planes(2, std::vector<float>(FRAME_SAMPLES));
+    for (int c = 0; c < 2; c++) {
+        for (int i = 0; i < FRAME_SAMPLES; i++) {
+            planes[c][i] = (float) rand() / RAND_MAX * 2.0f - 1.0f;
+        }
+    }
+    std::vector<uint8_t> dst(FRAME_SAMPLES * 2 * sizeof(float));
+
+    printf("%d samples per frame, ns/frame:\n", FRAME_SAMPLES);
+    printf("%-28s %12s %12s %12s\n", "", "converter", "reference", "swresample");
+    for (size_t i = 0; i < sizeof(CASES) / sizeof(CASES[0]); i++) {
+        const BenchmarkCase &cs = CASES[i];
+        // S16P 输入使用同一块内存的前半部分，数值不影响耗时
+        std::vector<const uint8_t *> src(cs.srcChannels);
+        for (int c = 0; c < cs.srcChannels; c++) {
+            src[c] = (const uint8_t *) planes[c].data();
+        }
+        double converter = runCase(cs, 0, src, dst.data());
+        double reference = runCase(cs, 1, src, dst.data());
+        double swr = runCase(cs, 2, src, dst.data());
+        printf("%-28s %12.0f %12.0f ", cs.name, converter, reference);
+        if (swr >= 0) {
+            printf("%12.0f\n", swr);
+        } else {
+            printf("%12s\n", "-");
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,59 @@
+#ifndef SAMPLECONVERTERREFERENCE_H
+#define SAMPLECONVERTERREFERENCE_H
+
+#include <math.h>
+#include <stdint.h>
+
+extern "C" {
+#include "libavutil/common.h"
+#include "libavutil/samplefmt.h"
+}
+
+/**
+ * SampleConverter 的标量参考实现，逐个采样点按 SampleConverter.h 中描述的公式计算
+ * 只支持 SampleConverter::isSupported 接受的组合
+ */
+static inline int16_t refFloatToS16(float value) {
+    double scaled = (double) value * 32768.0;
+    return (int16_t) (scaled >= 32767.0 ? 32767 : scaled <= -32768.0 ? -32768 : lrint(scaled));
+}
+
+static inline void refConvert(uint8_t *dst, AVSampleFormat dstFmt, int dstChannels,
+                              const uint8_t *const *src, AVSampleFormat srcFmt, int srcChannels, int nbSamples) {
+    for (int i = 0; i < nbSamples; i++) {
+        if (dstFmt == AV_SAMPLE_FMT_FLT) {
+            for (int c = 0; c < dstChannels; c++) {
+                ((float *) dst)[i * dstChannels + c] = srcFmt == AV_SAMPLE_FMT_S16P
+                                                       ? ((const int16_t *) src[c])[i] * (1.0f / 32768.0f)
+                                                       : ((const float *) src[c])[i];
+            }
+            continue;
+        }
+        int16_t *out = (int16_t *) dst + i * dstChannels;
+        if (srcFmt == AV_SAMPLE_FMT_FLTP) {
+            const float *const *in = (const float *const *) src;
+            if (srcChannels == dstChannels) {
+                for (int c = 0; c < dstChannels; c++) {
+                    out[c] = refFloatToS16(in[c][i]);
+                }
+            } else if (srcChannels == 1) {
+                out[0] = out[1] = refFloatToS16(in[0][i] * 0.70710677f);
+            } else {
+                out[0] = refFloatToS16(in[0][i] * 0.5f + in[1][i] * 0.5f);
+            }
+        } else {
+            const int16_t *const *in = (const int16_t *const *) src;
+            if (srcChannels == dstChannels) {
+                for (int c = 0; c < dstChannels; c++) {
+                    out[c] = in[c][i];
+                }
+            } else if (srcChannels == 1) {
+                out[0] = out[1] = (int16_t) ((in[0][i] * 23170 + (1 << 14)) >> 15);
+            } else {
+                out[0] = (int16_t) ((in[0][i] + in[1][i] + 1) >> 1);
+            }
+        }
+    }
+}
+
+#endif //SAMPLECONVERTERREFERENCE_H
@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "SampleConverter.h"
+#include "SampleConverterReference.h"
+
+#ifdef SAMPLE_CONVERTER_TEST_SWR
+extern "C" {
+#include "libswresample/swresample.h"
+}
+#endif
+
+// 超出范围的输入，swresample 的 av_clip_int16(lrintf(x * 32768)) 在乘积超出 int32 时会回绕，与它比较时使用较小的值
+#ifdef SAMPLE_CONVERTER_TEST_SWR
+#define OVERFLOW_VALUE 1e4
+#else
+#define OVERFLOW_VALUE 1e10
+#endif
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: ", __FILE__, __LINE__); \
+        fprintf(stderr, __VA_ARGS__); \
+        fprintf(stderr, "\n"); \
+        failures++; \
+    } \
+} while (0)
+
+struct ConvertCase {
+    AVSampleFormat srcFmt;
+    int64_t srcLayout;
+    AVSampleFormat dstFmt;
+    int64_t dstLayout;
+};
+
+static const ConvertCase CASES[] = {
+        {AV_SAMPLE_FMT_FLTP, AV_CH_LAYOUT_MONO,    AV_SAMPLE_FMT_S16, AV_CH_LAYOUT_MONO},
+        {AV_SAMPLE_FMT_FLTP, AV_CH_LAYOUT_STEREO,  AV_SAMPLE_FMT_S16, AV_CH_LAYOUT_STEREO},
+        {AV_SAMPLE_FMT_FLTP, AV_CH_LAYOUT_5POINT1, AV_SAMPLE_FMT_S16, AV_CH_LAYOUT_5POINT1},
+        {AV_SAMPLE_FMT_FLTP, AV_CH_LAYOUT_MONO,    AV_SAMPLE_FMT_S16, AV_CH_LAYOUT_STEREO},
+        {AV_SAMPLE_FMT_FLTP, AV_CH_LAYOUT_STEREO,  AV_SAMPLE_FMT_S16, AV_CH_LAYOUT_MONO},
+        {AV_SAMPLE_FMT_S16P, AV_CH_LAYOUT_MONO,    AV_SAMPLE_FMT_S16, AV_CH_LAYOUT_MONO},
+        {AV_SAMPLE_FMT_S16P, AV_CH_LAYOUT_STEREO,  AV_SAMPLE_FMT_S16, AV_CH_LAYOUT_STEREO},
+        {AV_SAMPLE_FMT_S16P, AV_CH_LAYOUT_5POINT1, AV_SAMPLE_FMT_S16, AV_CH_LAYOUT_5POINT1},
+        {AV_SAMPLE_FMT_S16P, AV_CH_LAYOUT_MONO,    AV_SAMPLE_FMT_S16, AV_CH_LAYOUT_STEREO},
+        {AV_SAMPLE_FMT_S16P, AV_CH_LAYOUT_STEREO,  AV_SAMPLE_FMT_S16, AV_CH_LAYOUT_MONO},
+        {AV_SAMPLE_FMT_FLTP, AV_CH_LAYOUT_MONO,    AV_SAMPLE_FMT_FLT, AV_CH_LAYOUT_MONO},
+        {AV_SAMPLE_FMT_FLTP, AV_CH_LAYOUT_STEREO,  AV_SAMPLE_FMT_FLT, AV_CH_LAYOUT_STEREO},
+        {AV_SAMPLE_FMT_S16P, AV_CH_LAYOUT_STEREO,  AV_SAMPLE_FMT_FLT, AV_CH_LAYOUT_STEREO},
+};
+
+// 不链接 FFmpeg，声道数、采样大小和格式名称在这里计算
+static int channelCount(int64_t layout) {
+    return __builtin_popcountll((unsigned long long) layout);
+}
+
+static int bytesPerSample(AVSampleFormat fmt) {
+    return fmt == AV_SAMPLE_FMT_S16 || fmt == AV_SAMPLE_FMT_S16P ? 2 : 4;
+}
+
+static const char *formatName(AVSampleFormat fmt) {
+    return fmt == AV_SAMPLE_FMT_S16P ? "s16p" : fmt == AV_SAMPLE_FMT_FLTP ? "fltp"
+                                                : fmt == AV_SAMPLE_FMT_S16 ? "s16" : "flt";
+}
+
+/**
+ * 输入包含 0.5 个最低位的边界值、满幅度和超出范围的值，检查取整方式和饱和
+ */
+static void fillPlane(uint8_t *plane, AVSampleFormat fmt, int nbSamples) {
+    for (int i = 0; i < nbSamples; i++) {
+        int r = rand() % 8;
+        if (fmt == AV_SAMPLE_FMT_FLTP) {
+            float value;
+            if (r == 0) {
+                value = (float) (rand() % 65536 - 32768) / 65536.0f;
+            } else if (r == 1) {
+                value = rand() % 2 ? 1.0f : -1.0f;
+            } else if (r == 2) {
+                value = (float) (rand() % 2 ? OVERFLOW_VALUE : -3.5);
+            } else {
+                value = (float) rand() / RAND_MAX * 2.4f - 1.2f;
+            }
+            ((float *) plane)[i] = value;
+        } else {
+            ((int16_t *) plane)[i] = r == 0 ? INT16_MAX : r == 1 ? INT16_MIN : (int16_t) (rand() % 65536 - 32768);
+        }
+    }
+}
+
+#ifdef SAMPLE_CONVERTER_TEST_SWR
+
+/**
+ * swresample 在采样率不变时的输出，与 AudioResampler 中的参数一致
+ * @return 输出的采样点数，< 0 为失败
+ */
+static int swrConvert(uint8_t *dst, const ConvertCase &cs, const uint8_t *const *src, int nbSamples) {
+    SwrContext *swr = swr_alloc_set_opts(NULL, cs.dstLayout, cs.dstFmt, 48000, cs.srcLayout, cs.srcFmt, 48000, 0,
+                                         NULL);
+    if (!swr || swr_init(swr) < 0) {
+        swr_free(&swr);
+        return -1;
+    }
+    int ret = swr_convert(swr, &dst, nbSamples, (const uint8_t **) src, nbSamples);
+    swr_free(&swr);
+    return ret;
+}
+
+#endif
+
+static void testCase(const ConvertCase &cs, int nbSamples) {
+    int srcChannels = channelCount(cs.srcLayout);
+    int dstChannels = channelCount(cs.dstLayout);
+    const char *srcName = formatName(cs.srcFmt);
+    const char *dstName = formatName(cs.dstFmt);
+    CHECK(SampleConverter::isSupported(cs.srcFmt, cs.srcLayout, cs.dstFmt, cs.dstLayout),
+          "%s %dch -> %s %dch is not supported", srcName, srcChannels, dstName, dstChannels);
+
+    int srcBytes = bytesPerSample(cs.srcFmt);
+    int dstSize = nbSamples * dstChannels * bytesPerSample(cs.dstFmt);
+    std::vector<std::vector<uint8_t> > planes(srcChannels, std::vector<uint8_t>((size_t) nbSamples * srcBytes));
+    std::vector<const uint8_t *> src(srcChannels);
+    for (int c = 0; c < srcChannels; c++) {
+        fillPlane(planes[c].data(), cs.srcFmt, nbSamples);
+        src[c] = planes[c].data();
+    }
+    std::vector<uint8_t> out(dstSize), ref(dstSize);
+    int ret = SampleConverter::convert(out.data(), cs.dstFmt, dstChannels, src.data(), cs.srcFmt, srcChannels,
+                                       nbSamples);
+    CHECK(ret == 0, "convert %s %dch -> %s %dch failed", srcName, srcChannels, dstName, dstChannels);
+    refConvert(ref.data(), cs.dstFmt, dstChannels, src.data(), cs.srcFmt, srcChannels, nbSamples);
+    for (int i = 0; i < nbSamples * dstChannels; i++) {
+        bool equal = cs.dstFmt == AV_SAMPLE_FMT_S16 ? ((int16_t *) out.data())[i] == ((int16_t *) ref.data())[i]
+                                                    : ((float *) out.data())[i] == ((float *) ref.data())[i];
+        if (!equal) {
+            CHECK(false, "%s %dch -> %s %dch, %d samples, differs from the reference at %d",
+                  srcName, srcChannels, dstName, dstChannels, nbSamples, i);
+            break;
+        }
+    }
+
+#ifdef SAMPLE_CONVERTER_TEST_SWR
+    // swresample 的混音内核可能按不同的顺序累加，S16 允许 1 个最低位的差别
+    std::vector<uint8_t> swr(dstSize);
+    ret = swrConvert(swr.data(), cs, src.data(), nbSamples);
+    CHECK(ret == nbSamples, "swr_convert %s %dch -> %s %dch returned %d", srcName, srcChannels, dstName,
+          dstChannels, ret);
+    for (int i = 0; ret == nbSamples && i < nbSamples * dstChannels; i++) {
+        double diff = cs.dstFmt == AV_SAMPLE_FMT_S16
+                      ? abs(((int16_t *) out.data())[i] - ((int16_t *) swr.data())[i])
+                      : fabs(((float *) out.data())[i] - ((float *) swr.data())[i]) * 32768.0;
+        if (diff > 1) {
+            CHECK(false, "%s %dch -> %s %dch, %d samples, differs from swresample at %d by %g",
+                  srcName, srcChannels, dstName, dstChannels, nbSamples, i, diff);
+            break;
+        }
+    }
+#endif
+}
+
+int main() {
+    srand(1);
+    // 覆盖 SIMD 一次处理的 4、8 个采样点以及剩下的尾部
+    const int counts[] = {1, 3, 4, 7, 8, 9, 64, 1023, 1024};
+    for (size_t i = 0; i < sizeof(CASES) / sizeof(CASES[0]); i++) {
+        for (size_t n = 0; n < sizeof(counts) / sizeof(counts[0]); n++) {
+            testCase(CASES[i], counts[n]);
+        }
+    }
+    // 不支持的组合需要经过 swresample
+    CHECK(!SampleConverter::isSupported(AV_SAMPLE_FMT_FLTP, AV_CH_LAYOUT_MONO, AV_SAMPLE_FMT_FLT,
+                                        AV_CH_LAYOUT_STEREO), "FLTP mono -> FLT stereo should not be supported");
+    CHECK(!SampleConverter::isSupported(AV_SAMPLE_FMT_S16, AV_CH_LAYOUT_STEREO, AV_SAMPLE_FMT_S16,
+                                        AV_CH_LAYOUT_STEREO), "interleaved input should not be supported");
+    CHECK(!SampleConverter::isSupported(AV_SAMPLE_FMT_FLTP, AV_CH_LAYOUT_5POINT1, AV_SAMPLE_FMT_S16,
+                                        AV_CH_LAYOUT_STEREO), "5.1 downmix should not be supported");
+    if (failures) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("SampleConverterTest passed\n");
+    return 0;
+}
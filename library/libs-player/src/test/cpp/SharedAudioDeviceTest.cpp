@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+#include "SharedAudioDevice.h"
+#include "NullAudioDevice.h"
+
+// 正常输入和阻塞输入写入的采样值
+#define ACTIVE_VALUE 1000
+#define STALLED_VALUE 1001
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: ", __FILE__, __LINE__); \
+        fprintf(stderr, __VA_ARGS__); \
+        fprintf(stderr, "\n"); \
+        failures++; \
+    } \
+} while (0)
+
+/**
+ * 空音频设备输出的数据
+ */
+struct Capture {
+    std::mutex mutex;
+    int callbacks;
+    std::vector<int16_t> last;
+};
+
+/**
+ * 模拟播放器的回调，stalled 为 true 时阻塞，相当于等待解码
+ */
+struct Input {
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stalled;
+    bool abort;
+    int16_t value;
+    int callbacks;
+};
+
+static void captureCallback(void *userdata, uint8_t *stream, int len) {
+    Capture *capture = (Capture *) userdata;
+    std::unique_lock<std::mutex> lock(capture->mutex);
+    capture->callbacks++;
+    capture->last.assign((int16_t *) stream, (int16_t *) (stream + len));
+}
+
+static void inputCallback(void *userdata, uint8_t *stream, int len) {
+    Input *input = (Input *) userdata;
+    std::unique_lock<std::mutex> lock(input->mutex);
+    while (input->stalled && !input->abort) {
+        input->condition.wait(lock);
+    }
+    input->callbacks++;
+    int16_t *samples = (int16_t *) stream;
+    for (int i = 0; i < len / (int) sizeof(int16_t); i++) {
+        samples[i] = input->value;
+    }
+}
+
+static int openInput(SharedAudioDevice *device, Input *input) {
+    AudioDeviceSpec desired;
+    AudioDeviceSpec obtained;
+    memset(&desired, 0, sizeof(AudioDeviceSpec));
+    desired.freq = SHARED_AUDIO_SAMPLE_RATE;
+    desired.format = AV_SAMPLE_FMT_S16;
+    desired.channels = SHARED_AUDIO_CHANNELS;
+    desired.samples = AUDIO_MIN_BUFFER_SIZE;
+    desired.callback = inputCallback;
+    desired.userdata = input;
+    return device->open(&desired, &obtained);
+}
+
+/**
+ * 取最近一次输出的数据，检查所有采样点是否为期望的左右声道的值
+ */
+static bool lastOutputEquals(Capture *capture, int left, int right, int *callbacks) {
+    std::unique_lock<std::mutex> lock(capture->mutex);
+    *callbacks = capture->callbacks;
+    if (capture->last.empty()) {
+        return false;
+    }
+    for (size_t i = 0; i + 1 < capture->last.size(); i += 2) {
+        if (capture->last[i] != left || capture->last[i + 1] != right) {
+            fprintf(stderr, "output[%d] = %d %d, expected %d %d\n", (int) i, capture->last[i],
+                    capture->last[i + 1], left, right);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main() {
+    Capture capture;
+    capture.callbacks = 0;
+    NullAudioDevice::setCapture(captureCallback, &capture);
+
+    Input active;
+    active.stalled = false;
+    active.abort = false;
+    active.value = ACTIVE_VALUE;
+    active.callbacks = 0;
+    Input stalled;
+    stalled.stalled = true;
+    stalled.abort = false;
+    stalled.value = STALLED_VALUE;
+    stalled.callbacks = 0;
+
+    SharedAudioDevice *activeDevice = new SharedAudioDevice();
+    SharedAudioDevice *stalledDevice = new SharedAudioDevice();
+    if (openInput(activeDevice, &active) <= 0 || openInput(stalledDevice, &stalled) <= 0) {
+        fprintf(stderr, "open shared audio device failed\n");
+        return 1;
+    }
+    // 左右声道增益不同，走双声道的混音内核
+    stalledDevice->setStereoVolume(0.5f, 0.25f);
+    activeDevice->start();
+    stalledDevice->start();
+
+    // 一个输入阻塞在回调中，输出线程仍然按时混音，阻塞的输入以静音混入
+    usleep(300 * 1000);
+    int callbacks = 0;
+    CHECK(lastOutputEquals(&capture, ACTIVE_VALUE, ACTIVE_VALUE, &callbacks),
+          "output while one input is stalled");
+    CHECK(callbacks >= 15, "output stalled with a blocked input: %d callbacks in 300 ms", callbacks);
+
+    // 恢复后两个输入一起混音，乘积四舍五入：1001 * 0.5 = 500.5 -> 501，1001 * 0.25 = 250.25 -> 250
+    {
+        std::unique_lock<std::mutex> lock(stalled.mutex);
+        stalled.stalled = false;
+        stalled.condition.notify_all();
+    }
+    usleep(300 * 1000);
+    CHECK(lastOutputEquals(&capture, ACTIVE_VALUE + 501, ACTIVE_VALUE + 250, &callbacks),
+          "output after the stalled input resumed");
+    CHECK(stalled.callbacks > 0, "stalled input was not called after resuming");
+
+    // 暂停的输入不再混入
+    stalledDevice->pause();
+    usleep(100 * 1000);
+    CHECK(lastOutputEquals(&capture, ACTIVE_VALUE, ACTIVE_VALUE, &callbacks), "output with one input paused");
+
+    activeDevice->stop();
+    stalledDevice->stop();
+    delete activeDevice;
+    delete stalledDevice;
+    SharedAudioOutput::getInstance()->destroy();
+    NullAudioDevice::setCapture(NULL, NULL);
+
+    if (failures) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("SharedAudioDeviceTest passed, %d output callbacks\n", callbacks);
+    return 0;
+}
@@ -0,0 +1,132 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+#include "SoundTouch.h"
+#include "TDStretch.h"
+#include "cpu_detect.h"
+
+using namespace soundtouch;
+
+#define SAMPLE_RATE 48000
+#define CHANNELS 2
+// 重叠长度，单位采样点，与 48000Hz 时默认的 8ms 接近
+#define OVERLAP_LENGTH 384
+// 每个内核重复调用的次数
+#define KERNEL_ROUNDS 20000
+// 变速处理的音频时长，单位秒
+#define STRETCH_SECONDS 20
+#define STRETCH_TEMPO 1.5
+
+/**
+ * 打开受保护的互相关函数
+ */
+template<class T>
+class StretchProbe : public T {
+public:
+    StretchProbe() {
+        this->channels = CHANNELS;
+        this->overlapLength = OVERLAP_LENGTH;
+    }
+
+    double corr(const float *mixingPos, const float *compare, double &norm) {
+        return this->calcCrossCorr(mixingPos, compare, norm);
+    }
+};
+
+static int64_t nowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void fillSignal(float *buf, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        double t = (double) (i / CHANNELS) / SAMPLE_RATE;
+        buf[i] = (float) (0.5 * sin(2 * M_PI * 220.0 * t) + 0.1 * ((double) rand() / RAND_MAX - 0.5));
+    }
+}
+
+/**
+ * 互相关内核的单次调用耗时，对齐的输入保证 SSE 不会跳过计算
+ * @return 单位纳秒
+ */
+template<class T>
+static double timeCrossCorr(const float *mixing, const float *compare) {
+    StretchProbe<T> probe;
+    double norm = 0;
+    double sum = 0;
+    int64_t start = nowUs();
+    for (int i = 0; i < KERNEL_ROUNDS; i++) {
+        sum += probe.corr(mixing + (i & 7) * 4, compare, norm);
+    }
+    int64_t elapsed = nowUs() - start;
+    // 使用结果，避免被优化掉
+    if (sum == 12345.0) {
+        printf("\n");
+    }
+    return (double) elapsed * 1000.0 / KERNEL_ROUNDS;
+}
+
+/**
+ * 完整的变速处理，disableMask 为关闭的指令集，0xffffffff 为纯标量实现
+ * @return 单位毫秒
+ */
+static double timeStretch(uint disableMask, const std::vector<float> &input) {
+    // 指令集在创建 TDStretch 和 FIRFilter 时选择
+    disableExtensions(disableMask);
+    SoundTouch *soundTouch = new SoundTouch();
+    soundTouch->setSampleRate(SAMPLE_RATE);
+    soundTouch->setChannels(CHANNELS);
+    soundTouch->setTempo(STRETCH_TEMPO);
+    std::vector<float> output(4096 * CHANNELS);
+    const uint chunk = 1024;
+    uint frames = (uint) (input.size() / CHANNELS);
+    int64_t start = nowUs();
+    for (uint pos = 0; pos < frames; pos += chunk) {
+        soundTouch->putSamples(input.data() + pos * CHANNELS, chunk < frames - pos ? chunk : frames - pos);
+        while (soundTouch->receiveSamples(output.data(), 4096) > 0) {
+        }
+    }
+    int64_t elapsed = nowUs() - start;
+    delete soundTouch;
+    disableExtensions(0);
+    return (double) elapsed / 1000.0;
+}
+
+int main() {
+    srand(1);
+    uint extensions = detectCPUextensions();
+    float *mixing = NULL;
+    float *compare = NULL;
+    if (posix_memalign((void **) &mixing, 32, (OVERLAP_LENGTH + 64) * CHANNELS * sizeof(float)) != 0
+        || posix_memalign((void **) &compare, 32, OVERLAP_LENGTH * CHANNELS * sizeof(float)) != 0) {
+        return 1;
+    }
+    fillSignal(mixing, (OVERLAP_LENGTH + 64) * CHANNELS);
+    fillSignal(compare, OVERLAP_LENGTH * CHANNELS);
+
+    printf("cross correlation, %d channels, overlap %d:\n", CHANNELS, OVERLAP_LENGTH);
+    printf("  scalar: %8.1f ns\n", timeCrossCorr<TDStretch>(mixing, compare));
+#ifdef SOUNDTOUCH_ALLOW_SSE
+    if (extensions & SUPPORT_SSE) {
+        printf("  SSE:    %8.1f ns\n", timeCrossCorr<TDStretchSSE>(mixing, compare));
+    }
+#endif
+#ifdef SOUNDTOUCH_ALLOW_AVX2
+    if (extensions & SUPPORT_AVX2) {
+        printf("  AVX2:   %8.1f ns\n", timeCrossCorr<TDStretchAVX2>(mixing, compare));
+    }
+#endif
+    free(mixing);
+    free(compare);
+
+    std::vector<float> input((size_t) SAMPLE_RATE * STRETCH_SECONDS * CHANNELS);
+    fillSignal(input.data(), input.size());
+    double scalarTime = timeStretch(0xffffffff, input);
+    double simdTime = timeStretch(0, input);
+    printf("tempo %.1f, %d s of %d Hz stereo:\n", STRETCH_TEMPO, STRETCH_SECONDS, SAMPLE_RATE);
+    printf("  scalar: %8.2f ms\n", scalarTime);
+    printf("  SIMD:   %8.2f ms (%.2fx)\n", simdTime, scalarTime / simdTime);
+    return 0;
+}
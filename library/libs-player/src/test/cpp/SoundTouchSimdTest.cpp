@@ -0,0 +1,186 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "TDStretch.h"
+#include "FIRFilter.h"
+#include "cpu_detect.h"
+
+using namespace soundtouch;
+
+// 重叠长度，单位采样点，与 48000Hz 时默认的 8ms 接近且为 8 的倍数
+#define OVERLAP_LENGTH 384
+// 逐个比较的搜索位置数量
+#define SEEK_COUNT 256
+// 相对于结果最大值的误差上限
+#define TOLERANCE 1e-5
+
+static int failures = 0;
+
+/**
+ * 打开受保护的互相关函数，T 为标量实现 TDStretch 或者某个 SIMD 实现
+ */
+template<class T>
+class StretchProbe : public T {
+public:
+    void setup(int numChannels, int length) {
+        this->channels = numChannels;
+        this->overlapLength = length;
+    }
+
+    double corr(const float *mixingPos, const float *compare, double &norm) {
+        return this->calcCrossCorr(mixingPos, compare, norm);
+    }
+
+    double corrAccumulate(const float *mixingPos, const float *compare, double &norm) {
+        return this->calcCrossCorrAccumulate(mixingPos, compare, norm);
+    }
+};
+
+static float *allocAligned(size_t count) {
+    void *ptr = NULL;
+    if (posix_memalign(&ptr, 32, count * sizeof(float)) != 0) {
+        return NULL;
+    }
+    return (float *) ptr;
+}
+
+/**
+ * 带噪声的多个正弦波叠加，接近音乐信号的互相关分布
+ */
+static void fillSignal(float *buf, size_t count, int channels) {
+    for (size_t i = 0; i < count; i++) {
+        double t = (double) (i / channels) / 48000.0;
+        int c = (int) (i % channels);
+        buf[i] = (float) (0.5 * sin(2 * M_PI * 220.0 * t + c) + 0.25 * sin(2 * M_PI * 1375.0 * t)
+                          + 0.1 * ((double) rand() / RAND_MAX - 0.5));
+    }
+}
+
+/**
+ * 在每个搜索位置比较互相关和累加的互相关，SIMD 跳过的位置（返回 -1e50）不比较
+ */
+template<class T>
+static void compareCrossCorr(const char *name, int channels) {
+    StretchProbe<TDStretch> scalar;
+    StretchProbe<T> simd;
+    scalar.setup(channels, OVERLAP_LENGTH);
+    simd.setup(channels, OVERLAP_LENGTH);
+
+    size_t total = (size_t) channels * (OVERLAP_LENGTH + SEEK_COUNT + 1);
+    float *mixing = allocAligned(total);
+    float *compare = allocAligned((size_t) channels * OVERLAP_LENGTH);
+    fillSignal(mixing, total, channels);
+    fillSignal(compare, (size_t) channels * OVERLAP_LENGTH, channels);
+
+    std::vector<double> ref(SEEK_COUNT), out(SEEK_COUNT), refAcc(SEEK_COUNT), outAcc(SEEK_COUNT);
+    double refNorm = 0, outNorm = 0, refAccNorm = 0, outAccNorm = 0;
+    double maxValue = 0;
+    for (int i = 0; i < SEEK_COUNT; i++) {
+        const float *pos = mixing + i * channels;
+        ref[i] = scalar.corr(pos, compare, refNorm);
+        out[i] = simd.corr(pos, compare, outNorm);
+        if (i == 0) {
+            refAcc[i] = scalar.corr(pos, compare, refAccNorm);
+            outAcc[i] = simd.corr(pos, compare, outAccNorm);
+        } else {
+            refAcc[i] = scalar.corrAccumulate(pos, compare, refAccNorm);
+            outAcc[i] = simd.corrAccumulate(pos, compare, outAccNorm);
+        }
+        maxValue = fmax(maxValue, fabs(ref[i]));
+        if (out[i] > -1e49 && fabs(refNorm - outNorm) > TOLERANCE * refNorm) {
+            fprintf(stderr, "%s %dch: norm at %d: %g != %g\n", name, channels, i, outNorm, refNorm);
+            failures++;
+        }
+    }
+
+    double maxError = 0;
+    int compared = 0;
+    for (int i = 0; i < SEEK_COUNT; i++) {
+        if (out[i] > -1e49) {
+            maxError = fmax(maxError, fabs(out[i] - ref[i]));
+            compared++;
+        }
+        if (outAcc[i] > -1e49) {
+            maxError = fmax(maxError, fabs(outAcc[i] - refAcc[i]));
+        }
+    }
+    printf("%-6s %dch cross correlation: %d offsets, max error %.3g (max value %.3g)\n", name, channels, compared,
+           maxError, maxValue);
+    if (compared == 0 || maxError > TOLERANCE * maxValue) {
+        fprintf(stderr, "%s %dch cross correlation exceeds tolerance\n", name, channels);
+        failures++;
+    }
+    free(mixing);
+    free(compare);
+}
+
+/**
+ * 同样的系数和输入，比较双声道 FIR 滤波的输出
+ */
+template<class T>
+static void compareFir(const char *name, uint length) {
+    FIRFilter scalar;
+    T simd;
+    std::vector<float> coeffs(length);
+    for (uint i = 0; i < length; i++) {
+        coeffs[i] = (float) ((double) rand() / RAND_MAX - 0.5);
+    }
+    scalar.setCoefficients(coeffs.data(), length, 5);
+    simd.setCoefficients(coeffs.data(), length, 5);
+
+    const uint frames = 4096;
+    float *src = allocAligned(frames * 2);
+    float *ref = allocAligned(frames * 2);
+    float *out = allocAligned(frames * 2);
+    fillSignal(src, frames * 2, 2);
+    uint refCount = scalar.evaluate(ref, src, frames, 2);
+    uint outCount = simd.evaluate(out, src, frames, 2);
+    double maxError = 0;
+    double maxValue = 0;
+    for (uint i = 0; i < refCount * 2 && refCount == outCount; i++) {
+        maxError = fmax(maxError, fabs(out[i] - ref[i]));
+        maxValue = fmax(maxValue, fabs(ref[i]));
+    }
+    printf("%-6s FIR %u taps: %u frames, max error %.3g (max value %.3g)\n", name, length, outCount, maxError,
+           maxValue);
+    if (refCount != outCount || refCount == 0 || maxError > TOLERANCE * maxValue) {
+        fprintf(stderr, "%s FIR %u taps exceeds tolerance, frames %u/%u\n", name, length, outCount, refCount);
+        failures++;
+    }
+    free(src);
+    free(ref);
+    free(out);
+}
+
+int main() {
+    srand(1);
+    uint extensions = detectCPUextensions();
+    int tested = 0;
+#ifdef SOUNDTOUCH_ALLOW_SSE
+    if (extensions & SUPPORT_SSE) {
+        compareCrossCorr<TDStretchSSE>("SSE", 1);
+        compareCrossCorr<TDStretchSSE>("SSE", 2);
+        compareFir<FIRFilterSSE>("SSE", 32);
+        compareFir<FIRFilterSSE>("SSE", 64);
+        tested++;
+    }
+#endif
+#ifdef SOUNDTOUCH_ALLOW_AVX2
+    if (extensions & SUPPORT_AVX2) {
+        compareCrossCorr<TDStretchAVX2>("AVX2", 1);
+        compareCrossCorr<TDStretchAVX2>("AVX2", 2);
+        compareFir<FIRFilterAVX2>("AVX2", 32);
+        compareFir<FIRFilterAVX2>("AVX2", 64);
+        tested++;
+    }
+#endif
+    if (tested == 0) {
+        printf("no SIMD kernels available on this CPU\n");
+    }
+    if (failures) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <string.h>
+#include "VideoFilter.h"
+
+// 每种滤镜处理的帧数
+#define FRAME_COUNT 60
+#define FRAME_WIDTH 1920
+#define FRAME_HEIGHT 1080
+
+static const char *FILTERS[] = {
+        "null",
+        "yadif",
+        "yadif=1",
+        "bwdif",
+        "hqdn3d",
+        "transpose=1",
+        "scale=1280:-2",
+};
+
+/**
+ * 生成随帧移动的渐变图像，避免降噪和去隔行滤镜走静止画面的捷径
+ */
+static int fillFrame(AVFrame *frame, int index) {
+    av_frame_unref(frame);
+    frame->width = FRAME_WIDTH;
+    frame->height = FRAME_HEIGHT;
+    frame->format = AV_PIX_FMT_YUV420P;
+    frame->sample_aspect_ratio = (AVRational) {1, 1};
+    frame->pts = index;
+    if (av_frame_get_buffer(frame, 0) < 0) {
+        return -1;
+    }
+    for (int y = 0; y < FRAME_HEIGHT; y++) {
+        uint8_t *line = frame->data[0] + y * frame->linesize[0];
+        for (int x = 0; x < FRAME_WIDTH; x++) {
+            line[x] = (uint8_t) (x + y + index * 4);
+        }
+    }
+    for (int i = 1; i < 3; i++) {
+        for (int y = 0; y < FRAME_HEIGHT / 2; y++) {
+            memset(frame->data[i] + y * frame->linesize[i], 128 + (index & 15), FRAME_WIDTH / 2);
+        }
+    }
+    return 0;
+}
+
+/**
+ * 不开启滤镜线程，直接用 sendFrame/receiveFrame 同步处理
+ * @param outputCount 输出的帧数
+ * @param elapsed 总耗时，单位微秒
+ * @return 0 为成功
+ */
+static int runFilter(const char *filters, int threads, int *outputCount, int64_t *elapsed) {
+    PlayerState *playerState = new PlayerState();
+    playerState->filter_threads = threads;
+    VideoFilter *filter = new VideoFilter(playerState, filters, (AVRational) {1, 25}, (AVRational) {25, 1});
+    AVFrame *input = av_frame_alloc();
+    AVFrame *output = av_frame_alloc();
+    int ret = 0;
+    int count = 0;
+    int64_t total = 0;
+    for (int i = 0; i <= FRAME_COUNT && ret == 0; i++) {
+        // 最后送入 NULL 取出滤镜中缓存的帧
+        if (i < FRAME_COUNT && fillFrame(input, i) < 0) {
+            ret = -1;
+            break;
+        }
+        int64_t start = av_gettime_relative();
+        ret = filter->sendFrame(i < FRAME_COUNT ? input : NULL);
+        while (ret == 0) {
+            int got = filter->receiveFrame(output);
+            if (got < 0) {
+                if (got != AVERROR(EAGAIN) && got != AVERROR_EOF) {
+                    ret = got;
+                }
+                break;
+            }
+            if (output->format != AV_PIX_FMT_YUV420P && output->format != AV_PIX_FMT_YUVJ420P
+                && output->format != AV_PIX_FMT_BGRA) {
+                fprintf(stderr, "%s: unexpected output format %d\n", filters, output->format);
+                ret = -1;
+            }
+            count++;
+            av_frame_unref(output);
+        }
+        total += av_gettime_relative() - start;
+    }
+    av_frame_free(&input);
+    av_frame_free(&output);
+    delete filter;
+    delete playerState;
+    *outputCount = count;
+    *elapsed = total;
+    return ret;
+}
+
+int main() {
+    int failed = 0;
+    printf("%dx%d YUV420P, %d frames\n", FRAME_WIDTH, FRAME_HEIGHT, FRAME_COUNT);
+    for (size_t i = 0; i < sizeof(FILTERS) / sizeof(FILTERS[0]); i++) {
+        // 单线程和自动线程数
+        for (int threads = 1; threads >= 0; threads--) {
+            int count = 0;
+            int64_t elapsed = 0;
+            if (runFilter(FILTERS[i], threads, &count, &elapsed) < 0 || count <= 0) {
+                fprintf(stderr, "%s failed, output %d frames\n", FILTERS[i], count);
+                failed = 1;
+                continue;
+            }
+            printf("%-16s threads: %-4s %8.2f ms/frame, output %d frames\n", FILTERS[i],
+                   threads ? "1" : "auto", (double) elapsed / FRAME_COUNT / 1000.0, count);
+        }
+    }
+    return failed;
+}